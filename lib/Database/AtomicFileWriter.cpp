@@ -0,0 +1,131 @@
+#include <AtomicFileWriter.h>
+
+#include <vector>
+
+#if defined(ESP32)
+#include <SPIFFS.h>
+#endif
+
+const char AtomicFileWriter::TEMP_DIRECTORY[] = "/x";
+
+// Temp files are named TEMP_PREFIX<id>, and their journals have
+// JOURNAL_SUFFIX appended
+static const char TEMP_PREFIX[] = "atomic.";
+static const char JOURNAL_SUFFIX[] = ".dst";
+
+std::atomic<uint32_t> AtomicFileWriter::nextId(0);
+
+AtomicFileWriter::AtomicFileWriter()
+  : AtomicFileWriter(nextId++)
+{ }
+
+AtomicFileWriter::AtomicFileWriter(uint32_t id)
+  : id(id)
+  , tempPath(String(TEMP_DIRECTORY) + "/" + TEMP_PREFIX + id)
+{ }
+
+String AtomicFileWriter::getJournalPath() const {
+  return tempPath + JOURNAL_SUFFIX;
+}
+
+File AtomicFileWriter::open(const char* mode) {
+  return SPIFFS.open(tempPath, mode);
+}
+
+bool AtomicFileWriter::commit(const String& path) {
+  const String journalPath = getJournalPath();
+  File journal = SPIFFS.open(journalPath, "w");
+
+  if (!journal) {
+    abort();
+    return false;
+  }
+
+  // The newline marks the journal as complete
+  journal.print(path);
+  journal.print('\n');
+  journal.close();
+
+  // From here on, recover() will finish the job if power is lost
+  SPIFFS.remove(path);
+  bool renamed = SPIFFS.rename(tempPath, path);
+  SPIFFS.remove(journalPath);
+
+  return renamed;
+}
+
+void AtomicFileWriter::abort() {
+  SPIFFS.remove(tempPath);
+  SPIFFS.remove(getJournalPath());
+}
+
+// Full paths of the files in directory
+static std::vector<String> listFiles(const char* directory) {
+  std::vector<String> paths;
+
+#if defined(ESP8266)
+  Dir dir = SPIFFS.openDir(directory);
+
+  while (dir.next()) {
+    paths.push_back(dir.fileName());
+  }
+#else
+  File dir = SPIFFS.open(directory);
+
+  if (dir && dir.isDirectory()) {
+    while (File file = dir.openNextFile()) {
+      paths.push_back(file.name());
+      file.close();
+    }
+  }
+#endif
+
+  // Some versions of SPIFFS give the full path, and others just the name
+  for (String& path : paths) {
+    path = String(directory) + "/" + path.substring(path.lastIndexOf('/') + 1);
+  }
+
+  return paths;
+}
+
+void AtomicFileWriter::recover() {
+  const String prefix = String(TEMP_DIRECTORY) + "/" + TEMP_PREFIX;
+  std::vector<String> journals;
+  std::vector<String> temps;
+
+  // Sorted out first so that files aren't removed while the directory is
+  // being read
+  for (const String& path : listFiles(TEMP_DIRECTORY)) {
+    if (path.startsWith(prefix)) {
+      (path.endsWith(JOURNAL_SUFFIX) ? journals : temps).push_back(path);
+    }
+  }
+
+  for (const String& journalPath : journals) {
+    const String tempPath =
+        journalPath.substring(0, journalPath.length() - strlen(JOURNAL_SUFFIX));
+
+    File journal = SPIFFS.open(journalPath, "r");
+    String path = journal.readString();
+    journal.close();
+
+    if (path.endsWith("\n") && SPIFFS.exists(tempPath)) {
+      path.remove(path.length() - 1);
+
+      Serial.printf_P(PSTR("AtomicFileWriter: finishing write to %s\n"), path.c_str());
+
+      SPIFFS.remove(path);
+      SPIFFS.rename(tempPath, path);
+    }
+
+    SPIFFS.remove(journalPath);
+  }
+
+  // Never committed.  The original files are untouched.
+  for (const String& tempPath : temps) {
+    if (SPIFFS.exists(tempPath)) {
+      Serial.println(F("AtomicFileWriter: discarding uncommitted write"));
+      SPIFFS.remove(tempPath);
+    }
+  }
+}
@@ -0,0 +1,78 @@
+#include <Arduino.h>
+#include <FS.h>
+
+#include <atomic>
+
+#pragma once
+
+/**
+ * Replaces files so that losing power part way through never leaves a
+ * partially written one behind.
+ *
+ * New contents are written to a temp file.  To commit, the destination is
+ * recorded in a journal, the old file is removed, and the temp file is renamed
+ * into place.  SPIFFS can't rename over an existing file, so recover() must be
+ * called at boot to finish (or discard) a write that was interrupted.
+ *
+ * Each writer has a temp file and journal of its own, so several writes can
+ * be in progress at once.  A writer is identified by its ID, which lets a
+ * write that spans several calls (e.g., the chunks of an upload) be picked up
+ * again without keeping a File open in between.
+ */
+class AtomicFileWriter {
+public:
+  static const char TEMP_DIRECTORY[];
+
+  /**
+   * Starts a new write, with a temp file that no other writer is using
+   */
+  AtomicFileWriter();
+
+  /**
+   * Continues the write with the given ID
+   *
+   * @param id
+   */
+  explicit AtomicFileWriter(uint32_t id);
+
+  inline uint32_t getId() const { return id; }
+  inline const String& getTempPath() const { return tempPath; }
+
+  /**
+   * Opens the temp file.  Use "w" to start writing, "a" to add to what's
+   * already been written, and "r" to read it back before committing.
+   *
+   * @param mode
+   * @return File
+   */
+  File open(const char* mode = "w");
+
+  /**
+   * Replaces path with the contents of the temp file.  The temp file must be
+   * closed.
+   *
+   * @param path
+   * @return bool true iff path was replaced
+   */
+  bool commit(const String& path);
+
+  /**
+   * Discards the temp file
+   */
+  void abort();
+
+  /**
+   * Completes commits that were interrupted, and discards temp files from
+   * writes that were never committed (including ones whose request was
+   * dropped part way through).
+   */
+  static void recover();
+
+private:
+  static std::atomic<uint32_t> nextId;
+
+  const uint32_t id;
+  const String tempPath;
+
+  String getJournalPath() const;
+};
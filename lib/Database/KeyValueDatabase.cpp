@@ -1,7 +1,9 @@
 #include <KeyValueDatabase.h>
+#include <Metrics.h>
 #include <SPIFFS.h>
 
-KeyValueDatabase::KeyValueDatabase() : db(nullptr), _size(0) {}
+KeyValueDatabase::KeyValueDatabase()
+  : db(nullptr), _size(0), batchDepth(0), sizeDirty(false) {}
 
 void KeyValueDatabase::open(File _db) {
   if (this->db) {
@@ -34,12 +36,15 @@ void KeyValueDatabase::initialize() {
   }
 
   db.flush();
+  METRIC_INC(kvFlushes);
 }
 
 bool KeyValueDatabase::get(const char* key,
     size_t keyLength,
     char* valueBuffer,
     size_t valueBufferLen) {
+  METRIC_INC(kvReads);
+
   size_t rowSize = seekToRow(key, keyLength);
 
   if (!rowSize) {
@@ -60,6 +65,8 @@ bool KeyValueDatabase::get(const char* key,
 
 void KeyValueDatabase::set(
     const char* key, size_t keyLength, const char* value, size_t valueLength) {
+  METRIC_INC(kvWrites);
+
   size_t existingRowSize = seekToRow(key, keyLength);
   size_t newRowSize = keyLength + valueLength;
 
@@ -86,10 +93,12 @@ void KeyValueDatabase::set(
     }
   }
 
-  db.flush();
+  commit();
 }
 
 void KeyValueDatabase::erase(const char* key, size_t keyLength) {
+  METRIC_INC(kvWrites);
+
   if (seekToRow(key, keyLength)) {
     db.seek(db.position() - keyLength - 1, SeekSet);
     db.write(0);
@@ -98,7 +107,7 @@ void KeyValueDatabase::erase(const char* key, size_t keyLength) {
     flushSize();
   }
 
-  db.flush();
+  commit();
 }
 
 void KeyValueDatabase::writeRow(const char* key,
@@ -185,7 +194,7 @@ size_t KeyValueDatabase::seekToEmptyRow(size_t rowLength) {
   for (uint8_t i = 0; i < rowCapacity + 2; ++i) {
     db.write(0);
   }
-  db.flush();
+  commit();
 
   // Seek back to beginning of row
   db.seek(db.position() - rowCapacity - 2, SeekSet);
@@ -211,9 +220,42 @@ void KeyValueDatabase::writeUint32(uint32_t val) {
 }
 
 void KeyValueDatabase::flushSize() {
+  // The header is rewritten once when the batch ends
+  if (batchDepth > 0) {
+    sizeDirty = true;
+    return;
+  }
+
   db.seek(4, SeekSet);
   writeUint32(_size);
   db.flush();
+  METRIC_INC(kvFlushes);
+
+  sizeDirty = false;
+}
+
+void KeyValueDatabase::commit() {
+  if (batchDepth == 0) {
+    db.flush();
+    METRIC_INC(kvFlushes);
+  }
+}
+
+void KeyValueDatabase::beginBatch() {
+  ++batchDepth;
+}
+
+void KeyValueDatabase::endBatch() {
+  if (batchDepth == 0 || --batchDepth > 0) {
+    return;
+  }
+
+  if (sizeDirty) {
+    flushSize();
+  } else {
+    db.flush();
+    METRIC_INC(kvFlushes);
+  }
 }
 
 void KeyValueDatabase::readSize() {
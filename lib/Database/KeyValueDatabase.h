@@ -88,6 +88,18 @@ public:
    */
   bool skipRead(size_t count);
 
+  /**
+   * Defer flushing writes until the matching call to endBatch().  Batches can
+   * be nested; only the outermost endBatch() flushes.
+   */
+  void beginBatch();
+
+  /**
+   * Write the size header if it changed and flush everything written since
+   * beginBatch().
+   */
+  void endBatch();
+
 private:
   /**
    * Writes a row with the given key and value.  Assumes that the file pointer is in the appropriate position.
@@ -129,6 +141,13 @@ private:
   void flushSize();
   void readSize();
 
+  /**
+   * Flush pending writes, unless a batch is in progress.
+   */
+  void commit();
+
   File db;
   uint32_t _size;
+  uint8_t batchDepth;
+  bool sizeDirty;
 };
\ No newline at end of file
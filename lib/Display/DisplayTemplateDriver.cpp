@@ -1,6 +1,11 @@
 #include <DisplayTemplateDriver.h>
+#include <DisplayTypeHelpers.h>
 #include <FS.h>
 #include <FillStyle.h>
+#include <Metrics.h>
+#include <TemplateCache.h>
+#include <TextAlignment.h>
+#include <TextLayout.h>
 
 #define JSON_VAL_OR_DEFAULT(json, key, d) \
   (json.containsKey(key) ? json[key] : d)
@@ -8,11 +13,15 @@
 DisplayTemplateDriver::DisplayTemplateDriver(
     GxEPD2_GFX* display, Settings& settings)
     : display(display)
+    , panel(settings.display.display_type)
     , settings(settings)
     , onVariableUpdateFn(nullptr)
     , onRegionUpdateFn(nullptr)
     , dirty(true)
     , shouldFullUpdate(false)
+    , renderingSuspended(false)
+    , pendingRefresh(false)
+    , skippedRefreshes(0)
     , lastFullUpdate(0) {
 #if defined(ESP32)
   mutex = xSemaphoreCreateMutex();
@@ -52,6 +61,7 @@ void DisplayTemplateDriver::loop() {
 
     // Delete regions so we don't have unused regions hanging around
     regions.clear();
+    std::atomic_store(&formatterFactory, std::shared_ptr<const VariableFormatterFactory>());
 
     // Always schedule a full update.  Even if template is the same, it could've
     // changed.
@@ -64,7 +74,12 @@ void DisplayTemplateDriver::loop() {
     this->newTemplate = "";
   }
 
-  if (shouldFullUpdate || dirty) {
+  if (renderingSuspended) {
+    if (pendingRefresh) {
+      ++skippedRefreshes;
+      pendingRefresh = false;
+    }
+  } else if (shouldFullUpdate || dirty) {
     time_t now = millis();
 
     if (shouldFullUpdate ||
@@ -88,6 +103,46 @@ void DisplayTemplateDriver::loop() {
 
 void DisplayTemplateDriver::scheduleFullUpdate() { shouldFullUpdate = true; }
 
+Framebuffer DisplayTemplateDriver::getFramebuffer() {
+  return DisplayTypeHelpers::getFramebuffer(panel, display);
+}
+
+void DisplayTemplateDriver::suspendRendering() {
+#if defined(ESP32)
+  xSemaphoreTake(mutex, portMAX_DELAY);
+#endif
+
+  renderingSuspended = true;
+  pendingRefresh = false;
+  skippedRefreshes = 0;
+
+#if defined(ESP32)
+  xSemaphoreGive(mutex);
+#endif
+}
+
+uint32_t DisplayTemplateDriver::resumeRendering() {
+#if defined(ESP32)
+  xSemaphoreTake(mutex, portMAX_DELAY);
+#endif
+
+  // Changes since the last loop() are rendered by the consolidated refresh
+  if (pendingRefresh) {
+    ++skippedRefreshes;
+    pendingRefresh = false;
+  }
+
+  const uint32_t saved = skippedRefreshes > 0 ? skippedRefreshes - 1 : 0;
+  renderingSuspended = false;
+  skippedRefreshes = 0;
+
+#if defined(ESP32)
+  xSemaphoreGive(mutex);
+#endif
+
+  return saved;
+}
+
 void DisplayTemplateDriver::clearDirtyRegions() {
   DoublyLinkedListNode<std::shared_ptr<Region>>* curr = regions.getHead();
 
@@ -109,6 +164,8 @@ void DisplayTemplateDriver::flushDirtyRegions(bool updateScreen) {
     if (region->isDirty()) {
       Serial.printf_P(PSTR("Rendering %s\n"),
           region->getVariableName().c_str());
+
+      METRIC_TIME(regionRender);
       region->render(display);
     }
 
@@ -117,6 +174,9 @@ void DisplayTemplateDriver::flushDirtyRegions(bool updateScreen) {
 
   // Can skip partial updates if we don't need to update the screen
   if (updateScreen) {
+    METRIC_TIME(flushDirtyRegions);
+    uint32_t numWindows = 0;
+
     // Issue partial updates to bounding boxes
     // This is crappy and O(n^2), but shouldn't matter unless there are
     // shitlaods of regions.
@@ -134,6 +194,8 @@ void DisplayTemplateDriver::flushDirtyRegions(bool updateScreen) {
         if (!DisplayTemplateDriver::regionContainedIn(bb, flushedRegions)) {
           if (settings.display.windowed_updates) {
             display->displayWindow(bb.x, bb.y, bb.w, bb.h);
+            METRIC_OBSERVE(refreshWindowArea, bb.w * bb.h);
+            ++numWindows;
           }
           flushedRegions.add(bb);
         }
@@ -146,8 +208,13 @@ void DisplayTemplateDriver::flushDirtyRegions(bool updateScreen) {
     // partial mode.
     if (!settings.display.windowed_updates) {
       display->display(true);
+      METRIC_OBSERVE(
+          refreshWindowArea, display->width() * display->height());
+      ++numWindows;
     }
 
+    METRIC_OBSERVE(refreshWindows, numWindows);
+
     display->powerOff();
   }
 }
@@ -173,12 +240,16 @@ bool DisplayTemplateDriver::regionContainedIn(
 
 void DisplayTemplateDriver::fullUpdate() {
   flushDirtyRegions(false);
+
+  METRIC_TIME(fullUpdate);
   display->setFullWindow();
   display->display(false);
 }
 
 void DisplayTemplateDriver::updateVariable(
     const String& key, const String& value) {
+  METRIC_TIME(updateVariable);
+
 #if defined(ESP32)
   xSemaphoreTake(mutex, portMAX_DELAY);
 #endif
@@ -191,15 +262,7 @@ void DisplayTemplateDriver::updateVariable(
     std::shared_ptr<Region> region = curr->data;
 
     if (region->getVariableName() == key) {
-      if (region->updateValue(value)) {
-        this->dirty = true;
-
-        if (this->onRegionUpdateFn) {
-          this->onRegionUpdateFn(region->getId(),
-              key,
-              region->getVariableValue(key));
-        }
-      }
+      updateRegion(region, value);
     }
 
     curr = curr->next;
@@ -215,6 +278,60 @@ void DisplayTemplateDriver::updateVariable(
 #endif
 }
 
+void DisplayTemplateDriver::updateVariables(const VariableBatch& batch) {
+  if (batch.empty()) {
+    return;
+  }
+
+#if defined(ESP32)
+  xSemaphoreTake(mutex, portMAX_DELAY);
+#endif
+
+  vars.beginBatch();
+  for (const auto& entry : batch) {
+    vars.set(entry.first, entry.second);
+  }
+  vars.endBatch();
+
+  DoublyLinkedListNode<std::shared_ptr<Region>>* curr = regions.getHead();
+
+  while (curr != NULL) {
+    std::shared_ptr<Region> region = curr->data;
+    auto match = batch.find(region->getVariableName());
+
+    if (match != batch.end()) {
+      updateRegion(region, match->second);
+    }
+
+    curr = curr->next;
+  }
+
+  if (this->onVariableUpdateFn) {
+    for (const auto& entry : batch) {
+      if (entry.first != "timestamp") {
+        this->onVariableUpdateFn(entry.first, entry.second);
+      }
+    }
+  }
+
+#if defined(ESP32)
+  xSemaphoreGive(mutex);
+#endif
+}
+
+void DisplayTemplateDriver::updateRegion(
+    std::shared_ptr<Region>& region, const String& value) {
+  if (region->updateValue(value)) {
+    this->dirty = true;
+    this->pendingRefresh = true;
+
+    if (this->onRegionUpdateFn) {
+      const String& key = region->getVariableName();
+      this->onRegionUpdateFn(region->getId(), key, region->getVariableValue(key));
+    }
+  }
+}
+
 void DisplayTemplateDriver::deleteVariable(const String& key) {
   updateVariable(key, "");
   vars.erase(key);
@@ -236,6 +353,52 @@ const String& DisplayTemplateDriver::getTemplateFilename() {
   return templateFilename;
 }
 
+void DisplayTemplateDriver::invalidateTemplate(const String& path) {
+#if defined(ESP32)
+  xSemaphoreTake(mutex, portMAX_DELAY);
+#endif
+
+  if (newTemplate.length() == 0 && path == templateFilename) {
+    newTemplate = templateFilename;
+  }
+
+#if defined(ESP32)
+  xSemaphoreGive(mutex);
+#endif
+}
+
+void DisplayTemplateDriver::invalidateFonts() {
+#if defined(ESP32)
+  xSemaphoreTake(mutex, portMAX_DELAY);
+#endif
+
+  fonts.invalidate();
+
+  if (newTemplate.length() == 0) {
+    newTemplate = templateFilename;
+  }
+
+#if defined(ESP32)
+  xSemaphoreGive(mutex);
+#endif
+}
+
+// Doesn't take the lock.  The font store has its own, and the rest of
+// validation only reads the template and SPIFFS.
+bool DisplayTemplateDriver::validateTemplate(
+    JsonDocument& tmpl, JsonArray errors) {
+  return checkTemplate(tmpl, errors);
+}
+
+bool DisplayTemplateDriver::checkTemplate(
+    JsonDocument& tmpl, JsonArray errors) {
+  TemplateValidator validator(
+      [](const char* path) { return SPIFFS.exists(path); },
+      [this](const char* name) { return fonts.contains(name); });
+
+  return validator.validate(tmpl, errors);
+}
+
 void DisplayTemplateDriver::loadTemplate(const String& templateFilename) {
   if (!SPIFFS.exists(templateFilename)) {
     Serial.println(F("WARN - template file does not exist"));
@@ -247,11 +410,28 @@ void DisplayTemplateDriver::loadTemplate(const String& templateFilename) {
   Serial.print(F("Loading template: "));
   Serial.println(templateFilename);
 
-  File file = SPIFFS.open(templateFilename, "r");
-
   DynamicJsonDocument jsonBuffer(JSON_TEMPLATE_BUFFER_SIZE);
-  deserializeJson(jsonBuffer, file);
-  file.close();
+
+  // Templates saved before they were validated on upload are compiled the
+  // first time they're loaded
+  if (!TemplateCache::load(templateFilename, jsonBuffer)) {
+    File file = SPIFFS.open(templateFilename, "r");
+    deserializeJson(jsonBuffer, file);
+    file.close();
+
+    StaticJsonDocument<1024> errors;
+
+    if (!jsonBuffer.isNull()
+        && checkTemplate(jsonBuffer, errors.to<JsonArray>())) {
+      TemplateCache::save(templateFilename, jsonBuffer);
+    } else {
+      for (JsonObject error : errors.as<JsonArray>()) {
+        Serial.printf_P(PSTR("WARN - invalid template: %s: %s\n"),
+            error["path"].as<const char*>(),
+            error["message"].as<const char*>());
+      }
+    }
+  }
 
   JsonObject tmpl = jsonBuffer.as<JsonObject>();
 
@@ -270,39 +450,27 @@ void DisplayTemplateDriver::loadTemplate(const String& templateFilename) {
 
   display->fillScreen(backgroundColor);
 
-  if (tmpl.containsKey("rotation")) {
-    display->setRotation(tmpl["rotation"]);
+  JsonVariant rotation = tmpl["rotation"];
+  if (!rotation.isNull()) {
+    display->setRotation(rotation);
   }
 
   JsonVariant formatters = tmpl["formatters"];
-  VariableFormatterFactory formatterFactory(formatters);
+  auto factory = std::make_shared<const VariableFormatterFactory>(formatters);
 
   JsonObject updateRects = tmpl["update_rects"];
 
-  if (tmpl.containsKey("lines")) {
-    renderLines(tmpl["lines"].as<JsonArray>());
-  }
-
-  if (tmpl.containsKey("bitmaps")) {
-    renderBitmaps(formatterFactory, tmpl["bitmaps"], backgroundColor);
-  }
+  // Missing sections are null arrays, which render nothing
+  renderLines(tmpl["lines"]);
+  renderBitmaps(*factory, tmpl["bitmaps"], backgroundColor);
+  renderTexts(*factory, updateRects, tmpl["text"], backgroundColor);
+  renderRectangles(*factory, tmpl["rectangles"], backgroundColor);
 
-  if (tmpl.containsKey("text")) {
-    renderTexts(formatterFactory,
-        updateRects,
-        tmpl["text"].as<JsonArray>(),
-        backgroundColor);
-  }
-
-  if (tmpl.containsKey("rectangles")) {
-    renderRectangles(formatterFactory,
-        tmpl["rectangles"].as<JsonArray>(),
-        backgroundColor);
-  }
+  std::atomic_store(&formatterFactory, factory);
 }
 
 std::shared_ptr<Region> DisplayTemplateDriver::addRectangleRegion(
-    VariableFormatterFactory& formatterFactory,
+    const VariableFormatterFactory& formatterFactory,
     JsonObject spec,
     uint16_t index,
     uint16_t backgroundColor) {
@@ -333,7 +501,7 @@ std::shared_ptr<Region> DisplayTemplateDriver::addRectangleRegion(
 }
 
 void DisplayTemplateDriver::renderRectangles(
-    VariableFormatterFactory& formatterFactory,
+    const VariableFormatterFactory& formatterFactory,
     JsonArray rectangles,
     uint16_t backgroundColor) {
   size_t ix = 0;
@@ -409,7 +577,7 @@ void DisplayTemplateDriver::drawBitmap(GxEPD2_GFX* display,
 }
 
 void DisplayTemplateDriver::renderBitmaps(
-    VariableFormatterFactory& formatterFactory,
+    const VariableFormatterFactory& formatterFactory,
     JsonArray bitmaps,
     uint16_t templateBackground) {
   for (size_t i = 0; i < bitmaps.size(); i++) {
@@ -423,9 +591,11 @@ void DisplayTemplateDriver::renderBitmaps(
     const uint16_t backgroundColor =
         extractBackgroundColor(bitmap, templateBackground);
 
+    JsonObject value = bitmap["value"];
+
     // v2 format where there is an explicit "value" key
-    if (bitmap.containsKey("value")) {
-      bitmap = bitmap["value"];
+    if (!value.isNull()) {
+      bitmap = value;
 
       if (bitmap["type"] == "static") {
         renderBitmap(bitmap["value"].as<const char*>(),
@@ -440,20 +610,17 @@ void DisplayTemplateDriver::renderBitmaps(
       // fall back on v1 format where "static" and "variable" are inline with
       // the definition
     } else {
-      if (bitmap.containsKey("static")) {
-        renderBitmap(bitmap["static"].as<const char*>(),
-            x,
-            y,
-            w,
-            h,
-            color,
-            backgroundColor);
+      const char* staticValue = bitmap["static"];
+
+      if (staticValue != nullptr) {
+        renderBitmap(staticValue, x, y, w, h, color, backgroundColor);
         continue;
       }
     }
 
-    if (bitmap.containsKey("variable")) {
-      const String& variable = bitmap["variable"];
+    const char* variable = bitmap["variable"];
+
+    if (variable != nullptr) {
       std::shared_ptr<Region> region = addBitmapRegion(x,
           y,
           w,
@@ -469,7 +636,7 @@ void DisplayTemplateDriver::renderBitmaps(
 }
 
 void DisplayTemplateDriver::renderTexts(
-    VariableFormatterFactory& formatterFactory,
+    const VariableFormatterFactory& formatterFactory,
     JsonObject updateRects,
     JsonArray texts,
     uint16_t backgroundColor) {
@@ -481,30 +648,32 @@ void DisplayTemplateDriver::renderTexts(
     auto font = parseFont(text["font"]);
     auto color = extractColor(text);
     auto textSize = extractTextSize(text);
+    auto alignment = textAlignmentFromString(text["alignment"]);
 
-    // Font should be set first because it fiddles with the cursor.
-    display->setFont(font);
-    display->setCursor(x, y);
-    display->setTextSize(textSize);
-    display->setTextColor(color);
+    JsonObject value = text["value"];
 
     // v2 format where there is an explicit "value" key
-    if (text.containsKey("value")) {
-      text = text["value"];
+    if (!value.isNull()) {
+      text = value;
 
       if (text["type"] == "static") {
-        display->print(text["value"].as<const char*>());
+        TextLayout(font, textSize, alignment)
+            .render(display, text["value"].as<const char*>(), x, y, color);
       }
       // fall back on v1 format where "static" and "variable" are inline with
       // the definition
     } else {
-      if (text.containsKey("static")) {
-        display->print(text["static"].as<const char*>());
+      const char* staticValue = text["static"];
+
+      if (staticValue != nullptr) {
+        TextLayout(font, textSize, alignment)
+            .render(display, staticValue, x, y, color);
       }
     }
 
-    if (text.containsKey("variable")) {
-      const String& variable = text["variable"].as<const char*>();
+    const char* variable = text["variable"];
+
+    if (variable != nullptr) {
       auto formatter = formatterFactory.create(text);
 
       std::shared_ptr<Region> region = addTextRegion(x,
@@ -512,6 +681,7 @@ void DisplayTemplateDriver::renderTexts(
           color,
           backgroundColor,
           font,
+          alignment,
           textSize,
           formatter,
           updateRects,
@@ -540,7 +710,7 @@ std::shared_ptr<Region> DisplayTemplateDriver::addBitmapRegion(uint16_t x,
     uint16_t h,
     uint16_t color,
     uint16_t backgroundColor,
-    VariableFormatterFactory& formatterFactory,
+    const VariableFormatterFactory& formatterFactory,
     JsonObject spec,
     uint16_t index) {
   std::shared_ptr<Region> region =
@@ -562,7 +732,8 @@ std::shared_ptr<Region> DisplayTemplateDriver::addTextRegion(uint16_t x,
     uint16_t y,
     uint16_t color,
     uint16_t backgroundColor,
-    const GFXfont* font,
+    std::shared_ptr<const FontMetrics> font,
+    TextAlignment alignment,
     uint8_t textSize,
     std::shared_ptr<const VariableFormatter> formatter,
     JsonObject updateRects,
@@ -575,6 +746,7 @@ std::shared_ptr<Region> DisplayTemplateDriver::addTextRegion(uint16_t x,
       color,
       backgroundColor,
       font,
+      alignment,
       formatter,
       textSize,
       index);
@@ -587,32 +759,23 @@ void DisplayTemplateDriver::printError(const char* message) {
   Serial.printf_P(PSTR("Printing error to screen: %s\n"), message);
 
   display->fillScreen(GxEPD_BLACK);
-  display->setFont(&FreeMonoBold9pt7b);
-  display->setTextColor(GxEPD_WHITE);
-  display->setCursor(0, display->height() / 2);
-  display->print(message);
+  TextLayout(fonts.get("FreeMonoBold9pt7b"), 1, TextAlignment::LEFT)
+      .render(display, message, 0, display->height() / 2, GxEPD_WHITE);
   display->display(false);
 }
 
-const GFXfont* DisplayTemplateDriver::parseFont(const String& fontName) {
-  if (fontName.equalsIgnoreCase("FreeMonoBold24pt7b")) {
-    return &FreeMonoBold24pt7b;
-  } else if (fontName.equalsIgnoreCase("FreeSans18pt7b")) {
-    return &FreeSans18pt7b;
-  } else if (fontName.equalsIgnoreCase("FreeSans12pt7b")) {
-    return &FreeSans12pt7b;
-  } else if (fontName.equalsIgnoreCase("FreeSans9pt7b")) {
-    return &FreeSans9pt7b;
-  } else if (fontName.equalsIgnoreCase("FreeSansBold9pt7b")) {
-    return &FreeSansBold9pt7b;
-  } else if (fontName.equalsIgnoreCase("FreeMono9pt7b")) {
-    return &FreeMono9pt7b;
-  } else {
+std::shared_ptr<const FontMetrics> DisplayTemplateDriver::parseFont(
+    const String& fontName) {
+  std::shared_ptr<const FontMetrics> font = fonts.get(fontName);
+
+  if (font == nullptr) {
     Serial.print(F("WARN - tried to fetch unknown font: "));
     Serial.println(fontName);
 
-    return defaultFont;
+    return fonts.get(FontStore::DEFAULT_FONT);
   }
+
+  return font;
 }
 
 const uint16_t DisplayTemplateDriver::parseColor(const String& colorName) {
@@ -629,64 +792,59 @@ const uint16_t DisplayTemplateDriver::parseColor(const String& colorName) {
   }
 }
 
+// Validated templates have all of these filled in.  Each is looked up once.
 const uint8_t DisplayTemplateDriver::extractTextSize(JsonObject spec) {
-  if (spec.containsKey("font_size")) {
-    return spec["font_size"];
-  } else {
-    return 1;
-  }
+  JsonVariant size = spec["font_size"];
+
+  // as<>() also converts numeric strings, which templates that failed
+  // validation can still have
+  return size.isNull() ? 1 : size.as<uint8_t>();
 }
 
 const uint16_t DisplayTemplateDriver::extractColor(JsonObject spec) {
-  if (spec.containsKey("color")) {
-    return parseColor(spec["color"]);
-  } else {
-    return defaultColor;
-  }
+  const char* color = spec["color"];
+  return color != nullptr ? parseColor(color) : defaultColor;
 }
 
 const uint16_t DisplayTemplateDriver::extractBackgroundColor(
     JsonObject spec, uint16_t templateBackground) {
-  if (spec.containsKey("background_color")) {
-    return parseColor(spec["background_color"]);
-  } else {
-    return templateBackground;
-  }
+  const char* color = spec["background_color"];
+  return color != nullptr ? parseColor(color) : templateBackground;
 }
 
-void DisplayTemplateDriver::resolveVariables(
+bool DisplayTemplateDriver::resolveVariables(
     JsonArray toResolve, JsonArray response) {
-  File file = SPIFFS.open(templateFilename, "r");
-  DynamicJsonDocument jsonBuffer(JSON_TEMPLATE_BUFFER_SIZE);
-  auto error = deserializeJson(jsonBuffer, file);
-  file.close();
-
-  if (error) {
-    Serial.print(F("Error parsing template file: "));
-    Serial.println(error.c_str());
-    return;
-  }
+  return resolveVariables(toResolve,
+      [&response](const String& name, const String& value, JsonVariant ref) {
+        JsonObject resolvedVar = response.createNestedObject();
+        resolvedVar["k"] = name;
+        resolvedVar["v"] = value;
+        resolvedVar["ref"] = ref;
+      });
+}
 
-  JsonObject tmpl = jsonBuffer.as<JsonObject>();
+bool DisplayTemplateDriver::resolveVariables(
+    JsonArray toResolve, ResolvedVariableFn fn) {
+  // Not under the lock (see mutex).  Formatters are stateless, the factory
+  // stays alive until this copy is released even if a new template is loaded
+  // in the meantime, and vars locks each lookup itself.
+  std::shared_ptr<const VariableFormatterFactory> factory =
+      std::atomic_load(&formatterFactory);
 
-  if (tmpl.isNull()) {
-    return;
+  if (!factory) {
+    return false;
   }
 
-  JsonVariant formatters = tmpl["formatters"];
-  VariableFormatterFactory formatterFactory(formatters);
-
   for (JsonArray var : toResolve) {
     String name = var[0];
     String value = vars.get(name);
 
-    auto formatter = formatterFactory.create(var[1]);
+    auto formatter = factory->create(var[1]);
 
-    JsonObject resolvedVar = response.createNestedObject();
-    resolvedVar["k"] = name;
-    resolvedVar["v"] = formatter->format(value);
-    resolvedVar["ref"] = var[2];
+    fn(name, formatter->format(value), var[2]);
   }
+
+  return true;
 }
 
 void DisplayTemplateDriver::dumpRegionValues(JsonObject response) {
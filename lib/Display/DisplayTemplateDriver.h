@@ -3,13 +3,16 @@
 #include <DoublyLinkedList.h>
 #include <EnvironmentConfig.h>
 #include <FS.h>
+#include <FontStore.h>
+#include <Framebuffer.h>
 #include <GxEPD2_BW.h>
 #include <RectangleRegion.h>
 #include <Settings.h>
+#include <TemplateValidator.h>
 #include <TextRegion.h>
+#include <VariableBatch.h>
 #include <VariableDictionary.h>
 #include <VariableFormatters.h>
-#include <gfxfont.h>
 
 #if defined(ESP32)
 #include <SPIFFS.h>
@@ -25,17 +28,6 @@ extern "C" {
 #define TEXT_BOUNDING_BOX_PADDING 5
 #endif
 
-#include <Fonts/FreeMono9pt7b.h>
-#include <Fonts/FreeMonoBold12pt7b.h>
-#include <Fonts/FreeMonoBold18pt7b.h>
-#include <Fonts/FreeMonoBold24pt7b.h>
-#include <Fonts/FreeMonoBold9pt7b.h>
-#include <Fonts/FreeSans24pt7b.h>
-#include <Fonts/FreeSans18pt7b.h>
-#include <Fonts/FreeSans12pt7b.h>
-#include <Fonts/FreeSans9pt7b.h>
-#include <Fonts/FreeSansBold9pt7b.h>
-
 #include <functional>
 #include <memory>
 
@@ -49,6 +41,11 @@ typedef const String& TVariableValue;
 typedef std::function<void(TRegionId, TVariableName, TVariableValue)>
     RegionUpdateObserverFn;
 
+// Called with the variable name, its formatted value, and the caller-supplied
+// reference for each resolved variable
+typedef std::function<void(TVariableName, TVariableValue, JsonVariant)>
+    ResolvedVariableFn;
+
 class DisplayTemplateDriver {
  public:
   DisplayTemplateDriver(GxEPD2_GFX* display, Settings& settings);
@@ -56,12 +53,21 @@ class DisplayTemplateDriver {
   // Updates the value for the given variable, and marks any regions bound to
   // that variable as dirty.
   void updateVariable(const String& name, const String& value);
+
+  // Applies several updates at once.  The values are persisted together, and
+  // regions are only scanned once regardless of the size of the batch.
+  void updateVariables(const VariableBatch& batch);
   void deleteVariable(const String& name);
   String getVariable(const String& name);
   void clearVariables();
 
-  // Helper to resolve variable values (used in REST API)
-  void resolveVariables(JsonArray toResolve, JsonArray response);
+  // Helper to resolve variable values (used in REST API).  Returns false if
+  // no template is loaded, because references to the template's formatters
+  // can't be resolved.  Doesn't wait for a refresh in progress.
+  bool resolveVariables(JsonArray toResolve, JsonArray response);
+  // Same as above, but hands each variable to fn as it's resolved so that
+  // callers can stream large responses
+  bool resolveVariables(JsonArray toResolve, ResolvedVariableFn fn);
   // Helper to return all current variable values
   void dumpRegionValues(JsonObject response);
 
@@ -70,6 +76,23 @@ class DisplayTemplateDriver {
   void setTemplate(const String& filename);
   const String& getTemplateFilename();
 
+  // Call after the template file at path is modified.  Reloads it if it's the
+  // template being displayed.
+  void invalidateTemplate(const String& path);
+
+  // Call after fonts in SPIFFS are added or removed.  Reloads the current
+  // template so that it picks up the change.
+  void invalidateFonts();
+
+  // Checks a template before it's saved, against the fonts and bitmaps that
+  // are available.  Fills in omitted fields (see TemplateValidator).  Doesn't
+  // wait for a refresh that's in progress.
+  bool validateTemplate(JsonDocument& tmpl, JsonArray errors);
+
+  // What's currently drawn on the display.  Not synchronized with rendering,
+  // so a region that's being redrawn may be partially updated.
+  Framebuffer getFramebuffer();
+
   // Performs a full update of the display.  Applies the template and refreshes
   // the entire screen.
   void fullUpdate();
@@ -81,6 +104,15 @@ class DisplayTemplateDriver {
   // and performing partial updates on the bounding boxes.
   void loop();
 
+  // While rendering is suspended, variables and regions are still updated,
+  // but the display isn't refreshed.  Everything that changed is rendered
+  // together on the first loop() after rendering is resumed.
+  void suspendRendering();
+
+  // Returns the number of refreshes that were skipped while suspended,
+  // excluding the one that will render the accumulated changes.
+  uint32_t resumeRendering();
+
   // Registers fn as an observer when a variable changes
   void onVariableUpdate(VariableUpdateObserverFn fn);
 
@@ -102,6 +134,8 @@ class DisplayTemplateDriver {
 
  private:
   GxEPD2_GFX* display;
+  // Type display was built with
+  const GxEPD2::Panel panel;
   VariableDictionary vars;
   String templateFilename;
   Settings& settings;
@@ -110,33 +144,49 @@ class DisplayTemplateDriver {
   RegionUpdateObserverFn onRegionUpdateFn;
 
   DoublyLinkedList<std::shared_ptr<Region>> regions;
+  FontStore fonts;
+  // Reference formatters from the loaded template, kept around for
+  // resolveVariables.  Null if no template is loaded.  resolveVariables reads
+  // it without the lock, so it's replaced rather than modified, and only
+  // accessed through std::atomic_load and std::atomic_store.
+  std::shared_ptr<const VariableFormatterFactory> formatterFactory;
 
   bool dirty;
   bool shouldFullUpdate;
+  bool renderingSuspended;
+  // Set when a region changes.  Used to count the refreshes that would have
+  // happened while rendering was suspended.
+  bool pendingRefresh;
+  uint32_t skippedRefreshes;
   time_t lastFullUpdate;
 
 #if defined(ESP32)
+  // Held by loop() for the whole of a refresh, which takes 20 s or more on
+  // three color panels.  Updates from the web server take it.  Requests that
+  // only read (resolving variables, screenshots, validating templates) don't,
+  // so that they can't stall the async web task for that long.
   SemaphoreHandle_t mutex;
 #endif
 
   const uint16_t defaultColor = GxEPD_BLACK;
   const uint16_t defaultBackgroundColor = GxEPD_WHITE;
-  const GFXfont* defaultFont = &FreeSans9pt7b;
 
+  void updateRegion(std::shared_ptr<Region>& region, const String& value);
   void flushDirtyRegions(bool screenUpdates);
   void clearDirtyRegions();
   void printError(const char* message);
   void loadTemplate(const String& templateFilename);
+  bool checkTemplate(JsonDocument& tmpl, JsonArray errors);
 
   void renderLines(JsonArray lines);
-  void renderRectangles(VariableFormatterFactory& formatterFactory,
+  void renderRectangles(const VariableFormatterFactory& formatterFactory,
       JsonArray lines,
       uint16_t backgroundColor);
-  void renderTexts(VariableFormatterFactory& formatterFactory,
+  void renderTexts(const VariableFormatterFactory& formatterFactory,
       JsonObject updateRects,
       JsonArray text,
       uint16_t backgroundColor);
-  void renderBitmaps(VariableFormatterFactory& formatterFactory,
+  void renderBitmaps(const VariableFormatterFactory& formatterFactory,
       JsonArray bitmaps,
       uint16_t templateBackground);
   void renderBitmap(const String& filename,
@@ -154,7 +204,8 @@ class DisplayTemplateDriver {
       uint16_t y,
       uint16_t color,
       uint16_t backgroundColor,
-      const GFXfont* font,
+      std::shared_ptr<const FontMetrics> font,
+      TextAlignment alignment,
       uint8_t textSize,
       std::shared_ptr<const VariableFormatter> formatter,
       JsonObject updateRects,
@@ -166,17 +217,17 @@ class DisplayTemplateDriver {
       uint16_t h,
       uint16_t color,
       uint16_t backgroundColor,
-      VariableFormatterFactory& formatterFactory,
+      const VariableFormatterFactory& formatterFactory,
       JsonObject spec,
       uint16_t index);
   std::shared_ptr<Region> addRectangleRegion(
-      VariableFormatterFactory& formatterFactory,
+      const VariableFormatterFactory& formatterFactory,
       JsonObject spec,
       uint16_t index,
       uint16_t backgroundColor);
 
   const uint16_t parseColor(const String& colorName);
-  const GFXfont* parseFont(const String& fontName);
+  std::shared_ptr<const FontMetrics> parseFont(const String& fontName);
   const uint16_t extractColor(JsonObject spec);
   const uint16_t extractBackgroundColor(
       JsonObject spec, uint16_t templateBackground);
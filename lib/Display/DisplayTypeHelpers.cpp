@@ -3,6 +3,7 @@
 #include <GxEPD2_BW.h>
 #include <GxEPD2_3C.h>
 #include <DisplayTypeHelpers.h>
+#include <Framebuffer.h>
 
 #include <map>
 #include <utility>
@@ -17,6 +18,119 @@ inline static GxEPD2_GFX* __gxepd2_build_3c_driver(const uint8_t dc, const uint8
   return new GxEPD2_3C<Display, Display::HEIGHT>(Display(ssPin, dc, rst, busy));
 }
 
+// GxEPD2 doesn't expose its buffers.  Access checks don't apply to the
+// arguments of an explicit instantiation, which is the one way to name a
+// private member from outside of its class without patching the library.
+// PrivateMemberBinding stores the member pointer in PrivateMember<Tag> during
+// static initialization.
+template <class Tag>
+struct PrivateMember {
+  static typename Tag::type pointer;
+};
+
+template <class Tag>
+typename Tag::type PrivateMember<Tag>::pointer = nullptr;
+
+template <class Tag, typename Tag::type Pointer>
+struct PrivateMemberBinding {
+  PrivateMemberBinding() { PrivateMember<Tag>::pointer = Pointer; }
+  static PrivateMemberBinding instance;
+};
+
+template <class Tag, typename Tag::type Pointer>
+PrivateMemberBinding<Tag, Pointer> PrivateMemberBinding<Tag, Pointer>::instance;
+
+template <class Display>
+using __gxepd2_plane = uint8_t[(Display::WIDTH / 8) * Display::HEIGHT];
+
+template <class Display>
+struct __gxepd2_bw_buffer {
+  typedef __gxepd2_plane<Display> GxEPD2_BW<Display, Display::HEIGHT>::*type;
+};
+
+template <class Display>
+struct __gxepd2_3c_black_buffer {
+  typedef __gxepd2_plane<Display> GxEPD2_3C<Display, Display::HEIGHT>::*type;
+};
+
+template <class Display>
+struct __gxepd2_3c_color_buffer {
+  typedef __gxepd2_plane<Display> GxEPD2_3C<Display, Display::HEIGHT>::*type;
+};
+
+#define __GXEPD2_BIND_BW_BUFFER(Display)                      \
+  template struct PrivateMemberBinding<                      \
+      __gxepd2_bw_buffer<Display>,                           \
+      &GxEPD2_BW<Display, Display::HEIGHT>::_buffer>;
+
+#define __GXEPD2_BIND_3C_BUFFERS(Display)                     \
+  template struct PrivateMemberBinding<                      \
+      __gxepd2_3c_black_buffer<Display>,                     \
+      &GxEPD2_3C<Display, Display::HEIGHT>::_black_buffer>;  \
+  template struct PrivateMemberBinding<                      \
+      __gxepd2_3c_color_buffer<Display>,                     \
+      &GxEPD2_3C<Display, Display::HEIGHT>::_color_buffer>;
+
+// Must cover every display built by buildDisplay
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_154)
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_213)
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_213_B72)
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_213_flex)
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_290)
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_290_T5)
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_270)
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_420)
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_583)
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_750)
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_213_B73)
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_260)
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_371)
+__GXEPD2_BIND_BW_BUFFER(GxEPD2_750_T7)
+__GXEPD2_BIND_3C_BUFFERS(GxEPD2_it60)
+__GXEPD2_BIND_3C_BUFFERS(GxEPD2_154c)
+__GXEPD2_BIND_3C_BUFFERS(GxEPD2_213c)
+__GXEPD2_BIND_3C_BUFFERS(GxEPD2_290c)
+__GXEPD2_BIND_3C_BUFFERS(GxEPD2_270c)
+__GXEPD2_BIND_3C_BUFFERS(GxEPD2_420c)
+__GXEPD2_BIND_3C_BUFFERS(GxEPD2_583c)
+__GXEPD2_BIND_3C_BUFFERS(GxEPD2_750c)
+__GXEPD2_BIND_3C_BUFFERS(GxEPD2_750c_Z08)
+
+template <class Display>
+inline static Framebuffer __gxepd2_bw_framebuffer(GxEPD2_GFX* display) {
+  auto driver = static_cast<GxEPD2_BW<Display, Display::HEIGHT>*>(display);
+  auto buffer = PrivateMember<__gxepd2_bw_buffer<Display>>::pointer;
+
+  if (buffer == nullptr) {
+    return Framebuffer();
+  }
+
+  return Framebuffer(driver->*buffer,
+      nullptr,
+      Display::WIDTH,
+      Display::HEIGHT,
+      display->getRotation(),
+      false);
+}
+
+template <class Display>
+inline static Framebuffer __gxepd2_3c_framebuffer(GxEPD2_GFX* display, bool reverse = false) {
+  auto driver = static_cast<GxEPD2_3C<Display, Display::HEIGHT>*>(display);
+  auto black = PrivateMember<__gxepd2_3c_black_buffer<Display>>::pointer;
+  auto color = PrivateMember<__gxepd2_3c_color_buffer<Display>>::pointer;
+
+  if (black == nullptr || color == nullptr) {
+    return Framebuffer();
+  }
+
+  return Framebuffer(driver->*black,
+      driver->*color,
+      Display::WIDTH,
+      Display::HEIGHT,
+      display->getRotation(),
+      reverse);
+}
+
 const std::map<const char*, GxEPD2::Panel, cmp_str> DisplayTypeHelpers::PANELS_BY_NAME = {
   { "GDEP015OC1", GxEPD2::Panel::GDEP015OC1 },
   { "GDEW0154Z04", GxEPD2::Panel::GDEW0154Z04 },
@@ -214,7 +328,69 @@ GxEPD2_GFX* DisplayTypeHelpers::buildDisplay(GxEPD2::Panel type, uint8_t dc, uin
     case GxEPD2::Panel::GDEW075Z08:
       return __gxepd2_build_3c_driver<GxEPD2_750c_Z08>(dc, rst, busy, ss);
     default:
-      Serial.printf_P(PSTR("Unsupported display type, using default.  Provided display: %d\n"), static_cast<size_t>(type));
+      Serial.printf_P(PSTR("Unsupported display type, using default.  Provided display: %u\n"), static_cast<unsigned>(type));
       return buildDisplay(DisplayTypeHelpers::DEFAULT_PANEL, dc, rst, busy, ss);
   }
-}
\ No newline at end of file
+}
+Framebuffer DisplayTypeHelpers::getFramebuffer(GxEPD2::Panel type, GxEPD2_GFX* display) {
+  if (display == nullptr) {
+    return Framebuffer();
+  }
+
+  // display must have been built by buildDisplay with the same type
+  switch (type) {
+    // black/white displays
+    case GxEPD2::Panel::GDEP015OC1:
+      return __gxepd2_bw_framebuffer<GxEPD2_154>(display);
+    case GxEPD2::Panel::GDE0213B1:
+      return __gxepd2_bw_framebuffer<GxEPD2_213>(display);
+    case GxEPD2::Panel::GDEH0213B72:
+      return __gxepd2_bw_framebuffer<GxEPD2_213_B72>(display);
+    case GxEPD2::Panel::GDEW0213I5F:
+      return __gxepd2_bw_framebuffer<GxEPD2_213_flex>(display);
+    case GxEPD2::Panel::GDEH029A1:
+      return __gxepd2_bw_framebuffer<GxEPD2_290>(display);
+    case GxEPD2::Panel::GDEW029T5:
+      return __gxepd2_bw_framebuffer<GxEPD2_290_T5>(display);
+    case GxEPD2::Panel::GDEW027W3:
+      return __gxepd2_bw_framebuffer<GxEPD2_270>(display);
+    case GxEPD2::Panel::GDEW042T2:
+      return __gxepd2_bw_framebuffer<GxEPD2_420>(display);
+    case GxEPD2::Panel::GDEW0583T7:
+      return __gxepd2_bw_framebuffer<GxEPD2_583>(display);
+    case GxEPD2::Panel::GDEW075T8:
+      return __gxepd2_bw_framebuffer<GxEPD2_750>(display);
+    case GxEPD2::Panel::GDEH0213B73:
+      return __gxepd2_bw_framebuffer<GxEPD2_213_B73>(display);
+    case GxEPD2::Panel::GDEW026T0:
+      return __gxepd2_bw_framebuffer<GxEPD2_260>(display);
+    case GxEPD2::Panel::GDEW0371W7:
+      return __gxepd2_bw_framebuffer<GxEPD2_371>(display);
+    case GxEPD2::Panel::GDEW075T7:
+      return __gxepd2_bw_framebuffer<GxEPD2_750_T7>(display);
+
+    // Color displays
+    case GxEPD2::Panel::ED060SCT:
+      return __gxepd2_3c_framebuffer<GxEPD2_it60>(display);
+    case GxEPD2::Panel::GDEW0154Z04:
+      return __gxepd2_3c_framebuffer<GxEPD2_154c>(display);
+    case GxEPD2::Panel::GDEW0213Z16:
+      // GxEPD2_3C draws this panel's rows bottom to top
+      return __gxepd2_3c_framebuffer<GxEPD2_213c>(display, true);
+    case GxEPD2::Panel::GDEW029Z10:
+      return __gxepd2_3c_framebuffer<GxEPD2_290c>(display);
+    case GxEPD2::Panel::GDEW027C44:
+      return __gxepd2_3c_framebuffer<GxEPD2_270c>(display);
+    case GxEPD2::Panel::GDEW042Z15:
+      return __gxepd2_3c_framebuffer<GxEPD2_420c>(display);
+    case GxEPD2::Panel::GDEW0583Z21:
+      return __gxepd2_3c_framebuffer<GxEPD2_583c>(display);
+    case GxEPD2::Panel::GDEW075Z09:
+      return __gxepd2_3c_framebuffer<GxEPD2_750c>(display);
+    case GxEPD2::Panel::GDEW075Z08:
+      return __gxepd2_3c_framebuffer<GxEPD2_750c_Z08>(display);
+    default:
+      // buildDisplay falls back to the default panel for unsupported types
+      return getFramebuffer(DisplayTypeHelpers::DEFAULT_PANEL, display);
+  }
+}
@@ -3,6 +3,7 @@
 #include <GxEPD2.h>
 #include <GxEPD2_GFX.h>
 #include <CharComparator.h>
+#include <Framebuffer.h>
 
 #include <memory>
 #include <map>
@@ -17,6 +18,9 @@ public:
 
   static GxEPD2_GFX* buildDisplay(GxEPD2::Panel type, uint8_t dcPin, uint8_t rstPin, uint8_t busyPin, uint8_t ssPin);
 
+  // Pixels currently drawn on a display returned by buildDisplay(type, ...)
+  static Framebuffer getFramebuffer(GxEPD2::Panel type, GxEPD2_GFX* display);
+
   static const GxEPD2::Panel DEFAULT_PANEL;
   static const char* DISPLAY_NAMES[];
 
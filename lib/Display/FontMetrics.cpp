@@ -0,0 +1,69 @@
+#include <FontMetrics.h>
+
+#include <algorithm>
+
+// Same fallback Adafruit_GFX uses for reading the glyph table pointer
+#ifndef pgm_read_pointer
+#define pgm_read_pointer(addr) ((void*)pgm_read_dword(addr))
+#endif
+
+FontMetrics::FontMetrics()
+  : first(0)
+  , last(0)
+  , yAdvance(0)
+  , ascent(0)
+  , descent(0)
+  , maxAdvance(0)
+  , bitmap(nullptr)
+{ }
+
+FontMetrics::FontMetrics(const GFXfont* font)
+  : first(pgm_read_byte(&font->first))
+  , last(pgm_read_byte(&font->last))
+  , yAdvance(pgm_read_byte(&font->yAdvance))
+  , ascent(0)
+  , descent(0)
+  , maxAdvance(0)
+  , bitmap(reinterpret_cast<const uint8_t*>(pgm_read_pointer(&font->bitmap)))
+{
+  const GFXglyph* table =
+      reinterpret_cast<const GFXglyph*>(pgm_read_pointer(&font->glyph));
+
+  glyphs.reserve(last - first + 1);
+
+  for (size_t i = 0; i <= static_cast<size_t>(last - first); ++i) {
+    const GFXglyph* glyph = &table[i];
+
+    glyphs.push_back({
+      .bitmapOffset = static_cast<uint16_t>(pgm_read_word(&glyph->bitmapOffset)),
+      .width = static_cast<uint8_t>(pgm_read_byte(&glyph->width)),
+      .height = static_cast<uint8_t>(pgm_read_byte(&glyph->height)),
+      .xAdvance = static_cast<uint8_t>(pgm_read_byte(&glyph->xAdvance)),
+      .xOffset = static_cast<int8_t>(pgm_read_byte(&glyph->xOffset)),
+      .yOffset = static_cast<int8_t>(pgm_read_byte(&glyph->yOffset))
+    });
+  }
+
+  computeSummary();
+}
+
+FontMetrics::~FontMetrics() { }
+
+void FontMetrics::computeSummary() {
+  int16_t maxAscent = 0;
+  int16_t maxDescent = 0;
+
+  for (const Glyph& glyph : glyphs) {
+    maxAscent = std::max(maxAscent, static_cast<int16_t>(-glyph.yOffset));
+    maxDescent = std::max(
+        maxDescent, static_cast<int16_t>(glyph.yOffset + glyph.height));
+    maxAdvance = std::max(maxAdvance, glyph.xAdvance);
+  }
+
+  ascent = maxAscent;
+  descent = maxDescent;
+}
+
+const uint8_t* FontMetrics::getGlyphBitmap(const Glyph& glyph) const {
+  return bitmap + glyph.bitmapOffset;
+}
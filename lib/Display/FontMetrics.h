@@ -0,0 +1,60 @@
+#include <Arduino.h>
+#include <gfxfont.h>
+
+#include <memory>
+#include <vector>
+
+#pragma once
+
+// Metrics for a GFXfont, copied out of PROGMEM once per font so that layout
+// doesn't need to go through pgm_read_* for every glyph.  Shared between all
+// regions that use the same font (see FontStore).
+class FontMetrics {
+public:
+  struct Glyph {
+    uint16_t bitmapOffset;
+    uint8_t width;
+    uint8_t height;
+    uint8_t xAdvance;
+    int8_t xOffset;
+    int8_t yOffset;
+  };
+
+  explicit FontMetrics(const GFXfont* font);
+  virtual ~FontMetrics();
+
+  // Returns nullptr if c isn't in the font
+  inline const Glyph* getGlyph(uint8_t c) const {
+    if (c < first || c > last) {
+      return nullptr;
+    }
+    return &glyphs[c - first];
+  }
+
+  // Bitmap data for glyph, packed MSB-first with no row padding
+  virtual const uint8_t* getGlyphBitmap(const Glyph& glyph) const;
+
+  // Distance above and below the baseline covered by the tallest glyphs
+  inline uint8_t getAscent() const { return ascent; }
+  inline uint8_t getDescent() const { return descent; }
+
+  inline uint8_t getMaxAdvance() const { return maxAdvance; }
+  inline uint8_t getYAdvance() const { return yAdvance; }
+
+protected:
+  FontMetrics();
+
+  // Fills in the summary metrics from glyphs
+  void computeSummary();
+
+  std::vector<Glyph> glyphs;
+  uint8_t first;
+  uint8_t last;
+  uint8_t yAdvance;
+  uint8_t ascent;
+  uint8_t descent;
+  uint8_t maxAdvance;
+
+private:
+  const uint8_t* bitmap;
+};
@@ -0,0 +1,184 @@
+#include <FontStore.h>
+#include <Settings.h>
+#include <SpiffsFontMetrics.h>
+
+#include <Fonts/FreeMono9pt7b.h>
+#include <Fonts/FreeMonoBold9pt7b.h>
+#include <Fonts/FreeMonoBold24pt7b.h>
+#include <Fonts/FreeSans9pt7b.h>
+#include <Fonts/FreeSans12pt7b.h>
+#include <Fonts/FreeSans18pt7b.h>
+#include <Fonts/FreeSansBold9pt7b.h>
+
+#include <algorithm>
+
+namespace {
+
+struct BuiltinFont {
+  const char* name;
+  const GFXfont* font;
+};
+
+static const BuiltinFont BUILTIN_FONTS[] = {
+  {"FreeMono9pt7b", &FreeMono9pt7b},
+  {"FreeMonoBold9pt7b", &FreeMonoBold9pt7b},
+  {"FreeMonoBold24pt7b", &FreeMonoBold24pt7b},
+  {"FreeSans9pt7b", &FreeSans9pt7b},
+  {"FreeSans12pt7b", &FreeSans12pt7b},
+  {"FreeSans18pt7b", &FreeSans18pt7b},
+  {"FreeSansBold9pt7b", &FreeSansBold9pt7b},
+};
+
+}
+
+const char FontStore::DEFAULT_FONT[] = "FreeSans9pt7b";
+
+FontStore::FontStore()
+  : glyphCache(std::make_shared<GlyphCache>())
+  , indexed(false)
+{
+#if defined(ESP32)
+  mutex = xSemaphoreCreateMutex();
+
+  if (mutex == NULL) {
+    Serial.println(F("ERROR: could not create mutex"));
+  }
+#endif
+}
+
+void FontStore::lock() {
+#if defined(ESP32)
+  xSemaphoreTake(mutex, portMAX_DELAY);
+#endif
+}
+
+void FontStore::unlock() {
+#if defined(ESP32)
+  xSemaphoreGive(mutex);
+#endif
+}
+
+// FNV-1a, case-insensitive
+uint32_t FontStore::hashName(const char* name) {
+  uint32_t hash = 2166136261UL;
+
+  for (const char* p = name; *p != 0; ++p) {
+    hash ^= static_cast<uint8_t>(tolower(static_cast<unsigned char>(*p)));
+    hash *= 16777619UL;
+  }
+
+  return hash;
+}
+
+void FontStore::invalidate() {
+  lock();
+  indexed = false;
+  unlock();
+}
+
+void FontStore::buildIndex() {
+  entries.clear();
+
+  // Uploaded fonts are added first so that the stable sort below keeps them
+  // ahead of built-in fonts with the same name.
+#if defined(ESP8266)
+  Dir dir = SPIFFS.openDir(FONTS_DIRECTORY);
+
+  while (dir.next()) {
+    addUploadedFont(dir.fileName());
+  }
+#else
+  File dir = SPIFFS.open(FONTS_DIRECTORY);
+
+  if (dir && dir.isDirectory()) {
+    while (File file = dir.openNextFile()) {
+      String path = file.name();
+      file.close();
+      addUploadedFont(path);
+    }
+  }
+#endif
+
+  for (const BuiltinFont& font : BUILTIN_FONTS) {
+    entries.push_back({hashName(font.name), font.name, font.font});
+  }
+
+  std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+    return a.hash < b.hash;
+  });
+
+  indexed = true;
+}
+
+void FontStore::addUploadedFont(const String& path) {
+  String name = path.substring(path.lastIndexOf('/') + 1);
+
+  // Checked here rather than when it's loaded, so that templates using it
+  // fail validation instead of silently falling back to the default font
+  if (!SpiffsFontMetrics::isValid(String(FONTS_DIRECTORY) + "/" + name)) {
+    Serial.printf_P(PSTR("FontStore - WARN: skipping invalid font: %s\n"), name.c_str());
+    return;
+  }
+
+  entries.push_back({hashName(name.c_str()), name, nullptr});
+}
+
+FontStore::Entry* FontStore::find(const String& name) {
+  if (!indexed) {
+    buildIndex();
+  }
+
+  const uint32_t hash = hashName(name.c_str());
+  auto it = std::lower_bound(entries.begin(), entries.end(), hash, [](const Entry& entry, uint32_t hash) {
+    return entry.hash < hash;
+  });
+
+  for (; it != entries.end() && it->hash == hash; ++it) {
+    if (it->name.equalsIgnoreCase(name)) {
+      return &*it;
+    }
+  }
+
+  return nullptr;
+}
+
+bool FontStore::contains(const String& name) {
+  lock();
+  const bool found = find(name) != nullptr;
+  unlock();
+
+  return found;
+}
+
+std::shared_ptr<const FontMetrics> FontStore::get(const String& name) {
+  lock();
+  Entry* entry = find(name);
+
+  if (entry == nullptr) {
+    unlock();
+    return nullptr;
+  }
+
+  std::shared_ptr<const FontMetrics> metrics = entry->metrics.lock();
+
+  if (metrics == nullptr) {
+    if (entry->builtin != nullptr) {
+      metrics = std::make_shared<FontMetrics>(entry->builtin);
+    } else {
+      metrics = SpiffsFontMetrics::open(
+          String(FONTS_DIRECTORY) + "/" + entry->name, glyphCache);
+    }
+
+    entry->metrics = metrics;
+  }
+
+  unlock();
+
+  return metrics;
+}
+
+void FontStore::listBuiltinFonts(JsonArray result) {
+  for (const BuiltinFont& font : BUILTIN_FONTS) {
+    result.add(font.name);
+  }
+}
@@ -0,0 +1,73 @@
+#include <ArduinoJson.h>
+#include <FontMetrics.h>
+#include <GlyphCache.h>
+
+#include <memory>
+#include <vector>
+
+#if defined(ESP32)
+extern "C" {
+#include "freertos/semphr.h"
+}
+#endif
+
+#pragma once
+
+// Looks up fonts by name.  Fonts compiled into the firmware are always
+// available.  Fonts uploaded to FONTS_DIRECTORY are found by their filename,
+// and take precedence over a built-in font with the same name.  Uploaded files
+// that aren't valid fonts are left out.
+//
+// Names are matched case-insensitively through a table sorted by hash.  The
+// table is built the first time a font is requested, and rebuilt after
+// invalidate() is called.
+//
+// Each call holds a lock of its own, so fonts can be looked up (e.g., to
+// validate a template on the web server's task) while the display driver is
+// rendering with them.
+class FontStore {
+public:
+  static const char DEFAULT_FONT[];
+
+  FontStore();
+
+  // Returns nullptr if there is no font with the given name
+  std::shared_ptr<const FontMetrics> get(const String& name);
+
+  // Like get(), but doesn't load the font
+  bool contains(const String& name);
+
+  // Call when fonts are added to or removed from SPIFFS
+  void invalidate();
+
+  static void listBuiltinFonts(JsonArray result);
+
+private:
+  struct Entry {
+    uint32_t hash;
+    String name;
+
+    // nullptr for fonts stored in SPIFFS
+    const GFXfont* builtin;
+
+    // Lets regions using the same font share the metrics
+    std::weak_ptr<const FontMetrics> metrics;
+  };
+
+  std::vector<Entry> entries;
+  std::shared_ptr<GlyphCache> glyphCache;
+  bool indexed;
+
+#if defined(ESP32)
+  SemaphoreHandle_t mutex;
+#endif
+
+  void lock();
+  void unlock();
+
+  void buildIndex();
+  void addUploadedFont(const String& path);
+  Entry* find(const String& name);
+
+  static uint32_t hashName(const char* name);
+};
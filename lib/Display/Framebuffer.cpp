@@ -0,0 +1,67 @@
+#include <Framebuffer.h>
+
+Framebuffer::Framebuffer()
+    : black(nullptr)
+    , color(nullptr)
+    , nativeWidth(0)
+    , nativeHeight(0)
+    , rotation(0)
+    , reverse(false) {}
+
+Framebuffer::Framebuffer(const uint8_t* black,
+    const uint8_t* color,
+    uint16_t nativeWidth,
+    uint16_t nativeHeight,
+    uint8_t rotation,
+    bool reverse)
+    : black(black)
+    , color(color)
+    , nativeWidth(nativeWidth)
+    , nativeHeight(nativeHeight)
+    , rotation(rotation & 3)
+    , reverse(reverse) {}
+
+uint16_t Framebuffer::width() const {
+  return (rotation & 1) ? nativeHeight : nativeWidth;
+}
+
+uint16_t Framebuffer::height() const {
+  return (rotation & 1) ? nativeWidth : nativeHeight;
+}
+
+uint16_t Framebuffer::getPixel(uint16_t x, uint16_t y) const {
+  uint16_t t;
+
+  // Same transform as GxEPD2's drawPixel
+  switch (rotation) {
+    case 1:
+      t = x;
+      x = nativeWidth - y - 1;
+      y = t;
+      break;
+    case 2:
+      x = nativeWidth - x - 1;
+      y = nativeHeight - y - 1;
+      break;
+    case 3:
+      t = x;
+      x = y;
+      y = nativeHeight - t - 1;
+      break;
+  }
+
+  if (reverse) {
+    y = nativeHeight - y - 1;
+  }
+
+  const size_t i = x / 8 + static_cast<size_t>(y) * (nativeWidth / 8);
+  const uint8_t mask = 1 << (7 - x % 8);
+
+  if (!(black[i] & mask)) {
+    return GxEPD_BLACK;
+  } else if (color != nullptr && !(color[i] & mask)) {
+    return GxEPD_RED;
+  } else {
+    return GxEPD_WHITE;
+  }
+}
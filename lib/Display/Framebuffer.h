@@ -0,0 +1,42 @@
+#include <Arduino.h>
+#include <GxEPD2.h>
+
+#pragma once
+
+// Read-only view of the buffers GxEPD2 draws into.  Displays are built with
+// a single page covering the whole panel (see DisplayTypeHelpers), so the
+// buffers always hold the full screen.
+//
+// Buffers are in the panel's native orientation, one bit per pixel, MSB first.
+// A set bit is white in the black plane, and not colored in the color plane.
+class Framebuffer {
+public:
+  // An invalid framebuffer, for displays whose buffers aren't known
+  Framebuffer();
+
+  Framebuffer(const uint8_t* black,
+      const uint8_t* color,
+      uint16_t nativeWidth,
+      uint16_t nativeHeight,
+      uint8_t rotation,
+      bool reverse);
+
+  inline bool isValid() const { return black != nullptr; }
+  inline bool hasColor() const { return color != nullptr; }
+
+  // Dimensions with the display's rotation applied, the same coordinates
+  // templates use
+  uint16_t width() const;
+  uint16_t height() const;
+
+  // GxEPD_WHITE, GxEPD_BLACK or GxEPD_RED.  x and y must be in bounds.
+  uint16_t getPixel(uint16_t x, uint16_t y) const;
+
+private:
+  const uint8_t* black;
+  const uint8_t* color;
+  uint16_t nativeWidth;
+  uint16_t nativeHeight;
+  uint8_t rotation;
+  bool reverse;
+};
@@ -0,0 +1,61 @@
+#include <GlyphCache.h>
+
+GlyphCache::GlyphCache(size_t capacity)
+  : capacity(capacity)
+  , size(0)
+{ }
+
+const uint8_t* GlyphCache::get(uint32_t key) {
+  auto it = index.find(key);
+
+  if (it == index.end()) {
+    return nullptr;
+  }
+
+  // Move to the front without invalidating the iterator in the index
+  entries.splice(entries.begin(), entries, it->second);
+
+  return it->second->data.data();
+}
+
+uint8_t* GlyphCache::put(uint32_t key, size_t entrySize) {
+  erase(key);
+
+  // A glyph larger than the whole cache still gets stored (by itself) so that
+  // it can be drawn.
+  while (!entries.empty() && size + entrySize > capacity) {
+    const Entry& last = entries.back();
+
+    size -= last.data.size();
+    index.erase(last.key);
+    entries.pop_back();
+  }
+
+  entries.push_front({key, std::vector<uint8_t>(entrySize)});
+  index[key] = entries.begin();
+  size += entrySize;
+
+  return entries.front().data.data();
+}
+
+void GlyphCache::erase(uint32_t key) {
+  auto it = index.find(key);
+
+  if (it != index.end()) {
+    size -= it->second->data.size();
+    entries.erase(it->second);
+    index.erase(it);
+  }
+}
+
+void GlyphCache::eraseOwner(uint16_t owner) {
+  for (auto it = entries.begin(); it != entries.end();) {
+    if ((it->key >> 16) == owner) {
+      size -= it->data.size();
+      index.erase(it->key);
+      it = entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
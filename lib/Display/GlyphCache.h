@@ -0,0 +1,54 @@
+#include <Arduino.h>
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#pragma once
+
+#ifndef FONT_GLYPH_CACHE_SIZE
+#define FONT_GLYPH_CACHE_SIZE 4096
+#endif
+
+// Least-recently-used cache of glyph bitmaps, bounded by the total number of
+// bitmap bytes it holds.  Used for fonts that are read from SPIFFS so that
+// only the glyphs that are actually being drawn are kept in memory.
+class GlyphCache {
+public:
+  explicit GlyphCache(size_t capacity = FONT_GLYPH_CACHE_SIZE);
+
+  // Keys are (owner << 16) | bitmap offset, so each font gets its own range
+  static inline uint32_t key(uint16_t owner, uint16_t bitmapOffset) {
+    return (static_cast<uint32_t>(owner) << 16) | bitmapOffset;
+  }
+
+  // Returns the cached bitmap for key and marks it as recently used, or
+  // nullptr if it isn't cached.
+  const uint8_t* get(uint32_t key);
+
+  // Allocates a size byte entry for key, evicting the least recently used
+  // entries to make room for it.  The caller fills the returned buffer.  It
+  // stays valid until the next call to put.
+  uint8_t* put(uint32_t key, size_t size);
+
+  void erase(uint32_t key);
+
+  // Drops all entries belonging to owner
+  void eraseOwner(uint16_t owner);
+
+  inline size_t getSize() const { return size; }
+  inline size_t getCapacity() const { return capacity; }
+
+private:
+  struct Entry {
+    uint32_t key;
+    std::vector<uint8_t> data;
+  };
+
+  const size_t capacity;
+  size_t size;
+
+  // Most recently used first
+  std::list<Entry> entries;
+  std::unordered_map<uint32_t, std::list<Entry>::iterator> index;
+};
@@ -7,6 +7,7 @@ Region::Region(
   std::shared_ptr<const VariableFormatter> formatter,
   String id
 ) : variable(variable)
+  , formatted(false)
   , boundingBox(boundingBox)
   , color(color)
   , formatter(formatter)
@@ -32,16 +33,23 @@ const String& Region::getVariableValue(const String& variable) {
 }
 
 bool Region::updateValue(const String &value) {
-  String newValue = formatter->format(value);
+  if (formatted && value == lastInput) {
+    return false;
+  }
+
+  lastInput = value;
+  formatted = true;
+
+  formatter->formatIntoWithScratch(value, formatBuffer, formatScratch);
 
   // No change
-  if (newValue == variableValue) {
+  if (formatBuffer == variableValue) {
     return false;
   }
 
-  Serial.printf_P(PSTR("Formatted value: %s\n"), newValue.c_str());
+  Serial.printf_P(PSTR("Formatted value: %s\n"), formatBuffer.c_str());
 
-  this->variableValue = newValue;
+  this->variableValue = formatBuffer;
   this->dirty = true;
 
   return true;
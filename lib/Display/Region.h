@@ -1,5 +1,6 @@
 #include <Arduino.h>
 #include <stddef.h>
+#include <algorithm>
 #include <memory>
 #include <VariableFormatters.h>
 #include <GxEPD2_GFX.h>
@@ -43,6 +44,31 @@ struct Rectangle {
       .h = roundedH
     };
   }
+
+  bool isEmpty() const {
+    return w == 0 || h == 0;
+  }
+
+  // Smallest rectangle containing both this and other
+  Rectangle enclosing(const Rectangle& other) const {
+    if (isEmpty()) {
+      return other;
+    } else if (other.isEmpty()) {
+      return *this;
+    }
+
+    uint16_t x1 = std::min(x, other.x);
+    uint16_t y1 = std::min(y, other.y);
+    uint16_t x2 = std::max(x + w, other.x + other.w);
+    uint16_t y2 = std::max(y + h, other.y + other.h);
+
+    return {
+      .x = x1,
+      .y = y1,
+      .w = static_cast<uint16_t>(x2 - x1),
+      .h = static_cast<uint16_t>(y2 - y1)
+    };
+  }
 };
 
 class Region {
@@ -75,6 +101,14 @@ public:
 protected:
   const String variable;
   String variableValue;
+  // The unformatted value variableValue was formatted from.  Formatters don't
+  // keep state, so an update with the same value is skipped here instead.
+  String lastInput;
+  bool formatted;
+  // Formatter output and intermediate results.  Kept between updates so that
+  // formatting reuses their buffers instead of allocating.
+  String formatBuffer;
+  String formatScratch;
   Rectangle boundingBox;
   uint16_t color;
   uint16_t background_color;
@@ -0,0 +1,237 @@
+#include <GxEPD2.h>
+#include <ScreenshotStream.h>
+
+#include <algorithm>
+
+static const uint8_t PNG_SIGNATURE[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+static const uint8_t PNG_GRAYSCALE = 0;
+static const uint8_t PNG_INDEXED = 3;
+// Deflate with a 32K window and no preset dictionary
+static const uint8_t ZLIB_HEADER[] = {0x78, 0x01};
+// White, black, red.  Indexes match packRow.
+static const uint8_t PNG_PALETTE[] = {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00};
+static const uint8_t PNG_FILTER_NONE = 0;
+
+static const uint32_t ADLER_MOD = 65521;
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t length) {
+  static const uint32_t TABLE[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+
+  for (size_t i = 0; i < length; ++i) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+    crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+  }
+
+  return crc;
+}
+
+static uint32_t adler32Update(uint32_t adler, const uint8_t* data, size_t length) {
+  uint32_t a = adler & 0xFFFF;
+  uint32_t b = adler >> 16;
+
+  for (size_t i = 0; i < length; ++i) {
+    a = (a + data[i]) % ADLER_MOD;
+    b = (b + a) % ADLER_MOD;
+  }
+
+  return (b << 16) | a;
+}
+
+ScreenshotStream::ScreenshotStream(const Framebuffer& framebuffer,
+    Format format,
+    uint16_t x,
+    uint16_t y,
+    uint16_t w,
+    uint16_t h)
+    : framebuffer(framebuffer)
+    , format(format)
+    , x(x)
+    , y(y)
+    , w(w)
+    , h(h)
+    , row(0)
+    , adler(1)
+    , offset(0) {
+  writeHeader();
+}
+
+const char* ScreenshotStream::contentType(Format format) {
+  return format == Format::PNG ? "image/png" : "image/x-portable-bitmap";
+}
+
+size_t ScreenshotStream::read(uint8_t* buffer, size_t maxLen) {
+  size_t written = 0;
+
+  while (written < maxLen) {
+    if (offset >= pending.size()) {
+      if (row > h) {
+        break;
+      }
+
+      next();
+      continue;
+    }
+
+    size_t n = std::min(maxLen - written, pending.size() - offset);
+    memcpy(buffer + written, pending.data() + offset, n);
+    written += n;
+    offset += n;
+  }
+
+  return written;
+}
+
+uint8_t ScreenshotStream::bitsPerPixel() const {
+  return (format == Format::PNG && framebuffer.hasColor()) ? 2 : 1;
+}
+
+size_t ScreenshotStream::rowBytes() const {
+  return (static_cast<size_t>(w) * bitsPerPixel() + 7) / 8;
+}
+
+void ScreenshotStream::next() {
+  pending.clear();
+  offset = 0;
+
+  if (row < h) {
+    writeRow();
+  } else {
+    writeTrailer();
+  }
+
+  ++row;
+}
+
+void ScreenshotStream::writeHeader() {
+  if (format == Format::PBM) {
+    char header[24];
+    size_t length = snprintf(header, sizeof(header), "P4\n%u %u\n", w, h);
+    append(header, length);
+    return;
+  }
+
+  append(PNG_SIGNATURE, sizeof(PNG_SIGNATURE));
+
+  size_t start = beginChunk("IHDR", 13);
+  appendUint32(w);
+  appendUint32(h);
+  pending.push_back(bitsPerPixel());
+  pending.push_back(framebuffer.hasColor() ? PNG_INDEXED : PNG_GRAYSCALE);
+  // Compression, filter and interlace methods
+  pending.push_back(0);
+  pending.push_back(0);
+  pending.push_back(0);
+  endChunk(start);
+
+  if (framebuffer.hasColor()) {
+    start = beginChunk("PLTE", sizeof(PNG_PALETTE));
+    append(PNG_PALETTE, sizeof(PNG_PALETTE));
+    endChunk(start);
+  }
+}
+
+void ScreenshotStream::writeRow() {
+  if (format == Format::PBM) {
+    packRow(y + row, true);
+    return;
+  }
+
+  const bool first = row == 0;
+  const bool last = row == h - 1;
+  const uint16_t blockLength = 1 + rowBytes();
+  const uint16_t blockLengthComplement = ~blockLength;
+
+  size_t start = beginChunk("IDAT",
+      (first ? sizeof(ZLIB_HEADER) : 0) + 5 + blockLength + (last ? 4 : 0));
+
+  if (first) {
+    append(ZLIB_HEADER, sizeof(ZLIB_HEADER));
+  }
+
+  // Stored block header: BFINAL, then LEN and its complement, little endian
+  pending.push_back(last ? 1 : 0);
+  pending.push_back(blockLength & 0xFF);
+  pending.push_back(blockLength >> 8);
+  pending.push_back(blockLengthComplement & 0xFF);
+  pending.push_back(blockLengthComplement >> 8);
+
+  const size_t dataStart = pending.size();
+  pending.push_back(PNG_FILTER_NONE);
+  packRow(y + row, false);
+  adler = adler32Update(adler, pending.data() + dataStart, blockLength);
+
+  if (last) {
+    appendUint32(adler);
+  }
+
+  endChunk(start);
+}
+
+void ScreenshotStream::writeTrailer() {
+  if (format == Format::PNG) {
+    endChunk(beginChunk("IEND", 0));
+  }
+}
+
+// PBM uses 1 for black.  PNG's grayscale uses 1 for white, and its indexed
+// rows use PNG_PALETTE.
+void ScreenshotStream::packRow(uint16_t rowY, bool blackIsSet) {
+  const uint8_t bits = bitsPerPixel();
+  uint8_t b = 0;
+  uint8_t used = 0;
+
+  for (uint16_t i = 0; i < w; ++i) {
+    const uint16_t color = framebuffer.getPixel(x + i, rowY);
+    uint8_t value;
+
+    if (bits == 2) {
+      value = color == GxEPD_WHITE ? 0 : (color == GxEPD_BLACK ? 1 : 2);
+    } else {
+      value = (color == GxEPD_WHITE) != blackIsSet;
+    }
+
+    b = (b << bits) | value;
+    used += bits;
+
+    if (used == 8) {
+      pending.push_back(b);
+      b = 0;
+      used = 0;
+    }
+  }
+
+  if (used > 0) {
+    pending.push_back(b << (8 - used));
+  }
+}
+
+size_t ScreenshotStream::beginChunk(const char* type, uint32_t length) {
+  appendUint32(length);
+  const size_t start = pending.size();
+  append(type, 4);
+  return start;
+}
+
+void ScreenshotStream::endChunk(size_t crcStart) {
+  const uint32_t crc = crc32Update(
+      0xFFFFFFFF, pending.data() + crcStart, pending.size() - crcStart);
+  appendUint32(crc ^ 0xFFFFFFFF);
+}
+
+void ScreenshotStream::append(const void* data, size_t length) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  pending.insert(pending.end(), bytes, bytes + length);
+}
+
+void ScreenshotStream::appendUint32(uint32_t value) {
+  pending.push_back(value >> 24);
+  pending.push_back((value >> 16) & 0xFF);
+  pending.push_back((value >> 8) & 0xFF);
+  pending.push_back(value & 0xFF);
+}
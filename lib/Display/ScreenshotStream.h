@@ -0,0 +1,68 @@
+#include <Arduino.h>
+#include <Framebuffer.h>
+
+#include <vector>
+
+#ifndef _SCREENSHOT_STREAM_H
+#define _SCREENSHOT_STREAM_H
+
+// Encodes a region of the framebuffer one row at a time, for chunked
+// responses.  Only a row's worth of output is buffered.
+//
+// PBM is the 1 bit "P4" format.  Anything that isn't white is black.
+//
+// PNG is grayscale at 1 bit per pixel, or indexed at 2 bits per pixel for
+// displays with a third color.  Rows are stored in uncompressed deflate
+// blocks, which makes the size predictable and costs nothing to produce.
+// Each row goes in its own IDAT chunk.
+class ScreenshotStream {
+public:
+  enum class Format { PBM, PNG };
+
+  // The region must be within the framebuffer
+  ScreenshotStream(const Framebuffer& framebuffer,
+      Format format,
+      uint16_t x,
+      uint16_t y,
+      uint16_t w,
+      uint16_t h);
+
+  static const char* contentType(Format format);
+
+  // Fills buffer with up to maxLen bytes.  Returns 0 when done.
+  size_t read(uint8_t* buffer, size_t maxLen);
+
+private:
+  const Framebuffer framebuffer;
+  const Format format;
+  const uint16_t x;
+  const uint16_t y;
+  const uint16_t w;
+  const uint16_t h;
+
+  // Next row to encode, relative to y.  h is the trailer, and h + 1 is done.
+  uint16_t row;
+  uint32_t adler;
+
+  // Encoded bytes of the current row, of which offset have been sent
+  std::vector<uint8_t> pending;
+  size_t offset;
+
+  uint8_t bitsPerPixel() const;
+  size_t rowBytes() const;
+
+  void next();
+  void writeHeader();
+  void writeRow();
+  void writeTrailer();
+  void packRow(uint16_t y, bool blackIsSet);
+
+  // PNG chunks.  crcStart is the offset of the chunk type in pending.
+  size_t beginChunk(const char* type, uint32_t length);
+  void endChunk(size_t crcStart);
+
+  void append(const void* data, size_t length);
+  void appendUint32(uint32_t value);
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include <SpiffsFontMetrics.h>
+
+const char SpiffsFontMetrics::MAGIC[] = "GFXF";
+
+SpiffsFontMetrics::SpiffsFontMetrics(
+  const String& path,
+  std::shared_ptr<GlyphCache> cache
+) : path(path)
+  , cache(cache)
+  , bitmapStart(0)
+{
+  static uint16_t nextId = 0;
+  id = nextId++;
+}
+
+SpiffsFontMetrics::~SpiffsFontMetrics() {
+  if (cache) {
+    cache->eraseOwner(id);
+  }
+}
+
+std::shared_ptr<const FontMetrics> SpiffsFontMetrics::open(
+    const String& path, std::shared_ptr<GlyphCache> cache) {
+  File file = SPIFFS.open(path, "r");
+
+  if (!file) {
+    return nullptr;
+  }
+
+  std::shared_ptr<SpiffsFontMetrics> metrics(new SpiffsFontMetrics(path, cache));
+  const bool loaded = metrics->load(file);
+  file.close();
+
+  if (!loaded) {
+    Serial.print(F("WARN - invalid font file: "));
+    Serial.println(path);
+
+    return nullptr;
+  }
+
+  return metrics;
+}
+
+bool SpiffsFontMetrics::isValid(const String& path) {
+  File file = SPIFFS.open(path, "r");
+
+  if (!file) {
+    return false;
+  }
+
+  SpiffsFontMetrics metrics(path, nullptr);
+  const bool loaded = metrics.load(file);
+  file.close();
+
+  return loaded;
+}
+
+bool SpiffsFontMetrics::load(File& file) {
+  uint8_t header[HEADER_SIZE];
+
+  if (file.read(header, HEADER_SIZE) != HEADER_SIZE ||
+      memcmp(header, MAGIC, 4) != 0) {
+    return false;
+  }
+
+  first = header[4];
+  last = header[5];
+  yAdvance = header[6];
+
+  if (last < first) {
+    return false;
+  }
+
+  const size_t numGlyphs = last - first + 1;
+  bitmapStart = HEADER_SIZE + numGlyphs * GLYPH_SIZE;
+
+  if (file.size() < bitmapStart) {
+    return false;
+  }
+
+  const size_t bitmapSize = file.size() - bitmapStart;
+  glyphs.reserve(numGlyphs);
+
+  for (size_t i = 0; i < numGlyphs; ++i) {
+    uint8_t entry[GLYPH_SIZE];
+
+    if (file.read(entry, GLYPH_SIZE) != GLYPH_SIZE) {
+      return false;
+    }
+
+    Glyph glyph = {
+      .bitmapOffset = static_cast<uint16_t>(entry[0] | (entry[1] << 8)),
+      .width = entry[2],
+      .height = entry[3],
+      .xAdvance = entry[4],
+      .xOffset = static_cast<int8_t>(entry[5]),
+      .yOffset = static_cast<int8_t>(entry[6])
+    };
+
+    // Make sure reading the bitmap later can't run off the end of the file
+    if (glyph.bitmapOffset + static_cast<size_t>(glyph.width * glyph.height + 7) / 8 > bitmapSize) {
+      return false;
+    }
+
+    glyphs.push_back(glyph);
+  }
+
+  computeSummary();
+
+  return true;
+}
+
+const uint8_t* SpiffsFontMetrics::getGlyphBitmap(const Glyph& glyph) const {
+  const uint32_t key = GlyphCache::key(id, glyph.bitmapOffset);
+  const uint8_t* bitmap = cache->get(key);
+
+  if (bitmap != nullptr) {
+    return bitmap;
+  }
+
+  const size_t size = (glyph.width * glyph.height + 7) / 8;
+  uint8_t* buffer = cache->put(key, size);
+  File file = SPIFFS.open(path, "r");
+
+  const bool read = file
+      && file.seek(bitmapStart + glyph.bitmapOffset)
+      && file.read(buffer, size) == size;
+  file.close();
+
+  if (!read) {
+    cache->erase(key);
+    return nullptr;
+  }
+
+  return buffer;
+}
@@ -0,0 +1,62 @@
+#include <FontMetrics.h>
+#include <GlyphCache.h>
+#include <FS.h>
+
+#if defined(ESP32)
+#include <SPIFFS.h>
+#endif
+
+#include <memory>
+
+#pragma once
+
+// A font stored in SPIFFS.  The glyph table is read into memory when the font
+// is opened.  Bitmaps are read on demand through a shared GlyphCache.  The
+// file is only open while it's being read, since SPIFFS can only have a few
+// files open at once.
+//
+// File format (multi-byte values are little endian):
+//
+//   0  char[4]   magic, "GFXF"
+//   4  uint8_t   first character
+//   5  uint8_t   last character
+//   6  uint8_t   yAdvance
+//   7  uint8_t   reserved
+//   8  glyph table, (last - first + 1) entries of 8 bytes each:
+//        uint16_t bitmapOffset
+//        uint8_t  width, height, xAdvance
+//        int8_t   xOffset, yOffset
+//        uint8_t  reserved
+//   .. bitmap data, in the same layout as GFXfont's bitmap array
+//
+// web/util/convert-gfx-font.js converts Adafruit_GFX font headers to this
+// format.
+class SpiffsFontMetrics : public FontMetrics {
+public:
+  static const char MAGIC[];
+  static const size_t HEADER_SIZE = 8;
+  static const size_t GLYPH_SIZE = 8;
+
+  // Returns nullptr if the file doesn't exist or isn't a valid font
+  static std::shared_ptr<const FontMetrics> open(
+      const String& path, std::shared_ptr<GlyphCache> cache);
+
+  // True if path is a font that open() would accept
+  static bool isValid(const String& path);
+
+  virtual ~SpiffsFontMetrics();
+
+  // The returned pointer is only valid until the next call.  Returns nullptr
+  // if the bitmap couldn't be read.
+  virtual const uint8_t* getGlyphBitmap(const Glyph& glyph) const;
+
+private:
+  SpiffsFontMetrics(const String& path, std::shared_ptr<GlyphCache> cache);
+
+  const String path;
+  std::shared_ptr<GlyphCache> cache;
+  uint16_t id;
+  size_t bitmapStart;
+
+  bool load(File& file);
+};
@@ -0,0 +1,76 @@
+#include <FS.h>
+#include <Settings.h>
+#include <TemplateCache.h>
+
+#if defined(ESP32)
+#include <SPIFFS.h>
+#endif
+
+String TemplateCache::pathFor(const String& templatePath) {
+  static const size_t prefixLength = strlen(TEMPLATES_DIRECTORY);
+
+  if (!templatePath.startsWith(TEMPLATES_DIRECTORY "/")) {
+    return "";
+  }
+
+  return String(COMPILED_TEMPLATES_DIRECTORY) + templatePath.substring(prefixLength);
+}
+
+bool TemplateCache::load(const String& templatePath, JsonDocument& tmpl) {
+  const String path = pathFor(templatePath);
+
+  if (path.length() == 0 || !SPIFFS.exists(path)) {
+    return false;
+  }
+
+  File file = SPIFFS.open(path, "r");
+  DeserializationError error = deserializeMsgPack(tmpl, file);
+  file.close();
+
+  if (error || !tmpl.is<JsonObject>()) {
+    Serial.printf_P(
+      PSTR("TemplateCache - WARN: discarding unreadable compiled template %s (%s)\n"),
+      path.c_str(),
+      error.c_str()
+    );
+
+    SPIFFS.remove(path);
+    tmpl.clear();
+
+    return false;
+  }
+
+  return true;
+}
+
+bool TemplateCache::save(const String& templatePath, const JsonDocument& tmpl) {
+  const String path = pathFor(templatePath);
+
+  if (path.length() == 0) {
+    return false;
+  }
+
+  File file = SPIFFS.open(path, FILE_WRITE);
+
+  if (!file) {
+    return false;
+  }
+
+  const size_t expected = measureMsgPack(tmpl);
+  const bool saved = serializeMsgPack(tmpl, file) == expected;
+  file.close();
+
+  if (!saved) {
+    SPIFFS.remove(path);
+  }
+
+  return saved;
+}
+
+void TemplateCache::invalidate(const String& templatePath) {
+  const String path = pathFor(templatePath);
+
+  if (path.length() > 0 && SPIFFS.exists(path)) {
+    SPIFFS.remove(path);
+  }
+}
@@ -0,0 +1,28 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#pragma once
+
+// Templates that passed TemplateValidator are also saved in
+// COMPILED_TEMPLATES_DIRECTORY as MessagePack, with the defaults the validator
+// filled in.  The driver loads the compiled copy when there is one.  The
+// original is kept as it was uploaded so that the editor gets back what it
+// saved.
+//
+// A compiled copy that can't be read is ignored, so a save that's interrupted
+// just means the template is compiled again the next time it's loaded.
+class TemplateCache {
+public:
+  // Path of the compiled copy of templatePath.  Empty for templates outside
+  // of TEMPLATES_DIRECTORY, which aren't cached.
+  static String pathFor(const String& templatePath);
+
+  // Returns false if there's no usable compiled copy of templatePath
+  static bool load(const String& templatePath, JsonDocument& tmpl);
+
+  // tmpl must have been validated
+  static bool save(const String& templatePath, const JsonDocument& tmpl);
+
+  // Call whenever the template at templatePath is written or removed
+  static void invalidate(const String& templatePath);
+};
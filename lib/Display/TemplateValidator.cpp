@@ -0,0 +1,758 @@
+#include <TemplateValidator.h>
+#include <VariableFormatters.h>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+namespace {
+
+static const char* const COLORS[] = {"black", "white", "red", "yellow", "color", nullptr};
+static const char* const ALIGNMENTS[] = {"left", "center", "right", nullptr};
+static const char* const FILL_STYLES[] = {"outline", "filled", nullptr};
+static const char* const VALUE_TYPES[] = {"static", "variable", nullptr};
+static const char* const FORMATTER_TYPES[] = {
+  "ref",
+  "identity",
+  "time",
+  "round",
+  "cases",
+  "range_cases",
+  "ratio",
+  "pfstring",
+  "pfnumeric",
+  "expr",
+  "pipeline",
+  nullptr
+};
+
+static bool isOneOf(const char* value, const char* const* choices) {
+  for (; *choices != nullptr; ++choices) {
+    if (strcasecmp(value, *choices) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool isType(const char* type, const char* expected) {
+  return type != nullptr && strcasecmp(type, expected) == 0;
+}
+
+// Names of reference formatters follow the schema's pattern
+static bool isValidName(const char* name) {
+  if (*name == 0) {
+    return false;
+  }
+
+  for (; *name != 0; ++name) {
+    if (!isalnum(static_cast<unsigned char>(*name)) && *name != '_') {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// ArduinoJson converts numeric strings, and the editor stores some numbers
+// that way
+static bool parseInteger(JsonVariant value, long& result) {
+  if (value.is<long>()) {
+    result = value.as<long>();
+    return true;
+  }
+
+  const char* str = value.as<const char*>();
+  char* end = nullptr;
+
+  if (str == nullptr || *str == 0) {
+    return false;
+  }
+
+  result = strtol(str, &end, 10);
+  return *end == 0;
+}
+
+}
+
+TemplateValidator::TemplateValidator(TExistsFn bitmapExists, TExistsFn fontExists)
+  : bitmapExists(bitmapExists)
+  , fontExists(fontExists)
+  , backgroundColor(nullptr)
+  , pathLength(0)
+  , errorCount(0)
+{
+  path[0] = 0;
+}
+
+bool TemplateValidator::validate(JsonDocument& tmpl, JsonArray errors) {
+  this->errors = errors;
+  errorCount = 0;
+  leave(0);
+
+  if (!tmpl.is<JsonObject>()) {
+    addError("must be an object");
+    return false;
+  }
+
+  JsonObject root = tmpl.as<JsonObject>();
+
+  backgroundColor = checkChoice(root, "background_color", COLORS, "white");
+
+  // Already reported.  Keeps elements from reporting it again.
+  if (backgroundColor == nullptr) {
+    backgroundColor = "white";
+  }
+
+  long rotation = 0;
+  if (!root["rotation"].isNull()
+    && (!parseInteger(root["rotation"], rotation) || rotation < 0 || rotation > 3)) {
+    addError("rotation", "must be 0, 1, 2 or 3");
+  }
+
+  referenceFormatters = root["formatters"];
+  checkReferenceFormatters(referenceFormatters);
+
+  checkElements(root, "lines", &TemplateValidator::checkLine);
+  checkElements(root, "bitmaps", &TemplateValidator::checkBitmap);
+  checkElements(root, "text", &TemplateValidator::checkText);
+  checkElements(root, "rectangles", &TemplateValidator::checkRectangle);
+
+  // Defaults that didn't fit would be silently missing
+  if (tmpl.overflowed()) {
+    leave(0);
+    addError("template is too large");
+  }
+
+  return errorCount == 0;
+}
+
+void TemplateValidator::addParseError(DeserializationError error, JsonArray errors) {
+  JsonObject result = errors.createNestedObject();
+  result["path"] = "";
+
+  if (error == DeserializationError::NoMemory) {
+    result["message"] = "template is too large";
+  } else {
+    result["message"] = "invalid JSON";
+  }
+}
+
+void TemplateValidator::checkElements(
+  JsonObject tmpl,
+  const char* key,
+  TCheckFn check
+) {
+  JsonVariant elements = tmpl[key];
+
+  if (elements.isNull()) {
+    return;
+  }
+
+  const size_t parent = enter(key);
+
+  if (elements.is<JsonArray>()) {
+    size_t ix = 0;
+
+    for (JsonVariant element : elements.as<JsonArray>()) {
+      const size_t p = enter(ix++);
+
+      if (element.is<JsonObject>()) {
+        (this->*check)(element.as<JsonObject>());
+      } else {
+        addError("must be an object");
+      }
+
+      leave(p);
+    }
+  } else {
+    addError("must be an array");
+  }
+
+  leave(parent);
+}
+
+void TemplateValidator::checkLine(JsonObject line) {
+  checkPosition(line, "x1", true);
+  checkPosition(line, "y1", true);
+  checkPosition(line, "x2", true);
+  checkPosition(line, "y2", true);
+  checkChoice(line, "color", COLORS, "black");
+}
+
+void TemplateValidator::checkBitmap(JsonObject bitmap) {
+  checkPosition(bitmap, "x", false);
+  checkPosition(bitmap, "y", false);
+  checkPosition(bitmap, "w", false);
+  checkPosition(bitmap, "h", false);
+  checkChoice(bitmap, "color", COLORS, "black");
+  checkChoice(bitmap, "background_color", COLORS, backgroundColor);
+  checkValue(bitmap, true);
+}
+
+void TemplateValidator::checkText(JsonObject text) {
+  checkPosition(text, "x", false);
+  checkPosition(text, "y", false);
+
+  const char* font = checkString(text, "font", false);
+  if (font != nullptr && !fontExists(font)) {
+    addError("font", "font not found");
+  }
+
+  long fontSize = 1;
+  if (text["font_size"].isNull()) {
+    text["font_size"] = fontSize;
+  } else if (parseInteger(text["font_size"], fontSize) && fontSize >= 1 && fontSize <= 255) {
+    // The driver reads it as a number
+    text["font_size"] = fontSize;
+  } else {
+    addError("font_size", "must be an integer from 1 to 255");
+  }
+
+  checkChoice(text, "alignment", ALIGNMENTS, "left");
+  checkChoice(text, "color", COLORS, "black");
+  checkValue(text, false);
+}
+
+void TemplateValidator::checkRectangle(JsonObject rectangle) {
+  checkPosition(rectangle, "x", false);
+  checkPosition(rectangle, "y", false);
+  checkChoice(rectangle, "style", FILL_STYLES, "outline");
+  checkChoice(rectangle, "color", COLORS, "black");
+  checkDimension(rectangle, "w");
+  checkDimension(rectangle, "h");
+}
+
+void TemplateValidator::checkValue(JsonObject spec, bool isBitmap) {
+  JsonVariant value = spec["value"];
+
+  // Older format where "static" and "variable" are inline with the definition
+  if (value.isNull()) {
+    const char* staticValue = checkString(spec, "static", false);
+
+    if (isBitmap && staticValue != nullptr && !bitmapExists(staticValue)) {
+      addError("static", "bitmap not found");
+    }
+
+    if (checkString(spec, "variable", false) != nullptr && spec.containsKey("formatter")) {
+      checkFormatter(spec, true, isBitmap);
+    }
+
+    return;
+  }
+
+  const size_t p = enter("value");
+
+  if (value.is<JsonObject>()) {
+    JsonObject choice = value.as<JsonObject>();
+    const char* type = checkChoice(choice, "type", VALUE_TYPES, nullptr);
+
+    if (isType(type, "static")) {
+      const char* staticValue = checkString(choice, "value", isBitmap);
+
+      if (isBitmap && staticValue != nullptr && !bitmapExists(staticValue)) {
+        addError("value", "bitmap not found");
+      }
+    } else if (isType(type, "variable")) {
+      checkString(choice, "variable", true);
+
+      if (choice.containsKey("formatter")) {
+        checkFormatter(choice, true, isBitmap);
+      }
+    }
+  } else {
+    addError("must be an object");
+  }
+
+  leave(p);
+}
+
+void TemplateValidator::checkDimension(JsonObject rectangle, const char* key) {
+  JsonVariant dimension = rectangle[key];
+
+  if (dimension.isNull()) {
+    return;
+  }
+
+  const size_t p = enter(key);
+
+  if (dimension.is<JsonObject>()) {
+    JsonObject choice = dimension.as<JsonObject>();
+    const char* type = checkChoice(choice, "type", VALUE_TYPES, nullptr);
+
+    if (isType(type, "static")) {
+      long value = 0;
+
+      if (parseInteger(choice["value"], value) && value >= 0) {
+        // Saves converting it every time the template is loaded
+        choice["value"] = value;
+      } else {
+        addError("value", "must be a non-negative integer");
+      }
+    } else if (isType(type, "variable")) {
+      checkString(choice, "variable", true);
+
+      if (choice.containsKey("formatter")) {
+        checkFormatter(choice, true, false);
+      }
+    }
+  } else {
+    addError("must be an object");
+  }
+
+  leave(p);
+}
+
+void TemplateValidator::checkReferenceFormatters(JsonVariant formatters) {
+  if (formatters.isNull()) {
+    return;
+  }
+
+  const size_t parent = enter("formatters");
+
+  if (formatters.is<JsonArray>()) {
+    size_t ix = 0;
+
+    for (JsonVariant formatter : formatters.as<JsonArray>()) {
+      const size_t p = enter(ix++);
+      JsonObject definition = formatter.as<JsonObject>();
+
+      if (definition.isNull()) {
+        addError("must be an object");
+      } else {
+        const char* name = checkString(definition, "name", true);
+
+        if (name != nullptr && !isValidName(name)) {
+          addError("name", "may only contain letters, digits and underscores");
+        }
+
+        if (definition.containsKey("formatter")) {
+          checkFormatter(definition, false, false);
+        } else {
+          addError("formatter", "is required");
+        }
+      }
+
+      leave(p);
+    }
+  // Older format, keyed by name
+  } else if (formatters.is<JsonObject>()) {
+    for (JsonPair kv : formatters.as<JsonObject>()) {
+      const size_t p = enter(kv.key().c_str());
+
+      if (kv.value().is<JsonObject>()) {
+        checkFormatter(kv.value().as<JsonObject>(), false, false);
+      } else {
+        addError("must be an object");
+      }
+
+      leave(p);
+    }
+  } else {
+    addError("must be an array");
+  }
+
+  leave(parent);
+}
+
+// Follows VariableFormatterFactory::_createInternal.  spec is either the
+// formatter itself, or an object with the formatter under "formatter".
+void TemplateValidator::checkFormatter(JsonObject spec, bool allowReference, bool isBitmap) {
+  JsonVariant formatter = spec;
+  size_t p = pathLength;
+
+  if (spec.containsKey("formatter")) {
+    formatter = spec["formatter"];
+    p = enter("formatter");
+  }
+
+  const char* type = nullptr;
+  const char* reference = nullptr;
+  JsonVariant args;
+
+  // Older format where the type is a string and arguments are next to it.
+  // References are prefixed with &.
+  if (formatter.is<const char*>()) {
+    type = formatter.as<const char*>();
+    args = spec["args"];
+
+    if (type[0] == '&') {
+      reference = type + 1;
+      type = "ref";
+    } else if (!isOneOf(type, FORMATTER_TYPES)) {
+      addError("unknown formatter type");
+      type = nullptr;
+    }
+  } else if (formatter.is<JsonObject>()) {
+    JsonObject definition = formatter.as<JsonObject>();
+    // The editor leaves the type out of formatters that haven't been set up
+    type = checkChoice(definition, "type", FORMATTER_TYPES, "identity");
+    args = definition["args"];
+
+    if (isType(type, "ref")) {
+      reference = checkString(definition, "ref", true);
+    }
+  } else {
+    addError("must be an object");
+  }
+
+  if (isType(type, "ref")) {
+    if (!allowReference) {
+      addError("reference formatters can't refer to other formatters");
+    } else if (reference != nullptr) {
+      JsonObject referenced = findReference(reference);
+
+      if (referenced.isNull()) {
+        addError("refers to an undefined formatter");
+      } else if (isBitmap) {
+        checkReferencedBitmaps(referenced);
+      }
+    }
+  } else if (type != nullptr) {
+    if (!args.isNull() && !args.is<JsonObject>()) {
+      addError("args", "must be an object");
+    } else {
+      const size_t argsPath = enter("args");
+      checkFormatterArgs(type, args.as<JsonObject>(), allowReference, isBitmap);
+      leave(argsPath);
+    }
+  }
+
+  leave(p);
+}
+
+void TemplateValidator::checkFormatterArgs(
+  const char* type,
+  JsonObject args,
+  bool allowReference,
+  bool isBitmap
+) {
+  if (isType(type, "time")) {
+    checkString(args, "format", false);
+    checkString(args, "timezone", false);
+  } else if (isType(type, "round")) {
+    checkInteger(args, "digits", false);
+  } else if (isType(type, "ratio")) {
+    if (!args["base"].isNull() && !args["base"].is<float>()) {
+      addError("base", "must be a number");
+    }
+  } else if (isType(type, "pfstring")) {
+    checkString(args, "format", false);
+  } else if (isType(type, "pfnumeric")) {
+    const char* format = checkString(args, "format", false);
+    PrintfFormatterNumeric::Spec spec;
+
+    if (format != nullptr) {
+      const char* error = PrintfFormatterNumeric::parse(format, spec);
+
+      if (error != nullptr) {
+        addError("format", error);
+      }
+    }
+  } else if (isType(type, "cases") || isType(type, "range_cases")) {
+    const char* listKey = isType(type, "cases") ? "cases" : "ranges";
+    JsonVariant list = args[listKey];
+
+    checkString(args, "prefix", false);
+    checkString(args, "default", false);
+
+    // Either a list of objects, or an object keyed by the value to match
+    if (!list.isNull() && !list.is<JsonArray>() && !list.is<JsonObject>()) {
+      addError(listKey, "must be an array or an object");
+    } else {
+      if (list.is<JsonArray>()) {
+        checkCaseList(list.as<JsonArray>(), listKey);
+      }
+
+      if (isBitmap) {
+        checkBitmapChoices(args, listKey);
+      }
+    }
+  } else if (isType(type, "expr")) {
+    const char* expression = checkString(args, "expression", true);
+    std::vector<ExpressionVariableFormatter::Instruction> program;
+
+    if (expression != nullptr) {
+      const char* error = ExpressionVariableFormatter::compile(expression, program);
+
+      if (error != nullptr) {
+        addError("expression", error);
+      }
+    }
+
+    if (args.containsKey("formatter")) {
+      checkFormatter(args, allowReference, isBitmap);
+    }
+  } else if (isType(type, "pipeline")) {
+    JsonVariant stages = args["stages"];
+
+    if (!stages.is<JsonArray>()) {
+      addError("stages", "must be an array");
+      return;
+    }
+
+    const size_t parent = enter("stages");
+    size_t ix = 0;
+
+    for (JsonVariant stage : stages.as<JsonArray>()) {
+      const size_t p = enter(ix++);
+
+      if (stage.is<JsonObject>()) {
+        // Only the last stage's output is a filename
+        checkFormatter(stage.as<JsonObject>(), allowReference, isBitmap && ix == stages.size());
+      } else {
+        addError("must be an object");
+      }
+
+      leave(p);
+    }
+
+    leave(parent);
+  }
+}
+
+void TemplateValidator::checkCaseList(JsonArray list, const char* listKey) {
+  const bool isRanges = strcmp(listKey, "ranges") == 0;
+  const size_t parent = enter(listKey);
+  size_t ix = 0;
+
+  for (JsonVariant item : list) {
+    const size_t p = enter(ix++);
+
+    JsonObject choice = item.as<JsonObject>();
+
+    if (choice.isNull()) {
+      addError("must be an object");
+    } else if (isRanges) {
+      if (!choice["min"].isNull() && !choice["min"].is<float>()) {
+        addError("min", "must be a number");
+      }
+
+      checkString(choice, "value", false);
+    } else {
+      checkString(choice, "key", false);
+      checkString(choice, "value", false);
+    }
+
+    leave(p);
+  }
+
+  leave(parent);
+}
+
+JsonObject TemplateValidator::findReference(const char* name) {
+  if (referenceFormatters.is<JsonArray>()) {
+    for (JsonObject definition : referenceFormatters.as<JsonArray>()) {
+      const char* definitionName = definition["name"];
+
+      if (definitionName != nullptr && strcmp(definitionName, name) == 0) {
+        return definition;
+      }
+    }
+  } else if (referenceFormatters.is<JsonObject>()) {
+    return referenceFormatters[name];
+  }
+
+  return JsonObject();
+}
+
+void TemplateValidator::checkReferencedBitmaps(JsonObject definition) {
+  JsonVariant formatter = definition;
+
+  if (definition.containsKey("formatter")) {
+    formatter = definition["formatter"];
+  }
+
+  if (!formatter.is<JsonObject>()) {
+    return;
+  }
+
+  const char* type = formatter["type"];
+
+  if (isType(type, "cases")) {
+    checkBitmapChoices(formatter["args"], "cases");
+  } else if (isType(type, "range_cases")) {
+    checkBitmapChoices(formatter["args"], "ranges");
+  }
+}
+
+void TemplateValidator::checkBitmapChoices(JsonObject args, const char* listKey) {
+  JsonVariant list = args[listKey];
+
+  if (list.is<JsonObject>()) {
+    for (JsonPair choice : list.as<JsonObject>()) {
+      if (!checkBitmapChoice(args, choice.value())) {
+        return;
+      }
+    }
+  } else {
+    for (JsonObject choice : list.as<JsonArray>()) {
+      if (!checkBitmapChoice(args, choice["value"])) {
+        return;
+      }
+    }
+  }
+
+  checkBitmapChoice(args, args["default"]);
+}
+
+bool TemplateValidator::checkBitmapChoice(JsonObject args, JsonVariant value) {
+  const char* name = value;
+
+  if (name == nullptr) {
+    return true;
+  }
+
+  char filename[TEMPLATE_VALIDATOR_MAX_PATH];
+  snprintf(filename, sizeof(filename), "%s%s", args["prefix"] | "", name);
+
+  if (!bitmapExists(filename)) {
+    addError("bitmap not found");
+    return false;
+  }
+
+  return true;
+}
+
+void TemplateValidator::checkInteger(JsonObject spec, const char* key, bool required) {
+  JsonVariant value = spec[key];
+  long parsed;
+
+  if (value.isNull()) {
+    if (required) {
+      addError(key, "is required");
+    }
+  } else if (!parseInteger(value, parsed)) {
+    addError(key, "must be an integer");
+  }
+}
+
+void TemplateValidator::checkPosition(JsonObject spec, const char* key, bool required) {
+  JsonVariant value = spec[key];
+  long parsed;
+
+  if (value.isNull()) {
+    if (required) {
+      addError(key, "is required");
+    }
+  } else if (!parseInteger(value, parsed) || parsed < 0) {
+    addError(key, "must be a non-negative integer");
+  }
+}
+
+const char* TemplateValidator::checkString(JsonObject spec, const char* key, bool required) {
+  JsonVariant value = spec[key];
+
+  if (value.isNull()) {
+    if (required) {
+      addError(key, "is required");
+    }
+
+    return nullptr;
+  } else if (!value.is<const char*>()) {
+    addError(key, "must be a string");
+    return nullptr;
+  }
+
+  return value.as<const char*>();
+}
+
+const char* TemplateValidator::checkChoice(
+  JsonObject spec,
+  const char* key,
+  const char* const* choices,
+  const char* defaultValue
+) {
+  JsonVariant value = spec[key];
+
+  if (value.isNull()) {
+    if (defaultValue == nullptr) {
+      addError(key, "is required");
+    } else {
+      spec[key] = defaultValue;
+    }
+
+    return defaultValue;
+  }
+
+  const char* str = value.as<const char*>();
+
+  if (str != nullptr && isOneOf(str, choices)) {
+    return str;
+  }
+
+  char message[96] = "must be one of";
+  size_t length = strlen(message);
+
+  for (const char* const* choice = choices; *choice != nullptr && length < sizeof(message); ++choice) {
+    length += snprintf(
+      message + length,
+      sizeof(message) - length,
+      "%s %s",
+      choice == choices ? "" : ",",
+      *choice
+    );
+  }
+
+  addError(key, message);
+  return nullptr;
+}
+
+size_t TemplateValidator::enter(const char* key) {
+  const size_t previous = pathLength;
+  const size_t end = sizeof(path) - 1;
+
+  if (pathLength < end) {
+    path[pathLength++] = '/';
+  }
+
+  // RFC 6901: "~" and "/" in keys are written as "~0" and "~1"
+  for (; *key != 0 && pathLength < end; ++key) {
+    if (*key == '~' || *key == '/') {
+      path[pathLength++] = '~';
+
+      if (pathLength < end) {
+        path[pathLength++] = *key == '~' ? '0' : '1';
+      }
+    } else {
+      path[pathLength++] = *key;
+    }
+  }
+
+  path[pathLength] = 0;
+  return previous;
+}
+
+size_t TemplateValidator::enter(size_t index) {
+  const size_t previous = pathLength;
+  const int n = snprintf(path + pathLength, sizeof(path) - pathLength, "/%u", static_cast<unsigned>(index));
+
+  pathLength = std::min(pathLength + (n > 0 ? n : 0), sizeof(path) - 1);
+  return previous;
+}
+
+void TemplateValidator::leave(size_t length) {
+  pathLength = length;
+  path[length] = 0;
+}
+
+void TemplateValidator::addError(const char* message) {
+  if (++errorCount > TEMPLATE_VALIDATOR_MAX_ERRORS) {
+    return;
+  }
+
+  JsonObject error = errors.createNestedObject();
+
+  // Passed as char* so that ArduinoJson stores copies
+  error["path"] = const_cast<char*>(path);
+  error["message"] = const_cast<char*>(message);
+}
+
+void TemplateValidator::addError(const char* key, const char* message) {
+  const size_t p = enter(key);
+  addError(message);
+  leave(p);
+}
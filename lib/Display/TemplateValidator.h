@@ -0,0 +1,101 @@
+#include <ArduinoJson.h>
+
+#include <algorithm>
+#include <functional>
+
+#pragma once
+
+#ifndef TEMPLATE_VALIDATOR_MAX_ERRORS
+#define TEMPLATE_VALIDATOR_MAX_ERRORS 32
+#endif
+
+#ifndef TEMPLATE_VALIDATOR_MAX_PATH
+#define TEMPLATE_VALIDATOR_MAX_PATH 128
+#endif
+
+// Checks templates against template.schema.json so that mistakes are reported
+// when a template is uploaded rather than when the display loads it (the
+// schema's constraints are checked one by one in test/test_driver).  On top
+// of the schema, formatter references have to name a formatter defined in the
+// template, fonts and static bitmaps have to exist, and pfnumeric formats and
+// expressions have to compile.
+//
+// Fields that were left out are filled in with the values used when
+// rendering, so a validated template can be rendered without looking for them.
+// Numbers the editor stored as strings are converted.
+//
+// Fonts and bitmaps are looked up through callbacks so that it can be run on
+// the host as well (see scripts/validate_template).
+class TemplateValidator {
+public:
+  // Called with a font name, or with the path of a bitmap file
+  typedef std::function<bool(const char* name)> TExistsFn;
+
+  TemplateValidator(TExistsFn bitmapExists, TExistsFn fontExists);
+
+  // Each problem is added to errors as an object with a JSON pointer to the
+  // offending value ("path") and a description ("message").  At most
+  // TEMPLATE_VALIDATOR_MAX_ERRORS are reported.  Returns true if the template
+  // is valid.
+  bool validate(JsonDocument& tmpl, JsonArray errors);
+
+  // Adds an error for a template that couldn't be deserialized
+  static void addParseError(DeserializationError error, JsonArray errors);
+
+private:
+  typedef void (TemplateValidator::*TCheckFn)(JsonObject spec);
+
+  TExistsFn bitmapExists;
+  TExistsFn fontExists;
+
+  JsonArray errors;
+  JsonVariant referenceFormatters;
+  // The template's, which bitmaps default to
+  const char* backgroundColor;
+
+  // JSON pointer to the value being checked
+  char path[TEMPLATE_VALIDATOR_MAX_PATH];
+  size_t pathLength;
+  size_t errorCount;
+
+  void checkElements(JsonObject tmpl, const char* key, TCheckFn check);
+  void checkBitmap(JsonObject bitmap);
+  void checkText(JsonObject text);
+  void checkRectangle(JsonObject rectangle);
+  void checkLine(JsonObject line);
+
+  // Checks the "value" of a bitmap or text, or the "static" and "variable"
+  // keys of the older format where they're inline with the definition
+  void checkValue(JsonObject spec, bool isBitmap);
+  void checkDimension(JsonObject rectangle, const char* key);
+
+  void checkReferenceFormatters(JsonVariant formatters);
+  void checkFormatter(JsonObject spec, bool allowReference, bool isBitmap);
+  void checkFormatterArgs(const char* type, JsonObject args, bool allowReference, bool isBitmap);
+  // The "cases" or "ranges" of a cases or range_cases formatter, when they're
+  // a list of objects
+  void checkCaseList(JsonArray list, const char* listKey);
+  JsonObject findReference(const char* name);
+  // Formatters for bitmaps produce filenames.  The ones that come from a
+  // fixed list are checked.
+  void checkReferencedBitmaps(JsonObject definition);
+  void checkBitmapChoices(JsonObject args, const char* listKey);
+  // Returns false (after adding an error) if value names a missing bitmap
+  bool checkBitmapChoice(JsonObject args, JsonVariant value);
+
+  void checkInteger(JsonObject spec, const char* key, bool required);
+  // Coordinates and sizes, which can't be negative
+  void checkPosition(JsonObject spec, const char* key, bool required);
+  // Fills in defaultValue if the key is missing.  Otherwise it has to be one
+  // of choices (case insensitive).  Returns the value.
+  const char* checkChoice(JsonObject spec, const char* key, const char* const* choices, const char* defaultValue);
+  const char* checkString(JsonObject spec, const char* key, bool required);
+
+  // Returns the previous length of the path, which is passed to leave()
+  size_t enter(const char* key);
+  size_t enter(size_t index);
+  void leave(size_t length);
+
+  void addError(const char* message);
+  void addError(const char* key, const char* message);
+};
@@ -0,0 +1,11 @@
+#include <TextAlignment.h>
+
+TextAlignment textAlignmentFromString(const String& str) {
+  if (str.equalsIgnoreCase("center")) {
+    return TextAlignment::CENTER;
+  } else if (str.equalsIgnoreCase("right")) {
+    return TextAlignment::RIGHT;
+  } else {
+    return TextAlignment::LEFT;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#include <Arduino.h>
+
+#pragma once
+
+enum class TextAlignment {
+  LEFT, CENTER, RIGHT
+};
+
+TextAlignment textAlignmentFromString(const String& str);
\ No newline at end of file
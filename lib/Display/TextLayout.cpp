@@ -0,0 +1,220 @@
+#include <TextLayout.h>
+
+#include <limits.h>
+#include <string.h>
+
+TextLayout::TextLayout(
+  std::shared_ptr<const FontMetrics> metrics,
+  uint8_t size,
+  TextAlignment alignment
+) : metrics(metrics)
+  , size(size)
+  , alignment(alignment)
+{
+  clear();
+}
+
+void TextLayout::clear() {
+  placements.clear();
+  minX = minY = INT16_MAX;
+  maxX = maxY = INT16_MIN;
+}
+
+void TextLayout::render(
+    GxEPD2_GFX* display, const String& text, int16_t x, int16_t y, uint16_t color) {
+  clear();
+
+  if (metrics == nullptr) {
+    return;
+  }
+
+  const char* str = text.c_str();
+  const size_t length = text.length();
+  const int16_t lineHeight = metrics->getYAdvance() * size;
+  const int16_t displayWidth = display->width();
+
+  int16_t cursorY = y;
+  placements.reserve(length);
+
+  display->startWrite();
+
+  for (size_t lineStart = 0; lineStart <= length; cursorY += lineHeight) {
+    const char* line = str + lineStart;
+    const char* newline = strchr(line, '\n');
+    const size_t lineLength = newline ? (newline - line) : (length - lineStart);
+
+    // Aligned text needs the width of the line before the first glyph can be
+    // placed.  That only needs the advances, which are already cached.
+    int16_t cursorX = x;
+    if (alignment == TextAlignment::LEFT && lineStart > 0) {
+      cursorX = 0;
+    } else if (alignment == TextAlignment::CENTER) {
+      cursorX -= measureAdvance(line, lineLength) / 2;
+    } else if (alignment == TextAlignment::RIGHT) {
+      cursorX -= measureAdvance(line, lineLength);
+    }
+
+    for (size_t i = 0; i < lineLength; ++i) {
+      const uint8_t c = line[i];
+      const FontMetrics::Glyph* glyph = metrics->getGlyph(c);
+
+      // Same as Adafruit_GFX: characters outside of the font are skipped
+      if (glyph == nullptr) {
+        continue;
+      }
+
+      if (glyph->width > 0 && glyph->height > 0) {
+        if (alignment == TextAlignment::LEFT &&
+            cursorX + (glyph->xOffset + glyph->width) * size > displayWidth) {
+          cursorX = 0;
+          cursorY += lineHeight;
+        }
+
+        drawGlyph(display, *glyph, cursorX, cursorY, color);
+
+        const int16_t x1 = cursorX + glyph->xOffset * size;
+        const int16_t y1 = cursorY + glyph->yOffset * size;
+        minX = std::min(minX, x1);
+        minY = std::min(minY, y1);
+        maxX = std::max(maxX, static_cast<int16_t>(x1 + glyph->width * size));
+        maxY = std::max(maxY, static_cast<int16_t>(y1 + glyph->height * size));
+      }
+
+      placements.push_back({c, cursorX, cursorY});
+      cursorX += glyph->xAdvance * size;
+    }
+
+    lineStart += lineLength + 1;
+  }
+
+  display->endWrite();
+}
+
+uint16_t TextLayout::measureAdvance(const char* text, size_t length) const {
+  uint16_t advance = 0;
+
+  for (size_t i = 0; i < length; ++i) {
+    const FontMetrics::Glyph* glyph = metrics->getGlyph(text[i]);
+
+    if (glyph != nullptr) {
+      advance += glyph->xAdvance * size;
+    }
+  }
+
+  return advance;
+}
+
+Rectangle TextLayout::getBounds() const {
+  // Pixels off the top or left of the screen aren't drawn, so clamp to 0
+  const int16_t x1 = std::max(minX, static_cast<int16_t>(0));
+  const int16_t y1 = std::max(minY, static_cast<int16_t>(0));
+
+  if (maxX <= x1 || maxY <= y1) {
+    return {0, 0, 0, 0};
+  }
+
+  return {
+    .x = static_cast<uint16_t>(x1),
+    .y = static_cast<uint16_t>(y1),
+    .w = static_cast<uint16_t>(maxX - x1),
+    .h = static_cast<uint16_t>(maxY - y1)
+  };
+}
+
+Rectangle TextLayout::glyphBound(const Placement& placement) const {
+  const FontMetrics::Glyph* glyph = metrics->getGlyph(placement.c);
+
+  int16_t x1 = placement.x + glyph->xOffset * size;
+  int16_t y1 = placement.y + glyph->yOffset * size;
+  int16_t x2 = x1 + glyph->width * size;
+  int16_t y2 = y1 + glyph->height * size;
+
+  x1 = std::max(x1, static_cast<int16_t>(0));
+  y1 = std::max(y1, static_cast<int16_t>(0));
+
+  if (x2 <= x1 || y2 <= y1) {
+    return {0, 0, 0, 0};
+  }
+
+  return {
+    .x = static_cast<uint16_t>(x1),
+    .y = static_cast<uint16_t>(y1),
+    .w = static_cast<uint16_t>(x2 - x1),
+    .h = static_cast<uint16_t>(y2 - y1)
+  };
+}
+
+Rectangle TextLayout::changedBound(const TextLayout& previous) const {
+  const std::vector<Placement>& before = previous.placements;
+  const std::vector<Placement>& after = placements;
+  const size_t minLength = std::min(before.size(), after.size());
+
+  auto samePlacement = [](const Placement& a, const Placement& b) {
+    return a.c == b.c && a.x == b.x && a.y == b.y;
+  };
+
+  size_t prefix = 0;
+  while (prefix < minLength && samePlacement(before[prefix], after[prefix])) {
+    ++prefix;
+  }
+
+  size_t suffix = 0;
+  while (suffix < (minLength - prefix) &&
+         samePlacement(before[before.size() - suffix - 1],
+                       after[after.size() - suffix - 1])) {
+    ++suffix;
+  }
+
+  Rectangle bound = {0, 0, 0, 0};
+
+  for (size_t i = prefix; i < before.size() - suffix; ++i) {
+    bound = bound.enclosing(previous.glyphBound(before[i]));
+  }
+
+  for (size_t i = prefix; i < after.size() - suffix; ++i) {
+    bound = bound.enclosing(glyphBound(after[i]));
+  }
+
+  return bound;
+}
+
+// Equivalent to the custom font path of Adafruit_GFX::drawChar, using the
+// cached glyph instead of reading it from PROGMEM.
+void TextLayout::drawGlyph(
+    GxEPD2_GFX* display,
+    const FontMetrics::Glyph& glyph,
+    int16_t x,
+    int16_t y,
+    uint16_t color) const {
+  const uint8_t* bitmap = metrics->getGlyphBitmap(glyph);
+
+  if (bitmap == nullptr) {
+    return;
+  }
+
+  uint8_t bits = 0;
+  uint8_t bit = 0;
+
+  for (uint8_t yy = 0; yy < glyph.height; ++yy) {
+    for (uint8_t xx = 0; xx < glyph.width; ++xx) {
+      if (!(bit++ & 7)) {
+        bits = pgm_read_byte(bitmap++);
+      }
+
+      if (bits & 0x80) {
+        if (size == 1) {
+          display->writePixel(x + glyph.xOffset + xx, y + glyph.yOffset + yy, color);
+        } else {
+          display->writeFillRect(
+              x + (glyph.xOffset + xx) * size,
+              y + (glyph.yOffset + yy) * size,
+              size,
+              size,
+              color);
+        }
+      }
+
+      bits <<= 1;
+    }
+  }
+}
@@ -0,0 +1,62 @@
+#include <FontMetrics.h>
+#include <Region.h>
+#include <TextAlignment.h>
+
+#include <GxEPD2_GFX.h>
+
+#include <memory>
+#include <vector>
+
+#pragma once
+
+// Positions and draws text from cached font metrics in a single pass over the
+// string.  Keeps the position of every glyph it placed so that two layouts of
+// the same region can be compared to find the area that actually changed.
+class TextLayout {
+public:
+  struct Placement {
+    uint8_t c;
+    int16_t x;
+    int16_t y;
+  };
+
+  TextLayout(
+    std::shared_ptr<const FontMetrics> metrics,
+    uint8_t size,
+    TextAlignment alignment
+  );
+
+  // Lays out text with its anchor at (x, y) and draws it to display.  y is the
+  // baseline of the first line.  x is the left edge, center or right edge of
+  // each line depending on the alignment.
+  //
+  // Left-aligned text is laid out the same way Adafruit_GFX::print does:
+  // lines after a newline, and text that wraps at the right edge of the
+  // display, start at the left edge of the display rather than at x.
+  void render(GxEPD2_GFX* display, const String& text, int16_t x, int16_t y, uint16_t color);
+
+  // Bounding box of the ink drawn by the last call to render
+  Rectangle getBounds() const;
+
+  // Area covering the glyphs that differ between previous and this layout.
+  // Glyphs that are the same character in the same position are skipped.
+  // Empty if nothing changed.
+  Rectangle changedBound(const TextLayout& previous) const;
+
+  // Sum of the advances for the glyphs in text, which is where the cursor
+  // would end up relative to where it started.
+  uint16_t measureAdvance(const char* text, size_t length) const;
+
+  void clear();
+
+private:
+  std::shared_ptr<const FontMetrics> metrics;
+  uint8_t size;
+  TextAlignment alignment;
+
+  std::vector<Placement> placements;
+  int16_t minX, minY, maxX, maxY;
+
+  Rectangle glyphBound(const Placement& placement) const;
+  void drawGlyph(GxEPD2_GFX* display, const FontMetrics::Glyph& glyph, int16_t x, int16_t y, uint16_t color) const;
+};
@@ -1,7 +1,5 @@
 #include <TextRegion.h>
 
-#define BB_COORD(c, d) (static_cast<uint16_t>(((c) >= 0) ? (c) : (d)))
-
 TextRegion::TextRegion(
   const String& variable,
   uint16_t x,
@@ -9,7 +7,8 @@ TextRegion::TextRegion(
   std::shared_ptr<Rectangle> fixedBound,
   uint16_t color,
   uint16_t backgroundColor,
-  const GFXfont* font,
+  std::shared_ptr<const FontMetrics> font,
+  TextAlignment alignment,
   std::shared_ptr<const VariableFormatter> formatter,
   uint8_t size,
   uint16_t index
@@ -20,55 +19,45 @@ TextRegion::TextRegion(
       formatter,
       "t-" + String(index)
     )
-  , font(font)
   , fixedBound(fixedBound)
-  , currentBound({x, y, 0, 0})
-  , previousBound({x, y, 0, 0})
-  , size(size)
+  , layout(font, size, alignment)
+  , previousLayout(font, size, alignment)
+  , dirtyBound({x, y, 0, 0})
   , backgroundColor(backgroundColor)
 { }
 
 TextRegion::~TextRegion() { }
 
 void TextRegion::render(GxEPD2_GFX* display) {
+  Rectangle previousBound = layout.getBounds();
+
   // Clear the previous text
   // TODO: expose setting for background color
   display->fillRect(
-    this->currentBound.x,
-    this->currentBound.y,
-    this->currentBound.w,
-    this->currentBound.h,
+    previousBound.x,
+    previousBound.y,
+    previousBound.w,
+    previousBound.h,
     backgroundColor
   );
 
-  display->setTextColor(color);
-  display->setFont(font);
-  display->setTextSize(size);
-  display->setCursor(this->boundingBox.x, this->boundingBox.y);
-  display->print(variableValue);
+  std::swap(layout, previousLayout);
+  layout.render(display, variableValue, this->boundingBox.x, this->boundingBox.y, color);
 
-  // Find and persist bounding box.  Need to persist in case it shrinks next
-  // time.  Update should always be for the larger bounding box.
-  int16_t x1, y1;
-  uint16_t w, h;
-  char valueCpy[variableValue.length() + 1];
-  strcpy(valueCpy, variableValue.c_str());
+  // If the glyphs that didn't change also didn't move, only the changed glyphs
+  // need to be refreshed.  This is common for clocks and other numbers since
+  // digits usually all have the same advance.
+  this->dirtyBound = layout.changedBound(previousLayout);
 
-  display->getTextBounds(valueCpy, this->boundingBox.x, this->boundingBox.y, &x1, &y1, &w, &h);
-
-  this->previousBound = this->currentBound;
-  this->currentBound = {x1, y1, w, h};
+  if (this->dirtyBound.isEmpty()) {
+    this->dirtyBound = previousBound.enclosing(layout.getBounds());
+  }
 }
 
 Rectangle TextRegion::getBoundingBox() {
   if (fixedBound != nullptr) {
     return *fixedBound;
   } else {
-    return {
-      .x = std::min(this->currentBound.x, this->previousBound.x),
-      .y = std::min(this->currentBound.y, this->previousBound.y),
-      .w = std::max(this->currentBound.w, this->previousBound.w),
-      .h = std::max(this->currentBound.h, this->previousBound.h)
-    };
+    return dirtyBound;
   }
 }
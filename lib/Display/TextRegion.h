@@ -1,4 +1,6 @@
 #include <Region.h>
+#include <FontMetrics.h>
+#include <TextLayout.h>
 
 #include <GxEPD2_EPD.h>
 #include <GxEPD2_GFX.h>
@@ -18,7 +20,8 @@ public:
     std::shared_ptr<Rectangle> fixedBoundingBox,
     uint16_t color,
     uint16_t backgroundColor,
-    const GFXfont* font,
+    std::shared_ptr<const FontMetrics> font,
+    TextAlignment alignment,
     std::shared_ptr<const VariableFormatter> formatter,
     uint8_t size,
     uint16_t index
@@ -29,19 +32,18 @@ public:
   virtual Rectangle getBoundingBox();
 
 protected:
-  const GFXfont* font;
-
   // Users can optionally manually specify a bounding rectangle.
   std::shared_ptr<Rectangle> fixedBound;
 
-  // Track current bounding box start coordinates separately from (x, y), which
-  // is the position we set the cursor at.
-  Rectangle currentBound;
+  // Layout of the value currently on screen, and of the one before it.  These
+  // are swapped on each render to reuse their buffers.
+  TextLayout layout;
+  TextLayout previousLayout;
 
-  // Previous bounding box coordinates
-  Rectangle previousBound;
+  // Area that changed during the last render.  When only some glyphs changed
+  // and the others didn't move, this covers just the changed glyphs.
+  Rectangle dirtyBound;
 
-  uint8_t size;
   uint16_t backgroundColor;
 };
 
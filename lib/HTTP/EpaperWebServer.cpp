@@ -1,8 +1,16 @@
 #include <DisplayTypeHelpers.h>
+#include <AtomicFileWriter.h>
 #include <EpaperWebServer.h>
+#include <JsonMergePatch.h>
 #include <KeyValueDatabase.h>
+#include <Metrics.h>
+#include <ScreenshotStream.h>
+#include <SpiffsFontMetrics.h>
+#include <TemplateCache.h>
 #include <web_assets.h>
 
+#include <algorithm>
+
 #if defined(ESP8266)
 #include <Updater.h>
 #elif defined(ESP32)
@@ -12,19 +20,35 @@
 static const char TEXT_HTML[] = "text/html";
 static const char TEXT_PLAIN[] = "text/plain";
 static const char APPLICATION_JSON[] = "application/json";
+static const char APPLICATION_OCTET_STREAM[] = "application/octet-stream";
 
 static const char CONTENT_TYPE_HEADER[] = "Content-Type";
+static const char ETAG_HEADER[] = "ETag";
+static const char IF_NONE_MATCH_HEADER[] = "If-None-Match";
+static const char CACHE_CONTROL_HEADER[] = "Cache-Control";
+
+// Hashed assets never change.  Everything else can be cached, but has to be
+// revalidated with its ETag.
+static const char CACHE_IMMUTABLE[] = "public, max-age=31536000, immutable";
+static const char CACHE_REVALIDATE[] = "no-cache";
 static const char METADATA_FILENAME[] = "metadata.json";
 static const char TMP_DIRECTORY[] = "/x";
 
 static const size_t MAX_VARIABLES_PER_PAGE = 20;
 
+// Larger WebSocket messages are dropped
+static const size_t WEBSOCKET_MAX_MESSAGE_SIZE = 8192;
+// Resolve responses are split into frames with at most this much JSON memory
+static const size_t WEBSOCKET_RESOLVE_FRAME_SIZE = 2048;
+
 using namespace std::placeholders;
 
-EpaperWebServer::EpaperWebServer(
-    DisplayTemplateDriver*& driver, Settings& settings)
+EpaperWebServer::EpaperWebServer(DisplayTemplateDriver*& driver,
+    Settings& settings,
+    UpdateTraceRecorder& traceRecorder)
     : driver(driver)
     , settings(settings)
+    , traceRecorder(traceRecorder)
     , authProvider(settings.web)
     , server(RichHttpServer<RichHttpConfig>(
           settings.web.port == 0 ? 80 : settings.web.port, authProvider))
@@ -32,6 +56,9 @@ EpaperWebServer::EpaperWebServer(
     , changeFn(nullptr)
     , cancelSleepFn(nullptr)
     , wsServer("/socket")
+    , broadcaster(wsServer)
+    , traceSocket("/trace")
+    , traceClientId(0)
     , deepSleepActive(false)
     , updateSuccessful(false) {
   driver->onVariableUpdate(
@@ -48,7 +75,11 @@ void EpaperWebServer::setDeepSleepActive(bool deepSleepActive) {
 
 uint16_t EpaperWebServer::getPort() const { return port; }
 
-void EpaperWebServer::handleClient() { wsServer.cleanupClients(); }
+void EpaperWebServer::handleClient() {
+  wsServer.cleanupClients();
+  traceSocket.cleanupClients();
+  broadcaster.flush();
+}
 
 void EpaperWebServer::begin() {
   for (auto it = WEB_ASSET_CONTENTS.begin(); it != WEB_ASSET_CONTENTS.end();
@@ -57,6 +88,8 @@ void EpaperWebServer::begin() {
     const uint8_t* contents = it->second;
     const size_t length = WEB_ASSET_LENGTHS.at(filename);
     const char* contentType = WEB_ASSET_CONTENT_TYPES.at(filename);
+    const char* etag = WEB_ASSET_ETAGS.at(filename);
+    const bool immutable = WEB_ASSET_IMMUTABLE.at(filename);
 
     server.buildHandler(filename).on(HTTP_GET,
         std::bind(&EpaperWebServer::handleServeGzip_P,
@@ -64,6 +97,8 @@ void EpaperWebServer::begin() {
             contentType,
             contents,
             length,
+            etag,
+            immutable,
             _1));
   }
 
@@ -84,11 +119,8 @@ void EpaperWebServer::begin() {
 
   server.buildHandler("/api/v1/templates")
       .on(HTTP_POST,
-          std::bind(&EpaperWebServer::handleNoOp, this, _1),
-          std::bind(&EpaperWebServer::handleCreateFile,
-              this,
-              TEMPLATES_DIRECTORY,
-              _1))
+          std::bind(&EpaperWebServer::handleCreateTemplateFinish, this, _1),
+          std::bind(&EpaperWebServer::handleCreateTemplate, this, _1))
       .on(HTTP_GET,
           std::bind(&EpaperWebServer::handleListDirectory,
               this,
@@ -113,6 +145,19 @@ void EpaperWebServer::begin() {
           std::bind(&EpaperWebServer::handleDeleteBitmap, this, _1))
       .on(HTTP_GET, std::bind(&EpaperWebServer::handleShowBitmap, this, _1));
 
+  server.buildHandler("/api/v1/fonts")
+      .on(HTTP_POST,
+          std::bind(&EpaperWebServer::handleCreateFontFinish, this, _1),
+          std::bind(&EpaperWebServer::handleCreateFile,
+              this,
+              FONTS_DIRECTORY,
+              _1))
+      .on(HTTP_GET, std::bind(&EpaperWebServer::handleListFonts, this, _1));
+
+  server.buildHandler("/api/v1/fonts/:filename")
+      .on(HTTP_DELETE,
+          std::bind(&EpaperWebServer::handleDeleteFont, this, _1));
+
   server.buildHandler("/api/v1/settings")
       .on(HTTP_GET, std::bind(&EpaperWebServer::handleGetSettings, this, _1))
       .on(HTTP_PUT,
@@ -122,13 +167,28 @@ void EpaperWebServer::begin() {
       .on(HTTP_GET, std::bind(&EpaperWebServer::handleGetSystem, this, _1))
       .on(HTTP_POST, std::bind(&EpaperWebServer::handlePostSystem, this, _1));
 
+#ifndef DISABLE_METRICS
+  server.buildHandler("/api/v1/metrics")
+      .on(HTTP_GET, std::bind(&EpaperWebServer::handleGetMetrics, this, _1));
+#endif
+
   server.buildHandler("/api/v1/screens")
       .on(HTTP_GET, std::bind(&EpaperWebServer::handleGetScreens, this, _1));
 
+  server.buildHandler("/api/v1/screen")
+      .on(HTTP_GET, std::bind(&EpaperWebServer::handleGetScreen, this, _1));
+
   server.buildHandler("/api/v1/resolve_variables")
       .on(HTTP_GET,
           std::bind(&EpaperWebServer::handleResolveVariables, this, _1));
 
+  server.buildHandler("/api/v1/trace")
+      .on(HTTP_GET, std::bind(&EpaperWebServer::handleGetTrace, this, _1))
+      .on(HTTP_PUT, std::bind(&EpaperWebServer::handleUpdateTrace, this, _1));
+
+  server.buildHandler("/api/v1/trace/file")
+      .on(HTTP_GET, std::bind(&EpaperWebServer::handleDownloadTrace, this, _1));
+
   server.buildHandler("/firmware")
       .on(HTTP_POST,
           std::bind(&EpaperWebServer::handleFirmwareUpdateComplete, this, _1),
@@ -139,6 +199,8 @@ void EpaperWebServer::begin() {
       _handleServeGzip_P(TEXT_HTML,
           INDEX_HTML_GZ,
           INDEX_HTML_GZ_LENGTH,
+          INDEX_HTML_GZ_ETAG,
+          false,
           request);
     } else {
       request->send(404);
@@ -152,45 +214,190 @@ void EpaperWebServer::begin() {
                        uint8_t* data,
                        size_t len) {
     if (type == WS_EVT_DATA) {
-      AwsFrameInfo* info = (AwsFrameInfo*)arg;
-      if (info->final && info->index == 0 && info->len == len &&
-          info->opcode == WS_TEXT) {
-        StaticJsonDocument<1024> reqBuffer;
-        auto err = deserializeJson(reqBuffer,
-            reinterpret_cast<const char*>(data),
-            len);
-
-        if (err) {
-          Serial.println(reinterpret_cast<const char*>(data));
-          Serial.println("Error processing websocket message");
-          Serial.println(err.c_str());
-        } else {
-          if (reqBuffer["type"] == "resolve") {
-            JsonArray variables = reqBuffer[F("variables")];
-
-            StaticJsonDocument<256> responseBuffer;
-            responseBuffer["type"] = "resolve";
-            JsonArray response = responseBuffer.createNestedArray("body");
-
-            driver->resolveVariables(variables, response);
-            size_t len = measureJson(responseBuffer);
-
-            AsyncWebSocketMessageBuffer* buffer = server->makeBuffer(len);
-            serializeJson(responseBuffer,
-                reinterpret_cast<char*>(buffer->get()),
-                len + 1);
-            client->text(buffer);
-          }
-        }
-      }
+      handleWebSocketData(client, (AwsFrameInfo*)arg, data, len);
+    } else if (type == WS_EVT_DISCONNECT) {
+      partialMessages.erase(client->id());
     }
   });
   server.addHandler(&wsServer);
 
+  traceSocket.onEvent([this](AsyncWebSocket* server,
+                          AsyncWebSocketClient* client,
+                          AwsEventType type,
+                          void* arg,
+                          uint8_t* data,
+                          size_t len) {
+    handleTraceSocketEvent(client, type);
+  });
+  server.addHandler(&traceSocket);
+
   server.clearBuilders();
   server.begin();
 }
 
+void EpaperWebServer::handleWebSocketData(AsyncWebSocketClient* client,
+    AwsFrameInfo* info,
+    uint8_t* data,
+    size_t len) {
+  // Fragmented messages aren't supported, but a single frame can still arrive
+  // in several pieces
+  if (!info->final || info->num != 0 || info->len > WEBSOCKET_MAX_MESSAGE_SIZE) {
+    partialMessages.erase(client->id());
+    return;
+  }
+
+  const bool binary = info->opcode == WS_BINARY;
+
+  if (info->index == 0 && info->len == len) {
+    handleWebSocketMessage(client, data, len, binary);
+    return;
+  }
+
+  std::vector<uint8_t>& message = partialMessages[client->id()];
+
+  if (info->index == 0) {
+    message.clear();
+    message.reserve(info->len);
+  } else if (message.size() != info->index) {
+    partialMessages.erase(client->id());
+    return;
+  }
+
+  message.insert(message.end(), data, data + len);
+
+  if (message.size() == info->len) {
+    handleWebSocketMessage(client, message.data(), message.size(), binary);
+    partialMessages.erase(client->id());
+  }
+}
+
+void EpaperWebServer::handleWebSocketMessage(AsyncWebSocketClient* client,
+    const uint8_t* data,
+    size_t len,
+    bool binary) {
+  // Leave room for the parsed structure as well as copies of the strings
+  DynamicJsonDocument reqBuffer(std::max<size_t>(1024, len * 4));
+  DeserializationError err = binary
+      ? deserializeMsgPack(reqBuffer, reinterpret_cast<const char*>(data), len)
+      : deserializeJson(reqBuffer, reinterpret_cast<const char*>(data), len);
+
+  if (err) {
+    Serial.print(F("Error processing websocket message: "));
+    Serial.println(err.c_str());
+    return;
+  }
+
+  if (reqBuffer["type"] == "resolve") {
+    handleResolveMessage(client, reqBuffer[F("variables")]);
+  } else if (reqBuffer["type"] == "protocol") {
+    // Responses switch to the requested encoding, starting with this one.
+    // Unknown encodings get JSON.
+    WebSocketEncoding encoding = reqBuffer["encoding"] == "msgpack"
+        ? WebSocketEncoding::MSGPACK
+        : WebSocketEncoding::JSON;
+    broadcaster.setEncoding(client->id(), encoding);
+
+    StaticJsonDocument<JSON_OBJECT_SIZE(2)> response;
+    response["type"] = "protocol";
+    response["encoding"] =
+        encoding == WebSocketEncoding::MSGPACK ? "msgpack" : "json";
+    broadcaster.send(client, response, 0);
+  }
+}
+
+void EpaperWebServer::handleResolveMessage(
+    AsyncWebSocketClient* client, JsonArray variables) {
+  DynamicJsonDocument frame(WEBSOCKET_RESOLVE_FRAME_SIZE);
+  JsonArray body;
+
+  // Every frame but the last has "more": true
+  auto startFrame = [&]() {
+    frame.clear();
+    frame["type"] = "resolve";
+    frame["more"] = true;
+    body = frame.createNestedArray("body");
+  };
+  auto append = [&](const String& name, const String& value, JsonVariant ref) {
+    JsonObject resolvedVar = body.createNestedObject();
+    resolvedVar["k"] = name;
+    resolvedVar["v"] = value;
+    resolvedVar["ref"] = ref;
+
+    return !frame.overflowed();
+  };
+
+  startFrame();
+
+  const bool resolved = driver->resolveVariables(variables,
+      [&](const String& name, const String& value, JsonVariant ref) {
+        const size_t size = body.size();
+
+        if (size < WEBSOCKET_MAX_BATCH_SIZE && append(name, value, ref)) {
+          return;
+        }
+
+        // Didn't fit.  Send what's there and retry in an empty frame.  A
+        // variable that doesn't fit on its own is sent truncated.
+        if (size > 0) {
+          while (body.size() > size) {
+            body.remove(size);
+          }
+
+          broadcaster.send(client, frame, size);
+          startFrame();
+          append(name, value, ref);
+        }
+      });
+
+  if (!resolved) {
+    frame["error"] = F("No template is loaded");
+  }
+
+  frame["more"] = false;
+  broadcaster.send(client, frame, body.size());
+}
+
+void EpaperWebServer::handleTraceSocketEvent(
+    AsyncWebSocketClient* client, AwsEventType type) {
+  if (type == WS_EVT_CONNECT) {
+    // The trace's keys are numbered from the start of the stream, so a second
+    // client couldn't read it
+    if (traceRecorder.isStreaming()) {
+      client->close();
+      return;
+    }
+
+    const uint32_t clientId = client->id();
+    traceClientId = clientId;
+
+    traceRecorder.startStream([this, clientId](const uint8_t* data, size_t length) {
+      AsyncWebSocketClient* client = traceSocket.client(clientId);
+
+      if (client == nullptr || client->queueIsFull()) {
+        return false;
+      }
+
+      AsyncWebSocketMessageBuffer* buffer = traceSocket.makeBuffer(length);
+
+      if (buffer == nullptr) {
+        return false;
+      }
+
+      memcpy(buffer->get(), data, length);
+      client->binary(buffer);
+      METRIC_INC(websocketSends);
+
+      return true;
+    });
+  } else if (type == WS_EVT_DISCONNECT && client->id() == traceClientId) {
+    traceClientId = 0;
+
+    if (traceRecorder.isStreaming()) {
+      traceRecorder.stop();
+    }
+  }
+}
+
 void EpaperWebServer::handleClearVariables(RequestContext& request) {
   driver->clearVariables();
   request.response.json[F("success")] = true;
@@ -293,42 +500,12 @@ void EpaperWebServer::handleFirmwareUpdateComplete(RequestContext& request) {
 
 void EpaperWebServer::handleVariableUpdate(
     const String& name, const String& value) {
-  StaticJsonDocument<128> responseBuffer;
-  responseBuffer["type"] = "variable";
-  JsonObject body = responseBuffer.createNestedObject("body");
-  body["k"] = name;
-  body["v"] = value;
-
-  size_t len = measureJson(responseBuffer);
-  AsyncWebSocketMessageBuffer* buffer = wsServer.makeBuffer(len);
-  serializeJson(responseBuffer,
-      reinterpret_cast<char*>(buffer->get()),
-      len + 1);
-
-  wsServer.textAll(buffer);
+  broadcaster.queueVariable(name, value);
 }
 
 void EpaperWebServer::handleRegionUpdate(
     const String& regionId, const String& variableName, const String& value) {
-  StaticJsonDocument<128> responseBuffer;
-  responseBuffer["type"] = "region";
-  JsonObject body = responseBuffer.createNestedObject("body");
-  body["id"] = regionId;
-  body["k"] = variableName;
-  body["v"] = value;
-
-  size_t len = measureJson(responseBuffer);
-  AsyncWebSocketMessageBuffer* buffer = wsServer.makeBuffer(len);
-  serializeJson(responseBuffer,
-      reinterpret_cast<char*>(buffer->get()),
-      len + 1);
-
-  wsServer.textAll(buffer);
-}
-
-void EpaperWebServer::handleNoOp(RequestContext& request) {
-  request.response.json[F("success")] = true;
-  request.response.setCode(200);
+  broadcaster.queueRegion(regionId, variableName, value);
 }
 
 void EpaperWebServer::handlePostSystem(RequestContext& request) {
@@ -370,6 +547,8 @@ void EpaperWebServer::handleGetSystem(RequestContext& request) {
   request.response.json["sdk_version"] = ESP.getSdkVersion();
   request.response.json["uptime"] = millis();
   request.response.json["deep_sleep_active"] = this->deepSleepActive;
+
+  broadcaster.dumpStats(request.response.json.createNestedObject("websocket"));
 }
 
 void EpaperWebServer::handleGetVariable(RequestContext& request) {
@@ -389,6 +568,8 @@ void EpaperWebServer::handleGetVariable(RequestContext& request) {
 
 void EpaperWebServer::handleDeleteVariable(RequestContext& request) {
   const char* variableName = request.pathVariables.get("variable_name");
+  // Deleting renders the variable as empty
+  traceRecorder.recordVariable(UpdateSource::HTTP, variableName, "");
   driver->deleteVariable(variableName);
 
   request.response.json["success"] = true;
@@ -403,27 +584,64 @@ void EpaperWebServer::handleUpdateVariables(RequestContext& request) {
     return;
   }
 
+  VariableBatch batch;
   for (JsonObject::iterator itr = vars.begin(); itr != vars.end(); ++itr) {
-    driver->updateVariable(itr->key().c_str(), itr->value().as<String>());
+    batch[itr->key().c_str()] = itr->value().as<String>();
   }
+  traceRecorder.recordBatch(UpdateSource::HTTP, batch);
+  driver->updateVariables(batch);
 
   request.response.json["success"] = true;
 }
 
+// True if one of the ETags in the request's If-None-Match header is etag
+static bool matchesEtag(AsyncWebServerRequest* request, const char* etag) {
+  AsyncWebHeader* header = request->getHeader(IF_NONE_MATCH_HEADER);
+
+  if (header == nullptr) {
+    return false;
+  }
+
+  const String& value = header->value();
+  return value == "*" || value.indexOf(etag) >= 0;
+}
+
+static void sendNotModified(
+    AsyncWebServerRequest* request, const char* etag, const char* cacheControl) {
+  AsyncWebServerResponse* response = request->beginResponse(304);
+  response->addHeader(ETAG_HEADER, etag);
+  response->addHeader(CACHE_CONTROL_HEADER, cacheControl);
+  request->send(response);
+}
+
 void EpaperWebServer::handleServeGzip_P(const char* contentType,
     const uint8_t* text,
     size_t length,
+    const char* etag,
+    bool immutable,
     RequestContext& request) {
-  _handleServeGzip_P(contentType, text, length, request.rawRequest);
+  _handleServeGzip_P(
+      contentType, text, length, etag, immutable, request.rawRequest);
 }
 
 void EpaperWebServer::_handleServeGzip_P(const char* contentType,
     const uint8_t* text,
     size_t length,
+    const char* etag,
+    bool immutable,
     AsyncWebServerRequest* request) {
+  const char* cacheControl = immutable ? CACHE_IMMUTABLE : CACHE_REVALIDATE;
+
+  if (matchesEtag(request, etag)) {
+    sendNotModified(request, etag, cacheControl);
+    return;
+  }
+
   AsyncWebServerResponse* response =
       request->beginResponse_P(200, contentType, text, length);
   response->addHeader("Content-Encoding", "gzip");
+  response->addHeader(ETAG_HEADER, etag);
+  response->addHeader(CACHE_CONTROL_HEADER, cacheControl);
   request->send(response);
 }
 
@@ -451,6 +669,29 @@ bool EpaperWebServer::serveFile(
   return false;
 }
 
+bool EpaperWebServer::serveFileWithEtag(const String& path,
+    const char* contentType,
+    AsyncWebServerRequest* request) {
+  const String etag = etags.get(path);
+
+  if (etag.length() == 0) {
+    return false;
+  }
+
+  if (matchesEtag(request, etag.c_str())) {
+    sendNotModified(request, etag.c_str(), CACHE_REVALIDATE);
+    return true;
+  }
+
+  AsyncWebServerResponse* response =
+      request->beginResponse(SPIFFS, path, contentType);
+  response->addHeader(ETAG_HEADER, etag);
+  response->addHeader(CACHE_CONTROL_HEADER, CACHE_REVALIDATE);
+  request->send(response);
+
+  return true;
+}
+
 // ---------
 // CRUD handlers for bitmaps
 // ---------
@@ -498,37 +739,202 @@ void EpaperWebServer::handleCreateBitmapFinish(RequestContext& request) {
   }
 }
 
-void EpaperWebServer::handleListBitmaps(RequestContext& request) {
-  JsonArray responseObj = request.response.json.createNestedArray(F("bitmaps"));
-  listDirectory(BITMAPS_DIRECTORY, responseObj);
-  char buffer[32];
-  StaticJsonDocument<1024> metadataBuffer;
+// Serializes the bitmap listing one entry at a time as the response is sent.
+// Metadata files are copied into the output as-is, straight from SPIFFS.
+class BitmapListingStream {
+public:
+  BitmapListingStream()
+      : offset(0)
+      , metadataRemaining(0)
+      , numEntries(0)
+      , finished(false) {
+    pending = F("{\"bitmaps\":[");
 
-  for (JsonObject it : responseObj) {
-    const char* path = it["name"];
+#if defined(ESP8266)
+    dir = SPIFFS.openDir(BITMAPS_DIRECTORY);
+#elif defined(ESP32)
+    dir = SPIFFS.open(BITMAPS_DIRECTORY);
 
-    if (path == nullptr) {
-      continue;
+    if (!dir || !dir.isDirectory()) {
+      Serial.print(F("Path is not a directory - "));
+      Serial.println(BITMAPS_DIRECTORY);
     }
+#endif
+  }
 
-    const char* filename = strrchr(path, '/');
+  // Fills buffer with up to maxLen bytes.  Returns 0 when done.
+  size_t read(uint8_t* buffer, size_t maxLen) {
+    size_t written = 0;
+
+    while (written < maxLen) {
+      if (offset < pending.length()) {
+        size_t n = std::min(maxLen - written, pending.length() - offset);
+        memcpy(buffer + written, pending.c_str() + offset, n);
+        written += n;
+        offset += n;
+      } else if (metadataRemaining > 0) {
+        size_t n = metadata.read(buffer + written, std::min(maxLen - written, metadataRemaining));
+
+        // The entry's already partly sent, so a failed read can only end it
+        // early
+        metadataRemaining = n == 0 ? 0 : metadataRemaining - n;
+        written += n;
+
+        if (metadataRemaining == 0) {
+          metadata.close();
+          pending = "}";
+          offset = 0;
+        }
+      } else if (finished) {
+        break;
+      } else {
+        nextEntry();
+        offset = 0;
+      }
+    }
 
-    if (filename != nullptr) {
-      snprintf(buffer, 31, "%s%s", BITMAP_METADATA_DIRECTORY, filename);
+    return written;
+  }
 
-      File f = SPIFFS.open(buffer);
+private:
+#if defined(ESP8266)
+  Dir dir;
+#elif defined(ESP32)
+  File dir;
+#endif
+  // Bytes of the current entry, of which offset have been sent.  If the
+  // entry has metadata, it's sent after these.
+  String pending;
+  size_t offset;
+  File metadata;
+  size_t metadataRemaining;
+  size_t numEntries;
+  bool finished;
+
+  bool nextFile(String& name, size_t& size) {
+#if defined(ESP8266)
+    if (!dir.next()) {
+      return false;
+    }
 
-      if (f && f.available()) {
-        JsonObject metadata = it.createNestedObject("metadata");
+    name = dir.fileName();
+    size = dir.fileSize();
+#elif defined(ESP32)
+    if (!dir || !dir.isDirectory()) {
+      return false;
+    }
 
-        deserializeJson(metadataBuffer, f);
-        f.close();
+    File file = dir.openNextFile();
 
-        // ArduinoJson will make a copy
-        metadata.set(metadataBuffer.as<JsonObject>());
-      }
+    if (!file) {
+      return false;
+    }
+
+    name = file.name();
+    size = file.size();
+#endif
+
+    return true;
+  }
+
+  void nextEntry() {
+    String name;
+    size_t size;
+
+    pending = "";
+
+    if (!nextFile(name, size)) {
+      pending += F("]}");
+      finished = true;
+      return;
+    }
+
+    StaticJsonDocument<JSON_OBJECT_SIZE(2)> entry;
+    entry["name"] = name.c_str();
+    entry["size"] = size;
+
+    if (numEntries++ > 0) {
+      pending += ',';
     }
+
+    String entryJson;
+    serializeJson(entry, entryJson);
+    pending += entryJson;
+
+    if (openMetadata(name)) {
+      // Replace the closing brace of the entry with the metadata field.  The
+      // brace is sent again once the metadata has been copied.
+      pending.remove(pending.length() - 1);
+      pending += F(",\"metadata\":");
+    }
+  }
+
+  static bool isWhitespace(int c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+  }
+
+  int byteAt(size_t position) {
+    metadata.seek(position);
+    return metadata.read();
+  }
+
+  // Opens the metadata for path, positioned at the start of the object in it.
+  // Returns false if there's no metadata for the file.
+  bool openMetadata(const String& path) {
+    int filenameStart = path.lastIndexOf('/');
+
+    if (filenameStart < 0) {
+      return false;
+    }
+
+    String metadataPath = BITMAP_METADATA_DIRECTORY;
+    metadataPath += path.c_str() + filenameStart;
+
+    if (!SPIFFS.exists(metadataPath)) {
+      return false;
+    }
+
+    metadata = SPIFFS.open(metadataPath, "r");
+
+    if (!metadata) {
+      return false;
+    }
+
+    size_t start = 0;
+    size_t end = metadata.size();
+
+    while (start < end && isWhitespace(byteAt(start))) {
+      ++start;
+    }
+    while (end > start && isWhitespace(byteAt(end - 1))) {
+      --end;
+    }
+
+    // Not parsed, but at least make sure it's an object so one bad file
+    // can't break the rest of the listing
+    if (end - start < 2 || byteAt(start) != '{' || byteAt(end - 1) != '}') {
+      metadata.close();
+      return false;
+    }
+
+    metadata.seek(start);
+    metadataRemaining = end - start;
+
+    return true;
   }
+};
+
+void EpaperWebServer::handleListBitmaps(RequestContext& request) {
+  std::shared_ptr<BitmapListingStream> listing =
+      std::make_shared<BitmapListingStream>();
+
+  AsyncWebServerResponse* response = request.rawRequest->beginChunkedResponse(
+      APPLICATION_JSON,
+      [listing](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+        return listing->read(buffer, maxLen);
+      });
+
+  request.rawRequest->send(response);
 }
 
 void EpaperWebServer::handleCreateBitmap(RequestContext& request) {
@@ -542,7 +948,11 @@ void EpaperWebServer::handleCreateBitmap(RequestContext& request) {
 void EpaperWebServer::handleShowBitmap(RequestContext& request) {
   const char* filename = request.pathVariables.get("filename");
   String path = String(BITMAPS_DIRECTORY) + "/" + filename;
-  request.rawRequest->send(SPIFFS, path, "application/octet-stream");
+
+  if (!serveFileWithEtag(path, "application/octet-stream", request.rawRequest)) {
+    request.response.json["error"] = F("File not found");
+    request.response.setCode(404);
+  }
 }
 
 void EpaperWebServer::handleDeleteBitmap(RequestContext& request) {
@@ -551,6 +961,54 @@ void EpaperWebServer::handleDeleteBitmap(RequestContext& request) {
   handleDeleteFile(path, request);
 }
 
+// Name of the first file uploaded with request, or empty if there wasn't one
+static String getUploadedFilename(AsyncWebServerRequest* request) {
+  for (size_t i = 0; i < request->params(); ++i) {
+    AsyncWebParameter* param = request->getParam(i);
+
+    if (param->isFile()) {
+      return param->value();
+    }
+  }
+
+  return "";
+}
+
+// ---------
+// CRUD handlers for fonts
+// ---------
+
+void EpaperWebServer::handleCreateFontFinish(RequestContext& request) {
+  const String filename = getUploadedFilename(request.rawRequest);
+  const String path = String(FONTS_DIRECTORY) + "/" + filename;
+
+  // A font that can't be loaded would only be skipped by every template that
+  // uses it, so don't keep it
+  if (filename.length() > 0 && !SpiffsFontMetrics::isValid(path)) {
+    SPIFFS.remove(path);
+    etags.invalidate(path);
+
+    request.response.json[F("error")] = F("Not a valid font file");
+    request.response.setCode(400);
+  } else {
+    request.response.json[F("success")] = true;
+  }
+
+  driver->invalidateFonts();
+}
+
+void EpaperWebServer::handleListFonts(RequestContext& request) {
+  listDirectory(FONTS_DIRECTORY, request.response.json.createNestedArray(F("fonts")));
+  FontStore::listBuiltinFonts(request.response.json.createNestedArray(F("builtin")));
+}
+
+void EpaperWebServer::handleDeleteFont(RequestContext& request) {
+  const char* filename = request.pathVariables.get("filename");
+  String path = String(FONTS_DIRECTORY) + "/" + filename;
+  handleDeleteFile(path, request);
+  driver->invalidateFonts();
+}
+
 void EpaperWebServer::listDirectory(const char* dirName, JsonArray result) {
 #if defined(ESP8266)
   Dir dir = SPIFFS.openDir(dirName);
@@ -593,9 +1051,7 @@ void EpaperWebServer::handleShowTemplate(RequestContext& request) {
   const char* filename = request.pathVariables.get("filename");
   String path = String(TEMPLATES_DIRECTORY) + "/" + filename;
 
-  if (SPIFFS.exists(path.c_str())) {
-    request.rawRequest->send(SPIFFS, path, APPLICATION_JSON);
-  } else {
+  if (!serveFileWithEtag(path, APPLICATION_JSON, request.rawRequest)) {
     request.response.json["error"] = F("File not found");
     request.response.setCode(404);
   }
@@ -603,6 +1059,8 @@ void EpaperWebServer::handleShowTemplate(RequestContext& request) {
 
 void EpaperWebServer::handleDeleteFile(
     const String& path, RequestContext& request) {
+  etags.invalidate(path);
+
   if (SPIFFS.exists(path.c_str())) {
     if (SPIFFS.remove(path.c_str())) {
       request.response.json["success"] = true;
@@ -619,21 +1077,130 @@ void EpaperWebServer::handleDeleteFile(
 void EpaperWebServer::handleUpdateTemplate(RequestContext& request) {
   const char* filename = request.pathVariables.get("filename");
   String path = String(TEMPLATES_DIRECTORY) + "/" + filename;
-  handleUpdateJsonFile(path, request);
+
+  // The merged template is checked the same way as an uploaded one before it
+  // replaces the original
+  AtomicFileWriter writer;
+
+  if (mergeJsonFile(path, writer, request) && commitTemplate(writer, path, request)) {
+    request.rawRequest->send(SPIFFS, path, APPLICATION_JSON);
+  }
 }
 
 void EpaperWebServer::handleDeleteTemplate(RequestContext& request) {
   const char* filename = request.pathVariables.get("filename");
   String path = String(TEMPLATES_DIRECTORY) + "/" + filename;
+
+  TemplateCache::invalidate(path);
   handleDeleteFile(path, request);
 }
 
+// ID of the AtomicFileWriter an upload is being written with, or nullptr if
+// the request doesn't have one.  Kept in the request's _tempObject, which it
+// releases with free().
+static uint32_t* getUploadWriterId(AsyncWebServerRequest* request) {
+  return static_cast<uint32_t*>(request->_tempObject);
+}
+
+// Uploads are written to the side and only replace the template once they've
+// been validated.  Each request has its own temp file.  The open file is kept
+// on the request between chunks.
+void EpaperWebServer::handleCreateTemplate(RequestContext& request) {
+  AsyncWebServerRequest* rawRequest = request.rawRequest;
+
+  if (request.upload.index == 0 && getUploadWriterId(rawRequest) == nullptr) {
+    uint32_t* writerId = static_cast<uint32_t*>(malloc(sizeof(uint32_t)));
+
+    if (writerId != nullptr) {
+      AtomicFileWriter writer;
+      *writerId = writer.getId();
+      rawRequest->_tempObject = writerId;
+      rawRequest->_tempFile = writer.open("w");
+    }
+  }
+
+  File& uploadFile = rawRequest->_tempFile;
+
+  if (!uploadFile ||
+      uploadFile.write(request.upload.data, request.upload.length) !=
+          request.upload.length) {
+    request.response.setCode(500);
+    request.response.json["error"] = F("Failed to write to file");
+  }
+
+  if (uploadFile && request.upload.isFinal) {
+    uploadFile.close();
+  }
+}
+
+void EpaperWebServer::handleCreateTemplateFinish(RequestContext& request) {
+  const String filename = getUploadedFilename(request.rawRequest);
+  const uint32_t* writerId = getUploadWriterId(request.rawRequest);
+
+  if (filename.length() == 0 || writerId == nullptr) {
+    if (writerId != nullptr) {
+      AtomicFileWriter(*writerId).abort();
+    }
+
+    request.response.json[F("error")] = F("template file not found in request");
+    request.response.setCode(400);
+    return;
+  }
+
+  AtomicFileWriter writer(*writerId);
+  String path = String(TEMPLATES_DIRECTORY) + "/" + filename;
+
+  if (commitTemplate(writer, path, request)) {
+    request.response.json[F("success")] = true;
+  }
+}
+
+bool EpaperWebServer::commitTemplate(
+    AtomicFileWriter& writer, const String& path, RequestContext& request) {
+  DynamicJsonDocument tmpl(JSON_TEMPLATE_BUFFER_SIZE);
+  JsonArray errors = request.response.json.createNestedArray(F("errors"));
+
+  File file = writer.open("r");
+  DeserializationError error = deserializeJson(tmpl, file);
+  file.close();
+
+  if (error) {
+    TemplateValidator::addParseError(error, errors);
+  } else {
+    driver->validateTemplate(tmpl, errors);
+  }
+
+  if (errors.size() > 0) {
+    writer.abort();
+    request.response.json[F("success")] = false;
+    request.response.setCode(400);
+    return false;
+  }
+
+  etags.invalidate(path);
+  TemplateCache::invalidate(path);
+
+  if (!writer.commit(path)) {
+    request.response.json[F("error")] = F("Failed to save file");
+    request.response.setCode(500);
+    return false;
+  }
+
+  // The original is kept as it was written.  The checked copy, with defaults
+  // filled in, is what the display loads.
+  TemplateCache::save(path, tmpl);
+  driver->invalidateTemplate(path);
+
+  return true;
+}
+
 void EpaperWebServer::handleCreateFile(
     const char* filePrefix, RequestContext& request) {
   static File updateFile;
 
   if (request.upload.index == 0) {
     String path = String(filePrefix) + "/" + request.upload.filename;
+    etags.invalidate(path);
     updateFile = SPIFFS.open(path, FILE_WRITE);
 
     if (!updateFile) {
@@ -652,47 +1219,43 @@ void EpaperWebServer::handleCreateFile(
 
   if (updateFile && request.upload.isFinal) {
     updateFile.close();
+    // In case the file was served while it was being written
+    etags.invalidate(String(filePrefix) + "/" + request.upload.filename);
   }
 }
 
-void EpaperWebServer::handleUpdateJsonFile(
-    const String& path, RequestContext& request) {
+bool EpaperWebServer::mergeJsonFile(
+    const String& path, AtomicFileWriter& writer, RequestContext& request) {
   JsonObject body = request.getJsonBody().as<JsonObject>();
 
   if (body.isNull()) {
     request.response.json["error"] = F("Invalid JSON");
     request.response.setCode(400);
-    return;
+    return false;
   }
 
-  if (SPIFFS.exists(path)) {
-    File file = SPIFFS.open(path, "r");
-
-    DynamicJsonDocument fileBuffer(4096);
-    deserializeJson(fileBuffer, file);
-    file.close();
-    JsonObject tmpl = fileBuffer.as<JsonObject>();
-
-    if (tmpl.isNull()) {
-      request.response.json["error"] = F("Failed to load persisted file");
-      request.response.setCode(500);
-      return;
-    }
+  if (!SPIFFS.exists(path)) {
+    request.response.setCode(404);
+    return false;
+  }
 
-    for (JsonObject::iterator itr = body.begin(); itr != body.end(); ++itr) {
-      tmpl[itr->key()] = itr->value();
-    }
+  // The merged file is written next to the original and swapped in once it's
+  // complete, so it's never left half-written
+  File source = SPIFFS.open(path, "r");
+  File output = writer.open();
+  bool merged = source && output && JsonMergePatch::apply(source, body, output);
 
-    file = SPIFFS.open(path, "w");
-    serializeJson(tmpl, file);
-    file.close();
+  source.close();
+  output.close();
 
-    for (JsonObject::iterator itr = tmpl.begin(); itr != tmpl.end(); ++itr) {
-      request.response.json[itr->key()] = itr->value();
-    }
-  } else {
-    request.response.setCode(404);
+  if (!merged) {
+    writer.abort();
+    request.response.json["error"] = F("Failed to merge into persisted file");
+    request.response.setCode(500);
+    return false;
   }
+
+  return true;
 }
 
 void EpaperWebServer::handleUpdateSettings(RequestContext& request) {
@@ -732,6 +1295,16 @@ void EpaperWebServer::onCancelSleep(
   this->cancelSleepFn = cancelSleepFn;
 }
 
+#ifndef DISABLE_METRICS
+void EpaperWebServer::handleGetMetrics(RequestContext& request) {
+  AsyncResponseStream* response = request.rawRequest->beginResponseStream(
+      "text/plain; version=0.0.4");
+
+  Metrics::writePrometheus(*response);
+  request.rawRequest->send(response);
+}
+#endif
+
 void EpaperWebServer::handleGetScreens(RequestContext& request) {
   JsonArray screens = request.response.json.createNestedArray(F("screens"));
 
@@ -761,6 +1334,82 @@ void EpaperWebServer::handleGetScreens(RequestContext& request) {
   }
 }
 
+// Reads an optional integer query parameter.  Returns false if it's present
+// but out of range.
+static bool getRegionParam(AsyncWebServerRequest* request,
+    const char* name,
+    uint16_t max,
+    uint16_t& value) {
+  AsyncWebParameter* param = request->getParam(name);
+
+  if (param == nullptr) {
+    return true;
+  }
+
+  long parsed = param->value().toInt();
+
+  if (parsed < 0 || parsed > max) {
+    return false;
+  }
+
+  value = parsed;
+  return true;
+}
+
+void EpaperWebServer::handleGetScreen(RequestContext& request) {
+  Framebuffer framebuffer = driver->getFramebuffer();
+
+  if (!framebuffer.isValid()) {
+    request.response.json[F("error")] = F("Framebuffer is not available");
+    request.response.setCode(500);
+    return;
+  }
+
+  ScreenshotStream::Format format = ScreenshotStream::Format::PNG;
+  AsyncWebParameter* formatParam = request.rawRequest->getParam("format");
+
+  if (formatParam != nullptr) {
+    if (formatParam->value() == "pbm") {
+      format = ScreenshotStream::Format::PBM;
+    } else if (formatParam->value() != "png") {
+      request.response.json[F("error")] = F("format must be png or pbm");
+      request.response.setCode(400);
+      return;
+    }
+  }
+
+  const uint16_t width = framebuffer.width();
+  const uint16_t height = framebuffer.height();
+  uint16_t x = 0, y = 0, w = 0, h = 0;
+
+  // w and h default to the rest of the screen
+  if (!getRegionParam(request.rawRequest, "x", width - 1, x) ||
+      !getRegionParam(request.rawRequest, "y", height - 1, y) ||
+      !getRegionParam(request.rawRequest, "w", width - x, w) ||
+      !getRegionParam(request.rawRequest, "h", height - y, h)) {
+    request.response.json[F("error")] = F("region is outside of the screen");
+    request.response.setCode(400);
+    return;
+  }
+
+  std::shared_ptr<ScreenshotStream> screenshot =
+      std::make_shared<ScreenshotStream>(framebuffer,
+          format,
+          x,
+          y,
+          w > 0 ? w : width - x,
+          h > 0 ? h : height - y);
+
+  AsyncWebServerResponse* response = request.rawRequest->beginChunkedResponse(
+      ScreenshotStream::contentType(format),
+      [screenshot](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+        return screenshot->read(buffer, maxLen);
+      });
+
+  response->addHeader(CACHE_CONTROL_HEADER, "no-store");
+  request.rawRequest->send(response);
+}
+
 void EpaperWebServer::handleGetFormattedVariables(RequestContext& request) {
   JsonObject req = request.getJsonBody().as<JsonObject>();
 
@@ -768,10 +1417,58 @@ void EpaperWebServer::handleGetFormattedVariables(RequestContext& request) {
   JsonArray response =
       request.response.json.createNestedArray(F("resolved_variables"));
 
-  driver->resolveVariables(variables, response);
+  if (!driver->resolveVariables(variables, response)) {
+    request.response.json.remove(F("resolved_variables"));
+    request.response.json[F("error")] = F("No template is loaded");
+    request.response.setCode(503);
+  }
 }
 
 void EpaperWebServer::handleResolveVariables(RequestContext& request) {
   JsonObject response = request.response.json.createNestedObject("variables");
   driver->dumpRegionValues(response);
-}
\ No newline at end of file
+}
+
+void EpaperWebServer::handleGetTrace(RequestContext& request) {
+  traceRecorder.dumpStatus(request.response.json.createNestedObject(F("trace")));
+}
+
+void EpaperWebServer::handleUpdateTrace(RequestContext& request) {
+  JsonObject body = request.getJsonBody().as<JsonObject>();
+
+  JsonVariant recording = body[F("recording")];
+
+  if (!recording.is<bool>()) {
+    request.response.json[F("error")] = F("Expected a boolean \"recording\"");
+    request.response.setCode(400);
+    return;
+  }
+
+  if (!recording.as<bool>()) {
+    traceRecorder.stop();
+  } else if (traceRecorder.isStreaming()) {
+    request.response.json[F("error")] = F("A trace is being streamed");
+    request.response.setCode(409);
+    return;
+  } else if (!traceRecorder.startFile()) {
+    request.response.json[F("error")] = F("Couldn't open the trace file");
+    request.response.setCode(500);
+    return;
+  }
+
+  traceRecorder.dumpStatus(request.response.json.createNestedObject(F("trace")));
+}
+
+void EpaperWebServer::handleDownloadTrace(RequestContext& request) {
+  // The file is still being written to
+  if (traceRecorder.isRecording() && !traceRecorder.isStreaming()) {
+    request.response.json[F("error")] = F("Stop recording first");
+    request.response.setCode(409);
+    return;
+  }
+
+  if (!serveFile(UPDATE_TRACE_FILE, APPLICATION_OCTET_STREAM, request)) {
+    request.response.json[F("error")] = F("No trace has been recorded");
+    request.response.setCode(404);
+  }
+}
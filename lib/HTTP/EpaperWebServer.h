@@ -1,9 +1,15 @@
 #include <ESPAsyncWebServer.h>
+#include <AtomicFileWriter.h>
 #include <FS.h>
 #include <DisplayTemplateDriver.h>
+#include <FileEtagIndex.h>
 #include <Settings.h>
 #include <RichHttpServer.h>
+#include <UpdateTraceRecorder.h>
+#include <WebSocketBroadcaster.h>
 #include <functional>
+#include <map>
+#include <vector>
 
 #if defined(ESP32)
 #include <SPIFFS.h>
@@ -20,7 +26,9 @@ public:
   using OnChangeFn = std::function<void()>;
   using OnCancelSleepFn = std::function<void()>;
 
-  EpaperWebServer(DisplayTemplateDriver*& driver, Settings& settings);
+  EpaperWebServer(DisplayTemplateDriver*& driver,
+      Settings& settings,
+      UpdateTraceRecorder& traceRecorder);
   ~EpaperWebServer();
 
   void onSettingsChange(OnChangeFn changeFn);
@@ -33,12 +41,20 @@ public:
 private:
   DisplayTemplateDriver*& driver;
   Settings& settings;
+  UpdateTraceRecorder& traceRecorder;
   PassthroughAuthProvider<WebSettings> authProvider;
   RichHttpServer<RichHttpConfig> server;
   uint16_t port;
   OnChangeFn changeFn;
   OnCancelSleepFn cancelSleepFn;
   AsyncWebSocket wsServer;
+  WebSocketBroadcaster broadcaster;
+  // Streams an UpdateTrace to one client at a time
+  AsyncWebSocket traceSocket;
+  uint32_t traceClientId;
+  // Client id -> message received so far, for messages split across packets
+  std::map<uint32_t, std::vector<uint8_t>> partialMessages;
+  FileEtagIndex etags;
   bool deepSleepActive;
   bool updateSuccessful;
 
@@ -51,6 +67,22 @@ private:
   // Region update observer
   void handleRegionUpdate(const String& regionId, const String& variableKey, const String& variableValue);
 
+  // WebSocket handlers
+  void handleWebSocketData(
+    AsyncWebSocketClient* client,
+    AwsFrameInfo* info,
+    uint8_t* data,
+    size_t len
+  );
+  void handleWebSocketMessage(
+    AsyncWebSocketClient* client,
+    const uint8_t* data,
+    size_t len,
+    bool binary
+  );
+  void handleResolveMessage(AsyncWebSocketClient* client, JsonArray variables);
+  void handleTraceSocketEvent(AsyncWebSocketClient* client, AwsEventType type);
+
   // Variables CRUD
   void handleListVariables(RequestContext& request);
   void handleUpdateVariables(RequestContext& request);
@@ -59,8 +91,6 @@ private:
   void handleGetVariable(RequestContext& request);
   void handleGetFormattedVariables(RequestContext& request);
 
-  void handleNoOp(RequestContext& request);
-
   // General info routes
   void handleGetSystem(RequestContext& request);
   void handlePostSystem(RequestContext& request);
@@ -78,17 +108,33 @@ private:
   void handleCreateBitmapFinish(RequestContext& request);
   void handleListBitmaps(RequestContext& request);
 
+  // CRUD handlers for Fonts
+  void handleCreateFontFinish(RequestContext& request);
+  void handleListFonts(RequestContext& request);
+  void handleDeleteFont(RequestContext& request);
+
   // CRUD handlers for Templates
   void handleDeleteTemplate(RequestContext& request);
   void handleShowTemplate(RequestContext& request);
   void handleUpdateTemplate(RequestContext& request);
+  void handleCreateTemplate(RequestContext& request);
+  void handleCreateTemplateFinish(RequestContext& request);
 
   void handleUpdateSettings(RequestContext& request);
   void handleGetSettings(RequestContext& request);
 
   void handleGetScreens(RequestContext& request);
+#ifndef DISABLE_METRICS
+  void handleGetMetrics(RequestContext& request);
+#endif
+  void handleGetScreen(RequestContext& request);
   void handleResolveVariables(RequestContext& request);
 
+  // Update trace recording
+  void handleGetTrace(RequestContext& request);
+  void handleUpdateTrace(RequestContext& request);
+  void handleDownloadTrace(RequestContext& request);
+
   // Misc helpers
   void handleUpdateFile(ArUploadHandlerFunction* request, const char* filename);
   void handleServeFile(
@@ -101,16 +147,28 @@ private:
     const char* contentType,
     const uint8_t* text,
     size_t length,
+    const char* etag,
+    bool immutable,
     RequestContext& request
   );
   void _handleServeGzip_P(
     const char* contentType,
     const uint8_t* text,
     size_t length,
+    const char* etag,
+    bool immutable,
     AsyncWebServerRequest* request
   );
   bool serveFile(const char* file, const char* contentType, RequestContext& request);
-  void handleUpdateJsonFile(const String& file, RequestContext& request);
+  // Serves a SPIFFS file with an ETag, answering 304 if the client's copy is
+  // current.  Returns false if the file doesn't exist.
+  bool serveFileWithEtag(const String& path, const char* contentType, AsyncWebServerRequest* request);
+  // Merge-patches the request body into file, writing the result to writer's
+  // temp file.  On failure, sets the response and aborts writer.
+  bool mergeJsonFile(const String& file, AtomicFileWriter& writer, RequestContext& request);
+  // Validates the template in writer's temp file and, if it's valid, replaces
+  // path with it.  Otherwise, aborts writer and answers 400 with the errors.
+  bool commitTemplate(AtomicFileWriter& writer, const String& path, RequestContext& request);
 };
 
 #endif
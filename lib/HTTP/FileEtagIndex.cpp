@@ -0,0 +1,90 @@
+#include <FileEtagIndex.h>
+#include <MD5Builder.h>
+
+#if defined(ESP32)
+#include <SPIFFS.h>
+#endif
+
+const char FileEtagIndex::FILENAME[] = "/etags.db";
+
+// "<size>:<md5>"
+static const size_t MAX_ENTRY_SIZE = 48;
+
+FileEtagIndex::FileEtagIndex()
+  : loaded(false)
+{ }
+
+void FileEtagIndex::load() {
+  // r+ fails if the file doesn't already exist
+  if (! SPIFFS.exists(FILENAME)) {
+    SPIFFS.open(FILENAME, "w").close();
+  }
+
+  db.open(SPIFFS.open(FILENAME, "r+"));
+  loaded = true;
+}
+
+String FileEtagIndex::get(const String& path) {
+  if (! SPIFFS.exists(path)) {
+    return "";
+  }
+
+  if (! loaded) {
+    load();
+  }
+
+  File file = SPIFFS.open(path, "r");
+  const size_t size = file.size();
+  file.close();
+
+  char entry[MAX_ENTRY_SIZE];
+
+  if (db.get(path.c_str(), path.length(), entry, sizeof(entry))) {
+    char* hash = strchr(entry, ':');
+
+    if (hash != nullptr && strtoul(entry, nullptr, 10) == size) {
+      String etag;
+      etag.reserve(strlen(hash + 1) + 2);
+      etag += '"';
+      etag += hash + 1;
+      etag += '"';
+
+      return etag;
+    }
+  }
+
+  size_t hashedSize;
+  String hash = hashFile(path, hashedSize);
+
+  snprintf_P(entry, sizeof(entry), PSTR("%u:%s"), hashedSize, hash.c_str());
+  db.set(path.c_str(), path.length(), entry, strlen(entry));
+
+  return String("\"") + hash + "\"";
+}
+
+void FileEtagIndex::invalidate(const String& path) {
+  if (! loaded) {
+    load();
+  }
+
+  db.erase(path.c_str(), path.length());
+}
+
+String FileEtagIndex::hashFile(const String& path, size_t& size) {
+  File file = SPIFFS.open(path, "r");
+  MD5Builder md5;
+  uint8_t buffer[128];
+
+  size = 0;
+  md5.begin();
+
+  while (size_t n = file.read(buffer, sizeof(buffer))) {
+    md5.add(buffer, n);
+    size += n;
+  }
+
+  file.close();
+  md5.calculate();
+
+  return md5.toString();
+}
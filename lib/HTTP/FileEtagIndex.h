@@ -0,0 +1,36 @@
+#include <Arduino.h>
+#include <FS.h>
+#include <KeyValueDatabase.h>
+
+#ifndef _FILE_ETAG_INDEX_H
+#define _FILE_ETAG_INDEX_H
+
+// Strong ETags for files on SPIFFS.  A file's ETag is an MD5 of its contents,
+// computed the first time it's served.  ETags are kept in a small sidecar
+// database until the file changes.
+//
+// Each entry also records the file's size.  If a file changes without being
+// invalidated (e.g., a new SPIFFS image was flashed), the size will usually
+// differ and the hash is recomputed.
+class FileEtagIndex {
+public:
+  static const char FILENAME[];
+
+  FileEtagIndex();
+
+  // Returns the quoted ETag for path, or an empty string if the file doesn't
+  // exist
+  String get(const String& path);
+
+  // Call whenever the file at path is written or removed
+  void invalidate(const String& path);
+
+private:
+  KeyValueDatabase db;
+  bool loaded;
+
+  void load();
+  static String hashFile(const String& path, size_t& size);
+};
+
+#endif
@@ -0,0 +1,352 @@
+#include <ArduinoJson.h>
+#include <Metrics.h>
+#include <WebSocketBroadcaster.h>
+
+#include <algorithm>
+#include <iterator>
+
+WebSocketBroadcaster::WebSocketBroadcaster(AsyncWebSocket& wsServer)
+  : wsServer(wsServer)
+  , version(0)
+  , lastFlush(0)
+  , stats()
+{
+#if defined(ESP32)
+  mutex = xSemaphoreCreateMutex();
+
+  if (mutex == NULL) {
+    Serial.println(F("ERROR: could not create mutex"));
+  }
+#endif
+}
+
+WebSocketBroadcaster::~WebSocketBroadcaster() {
+#if defined(ESP32)
+  vSemaphoreDelete(mutex);
+#endif
+}
+
+void WebSocketBroadcaster::lock() {
+#if defined(ESP32)
+  xSemaphoreTake(mutex, portMAX_DELAY);
+#endif
+}
+
+void WebSocketBroadcaster::unlock() {
+#if defined(ESP32)
+  xSemaphoreGive(mutex);
+#endif
+}
+
+String WebSocketBroadcaster::indexKey(bool isRegion, const String& key) {
+  // Variable names and region ids could collide, so qualify the key
+  String result;
+  result.reserve(key.length() + 2);
+  result += isRegion ? "r:" : "v:";
+  result += key;
+
+  return result;
+}
+
+WebSocketEncoding WebSocketBroadcaster::encodingOf(uint32_t clientId) const {
+  auto encoding = clientEncodings.find(clientId);
+  return encoding != clientEncodings.end() ? encoding->second : WebSocketEncoding::JSON;
+}
+
+void WebSocketBroadcaster::setEncoding(uint32_t clientId, WebSocketEncoding encoding) {
+  lock();
+
+  if (encoding == WebSocketEncoding::JSON) {
+    clientEncodings.erase(clientId);
+  } else {
+    clientEncodings[clientId] = encoding;
+  }
+
+  unlock();
+}
+
+WebSocketEncoding WebSocketBroadcaster::getEncoding(uint32_t clientId) {
+  lock();
+  WebSocketEncoding encoding = encodingOf(clientId);
+  unlock();
+
+  return encoding;
+}
+
+bool WebSocketBroadcaster::send(AsyncWebSocketClient* client, JsonDocument& doc, size_t numUpdates) {
+  lock();
+  WebSocketEncoding encoding = encodingOf(client->id());
+  AsyncWebSocketMessageBuffer* buffer = serialize(doc, encoding, numUpdates);
+  unlock();
+
+  if (buffer == nullptr) {
+    return false;
+  }
+
+  sendBuffer(client, buffer, encoding);
+  return true;
+}
+
+void WebSocketBroadcaster::sendBuffer(
+  AsyncWebSocketClient* client,
+  AsyncWebSocketMessageBuffer* buffer,
+  WebSocketEncoding encoding
+) {
+  METRIC_INC(websocketSends);
+
+  if (encoding == WebSocketEncoding::MSGPACK) {
+    client->binary(buffer);
+  } else {
+    client->text(buffer);
+  }
+}
+
+void WebSocketBroadcaster::dumpStats(JsonObject result) {
+  static const char* ENCODING_NAMES[] = { "json", "msgpack" };
+
+  lock();
+
+  for (size_t i = 0; i < sizeof(stats) / sizeof(stats[0]); ++i) {
+    JsonObject encodingStats = result.createNestedObject(ENCODING_NAMES[i]);
+    encodingStats["frames"] = stats[i].frames;
+    encodingStats["updates"] = stats[i].updates;
+    encodingStats["bytes"] = stats[i].bytes;
+    encodingStats["encode_us"] = stats[i].encodeMicros;
+  }
+
+  unlock();
+}
+
+void WebSocketBroadcaster::queueVariable(const String& name, const String& value) {
+  queue(false, name, name, value);
+}
+
+void WebSocketBroadcaster::queueRegion(
+  const String& regionId,
+  const String& variable,
+  const String& value
+) {
+  queue(true, regionId, variable, value);
+}
+
+void WebSocketBroadcaster::queue(
+  bool isRegion,
+  const String& key,
+  const String& variable,
+  const String& value
+) {
+  const String updateKey = indexKey(isRegion, key);
+
+  lock();
+
+  auto existing = index.find(updateKey);
+
+  if (existing != index.end()) {
+    // Reuse the node so that its strings don't need to be reallocated
+    updates.splice(updates.end(), updates, existing->second);
+  } else {
+    updates.emplace_back();
+    index[updateKey] = std::prev(updates.end());
+  }
+
+  Update& update = updates.back();
+  update.isRegion = isRegion;
+  update.key = key;
+  update.variable = variable;
+  update.value = value;
+  update.version = ++version;
+
+  unlock();
+}
+
+void WebSocketBroadcaster::flush() {
+  const unsigned long now = millis();
+
+  if (now - lastFlush < WEBSOCKET_BROADCAST_INTERVAL) {
+    return;
+  }
+  lastFlush = now;
+
+  struct Send {
+    AsyncWebSocketClient* client;
+    AsyncWebSocketMessageBuffer* buffer;
+    WebSocketEncoding encoding;
+  };
+
+  // (version last sent, encoding) -> (frame, version of its last update)
+  typedef std::pair<uint32_t, WebSocketEncoding> FrameKey;
+
+  std::vector<Send> sends;
+  // Frames are shared by clients that were last sent the same version in the
+  // same encoding
+  std::map<FrameKey, std::pair<AsyncWebSocketMessageBuffer*, uint32_t>> frames;
+  std::map<uint32_t, uint32_t> connected;
+  std::map<uint32_t, WebSocketEncoding> connectedEncodings;
+
+  lock();
+
+  for (AsyncWebSocketClient* client : wsServer.getClients()) {
+    if (client->status() != WS_CONNECTED) {
+      continue;
+    }
+
+    const WebSocketEncoding encoding = encodingOf(client->id());
+    if (encoding != WebSocketEncoding::JSON) {
+      connectedEncodings[client->id()] = encoding;
+    }
+
+    // New clients only get updates from now on
+    auto known = clientVersions.find(client->id());
+    uint32_t sent = known != clientVersions.end() ? known->second : version;
+
+    // Clients that are behind are skipped until they catch up.  They'll get
+    // the latest values of everything they missed.
+    if (sent < version && client->queueIsFull()) {
+      METRIC_INC(websocketDrops);
+    } else if (sent < version) {
+      const FrameKey key = std::make_pair(sent, encoding);
+      auto frame = frames.find(key);
+
+      if (frame == frames.end()) {
+        uint32_t frameVersion = sent;
+        AsyncWebSocketMessageBuffer* buffer = buildFrame(sent, encoding, frameVersion);
+
+        if (buffer == nullptr) {
+          METRIC_INC(websocketDrops);
+          connected[client->id()] = sent;
+          continue;
+        }
+
+        // Keeps the buffer alive until every client has queued it
+        buffer->lock();
+        frame = frames.insert(std::make_pair(key, std::make_pair(buffer, frameVersion))).first;
+      }
+
+      sends.push_back({ client, frame->second.first, encoding });
+      sent = frame->second.second;
+    }
+
+    connected[client->id()] = sent;
+  }
+
+  clientVersions.swap(connected);
+  clientEncodings.swap(connectedEncodings);
+  prune();
+
+  unlock();
+
+  // Sending can block on the network stack, so it's done without the lock
+  for (const Send& send : sends) {
+    sendBuffer(send.client, send.buffer, send.encoding);
+  }
+
+  for (const auto& frame : frames) {
+    frame.second.first->unlock();
+  }
+
+  if (!frames.empty()) {
+    wsServer._cleanBuffers();
+  }
+}
+
+AsyncWebSocketMessageBuffer* WebSocketBroadcaster::buildFrame(
+  uint32_t since,
+  WebSocketEncoding encoding,
+  uint32_t& sentVersion
+) {
+  // Updates are ordered by version, so the new ones are at the back
+  auto start = updates.end();
+  size_t numVariables = 0;
+  size_t numRegions = 0;
+
+  while (start != updates.begin() && std::prev(start)->version > since) {
+    --start;
+  }
+
+  auto end = start;
+  for (size_t i = 0; end != updates.end() && i < WEBSOCKET_MAX_BATCH_SIZE; ++i, ++end) {
+    if (end->isRegion) {
+      ++numRegions;
+    } else {
+      ++numVariables;
+    }
+  }
+
+  if (start == end) {
+    return nullptr;
+  }
+
+  // Strings are stored as pointers, so they don't count towards capacity
+  DynamicJsonDocument doc(
+    2*JSON_OBJECT_SIZE(2)
+    + JSON_ARRAY_SIZE(numVariables) + numVariables*JSON_OBJECT_SIZE(2)
+    + JSON_ARRAY_SIZE(numRegions) + numRegions*JSON_OBJECT_SIZE(3)
+  );
+
+  doc["type"] = "batch";
+  JsonObject body = doc.createNestedObject("body");
+  JsonArray variables = body.createNestedArray("variables");
+  JsonArray regions = body.createNestedArray("regions");
+
+  for (auto it = start; it != end; ++it) {
+    if (it->isRegion) {
+      JsonObject region = regions.createNestedObject();
+      region["id"] = it->key.c_str();
+      region["k"] = it->variable.c_str();
+      region["v"] = it->value.c_str();
+    } else {
+      JsonObject variable = variables.createNestedObject();
+      variable["k"] = it->key.c_str();
+      variable["v"] = it->value.c_str();
+    }
+
+    sentVersion = it->version;
+  }
+
+  return serialize(doc, encoding, numVariables + numRegions);
+}
+
+AsyncWebSocketMessageBuffer* WebSocketBroadcaster::serialize(
+  JsonDocument& doc,
+  WebSocketEncoding encoding,
+  size_t numUpdates
+) {
+  const unsigned long start = micros();
+  const bool msgpack = encoding == WebSocketEncoding::MSGPACK;
+
+  size_t len = msgpack ? measureMsgPack(doc) : measureJson(doc);
+  AsyncWebSocketMessageBuffer* buffer = wsServer.makeBuffer(len);
+
+  if (buffer == nullptr) {
+    return nullptr;
+  }
+
+  if (msgpack) {
+    serializeMsgPack(doc, buffer->get(), len);
+  } else {
+    serializeJson(doc, reinterpret_cast<char*>(buffer->get()), len + 1);
+  }
+
+  EncodingStats& encodingStats = stats[static_cast<size_t>(encoding)];
+  encodingStats.frames++;
+  encodingStats.updates += numUpdates;
+  encodingStats.bytes += len;
+  encodingStats.encodeMicros += micros() - start;
+
+  return buffer;
+}
+
+void WebSocketBroadcaster::prune() {
+  uint32_t minVersion = version;
+
+  for (const auto& client : clientVersions) {
+    minVersion = std::min(minVersion, client.second);
+  }
+
+  while (!updates.empty() && updates.front().version <= minVersion) {
+    const Update& update = updates.front();
+
+    index.erase(indexKey(update.isRegion, update.key));
+    updates.pop_front();
+  }
+}
@@ -0,0 +1,139 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+
+#include <list>
+#include <map>
+#include <vector>
+
+#if defined(ESP32)
+extern "C" {
+#include "freertos/semphr.h"
+}
+#endif
+
+#ifndef _WEB_SOCKET_BROADCASTER_H
+#define _WEB_SOCKET_BROADCASTER_H
+
+// Minimum time between frames sent to clients
+#ifndef WEBSOCKET_BROADCAST_INTERVAL
+#define WEBSOCKET_BROADCAST_INTERVAL 100
+#endif
+
+// Most updates included in a single frame.  The rest are sent on later ticks.
+#ifndef WEBSOCKET_MAX_BATCH_SIZE
+#define WEBSOCKET_MAX_BATCH_SIZE 32
+#endif
+
+// How messages to a client are serialized.  Clients start out with JSON text
+// frames and can switch to MessagePack binary frames.
+enum class WebSocketEncoding { JSON = 0, MSGPACK = 1 };
+
+// Coalesces variable and region updates into batched WebSocket frames.
+//
+// Queueing an update only touches memory, so it's safe to call with the
+// display driver's lock held.  Frames are built and sent from flush(), which
+// runs on the main loop.
+//
+// Only the latest value for each variable and region is kept.  Every update
+// gets a version number, and each client remembers the last version it was
+// sent.  A client whose send queue is full is skipped.  When it catches up,
+// it gets the latest value of everything that changed in the meantime in
+// one frame.
+class WebSocketBroadcaster {
+public:
+  WebSocketBroadcaster(AsyncWebSocket& wsServer);
+  ~WebSocketBroadcaster();
+
+  void queueVariable(const String& name, const String& value);
+  void queueRegion(const String& regionId, const String& variable, const String& value);
+
+  // Sends pending updates to clients that can accept them.  Does nothing if
+  // called more often than WEBSOCKET_BROADCAST_INTERVAL.
+  void flush();
+
+  void setEncoding(uint32_t clientId, WebSocketEncoding encoding);
+  WebSocketEncoding getEncoding(uint32_t clientId);
+
+  // Sends doc to a single client in the encoding it negotiated.  Returns false
+  // if the frame couldn't be allocated.
+  bool send(AsyncWebSocketClient* client, JsonDocument& doc, size_t numUpdates);
+
+  // Writes frame counts, bytes sent and time spent serializing for each
+  // encoding
+  void dumpStats(JsonObject result);
+
+private:
+  struct Update {
+    bool isRegion;
+    // Variable name, or region id
+    String key;
+    // Variable bound to the region (regions only)
+    String variable;
+    String value;
+    uint32_t version;
+  };
+
+  typedef std::list<Update> UpdateList;
+
+  struct EncodingStats {
+    uint32_t frames;
+    uint32_t updates;
+    uint32_t bytes;
+    uint32_t encodeMicros;
+  };
+
+  AsyncWebSocket& wsServer;
+
+  // Ordered by version.  An update is moved to the back when it's replaced.
+  UpdateList updates;
+  std::map<String, UpdateList::iterator> index;
+  uint32_t version;
+
+  // Client id -> last version sent
+  std::map<uint32_t, uint32_t> clientVersions;
+  // Only clients that switched away from JSON are listed
+  std::map<uint32_t, WebSocketEncoding> clientEncodings;
+  unsigned long lastFlush;
+
+  EncodingStats stats[2];
+
+#if defined(ESP32)
+  SemaphoreHandle_t mutex;
+#endif
+
+  void lock();
+  void unlock();
+
+  static String indexKey(bool isRegion, const String& key);
+
+  // Callers must hold the lock
+  WebSocketEncoding encodingOf(uint32_t clientId) const;
+
+  void queue(bool isRegion, const String& key, const String& variable, const String& value);
+
+  // Serializes updates newer than since into a frame.  Sets sentVersion to
+  // the version of the last update included.
+  AsyncWebSocketMessageBuffer* buildFrame(
+    uint32_t since,
+    WebSocketEncoding encoding,
+    uint32_t& sentVersion
+  );
+
+  AsyncWebSocketMessageBuffer* serialize(
+    JsonDocument& doc,
+    WebSocketEncoding encoding,
+    size_t numUpdates
+  );
+
+  static void sendBuffer(
+    AsyncWebSocketClient* client,
+    AsyncWebSocketMessageBuffer* buffer,
+    WebSocketEncoding encoding
+  );
+
+  // Drops updates every client has been sent
+  void prune();
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include <JsonMergePatch.h>
+
+static const size_t COPY_BUFFER_SIZE = 128;
+
+JsonMergePatch::MemberCollector::MemberCollector(std::vector<Member>& members)
+  : members(members)
+  , parser(nullptr)
+  , rootIsObject(false)
+{ }
+
+void JsonMergePatch::MemberCollector::setParser(JsonStreamParser* parser) {
+  this->parser = parser;
+}
+
+void JsonMergePatch::MemberCollector::onScalar(
+  const JsonStreamPath& path,
+  JsonStreamParser::ValueType,
+  const char*,
+  size_t
+) {
+  if (path.getDepth() == 1) {
+    addMember(path);
+  }
+}
+
+void JsonMergePatch::MemberCollector::onStartContainer(const JsonStreamPath& path, bool isArray) {
+  if (path.getDepth() == 0) {
+    rootIsObject = !isArray;
+  }
+}
+
+void JsonMergePatch::MemberCollector::onEndContainer(const JsonStreamPath& path, bool) {
+  // path no longer includes the container that just ended
+  if (path.getDepth() == 1) {
+    addMember(path);
+  }
+}
+
+void JsonMergePatch::MemberCollector::addMember(const JsonStreamPath& path) {
+  members.push_back({
+    .key = path[0].key,
+    .start = parser->getValueStart(),
+    .end = parser->getValueEnd()
+  });
+}
+
+bool JsonMergePatch::collectMembers(File& source, std::vector<Member>& members) {
+  MemberCollector collector(members);
+  JsonStreamParser parser(collector);
+  collector.setParser(&parser);
+
+  char buffer[COPY_BUFFER_SIZE];
+
+  source.seek(0);
+
+  while (size_t n = source.read(reinterpret_cast<uint8_t*>(buffer), sizeof(buffer))) {
+    if (!parser.feed(buffer, n)) {
+      return false;
+    }
+  }
+
+  return parser.finish() && collector.isObject();
+}
+
+bool JsonMergePatch::copyRange(File& source, size_t start, size_t end, Print& output) {
+  uint8_t buffer[COPY_BUFFER_SIZE];
+
+  if (!source.seek(start)) {
+    return false;
+  }
+
+  while (start < end) {
+    size_t n = source.read(buffer, std::min(sizeof(buffer), end - start));
+
+    if (n == 0 || output.write(buffer, n) != n) {
+      return false;
+    }
+
+    start += n;
+  }
+
+  return true;
+}
+
+bool JsonMergePatch::writeKey(bool& first, const char* key, Print& output) {
+  // Only holds a pointer to the key, which is enough to serialize it with
+  // proper escaping
+  StaticJsonDocument<JSON_OBJECT_SIZE(0)> keyDoc;
+  keyDoc.set(key);
+
+  if (!first && output.write(',') != 1) {
+    return false;
+  }
+  first = false;
+
+  return serializeJson(keyDoc, output) > 0 && output.write(':') == 1;
+}
+
+bool JsonMergePatch::apply(File& source, JsonObjectConst patch, Print& output) {
+  std::vector<Member> members;
+
+  if (!collectMembers(source, members)) {
+    return false;
+  }
+
+  bool first = true;
+
+  if (output.write('{') != 1) {
+    return false;
+  }
+
+  for (size_t i = 0; i < members.size(); ++i) {
+    const Member& member = members[i];
+    JsonVariantConst replacement = patch[member.key.c_str()];
+
+    if (!patch.containsKey(member.key.c_str())) {
+      if (!writeKey(first, member.key.c_str(), output)
+        || !copyRange(source, member.start, member.end, output)) {
+        return false;
+      }
+    } else if (!replacement.isNull()) {
+      // Duplicate keys are collapsed into the first one
+      bool seen = false;
+      for (size_t j = 0; j < i && !seen; ++j) {
+        seen = members[j].key == member.key;
+      }
+
+      if (!seen
+        && (!writeKey(first, member.key.c_str(), output)
+          || serializeJson(replacement, output) == 0)) {
+        return false;
+      }
+    }
+  }
+
+  for (JsonPairConst kv : patch) {
+    bool existing = false;
+
+    for (size_t i = 0; i < members.size() && !existing; ++i) {
+      existing = members[i].key == kv.key().c_str();
+    }
+
+    if (!existing && !kv.value().isNull()
+      && (!writeKey(first, kv.key().c_str(), output)
+        || serializeJson(kv.value(), output) == 0)) {
+      return false;
+    }
+  }
+
+  return output.write('}') == 1;
+}
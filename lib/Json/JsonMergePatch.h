@@ -0,0 +1,59 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <FS.h>
+#include <JsonStreamParser.h>
+
+#include <vector>
+
+#pragma once
+
+// Applies a JSON merge patch (RFC 7386) to the top level of an object stored
+// in a file, without loading the file into memory.
+//
+// Members of the patch replace members of the same name, and null members
+// remove them.  Nested objects are replaced rather than merged.  Members the
+// patch doesn't mention are copied from the source byte for byte, so only
+// their offsets are kept in memory.
+class JsonMergePatch {
+public:
+  // Returns false if source isn't a JSON object or output couldn't be
+  // written.  source is read twice, so it must be seekable.
+  static bool apply(File& source, JsonObjectConst patch, Print& output);
+
+private:
+  struct Member {
+    String key;
+    // Byte range of the value.  end is exclusive.
+    size_t start;
+    size_t end;
+  };
+
+  class MemberCollector : public JsonStreamParser::Handler {
+  public:
+    MemberCollector(std::vector<Member>& members);
+
+    virtual void onScalar(
+      const JsonStreamPath& path,
+      JsonStreamParser::ValueType type,
+      const char* value,
+      size_t length
+    );
+    virtual void onStartContainer(const JsonStreamPath& path, bool isArray);
+    virtual void onEndContainer(const JsonStreamPath& path, bool isArray);
+
+    void setParser(JsonStreamParser* parser);
+    inline bool isObject() const { return rootIsObject; }
+
+  private:
+    std::vector<Member>& members;
+    JsonStreamParser* parser;
+    bool rootIsObject;
+
+    void addMember(const JsonStreamPath& path);
+  };
+
+  static bool collectMembers(File& source, std::vector<Member>& members);
+  static bool copyRange(File& source, size_t start, size_t end, Print& output);
+  // Writes the separator if needed, followed by the quoted key and a colon
+  static bool writeKey(bool& first, const char* key, Print& output);
+};
@@ -0,0 +1,88 @@
+#include <JsonPath.h>
+
+#include <stdlib.h>
+
+bool JsonPath::parse(const char* expression, JsonPath& path) {
+  const char* p = expression;
+  path.segments.clear();
+
+  if (*p++ != '$') {
+    return false;
+  }
+
+  while (*p) {
+    Segment segment = { .isArray = false, .key = "", .index = 0 };
+
+    if (*p == '.') {
+      const char* start = ++p;
+
+      while (*p && *p != '.' && *p != '[') {
+        ++p;
+      }
+
+      if (p == start) {
+        path.segments.clear();
+        return false;
+      }
+
+      segment.key.reserve(p - start);
+      for (const char* c = start; c < p; ++c) {
+        segment.key += *c;
+      }
+    } else if (*p == '[' && (p[1] == '\'' || p[1] == '"')) {
+      const char quote = p[1];
+      const char* start = p + 2;
+      const char* end = strchr(start, quote);
+
+      if (end == nullptr || end[1] != ']') {
+        path.segments.clear();
+        return false;
+      }
+
+      for (const char* c = start; c < end; ++c) {
+        segment.key += *c;
+      }
+
+      p = end + 2;
+    } else if (*p == '[') {
+      char* end;
+      const long index = strtol(p + 1, &end, 10);
+
+      if (end == p + 1 || *end != ']' || index < 0 || index > UINT16_MAX) {
+        path.segments.clear();
+        return false;
+      }
+
+      segment.isArray = true;
+      segment.index = index;
+      p = end + 1;
+    } else {
+      path.segments.clear();
+      return false;
+    }
+
+    path.segments.push_back(segment);
+  }
+
+  return true;
+}
+
+bool JsonPath::matches(const JsonStreamPath& streamPath) const {
+  if (streamPath.getDepth() != segments.size()) {
+    return false;
+  }
+
+  // Compare from the deepest segment, which is the most likely to differ
+  for (size_t i = segments.size(); i > 0; --i) {
+    const Segment& expected = segments[i - 1];
+    const JsonStreamPath::Segment& actual = streamPath[i - 1];
+
+    if (expected.isArray != actual.isArray) {
+      return false;
+    } else if (expected.isArray ? expected.index != actual.index : expected.key != actual.key) {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,36 @@
+#include <Arduino.h>
+#include <JsonStreamParser.h>
+
+#include <vector>
+
+#pragma once
+
+// A compiled JSONPath expression selecting a single value.  Supports the
+// subset that's useful for picking fields out of device payloads:
+//
+//   $                 the whole document
+//   $.a.b             object members
+//   $['a b']          object members with characters that aren't allowed
+//                     after a dot
+//   $.a[0]            array elements
+//
+// Wildcards, slices and filters are not supported.
+class JsonPath {
+public:
+  struct Segment {
+    bool isArray;
+    String key;
+    uint16_t index;
+  };
+
+  // Returns false and leaves path empty if expression isn't valid
+  static bool parse(const char* expression, JsonPath& path);
+
+  // True if the value at streamPath is the one this path selects
+  bool matches(const JsonStreamPath& streamPath) const;
+
+  inline size_t getDepth() const { return segments.size(); }
+
+private:
+  std::vector<Segment> segments;
+};
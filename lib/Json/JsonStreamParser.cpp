@@ -0,0 +1,416 @@
+#include <JsonStreamParser.h>
+
+#include <string.h>
+
+static inline bool isWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool isNumberChar(char c) {
+  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+static inline bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// Checks number against JSON's grammar, which is stricter than strtod's (no
+// leading zeros, hex, infinities, or dangling points and exponents)
+static bool isValidNumber(const char* number) {
+  const char* p = number;
+
+  if (*p == '-') {
+    ++p;
+  }
+
+  if (*p == '0') {
+    ++p;
+  } else if (isDigit(*p)) {
+    while (isDigit(*p)) ++p;
+  } else {
+    return false;
+  }
+
+  if (*p == '.') {
+    ++p;
+    if (!isDigit(*p)) return false;
+    while (isDigit(*p)) ++p;
+  }
+
+  if (*p == 'e' || *p == 'E') {
+    ++p;
+    if (*p == '+' || *p == '-') ++p;
+    if (!isDigit(*p)) return false;
+    while (isDigit(*p)) ++p;
+  }
+
+  return *p == 0;
+}
+
+JsonStreamParser::JsonStreamParser(Handler& handler)
+  : handler(handler)
+  , token(new char[JSON_STREAM_MAX_TOKEN_SIZE + 1])
+{
+  reset();
+}
+
+void JsonStreamParser::reset() {
+  path.depth = 0;
+  state = State::VALUE;
+  resetToken();
+  readingKey = false;
+  highSurrogate = 0;
+  position = 0;
+  valueStart = 0;
+  valueEnd = 0;
+}
+
+bool JsonStreamParser::feed(const char* data, size_t length) {
+  for (size_t i = 0; i < length && state != State::ERROR; ++i) {
+    // Numbers and literals don't have a terminator, so the character after
+    // one is processed twice: once to end it, and again in the next state.
+    while (!process(data[i]));
+    ++position;
+  }
+
+  return state != State::ERROR;
+}
+
+bool JsonStreamParser::finish() {
+  if ((state == State::NUMBER || state == State::LITERAL) && path.depth == 0) {
+    endNumberOrLiteral();
+  }
+
+  return state == State::DONE;
+}
+
+bool JsonStreamParser::process(char c) {
+  switch (state) {
+    case State::VALUE:
+      if (!isWhitespace(c) && !startValue(c)) {
+        fail();
+      }
+      break;
+
+    case State::OBJECT_KEY_OR_END:
+    case State::OBJECT_KEY:
+      if (isWhitespace(c)) {
+        break;
+      } else if (c == '}' && state == State::OBJECT_KEY_OR_END) {
+        popContainer();
+      } else if (c == '"') {
+        path.segments[path.depth - 1].keyStart = position;
+        resetToken();
+        highSurrogate = 0;
+        readingKey = true;
+        state = State::STRING;
+      } else {
+        fail();
+      }
+      break;
+
+    case State::COLON:
+      if (c == ':') {
+        state = State::VALUE;
+      } else if (!isWhitespace(c)) {
+        fail();
+      }
+      break;
+
+    case State::OBJECT_COMMA_OR_END:
+      if (c == ',') {
+        state = State::OBJECT_KEY;
+      } else if (c == '}') {
+        popContainer();
+      } else if (!isWhitespace(c)) {
+        fail();
+      }
+      break;
+
+    case State::ARRAY_VALUE_OR_END:
+      if (c == ']') {
+        popContainer();
+      } else if (!isWhitespace(c)) {
+        state = State::VALUE;
+        return false;
+      }
+      break;
+
+    case State::ARRAY_COMMA_OR_END:
+      if (c == ',') {
+        path.segments[path.depth - 1].index++;
+        state = State::VALUE;
+      } else if (c == ']') {
+        popContainer();
+      } else if (!isWhitespace(c)) {
+        fail();
+      }
+      break;
+
+    case State::STRING:
+      // A high surrogate must be followed by an escaped low surrogate
+      if (highSurrogate != 0 && c != '\\') {
+        fail();
+      } else if (c == '"') {
+        token[tokenLength] = 0;
+
+        if (readingKey) {
+          // A truncated key could match a different member, so give up
+          if (tokenTruncated) {
+            fail();
+            break;
+          }
+
+          path.segments[path.depth - 1].key = token.get();
+          state = State::COLON;
+        } else {
+          valueEnd = position + 1;
+          endScalar(ValueType::STRING);
+        }
+      } else if (c == '\\') {
+        state = State::STRING_ESCAPE;
+      } else if (static_cast<uint8_t>(c) < 0x20) {
+        fail();
+      } else {
+        appendToken(c);
+      }
+      break;
+
+    case State::STRING_ESCAPE:
+      state = State::STRING;
+
+      if (highSurrogate != 0 && c != 'u') {
+        fail();
+        break;
+      }
+
+      switch (c) {
+        case '"':
+        case '\\':
+        case '/':
+          appendToken(c);
+          break;
+        case 'b':
+          appendToken('\b');
+          break;
+        case 'f':
+          appendToken('\f');
+          break;
+        case 'n':
+          appendToken('\n');
+          break;
+        case 'r':
+          appendToken('\r');
+          break;
+        case 't':
+          appendToken('\t');
+          break;
+        case 'u':
+          unicodeValue = 0;
+          unicodeDigits = 0;
+          state = State::STRING_UNICODE;
+          break;
+        default:
+          fail();
+      }
+      break;
+
+    case State::STRING_UNICODE: {
+      uint8_t digit;
+
+      if (c >= '0' && c <= '9') {
+        digit = c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        digit = c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        digit = c - 'A' + 10;
+      } else {
+        fail();
+        break;
+      }
+
+      unicodeValue = (unicodeValue << 4) | digit;
+
+      if (++unicodeDigits == 4) {
+        state = State::STRING;
+
+        const bool isHigh = unicodeValue >= 0xD800 && unicodeValue <= 0xDBFF;
+        const bool isLow = unicodeValue >= 0xDC00 && unicodeValue <= 0xDFFF;
+
+        // Surrogates can't be encoded in UTF-8 unless they're paired
+        if (isLow != (highSurrogate != 0)) {
+          fail();
+        } else if (isHigh) {
+          highSurrogate = unicodeValue;
+        } else if (isLow) {
+          appendCodePoint(0x10000 + ((highSurrogate - 0xD800) << 10) + (unicodeValue - 0xDC00));
+          highSurrogate = 0;
+        } else {
+          appendCodePoint(unicodeValue);
+        }
+      }
+      break;
+    }
+
+    case State::NUMBER:
+      if (isNumberChar(c)) {
+        appendToken(c);
+      } else {
+        endNumberOrLiteral();
+        return false;
+      }
+      break;
+
+    case State::LITERAL:
+      if (c >= 'a' && c <= 'z') {
+        appendToken(c);
+      } else {
+        endNumberOrLiteral();
+        return false;
+      }
+      break;
+
+    case State::DONE:
+      if (!isWhitespace(c)) {
+        fail();
+      }
+      break;
+
+    case State::ERROR:
+      break;
+  }
+
+  return true;
+}
+
+bool JsonStreamParser::startValue(char c) {
+  valueStart = position;
+  resetToken();
+
+  if (c == '{') {
+    handler.onStartContainer(path, false);
+    return pushContainer(false);
+  } else if (c == '[') {
+    handler.onStartContainer(path, true);
+    return pushContainer(true);
+  } else if (c == '"') {
+    readingKey = false;
+    highSurrogate = 0;
+    state = State::STRING;
+  } else if (c == '-' || (c >= '0' && c <= '9')) {
+    appendToken(c);
+    state = State::NUMBER;
+  } else if (c == 't' || c == 'f' || c == 'n') {
+    appendToken(c);
+    state = State::LITERAL;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+void JsonStreamParser::endNumberOrLiteral() {
+  ValueType type;
+
+  valueEnd = position;
+  token[tokenLength] = 0;
+
+  if (state == State::NUMBER) {
+    if (!isValidNumber(token.get())) {
+      fail();
+      return;
+    }
+
+    type = ValueType::NUMBER;
+  } else if (strcmp(token.get(), "true") == 0 || strcmp(token.get(), "false") == 0) {
+    type = ValueType::BOOLEAN;
+  } else if (strcmp(token.get(), "null") == 0) {
+    type = ValueType::NULL_VALUE;
+  } else {
+    fail();
+    return;
+  }
+
+  endScalar(type);
+}
+
+void JsonStreamParser::endScalar(ValueType type) {
+  handler.onScalar(path, type, token.get(), tokenLength);
+  endValue();
+}
+
+void JsonStreamParser::endValue() {
+  if (path.depth == 0) {
+    state = State::DONE;
+  } else if (path.segments[path.depth - 1].isArray) {
+    state = State::ARRAY_COMMA_OR_END;
+  } else {
+    state = State::OBJECT_COMMA_OR_END;
+  }
+}
+
+bool JsonStreamParser::pushContainer(bool isArray) {
+  if (path.depth >= JSON_STREAM_MAX_DEPTH) {
+    return false;
+  }
+
+  // Segments are kept around after their container closes so that their
+  // key buffers can be reused.
+  if (path.segments.size() <= path.depth) {
+    path.segments.emplace_back();
+  }
+
+  JsonStreamPath::Segment& segment = path.segments[path.depth++];
+  segment.isArray = isArray;
+  segment.key = "";
+  segment.index = 0;
+  segment.containerStart = valueStart;
+  segment.keyStart = 0;
+
+  state = isArray ? State::ARRAY_VALUE_OR_END : State::OBJECT_KEY_OR_END;
+
+  return true;
+}
+
+void JsonStreamParser::popContainer() {
+  const bool isArray = path.segments[path.depth - 1].isArray;
+
+  valueStart = path.segments[path.depth - 1].containerStart;
+  valueEnd = position + 1;
+  path.depth--;
+
+  handler.onEndContainer(path, isArray);
+  endValue();
+}
+
+void JsonStreamParser::resetToken() {
+  tokenLength = 0;
+  tokenTruncated = false;
+}
+
+void JsonStreamParser::appendToken(char c) {
+  if (tokenLength < JSON_STREAM_MAX_TOKEN_SIZE) {
+    token[tokenLength++] = c;
+  } else {
+    tokenTruncated = true;
+  }
+}
+
+void JsonStreamParser::appendCodePoint(uint32_t codePoint) {
+  if (codePoint < 0x80) {
+    appendToken(codePoint);
+  } else if (codePoint < 0x800) {
+    appendToken(0xC0 | (codePoint >> 6));
+    appendToken(0x80 | (codePoint & 0x3F));
+  } else if (codePoint < 0x10000) {
+    appendToken(0xE0 | (codePoint >> 12));
+    appendToken(0x80 | ((codePoint >> 6) & 0x3F));
+    appendToken(0x80 | (codePoint & 0x3F));
+  } else {
+    appendToken(0xF0 | (codePoint >> 18));
+    appendToken(0x80 | ((codePoint >> 12) & 0x3F));
+    appendToken(0x80 | ((codePoint >> 6) & 0x3F));
+    appendToken(0x80 | (codePoint & 0x3F));
+  }
+}
@@ -0,0 +1,145 @@
+#include <Arduino.h>
+
+#include <memory>
+#include <vector>
+
+#pragma once
+
+#ifndef JSON_STREAM_MAX_DEPTH
+#define JSON_STREAM_MAX_DEPTH 16
+#endif
+
+// Keys longer than this are an error.  Longer values are truncated, and
+// JsonStreamParser::isValueTruncated() is set while they're being emitted.
+#ifndef JSON_STREAM_MAX_TOKEN_SIZE
+#define JSON_STREAM_MAX_TOKEN_SIZE 1024
+#endif
+
+// Location of a value within a document.  Each segment is either an object
+// member (key) or an array element (index).  The root value has depth 0.
+class JsonStreamPath {
+public:
+  struct Segment {
+    bool isArray;
+    String key;
+    uint16_t index;
+
+    // Offsets of the container holding this segment, and of the key of the
+    // member (object members only)
+    size_t containerStart;
+    size_t keyStart;
+  };
+
+  JsonStreamPath() : depth(0) { }
+
+  inline size_t getDepth() const { return depth; }
+  inline const Segment& operator[](size_t i) const { return segments[i]; }
+
+private:
+  friend class JsonStreamParser;
+
+  std::vector<Segment> segments;
+  size_t depth;
+};
+
+// Push-based JSON parser.  Bytes are fed in as they arrive, in chunks of any
+// size, and events are emitted to a Handler as values complete.  Nothing is
+// allocated per value.  The only state is the current path and a buffer for
+// the token being read.
+class JsonStreamParser {
+public:
+  enum class ValueType { STRING, NUMBER, BOOLEAN, NULL_VALUE };
+
+  class Handler {
+  public:
+    virtual ~Handler() { }
+
+    // value is null-terminated.  Strings are unescaped.  Other values are the
+    // literal text from the document.
+    virtual void onScalar(const JsonStreamPath&, ValueType, const char*, size_t) { }
+
+    virtual void onStartContainer(const JsonStreamPath&, bool) { }
+    virtual void onEndContainer(const JsonStreamPath&, bool) { }
+  };
+
+  JsonStreamParser(Handler& handler);
+
+  // Prepares to parse a new document
+  void reset();
+
+  // Returns false if the document is invalid.  Once that happens, the rest
+  // of the input is ignored until reset() is called.
+  bool feed(const char* data, size_t length);
+
+  // Call after the last byte has been fed.  Returns true if exactly one
+  // complete value was parsed.
+  bool finish();
+
+  inline bool hasError() const { return state == State::ERROR; }
+
+  // Byte offsets of the value an event is being emitted for.  end is
+  // exclusive.  Only meaningful during a Handler callback.
+  inline size_t getValueStart() const { return valueStart; }
+  inline size_t getValueEnd() const { return valueEnd; }
+
+  // True if the value passed to onScalar was longer than
+  // JSON_STREAM_MAX_TOKEN_SIZE and is only a prefix of the real value.  The
+  // byte offsets above still cover all of it.
+  inline bool isValueTruncated() const { return tokenTruncated; }
+
+  // Total number of bytes fed since the last reset()
+  inline size_t getPosition() const { return position; }
+
+private:
+  enum class State {
+    VALUE,
+    OBJECT_KEY_OR_END,
+    OBJECT_KEY,
+    COLON,
+    OBJECT_COMMA_OR_END,
+    ARRAY_VALUE_OR_END,
+    ARRAY_COMMA_OR_END,
+    STRING,
+    STRING_ESCAPE,
+    STRING_UNICODE,
+    NUMBER,
+    LITERAL,
+    DONE,
+    ERROR
+  };
+
+  Handler& handler;
+  JsonStreamPath path;
+  State state;
+
+  std::unique_ptr<char[]> token;
+  size_t tokenLength;
+  bool tokenTruncated;
+  bool readingKey;
+
+  uint16_t unicodeValue;
+  uint8_t unicodeDigits;
+  uint16_t highSurrogate;
+
+  size_t position;
+  size_t valueStart;
+  size_t valueEnd;
+
+  // Returns false if c couldn't be consumed in the current state and should
+  // be processed again
+  bool process(char c);
+
+  bool startValue(char c);
+  void endValue();
+  void endScalar(ValueType type);
+  void endNumberOrLiteral();
+
+  bool pushContainer(bool isArray);
+  void popContainer();
+
+  void resetToken();
+  void appendToken(char c);
+  void appendCodePoint(uint32_t codePoint);
+
+  inline void fail() { state = State::ERROR; }
+};
@@ -0,0 +1,78 @@
+#include <FieldExtractor.h>
+
+#include <algorithm>
+
+FieldExtractor::FieldExtractor()
+  : maxDepth(0)
+  , parser(*this)
+  , payload(nullptr)
+  , batch(nullptr)
+{ }
+
+bool FieldExtractor::addField(const String& path, const String& variable) {
+  Field field;
+
+  if (!JsonPath::parse(path.c_str(), field.path)) {
+    return false;
+  }
+
+  field.variable = variable;
+  maxDepth = std::max(maxDepth, field.path.getDepth());
+  fields.push_back(field);
+
+  return true;
+}
+
+bool FieldExtractor::extract(const char* payload, size_t length, VariableBatch& batch) {
+  parser.reset();
+
+  this->payload = payload;
+  this->batch = &batch;
+
+  const bool valid = parser.feed(payload, length) && parser.finish();
+
+  this->payload = nullptr;
+  this->batch = nullptr;
+
+  return valid;
+}
+
+void FieldExtractor::onScalar(
+  const JsonStreamPath& path,
+  JsonStreamParser::ValueType type,
+  const char* value,
+  size_t
+) {
+  // A truncated value would be shown as if it were the whole thing
+  if (path.getDepth() > maxDepth || parser.isValueTruncated()) {
+    return;
+  }
+
+  for (const Field& field : fields) {
+    if (field.path.matches(path)) {
+      (*batch)[field.variable] =
+        type == JsonStreamParser::ValueType::NULL_VALUE ? "" : value;
+    }
+  }
+}
+
+void FieldExtractor::onEndContainer(const JsonStreamPath& path, bool) {
+  if (path.getDepth() > maxDepth) {
+    return;
+  }
+
+  for (const Field& field : fields) {
+    if (field.path.matches(path)) {
+      const size_t start = parser.getValueStart();
+      const size_t end = parser.getValueEnd();
+
+      String& value = (*batch)[field.variable];
+      value = "";
+      value.reserve(end - start);
+
+      for (size_t i = start; i < end; ++i) {
+        value += payload[i];
+      }
+    }
+  }
+}
@@ -0,0 +1,61 @@
+#include <Arduino.h>
+#include <JsonPath.h>
+#include <JsonStreamParser.h>
+#include <VariableBatch.h>
+
+#include <vector>
+
+#ifndef _FIELD_EXTRACTOR_H
+#define _FIELD_EXTRACTOR_H
+
+// Binds fields in a JSON payload to variables, e.g. $.temperature to
+// lr_temp.  All fields are pulled out in a single pass over the payload
+// without building a document.
+//
+// Scalars are extracted as text (strings unescaped, other values as written).
+// Objects and arrays are extracted as their raw JSON.  Scalars longer than
+// JSON_STREAM_MAX_TOKEN_SIZE are skipped.
+//
+// Each extractor keeps its own parser (and so a token buffer of that size),
+// so that messages are extracted without allocating one every time.
+class FieldExtractor : public JsonStreamParser::Handler {
+public:
+  FieldExtractor();
+
+  // Returns false if path isn't a valid JSONPath expression
+  bool addField(const String& path, const String& variable);
+
+  // Adds the value of each field present in payload to batch.  Returns false
+  // if payload isn't valid JSON, in which case batch may hold some fields.
+  bool extract(const char* payload, size_t length, VariableBatch& batch);
+
+  inline size_t getFieldCount() const { return fields.size(); }
+
+  virtual void onScalar(
+    const JsonStreamPath& path,
+    JsonStreamParser::ValueType type,
+    const char* value,
+    size_t length
+  ) override;
+  virtual void onEndContainer(const JsonStreamPath& path, bool isArray) override;
+
+private:
+  struct Field {
+    JsonPath path;
+    String variable;
+  };
+
+  std::vector<Field> fields;
+
+  // Nothing deeper than this can match, so deeper values are skipped quickly
+  size_t maxDepth;
+
+  // Kept between messages so that its buffers are only allocated once
+  JsonStreamParser parser;
+
+  // Only valid during extract()
+  const char* payload;
+  VariableBatch* batch;
+};
+
+#endif
@@ -1,8 +1,7 @@
 #include <MqttClient.h>
 #include <ArduinoJson.h>
+#include <Metrics.h>
 #include <Settings.h>
-#include <TokenIterator.h>
-#include <UrlTokenBindings.h>
 #include <functional>
 #include <map>
 
@@ -26,32 +25,83 @@ void MqttClient::internalCallback(MqttClient* client) {
 const char* MqttClient::CONNECTED_STATUS = "connected";
 const char* MqttClient::DISCONNECTED_STATUS = "disconnected";
 const char* MqttClient::STATUS_VARIABLE = "mqtt_state";
+const char* MqttClient::BOOTSTRAP_REFRESHES_SAVED_VARIABLE = "mqtt_bootstrap_refreshes_saved";
+
+// Calls fn with the whitespace-separated words on each line of rules.  Blank
+// lines and lines starting with # are skipped.
+static void forEachRule(
+  const String& rules,
+  const std::function<void(const std::vector<String>& words)>& fn
+) {
+  const char* line = rules.c_str();
+  std::vector<String> words;
+
+  while (*line) {
+    const char* lineEnd = strchr(line, '\n');
+    if (lineEnd == nullptr) {
+      lineEnd = line + strlen(line);
+    }
+
+    const char* p = line;
+    words.clear();
+
+    while (p < lineEnd) {
+      while (p < lineEnd && isspace(static_cast<unsigned char>(*p))) {
+        ++p;
+      }
+
+      const char* start = p;
+      while (p < lineEnd && !isspace(static_cast<unsigned char>(*p))) {
+        ++p;
+      }
+
+      if (p > start) {
+        words.emplace_back();
+        words.back().reserve(p - start);
+
+        for (const char* c = start; c < p; ++c) {
+          words.back() += *c;
+        }
+      }
+    }
+
+    if (!words.empty() && !words[0].startsWith("#")) {
+      fn(words);
+    }
+
+    line = *lineEnd ? lineEnd + 1 : lineEnd;
+  }
+}
 
 MqttClient::MqttClient(
   String domain,
   uint16_t port,
-  String variableTopicPattern,
+  String variableTopicPatterns,
   String username,
   String password,
-  String clientStatusTopic
+  String clientStatusTopic,
+  String variablesBatchTopic
 ) : port(port)
   , domain(domain)
   , username(username)
   , password(password)
   , lastConnectAttempt(0)
   , variableUpdateCallback(NULL)
-  , topicPattern(variableTopicPattern)
+  , variableBatchUpdateCallback(NULL)
+  , bootstrapCallback(NULL)
+  , bootstrapping(false)
+  , bootstrapStartedAt(0)
+  , lastMessageAt(0)
+  , bootstrapMessages(0)
   , clientStatusTopic(clientStatusTopic)
+  , variablesBatchTopic(variablesBatchTopic)
+  , messageHandler(std::bind(&MqttClient::handleMessage, this, _1, _2, _3))
 {
-  this->topicPatternBuffer = new char[topicPattern.length() + 1];
-  strcpy(this->topicPatternBuffer, this->topicPattern.c_str());
-  this->topicPatternTokens = new TokenIterator(this->topicPatternBuffer, topicPattern.length(), '/');
+  addTopicPatterns(variableTopicPatterns);
 }
 
 MqttClient::~MqttClient() {
-  delete this->topicPatternTokens;
-  delete this->topicPatternBuffer;
-
+  endBootstrap();
   updateStatus(MqttClient::DISCONNECTED_STATUS);
   mqttClient.disconnect();
 
@@ -65,6 +115,100 @@ void MqttClient::onVariableUpdate(TVariableUpdateFn fn) {
   this->variableUpdateCallback = fn;
 }
 
+void MqttClient::onVariableBatchUpdate(TVariableBatchUpdateFn fn) {
+  this->variableBatchUpdateCallback = fn;
+}
+
+void MqttClient::onBootstrap(TBootstrapFn fn) {
+  this->bootstrapCallback = fn;
+}
+
+void MqttClient::loop() {
+  if (!bootstrapping) {
+    return;
+  }
+
+  const unsigned long now = millis();
+
+  if (now - lastMessageAt >= MQTT_BOOTSTRAP_QUIET_PERIOD
+    || now - bootstrapStartedAt >= MQTT_BOOTSTRAP_TIMEOUT) {
+    endBootstrap();
+  }
+}
+
+void MqttClient::endBootstrap() {
+  if (!bootstrapping) {
+    return;
+  }
+
+  bootstrapping = false;
+
+  #ifdef MQTT_DEBUG
+    Serial.printf_P(
+      PSTR("MqttClient - bootstrap window closed after %lu ms, %u messages\n"),
+      millis() - bootstrapStartedAt,
+      bootstrapMessages
+    );
+  #endif
+
+  if (this->bootstrapCallback != NULL) {
+    this->bootstrapCallback(false, bootstrapMessages);
+  }
+}
+
+bool MqttClient::addRoute(const String& pattern, const Route& route) {
+  if (routes.size() > UINT16_MAX || !topics.add(pattern, routes.size())) {
+    return false;
+  }
+
+  routes.push_back(route);
+  subscriptions.insert(TopicTrie::toSubscription(pattern));
+
+  return true;
+}
+
+void MqttClient::addTopicPatterns(const String& patterns) {
+  forEachRule(patterns, [this](const std::vector<String>& words) {
+    Route route = { .binding = TopicBinding(), .extractor = nullptr };
+    const String& nameTemplate =
+      words.size() > 1 ? words[1] : MQTT_DEFAULT_VARIABLE_NAME_TEMPLATE;
+
+    if (words.size() > 2
+      || !route.binding.compile(words[0], nameTemplate)
+      || !addRoute(words[0], route)) {
+      Serial.printf_P(
+        PSTR("MqttClient - WARN: ignoring invalid topic pattern %s\n"),
+        words[0].c_str()
+      );
+    }
+  });
+}
+
+void MqttClient::addExtractionRules(const String& rules) {
+  forEachRule(rules, [this](const std::vector<String>& words) {
+    const String& topic = words[0];
+    FieldExtractor& extractor = extractors[topic];
+    const bool isNewTopic = extractor.getFieldCount() == 0;
+
+    bool valid = words.size() == 3 && extractor.addField(words[1], words[2]);
+
+    if (valid && isNewTopic) {
+      valid = addRoute(topic, { .binding = TopicBinding(), .extractor = &extractor });
+    }
+
+    if (!valid) {
+      Serial.printf_P(
+        PSTR("MqttClient - WARN: ignoring invalid extraction rule for topic %s\n"),
+        topic.c_str()
+      );
+
+      if (isNewTopic) {
+        extractors.erase(topic);
+      }
+    }
+  });
+}
+
 void MqttClient::begin() {
   #if defined(ESP32)
   reconnectTimer = xTimerCreate(
@@ -131,10 +275,19 @@ void MqttClient::disconnectCallback(AsyncMqttClientDisconnectReason reason) {
 }
 
 void MqttClient::connectCallback(bool sessionPresent) {
-  if (this->topicPattern.length() > 0) {
-    String topic = this->topicPattern;
-    topic.replace(String(":") + MQTT_TOPIC_VARIABLE_NAME_TOKEN, "+");
+  // Open the window before subscribing so that it covers the retained
+  // messages the subscriptions trigger
+  if (!bootstrapping && (!subscriptions.empty() || variablesBatchTopic.length() > 0)) {
+    bootstrapStartedAt = lastMessageAt = millis();
+    bootstrapMessages = 0;
+    bootstrapping = true;
+
+    if (this->bootstrapCallback != NULL) {
+      this->bootstrapCallback(true, 0);
+    }
+  }
 
+  for (const String& topic : subscriptions) {
     #ifdef MQTT_DEBUG
       printf_P(PSTR("MqttClient - subscribing to topic: %s\n"), topic.c_str());
     #endif
@@ -142,6 +295,14 @@ void MqttClient::connectCallback(bool sessionPresent) {
     mqttClient.subscribe(topic.c_str(), 0);
   }
 
+  if (this->variablesBatchTopic.length() > 0) {
+    #ifdef MQTT_DEBUG
+      printf_P(PSTR("MqttClient - subscribing to topic: %s\n"), variablesBatchTopic.c_str());
+    #endif
+
+    mqttClient.subscribe(this->variablesBatchTopic.c_str(), 0);
+  }
+
   updateStatus(MqttClient::CONNECTED_STATUS);
 
   if (variableUpdateCallback != nullptr) {
@@ -170,27 +331,91 @@ void MqttClient::messageCallback(
   size_t index,
   size_t total
 ) {
-  if (index > 0) {
-    Serial.println(F("MqttClient - WARNING: got unsupported second call to messageCallback"));
+  if (index == 0) {
+    METRIC_INC(mqttMessages);
+  }
+
+  if (bootstrapping) {
+    lastMessageAt = millis();
+
+    if (index == 0) {
+      ++bootstrapMessages;
+    }
+  }
+
+  if (this->variablesBatchTopic.length() > 0 && this->variablesBatchTopic == topic) {
+    handleBatchChunk(payload, len, index, total);
+  } else {
+    payloadAssembler.handleChunk(topic, payload, len, index, total, messageHandler);
+  }
+}
+
+void MqttClient::handleBatchChunk(const char* payload, size_t length, size_t index, size_t total) {
+  batchParser.feed(payload, length, index);
+
+  if (index + length < total) {
     return;
   }
 
-  char payloadCopy[len + 1];
-  memcpy(payloadCopy, payload, len);
-  payloadCopy[len] = 0;
+  if (batchParser.finish()) {
+    #ifdef MQTT_DEBUG
+      Serial.printf("MqttClient - Got batch of %u variables\n", batchParser.getBatch().size());
+    #endif
+
+    if (this->variableBatchUpdateCallback != NULL) {
+      this->variableBatchUpdateCallback(batchParser.getBatch());
+    }
+  } else {
+    Serial.println(F("MqttClient - WARN: ignoring invalid batch payload"));
+  }
+
+  batchParser.clear();
+}
 
+void MqttClient::handleMessage(char* topic, const char* payload, size_t length) {
   #ifdef MQTT_DEBUG
-    Serial.printf("MqttClient - Got message on topic: %s\n%s\n", topic, payloadCopy);
+    Serial.printf("MqttClient - Got %u byte message on topic: %s\n", length, topic);
   #endif
 
-  if (this->variableUpdateCallback != NULL) {
-    TokenIterator topicItr(topic, strlen(topic), '/');
-    UrlTokenBindings urlTokens(*topicPatternTokens, topicItr);
+  // payload isn't null-terminated, so it's copied the first time a variable
+  // pattern matches
+  String value;
+  String variable;
+  bool copiedValue = false;
+
+  topics.match(topic, [&](uint16_t routeId, const TopicLevels& levels) {
+    const Route& route = routes[routeId];
+
+    if (route.extractor != nullptr) {
+      handleExtraction(*route.extractor, payload, length);
+    } else if (this->variableUpdateCallback != NULL) {
+      if (!copiedValue) {
+        value.reserve(length);
+        for (size_t i = 0; i < length; ++i) {
+          value += payload[i];
+        }
+        copiedValue = true;
+      }
+
+      route.binding.render(levels, variable);
+      this->variableUpdateCallback(variable, value);
+    }
+  });
+}
+
+void MqttClient::handleExtraction(FieldExtractor& extractor, const char* payload, size_t length) {
+  VariableBatch batch;
 
-    if (urlTokens.hasBinding(MQTT_TOPIC_VARIABLE_NAME_TOKEN)) {
-      const char* variable = urlTokens.get(MQTT_TOPIC_VARIABLE_NAME_TOKEN);
+  if (!extractor.extract(payload, length, batch)) {
+    Serial.println(F("MqttClient - WARN: could not parse JSON payload for extraction"));
+    return;
+  }
 
-      this->variableUpdateCallback(variable, payloadCopy);
+  if (this->variableBatchUpdateCallback != NULL) {
+    this->variableBatchUpdateCallback(batch);
+  } else if (this->variableUpdateCallback != NULL) {
+    for (const auto& entry : batch) {
+      this->variableUpdateCallback(entry.first, entry.second);
     }
   }
 }
@@ -1,38 +1,82 @@
 #include <AsyncMqttClient.h>
-#include <TokenIterator.h>
 #include <EnvironmentConfig.h>
+#include <FieldExtractor.h>
+#include <PayloadAssembler.h>
+#include <TopicBinding.h>
+#include <TopicTrie.h>
+#include <VariableBatchParser.h>
+
+#include <map>
+#include <set>
+#include <vector>
 
 #ifndef _MQTT_CLIENT_H
 #define _MQTT_CLIENT_H
 
 #define MQTT_TOPIC_VARIABLE_NAME_TOKEN "variable_name"
+#define MQTT_DEFAULT_VARIABLE_NAME_TEMPLATE ":" MQTT_TOPIC_VARIABLE_NAME_TOKEN
 
 #ifndef MQTT_CONNECTION_ATTEMPT_FREQUENCY
 #define MQTT_CONNECTION_ATTEMPT_FREQUENCY 5000
 #endif
 
+// After (re)connecting, the broker replays retained messages.  The bootstrap
+// window lasts until no message has arrived for the quiet period, or until the
+// timeout passes, whichever is first.
+#ifndef MQTT_BOOTSTRAP_QUIET_PERIOD
+#define MQTT_BOOTSTRAP_QUIET_PERIOD 500
+#endif
+
+#ifndef MQTT_BOOTSTRAP_TIMEOUT
+#define MQTT_BOOTSTRAP_TIMEOUT 5000
+#endif
+
 class MqttClient {
 public:
   typedef std::function<void(const String&, const String&)> TVariableUpdateFn;
+  typedef std::function<void(const VariableBatch&)> TVariableBatchUpdateFn;
+  // Called with true when the bootstrap window opens, and with false and the
+  // number of messages received during it when it closes
+  typedef std::function<void(bool active, uint32_t messages)> TBootstrapFn;
 
-  MqttClient(String domain, uint16_t port, String variableTopicPattern);
+  // variableTopicPatterns has one pattern per line, optionally followed by a
+  // template for the variable name (see TopicBinding).  The template defaults
+  // to ":variable_name".  For example:
+  //
+  //   displays/my-display/variables/:variable_name
+  //   sensors/:room/:variable_name :room_:variable_name
+  //   weather/outside/temperature outside_temp
+  MqttClient(String domain, uint16_t port, String variableTopicPatterns);
   MqttClient(
     String domain,
     uint16_t port,
-    String variableTopicPattern,
+    String variableTopicPatterns,
     String username,
     String password,
-    String clientStatusTopic
+    String clientStatusTopic,
+    String variablesBatchTopic
   );
   ~MqttClient();
 
+  // Parses extraction rules, one per line, each of the form:
+  //
+  //   <topic> <JSONPath> <variable name>
+  //
+  // e.g. "zigbee/livingroom $.temperature lr_temp".  Blank lines and lines
+  // starting with # are ignored.  Must be called before begin().
+  void addExtractionRules(const String& rules);
+
   void begin();
+  void loop();
   void onVariableUpdate(TVariableUpdateFn fn);
+  void onVariableBatchUpdate(TVariableBatchUpdateFn fn);
+  void onBootstrap(TBootstrapFn fn);
   void updateStatus(const char* status);
 
   static const char* CONNECTED_STATUS;
   static const char* DISCONNECTED_STATUS;
   static const char* STATUS_VARIABLE;
+  static const char* BOOTSTRAP_REFRESHES_SAVED_VARIABLE;
 
 private:
   AsyncMqttClient mqttClient;
@@ -52,15 +96,43 @@ private:
 
   unsigned long lastConnectAttempt;
   TVariableUpdateFn variableUpdateCallback;
+  TVariableBatchUpdateFn variableBatchUpdateCallback;
+  TBootstrapFn bootstrapCallback;
+
+  // The window is opened from the MQTT client's task and closed from loop()
+  volatile bool bootstrapping;
+  volatile unsigned long bootstrapStartedAt;
+  volatile unsigned long lastMessageAt;
+  volatile uint32_t bootstrapMessages;
 
-  // This will get reused a bunch.  Allows us to avoid copying into a buffer
-  // every time a message is received.
-  String topicPattern;
-  char* topicPatternBuffer;
-  TokenIterator* topicPatternTokens;
   String clientStatusTopic;
+  String variablesBatchTopic;
+
+  PayloadAssembler payloadAssembler;
+  PayloadAssembler::TMessageFn messageHandler;
+
+  // Where messages matching a pattern go.  Variable patterns name the
+  // variable with a binding.  Extraction rules pull fields out of the payload.
+  struct Route {
+    TopicBinding binding;
+    FieldExtractor* extractor;
+  };
+
+  // Every pattern is compiled into the trie.  Its route ids index routes.
+  TopicTrie topics;
+  std::vector<Route> routes;
+  std::set<String> subscriptions;
+
+  // Topic pattern -> fields to pull out of JSON payloads published to it
+  std::map<String, FieldExtractor> extractors;
+
+  // Batches skip the reassembly buffer and are parsed chunk by chunk
+  VariableBatchParser batchParser;
 
   void connect();
+  void endBootstrap();
+  bool addRoute(const String& pattern, const Route& route);
+  void addTopicPatterns(const String& patterns);
 
   void onWifiConnected();
   void messageCallback(
@@ -71,6 +143,9 @@ private:
     size_t index,
     size_t total
   );
+  void handleMessage(char* topic, const char* payload, size_t length);
+  void handleExtraction(FieldExtractor& extractor, const char* payload, size_t length);
+  void handleBatchChunk(const char* payload, size_t length, size_t index, size_t total);
   void connectCallback(bool sessionPresent);
   void disconnectCallback(AsyncMqttClientDisconnectReason reason);
 };
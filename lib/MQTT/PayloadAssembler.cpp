@@ -0,0 +1,124 @@
+#include <PayloadAssembler.h>
+
+#include <new>
+
+PayloadAssembler::PayloadAssembler(size_t maxPayloadSize)
+  : maxPayloadSize(maxPayloadSize)
+{
+  for (Slot& slot : slots) {
+    slot.capacity = 0;
+    slot.received = 0;
+    slot.total = 0;
+    slot.active = false;
+  }
+}
+
+void PayloadAssembler::handleChunk(
+  char* topic,
+  const char* payload,
+  size_t length,
+  size_t index,
+  size_t total,
+  const TMessageFn& fn
+) {
+  // Common case: the whole message arrived at once
+  if (index == 0 && length == total) {
+    Slot* stale = findSlot(topic);
+    if (stale != nullptr) {
+      stale->active = false;
+    }
+
+    fn(topic, payload, length);
+    return;
+  }
+
+  Slot* slot;
+
+  if (index == 0) {
+    if (total > maxPayloadSize) {
+      Serial.printf_P(
+        PSTR("MqttClient - WARNING: dropping %u byte message on %s (max is %u)\n"),
+        total,
+        topic,
+        maxPayloadSize
+      );
+      return;
+    }
+
+    slot = acquireSlot(topic, total);
+
+    if (slot == nullptr) {
+      Serial.printf_P(PSTR("MqttClient - WARNING: no buffer available for message on %s\n"), topic);
+      return;
+    }
+  } else {
+    slot = findSlot(topic);
+
+    // Either the start of this message was dropped, or chunks arrived out of
+    // order.  Nothing useful can be done with the rest of the message.
+    if (slot == nullptr || slot->received != index || slot->total != total) {
+      if (slot != nullptr) {
+        slot->active = false;
+      }
+      return;
+    }
+  }
+
+  if (index + length > total) {
+    slot->active = false;
+    return;
+  }
+
+  memcpy(slot->buffer.get() + index, payload, length);
+  slot->received += length;
+
+  if (slot->received == total) {
+    slot->active = false;
+    fn(topic, slot->buffer.get(), total);
+  }
+}
+
+PayloadAssembler::Slot* PayloadAssembler::findSlot(const char* topic) {
+  for (Slot& slot : slots) {
+    if (slot.active && slot.topic == topic) {
+      return &slot;
+    }
+  }
+
+  return nullptr;
+}
+
+PayloadAssembler::Slot* PayloadAssembler::acquireSlot(const char* topic, size_t total) {
+  // A new message on a topic replaces any partial message on it.  Otherwise,
+  // prefer an idle buffer that's already big enough.
+  Slot* slot = findSlot(topic);
+
+  if (slot == nullptr) {
+    for (Slot& candidate : slots) {
+      if (!candidate.active &&
+          (slot == nullptr || (slot->capacity < total && candidate.capacity > slot->capacity))) {
+        slot = &candidate;
+      }
+    }
+  }
+
+  if (slot == nullptr) {
+    return nullptr;
+  }
+
+  if (slot->capacity < total) {
+    slot->buffer.reset(new (std::nothrow) char[total]);
+    slot->capacity = slot->buffer ? total : 0;
+
+    if (!slot->buffer) {
+      return nullptr;
+    }
+  }
+
+  slot->topic = topic;
+  slot->received = 0;
+  slot->total = total;
+  slot->active = true;
+
+  return slot;
+}
@@ -0,0 +1,61 @@
+#include <Arduino.h>
+
+#include <functional>
+#include <memory>
+
+#ifndef _PAYLOAD_ASSEMBLER_H
+#define _PAYLOAD_ASSEMBLER_H
+
+// Largest message payload that will be reassembled.  Larger messages are
+// dropped.
+#ifndef MQTT_MAX_PAYLOAD_SIZE
+#define MQTT_MAX_PAYLOAD_SIZE 8192
+#endif
+
+// Number of topics that can have a partially received message at once
+#ifndef MQTT_REASSEMBLY_SLOTS
+#define MQTT_REASSEMBLY_SLOTS 2
+#endif
+
+// AsyncMqttClient delivers payloads larger than its receive buffer in several
+// chunks.  This stitches the chunks back together, keyed by topic.
+//
+// Messages that arrive in one piece are passed through without being copied.
+// Otherwise the chunks are copied into a buffer from a small pool.  Buffers
+// are kept after the message is delivered so that they can be reused.
+class PayloadAssembler {
+public:
+  // payload is not null-terminated, and is only valid during the call
+  typedef std::function<void(char* topic, const char* payload, size_t length)> TMessageFn;
+
+  PayloadAssembler(size_t maxPayloadSize = MQTT_MAX_PAYLOAD_SIZE);
+
+  // Feeds one chunk of a message.  Calls fn once all total bytes of the
+  // message have arrived.
+  void handleChunk(
+    char* topic,
+    const char* payload,
+    size_t length,
+    size_t index,
+    size_t total,
+    const TMessageFn& fn
+  );
+
+private:
+  struct Slot {
+    String topic;
+    std::unique_ptr<char[]> buffer;
+    size_t capacity;
+    size_t received;
+    size_t total;
+    bool active;
+  };
+
+  const size_t maxPayloadSize;
+  Slot slots[MQTT_REASSEMBLY_SLOTS];
+
+  Slot* findSlot(const char* topic);
+  Slot* acquireSlot(const char* topic, size_t total);
+};
+
+#endif
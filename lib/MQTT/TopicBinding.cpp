@@ -0,0 +1,63 @@
+#include <TopicBinding.h>
+
+#include <string.h>
+
+bool TopicBinding::compile(const String& pattern, const String& nameTemplate) {
+  TopicLevels levels;
+  parts.clear();
+
+  if (nameTemplate.length() == 0 || !levels.parse(pattern.c_str())) {
+    return false;
+  }
+
+  const char* p = nameTemplate.c_str();
+
+  while (*p) {
+    int8_t tokenLevel = -1;
+    size_t tokenLength = 0;
+
+    if (*p == ':') {
+      for (size_t i = 0; i < levels.count; ++i) {
+        const char* level = levels.start[i];
+        const size_t nameLength = levels.length[i] - 1;
+
+        if (level[0] == ':' && nameLength > tokenLength && strncmp(p + 1, level + 1, nameLength) == 0) {
+          tokenLevel = i;
+          tokenLength = nameLength;
+        }
+      }
+
+      if (tokenLevel < 0) {
+        parts.clear();
+        return false;
+      }
+
+      parts.push_back({ .level = tokenLevel, .literal = "" });
+      p += tokenLength + 1;
+    } else {
+      if (parts.empty() || parts.back().level >= 0) {
+        parts.push_back({ .level = -1, .literal = "" });
+      }
+
+      parts.back().literal += *p++;
+    }
+  }
+
+  return true;
+}
+
+void TopicBinding::render(const TopicLevels& levels, String& name) const {
+  name = "";
+
+  for (const Part& part : parts) {
+    if (part.level < 0) {
+      name += part.literal;
+    } else if (static_cast<size_t>(part.level) < levels.count) {
+      const char* level = levels.start[part.level];
+
+      for (size_t i = 0; i < levels.length[part.level]; ++i) {
+        name += level[i];
+      }
+    }
+  }
+}
@@ -0,0 +1,34 @@
+#include <Arduino.h>
+#include <TopicTrie.h>
+
+#include <vector>
+
+#ifndef _TOPIC_BINDING_H
+#define _TOPIC_BINDING_H
+
+// Builds a variable name from the levels of a topic matching a pattern.  The
+// name template can reference named tokens in the pattern.  For example, with
+// the pattern "sensors/:room/:variable_name", the template
+// ":room_:variable_name" turns the topic "sensors/kitchen/temp" into
+// "kitchen_temp".
+//
+// When one token name is a prefix of another, the longest one is used.
+class TopicBinding {
+public:
+  // Returns false if the template is empty or references a token that isn't
+  // in the pattern
+  bool compile(const String& pattern, const String& nameTemplate);
+
+  void render(const TopicLevels& levels, String& name) const;
+
+private:
+  struct Part {
+    // Index of the topic level to substitute, or -1 for a literal
+    int8_t level;
+    String literal;
+  };
+
+  std::vector<Part> parts;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include <TopicTrie.h>
+
+#include <string.h>
+
+bool TopicLevels::parse(const char* topic) {
+  const char* p = topic;
+  count = 0;
+
+  while (true) {
+    if (count == MQTT_MAX_TOPIC_LEVELS) {
+      return false;
+    }
+
+    const char* end = strchr(p, '/');
+    const size_t len = end ? (end - p) : strlen(p);
+
+    start[count] = p;
+    length[count] = len;
+    ++count;
+
+    if (end == nullptr) {
+      return true;
+    }
+
+    p = end + 1;
+  }
+}
+
+TopicTrie::TopicTrie() { }
+
+bool TopicTrie::isWildcard(const char* level, size_t length) {
+  return (length == 1 && level[0] == '+') || (length > 1 && level[0] == ':');
+}
+
+TopicTrie::Node* TopicTrie::Node::findChild(const char* level, size_t length) const {
+  for (const std::unique_ptr<Node>& child : children) {
+    if (child->level.length() == length && strncmp(child->level.c_str(), level, length) == 0) {
+      return child.get();
+    }
+  }
+
+  return nullptr;
+}
+
+bool TopicTrie::add(const String& pattern, uint16_t routeId) {
+  TopicLevels levels;
+
+  if (pattern.length() == 0 || !levels.parse(pattern.c_str())) {
+    return false;
+  }
+
+  Node* node = &root;
+
+  for (size_t i = 0; i < levels.count; ++i) {
+    const char* level = levels.start[i];
+    const size_t length = levels.length[i];
+
+    if (length == 1 && level[0] == '#') {
+      if (i != levels.count - 1) {
+        return false;
+      }
+
+      node->remainderRoutes.push_back(routeId);
+      return true;
+    } else if (isWildcard(level, length)) {
+      if (!node->wildcard) {
+        node->wildcard.reset(new Node());
+      }
+
+      node = node->wildcard.get();
+    } else {
+      Node* child = node->findChild(level, length);
+
+      if (child == nullptr) {
+        child = new Node();
+        child->level.reserve(length);
+        for (size_t j = 0; j < length; ++j) {
+          child->level += level[j];
+        }
+
+        node->children.emplace_back(child);
+      }
+
+      node = child;
+    }
+  }
+
+  node->routes.push_back(routeId);
+  return true;
+}
+
+String TopicTrie::toSubscription(const String& pattern) {
+  TopicLevels levels;
+  String subscription;
+
+  if (!levels.parse(pattern.c_str())) {
+    return pattern;
+  }
+
+  subscription.reserve(pattern.length());
+
+  for (size_t i = 0; i < levels.count; ++i) {
+    if (i > 0) {
+      subscription += '/';
+    }
+
+    if (isWildcard(levels.start[i], levels.length[i])) {
+      subscription += '+';
+    } else {
+      for (size_t j = 0; j < levels.length[i]; ++j) {
+        subscription += levels.start[i][j];
+      }
+    }
+  }
+
+  return subscription;
+}
@@ -0,0 +1,96 @@
+#include <Arduino.h>
+
+#include <memory>
+#include <vector>
+
+#ifndef _TOPIC_TRIE_H
+#define _TOPIC_TRIE_H
+
+// Topics with more levels than this never match
+#ifndef MQTT_MAX_TOPIC_LEVELS
+#define MQTT_MAX_TOPIC_LEVELS 16
+#endif
+
+// Levels of a topic being matched.  Points into the topic string, which must
+// outlive it.
+struct TopicLevels {
+  const char* start[MQTT_MAX_TOPIC_LEVELS];
+  uint16_t length[MQTT_MAX_TOPIC_LEVELS];
+  size_t count;
+
+  // Splits topic on '/'.  Returns false if it has too many levels.
+  bool parse(const char* topic);
+};
+
+// Matches topics against a set of subscription patterns in one pass.
+//
+// Pattern levels are either literals or wildcards.  A wildcard is an MQTT
+// "+" or a named token like ":variable_name", both of which match exactly
+// one level.  A trailing "#" matches any number of remaining levels.
+//
+// Each pattern is registered with a route id.  Several patterns can share an
+// id, and one topic can match several patterns.
+class TopicTrie {
+public:
+  TopicTrie();
+
+  // Returns false if pattern isn't valid (e.g., "#" before the last level)
+  bool add(const String& pattern, uint16_t routeId);
+
+  // Calls fn(uint16_t routeId, const TopicLevels& levels) for each route with
+  // a pattern matching the topic.  Nothing is allocated.
+  template <typename Fn>
+  void match(const char* topic, Fn&& fn) const {
+    TopicLevels levels;
+
+    if (levels.parse(topic)) {
+      match(root, levels, 0, fn);
+    }
+  }
+
+  // Converts a pattern to the topic filter that should be subscribed to
+  static String toSubscription(const String& pattern);
+
+  static bool isWildcard(const char* level, size_t length);
+
+private:
+  struct Node {
+    String level;
+    std::vector<std::unique_ptr<Node>> children;
+    std::unique_ptr<Node> wildcard;
+
+    // Patterns ending at this node, and ending at this node followed by "#"
+    std::vector<uint16_t> routes;
+    std::vector<uint16_t> remainderRoutes;
+
+    Node* findChild(const char* level, size_t length) const;
+  };
+
+  Node root;
+
+  template <typename Fn>
+  static void match(const Node& node, const TopicLevels& levels, size_t level, Fn& fn) {
+    for (uint16_t routeId : node.remainderRoutes) {
+      fn(routeId, levels);
+    }
+
+    if (level == levels.count) {
+      for (uint16_t routeId : node.routes) {
+        fn(routeId, levels);
+      }
+      return;
+    }
+
+    // Literal levels are tried before wildcards
+    const Node* child = node.findChild(levels.start[level], levels.length[level]);
+    if (child != nullptr) {
+      match(*child, levels, level + 1, fn);
+    }
+
+    if (node.wildcard) {
+      match(*node.wildcard, levels, level + 1, fn);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include <VariableBatchParser.h>
+
+VariableBatchParser::VariableBatchParser()
+  : parser(*this)
+  , batchBytes(0)
+  , active(false)
+{ }
+
+void VariableBatchParser::feed(const char* payload, size_t length, size_t index) {
+  if (index == 0) {
+    clear();
+    parser.reset();
+    active = true;
+  } else if (!active || index != parser.getPosition()) {
+    active = false;
+    return;
+  }
+
+  // The handler can also abandon the batch, so check both
+  active = parser.feed(payload, length) && active;
+}
+
+bool VariableBatchParser::finish() {
+  const bool valid = active && parser.finish();
+  active = false;
+
+  return valid;
+}
+
+void VariableBatchParser::clear() {
+  batch.clear();
+  batchBytes = 0;
+}
+
+void VariableBatchParser::onStartContainer(const JsonStreamPath& path, bool isArray) {
+  // Only an object makes sense at the top level
+  if (path.getDepth() == 0 && isArray) {
+    active = false;
+  }
+}
+
+void VariableBatchParser::onScalar(
+  const JsonStreamPath& path,
+  JsonStreamParser::ValueType type,
+  const char* value,
+  size_t length
+) {
+  if (!active || path.getDepth() != 1 || path[0].isArray) {
+    return;
+  }
+
+  const String& key = path[0].key;
+  batchBytes += key.length() + length;
+
+  if (parser.isValueTruncated()
+    || batchBytes > MQTT_BATCH_MAX_BYTES
+    || (batch.size() >= MQTT_BATCH_MAX_VARIABLES && batch.count(key) == 0)) {
+    // Don't hold on to a batch that won't be applied
+    clear();
+    active = false;
+    return;
+  }
+
+  if (type == JsonStreamParser::ValueType::NULL_VALUE) {
+    batch[key] = "";
+  } else {
+    batch[key] = value;
+  }
+}
@@ -0,0 +1,63 @@
+#include <Arduino.h>
+#include <JsonStreamParser.h>
+#include <VariableBatch.h>
+
+#ifndef _VARIABLE_BATCH_PARSER_H
+#define _VARIABLE_BATCH_PARSER_H
+
+// Batches with more members than this are rejected
+#ifndef MQTT_BATCH_MAX_VARIABLES
+#define MQTT_BATCH_MAX_VARIABLES 64
+#endif
+
+// Batches whose names and values add up to more bytes than this are rejected
+#ifndef MQTT_BATCH_MAX_BYTES
+#define MQTT_BATCH_MAX_BYTES 8192
+#endif
+
+// Collects the members of a JSON object (e.g., {"a":"1","b":2}) into a
+// VariableBatch as the payload arrives.  Chunks are parsed as they're
+// received, so the size of a batch isn't limited by a reassembly buffer.
+//
+// Only scalar members of the top-level object are used.  Numbers and booleans
+// are stored as their literal text, and null as an empty string.  Nested
+// objects and arrays are ignored.
+//
+// The whole batch is held in memory until it's applied, so it's limited to
+// MQTT_BATCH_MAX_VARIABLES members and MQTT_BATCH_MAX_BYTES of names and
+// values.  A batch over either limit, or with a value too long for the
+// parser's token buffer, is rejected rather than partially applied.
+class VariableBatchParser : public JsonStreamParser::Handler {
+public:
+  VariableBatchParser();
+
+  // Feeds one chunk of a message.  index is the offset of the chunk within
+  // the payload.  A chunk with index 0 starts a new batch.  Chunks that don't
+  // continue the current batch cause it to be discarded.
+  void feed(const char* payload, size_t length, size_t index);
+
+  // Call after the last chunk.  Returns true if a complete, valid object was
+  // parsed.
+  bool finish();
+
+  inline const VariableBatch& getBatch() const { return batch; }
+
+  // Releases the memory held by the current batch
+  void clear();
+
+  virtual void onScalar(
+    const JsonStreamPath& path,
+    JsonStreamParser::ValueType type,
+    const char* value,
+    size_t length
+  ) override;
+  virtual void onStartContainer(const JsonStreamPath& path, bool isArray) override;
+
+private:
+  JsonStreamParser parser;
+  VariableBatch batch;
+  size_t batchBytes;
+  bool active;
+};
+
+#endif
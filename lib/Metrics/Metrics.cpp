@@ -0,0 +1,218 @@
+#include <Metrics.h>
+
+#ifndef DISABLE_METRICS
+
+// Durations, in microseconds
+static const uint32_t CPU_BUCKETS[] = {
+  100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000
+};
+static const uint32_t PANEL_BUCKETS[] = {
+  10000, 50000, 100000, 250000, 500000, 1000000, 2000000, 4000000, 8000000,
+  15000000, 30000000
+};
+
+static const uint32_t WINDOW_COUNT_BUCKETS[] = { 0, 1, 2, 4, 8, 16, 32 };
+// Pixels
+static const uint32_t WINDOW_AREA_BUCKETS[] = {
+  100, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000
+};
+
+static const uint32_t MICROSECONDS = 1000000;
+
+#define METRIC_BUCKETS(buckets) buckets, sizeof(buckets) / sizeof(buckets[0])
+
+MetricHistogram Metrics::updateVariable(
+    "epaper_update_variable_seconds",
+    "Time spent in updateVariable, including waiting for the display lock",
+    METRIC_BUCKETS(CPU_BUCKETS),
+    MICROSECONDS);
+MetricHistogram Metrics::regionRender(
+    "epaper_region_render_seconds",
+    "Time to draw a single region into the framebuffer",
+    METRIC_BUCKETS(CPU_BUCKETS),
+    MICROSECONDS);
+MetricHistogram Metrics::flushDirtyRegions(
+    "epaper_flush_dirty_regions_seconds",
+    "Time the panel spent on partial refreshes of dirty regions",
+    METRIC_BUCKETS(PANEL_BUCKETS),
+    MICROSECONDS);
+MetricHistogram Metrics::fullUpdate(
+    "epaper_full_update_seconds",
+    "Time the panel spent on full refreshes",
+    METRIC_BUCKETS(PANEL_BUCKETS),
+    MICROSECONDS);
+MetricHistogram Metrics::refreshWindows(
+    "epaper_refresh_windows",
+    "Windows refreshed by each partial refresh",
+    METRIC_BUCKETS(WINDOW_COUNT_BUCKETS),
+    1);
+MetricHistogram Metrics::refreshWindowArea(
+    "epaper_refresh_window_area_pixels",
+    "Area of each refreshed window",
+    METRIC_BUCKETS(WINDOW_AREA_BUCKETS),
+    1);
+
+MetricCounter Metrics::kvReads(
+    "epaper_kv_reads_total", "Key lookups in KeyValueDatabase files");
+MetricCounter Metrics::kvWrites(
+    "epaper_kv_writes_total", "Keys set or erased in KeyValueDatabase files");
+MetricCounter Metrics::kvFlushes(
+    "epaper_kv_flushes_total", "Flushes of KeyValueDatabase files to SPIFFS");
+
+MetricCounter Metrics::mqttMessages(
+    "epaper_mqtt_messages_total", "MQTT messages received");
+
+MetricCounter Metrics::websocketSends(
+    "epaper_websocket_sends_total", "Frames queued to WebSocket clients");
+MetricCounter Metrics::websocketDrops(
+    "epaper_websocket_drops_total",
+    "Broadcasts a WebSocket client missed because its queue was full or the "
+    "frame couldn't be allocated");
+
+// Writes value / scale without going through floating point
+static void printScaled(Print& out, uint64_t value, uint32_t scale) {
+  char buffer[32];
+  size_t digits = 0;
+
+  for (uint32_t s = scale; s > 1; s /= 10) {
+    ++digits;
+  }
+
+  if (digits == 0) {
+    snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(value));
+  } else {
+    snprintf(buffer,
+        sizeof(buffer),
+        "%llu.%0*llu",
+        static_cast<unsigned long long>(value / scale),
+        static_cast<int>(digits),
+        static_cast<unsigned long long>(value % scale));
+  }
+
+  out.print(buffer);
+}
+
+static void printHeader(
+    Print& out, const char* name, const char* help, const char* type) {
+  out.print(F("# HELP "));
+  out.print(name);
+  out.print(' ');
+  out.println(help);
+  out.print(F("# TYPE "));
+  out.print(name);
+  out.print(' ');
+  out.println(type);
+}
+
+MetricCounter::MetricCounter(const char* name, const char* help)
+    : name(name)
+    , help(help)
+    , value(0) {}
+
+void MetricCounter::write(Print& out) const {
+  printHeader(out, name, help, "counter");
+  out.print(name);
+  out.print(' ');
+  out.println(value.load(std::memory_order_relaxed));
+}
+
+MetricHistogram::MetricHistogram(const char* name,
+    const char* help,
+    const uint32_t* bounds,
+    size_t numBounds,
+    uint32_t scale)
+    : name(name)
+    , help(help)
+    , bounds(bounds)
+    , numBounds(numBounds < METRICS_MAX_BUCKETS ? numBounds : METRICS_MAX_BUCKETS)
+    , scale(scale)
+    , sumLow(0)
+    , sumHigh(0) {
+  for (size_t i = 0; i <= METRICS_MAX_BUCKETS; ++i) {
+    buckets[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void MetricHistogram::observe(uint32_t value) {
+  size_t i = 0;
+
+  while (i < numBounds && value > bounds[i]) {
+    ++i;
+  }
+
+  buckets[i].fetch_add(1, std::memory_order_relaxed);
+
+  const uint32_t previous = sumLow.fetch_add(value, std::memory_order_relaxed);
+
+  if (static_cast<uint32_t>(previous + value) < previous) {
+    sumHigh.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void MetricHistogram::write(Print& out) const {
+  printHeader(out, name, help, "histogram");
+
+  uint32_t count = 0;
+
+  for (size_t i = 0; i <= numBounds; ++i) {
+    count += buckets[i].load(std::memory_order_relaxed);
+
+    out.print(name);
+    out.print(F("_bucket{le=\""));
+
+    if (i < numBounds) {
+      printScaled(out, bounds[i], scale);
+    } else {
+      out.print(F("+Inf"));
+    }
+
+    out.print(F("\"} "));
+    out.println(count);
+  }
+
+  const uint64_t sum =
+      (static_cast<uint64_t>(sumHigh.load(std::memory_order_relaxed)) << 32) |
+      sumLow.load(std::memory_order_relaxed);
+
+  out.print(name);
+  out.print(F("_sum "));
+  printScaled(out, sum, scale);
+  out.println();
+
+  out.print(name);
+  out.print(F("_count "));
+  out.println(count);
+}
+
+void Metrics::writePrometheus(Print& out) {
+  updateVariable.write(out);
+  regionRender.write(out);
+  flushDirtyRegions.write(out);
+  fullUpdate.write(out);
+  refreshWindows.write(out);
+  refreshWindowArea.write(out);
+
+  kvReads.write(out);
+  kvWrites.write(out);
+  kvFlushes.write(out);
+
+  mqttMessages.write(out);
+
+  websocketSends.write(out);
+  websocketDrops.write(out);
+
+  printHeader(out, "epaper_free_heap_bytes", "Free heap", "gauge");
+  out.print(F("epaper_free_heap_bytes "));
+  out.println(ESP.getFreeHeap());
+
+#if defined(ESP32)
+  printHeader(out,
+      "epaper_min_free_heap_bytes",
+      "Lowest free heap since boot",
+      "gauge");
+  out.print(F("epaper_min_free_heap_bytes "));
+  out.println(ESP.getMinFreeHeap());
+#endif
+}
+
+#endif
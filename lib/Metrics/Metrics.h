@@ -0,0 +1,115 @@
+#include <Arduino.h>
+
+#include <atomic>
+
+#pragma once
+
+// Counters and fixed-bucket histograms, served in the Prometheus text format
+// from /api/v1/metrics.
+//
+// Updates are relaxed atomic adds, so they're safe from any task and never
+// block.  Values are read one at a time when they're written out, so a scrape
+// that races with an update can be off by that update.
+//
+// Build with -D DISABLE_METRICS to compile out the metrics and everything
+// that updates them.
+
+#ifndef METRICS_MAX_BUCKETS
+#define METRICS_MAX_BUCKETS 12
+#endif
+
+#ifndef DISABLE_METRICS
+#define METRIC_INC(metric) Metrics::metric.add(1)
+#define METRIC_ADD(metric, n) Metrics::metric.add(n)
+#define METRIC_OBSERVE(metric, value) Metrics::metric.observe(value)
+// Observes the time in microseconds until the end of the enclosing scope
+#define METRIC_TIME(metric) MetricTimer _metricTimer(Metrics::metric)
+#else
+#define METRIC_INC(metric) ((void)0)
+#define METRIC_ADD(metric, n) ((void)(n))
+#define METRIC_OBSERVE(metric, value) ((void)(value))
+#define METRIC_TIME(metric) ((void)0)
+#endif
+
+#ifndef DISABLE_METRICS
+
+class MetricCounter {
+public:
+  MetricCounter(const char* name, const char* help);
+
+  inline void add(uint32_t n) { value.fetch_add(n, std::memory_order_relaxed); }
+
+  void write(Print& out) const;
+
+private:
+  const char* name;
+  const char* help;
+  std::atomic<uint32_t> value;
+};
+
+class MetricHistogram {
+public:
+  // bounds are the buckets' inclusive upper bounds, ascending.  Observed
+  // values are divided by scale when they're written out (e.g., 1000000 for
+  // microseconds reported as seconds).  scale must be a power of 10.
+  MetricHistogram(const char* name,
+      const char* help,
+      const uint32_t* bounds,
+      size_t numBounds,
+      uint32_t scale);
+
+  void observe(uint32_t value);
+
+  void write(Print& out) const;
+
+private:
+  const char* name;
+  const char* help;
+  const uint32_t* bounds;
+  const size_t numBounds;
+  const uint32_t scale;
+
+  // Not cumulative.  The last bucket is +Inf.
+  std::atomic<uint32_t> buckets[METRICS_MAX_BUCKETS + 1];
+  // 64 bit atomics aren't lock-free on the ESP32, so the sum carries into
+  // sumHigh by hand
+  std::atomic<uint32_t> sumLow;
+  std::atomic<uint32_t> sumHigh;
+};
+
+class MetricTimer {
+public:
+  explicit MetricTimer(MetricHistogram& histogram)
+      : histogram(histogram)
+      , start(micros()) {}
+
+  ~MetricTimer() { histogram.observe(micros() - start); }
+
+private:
+  MetricHistogram& histogram;
+  const uint32_t start;
+};
+
+class Metrics {
+public:
+  static MetricHistogram updateVariable;
+  static MetricHistogram regionRender;
+  static MetricHistogram flushDirtyRegions;
+  static MetricHistogram fullUpdate;
+  static MetricHistogram refreshWindows;
+  static MetricHistogram refreshWindowArea;
+
+  static MetricCounter kvReads;
+  static MetricCounter kvWrites;
+  static MetricCounter kvFlushes;
+
+  static MetricCounter mqttMessages;
+
+  static MetricCounter websocketSends;
+  static MetricCounter websocketDrops;
+
+  // Writes every metric, plus heap gauges
+  static void writePrometheus(Print& out);
+};
+
+#endif
@@ -44,4 +44,12 @@ extern "C" {
 #define EPD_DEFAULT_BUSY_PIN 7
 // Pins 34-39 don't have internal pull-up or pull-down resistors
 #define EPD_DEFAULT_SLEEP_OVERRIDE_PIN 25
+#else
+// Host builds (see test/native).  There are no pins, but settings need
+// defaults.
+#define EPD_DEFAULT_SPI_BUS HSPI
+#define EPD_DEFAULT_DC_PIN 17
+#define EPD_DEFAULT_RST_PIN 16
+#define EPD_DEFAULT_BUSY_PIN 7
+#define EPD_DEFAULT_SLEEP_OVERRIDE_PIN 25
 #endif
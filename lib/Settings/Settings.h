@@ -21,6 +21,15 @@
 #define TEMPLATES_DIRECTORY "/t"
 #endif
 
+#ifndef FONTS_DIRECTORY
+#define FONTS_DIRECTORY "/f"
+#endif
+
+// Validated copies of templates, see TemplateCache
+#ifndef COMPILED_TEMPLATES_DIRECTORY
+#define COMPILED_TEMPLATES_DIRECTORY "/c"
+#endif
+
 static const char BITMAP_METADATA_DIRECTORY[] = "/m";
 
 #define XQUOTE(x) #x
@@ -60,6 +69,8 @@ public:
   persistentStringVar(password, "");
   persistentStringVar(server, "");
   persistentStringVar(variables_topic_pattern, "");
+  persistentStringVar(variables_batch_topic, "");
+  persistentStringVar(extraction_rules, "");
   persistentStringVar(client_status_topic, "")
 
   String serverHost() const;
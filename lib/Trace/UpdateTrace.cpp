@@ -0,0 +1,223 @@
+#include <UpdateTrace.h>
+
+#include <string.h>
+
+const uint8_t UpdateTrace::MAGIC[4] = {'E', 'P', 'T', 'R'};
+const uint8_t UpdateTrace::VERSION;
+
+const char* UpdateTrace::sourceToString(UpdateSource source) {
+  switch (source) {
+    case UpdateSource::MQTT:
+      return "mqtt";
+    case UpdateSource::HTTP:
+      return "http";
+    default:
+      return "system";
+  }
+}
+
+UpdateTraceEncoder::UpdateTraceEncoder() {}
+
+void UpdateTraceEncoder::begin(std::vector<uint8_t>& out) {
+  keys.clear();
+  newKeys.clear();
+
+  out.insert(out.end(), UpdateTrace::MAGIC, UpdateTrace::MAGIC + sizeof(UpdateTrace::MAGIC));
+  out.push_back(UpdateTrace::VERSION);
+}
+
+void UpdateTraceEncoder::encode(std::vector<uint8_t>& out,
+    UpdateEventType type,
+    UpdateSource source,
+    uint32_t delay,
+    const VariableBatch& values) {
+  newKeys.clear();
+
+  out.push_back(static_cast<uint8_t>(type) | (static_cast<uint8_t>(source) << 4));
+  encodeVarint(out, delay);
+
+  if (type == UpdateEventType::VARIABLE) {
+    auto entry = values.begin();
+
+    if (entry != values.end()) {
+      encodeKey(out, entry->first);
+      encodeString(out, entry->second);
+    } else {
+      encodeKey(out, "");
+      encodeString(out, "");
+    }
+  } else if (type == UpdateEventType::BATCH) {
+    encodeVarint(out, values.size());
+
+    for (const auto& entry : values) {
+      encodeKey(out, entry.first);
+      encodeString(out, entry.second);
+    }
+  }
+}
+
+void UpdateTraceEncoder::rollback(std::vector<uint8_t>& out, size_t start) {
+  out.resize(start);
+
+  for (const String& key : newKeys) {
+    keys.erase(key);
+  }
+  newKeys.clear();
+}
+
+void UpdateTraceEncoder::encodeKey(std::vector<uint8_t>& out, const String& key) {
+  auto it = keys.find(key);
+
+  if (it != keys.end()) {
+    encodeVarint(out, it->second);
+    return;
+  }
+
+  const uint32_t id = keys.size() + 1;
+  keys[key] = id;
+  newKeys.push_back(key);
+
+  encodeVarint(out, 0);
+  encodeString(out, key);
+}
+
+void UpdateTraceEncoder::encodeString(std::vector<uint8_t>& out, const String& value) {
+  encodeVarint(out, value.length());
+  out.insert(out.end(), value.c_str(), value.c_str() + value.length());
+}
+
+void UpdateTraceEncoder::encodeVarint(std::vector<uint8_t>& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(value);
+}
+
+UpdateTraceReader::UpdateTraceReader(const uint8_t* data, size_t length)
+    : data(data)
+    , length(length)
+    , position(UpdateTrace::HEADER_SIZE)
+    , time(0)
+    , valid(length >= UpdateTrace::HEADER_SIZE
+          && memcmp(data, UpdateTrace::MAGIC, sizeof(UpdateTrace::MAGIC)) == 0
+          && data[sizeof(UpdateTrace::MAGIC)] == UpdateTrace::VERSION)
+    , truncated(false) {}
+
+bool UpdateTraceReader::isValid() const { return valid; }
+
+bool UpdateTraceReader::isTruncated() const { return truncated; }
+
+bool UpdateTraceReader::next(UpdateEvent& event) {
+  if (!valid || truncated || position >= length) {
+    return false;
+  }
+
+  // Events are only consumed once they've been read completely, so that keys
+  // from a partial one aren't remembered
+  const size_t start = position;
+  const size_t startKeys = keys.size();
+
+  const uint8_t tag = data[position++];
+  uint32_t delay;
+
+  event.type = static_cast<UpdateEventType>(tag & 0x0F);
+  event.source = static_cast<UpdateSource>(tag >> 4);
+  event.values.clear();
+
+  bool ok = readVarint(delay);
+
+  if (ok && event.type == UpdateEventType::VARIABLE) {
+    String key, value;
+    ok = readKey(key) && readString(value);
+
+    if (ok) {
+      event.values[key] = value;
+    }
+  } else if (ok && event.type == UpdateEventType::BATCH) {
+    uint32_t count;
+    ok = readVarint(count);
+
+    for (uint32_t i = 0; ok && i < count; ++i) {
+      String key, value;
+      ok = readKey(key) && readString(value);
+
+      if (ok) {
+        event.values[key] = value;
+      }
+    }
+  } else if (event.type != UpdateEventType::SUSPEND
+      && event.type != UpdateEventType::RESUME) {
+    ok = false;
+  }
+
+  if (!ok) {
+    position = start;
+    keys.resize(startKeys);
+    truncated = true;
+
+    return false;
+  }
+
+  time += delay;
+  event.time = time;
+
+  return true;
+}
+
+bool UpdateTraceReader::readVarint(uint32_t& value) {
+  value = 0;
+
+  for (uint8_t shift = 0; shift < 35 && position < length; shift += 7) {
+    const uint8_t byte = data[position++];
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool UpdateTraceReader::readString(String& value) {
+  uint32_t size;
+
+  if (!readVarint(size) || size > length - position) {
+    return false;
+  }
+
+  value = "";
+  value.reserve(size);
+
+  const size_t end = position + size;
+  while (position < end) {
+    value += static_cast<char>(data[position++]);
+  }
+
+  return true;
+}
+
+bool UpdateTraceReader::readKey(String& key) {
+  uint32_t id;
+
+  if (!readVarint(id)) {
+    return false;
+  }
+
+  if (id == 0) {
+    if (!readString(key)) {
+      return false;
+    }
+
+    keys.push_back(key);
+    return true;
+  }
+
+  if (id > keys.size()) {
+    return false;
+  }
+
+  key = keys[id - 1];
+  return true;
+}
@@ -0,0 +1,123 @@
+#include <Arduino.h>
+#include <VariableBatch.h>
+
+#include <map>
+#include <vector>
+
+#ifndef _UPDATE_TRACE_H
+#define _UPDATE_TRACE_H
+
+// A compact binary log of variable updates and when they arrived, written on
+// the device by UpdateTraceRecorder and replayed on a computer by
+// scripts/replay_trace.
+//
+// A trace starts with the 4 byte magic "EPTR" and a version byte.  Then each
+// event is:
+//
+//   tag      1 byte: the UpdateEventType in the low nibble, the UpdateSource
+//            in the high one
+//   delay    varint: milliseconds since the previous event, or since the
+//            trace started
+//   payload  VARIABLE: a key and a value
+//            BATCH: a varint count, then that many keys and values
+//            SUSPEND, RESUME: nothing
+//
+// Varints are unsigned LEB128.  A value is a varint length followed by that
+// many bytes.  A key is a varint id: 0 introduces a new key, which follows
+// like a value and gets the next id (the first is 1); anything else repeats
+// the key with that id.
+//
+// A trace can end part way through an event (e.g., the device lost power
+// while recording).  Readers stop at the last complete one.
+
+enum class UpdateEventType : uint8_t {
+  VARIABLE = 1,
+  BATCH = 2,
+  // MQTT bootstrap started or ended, see DisplayTemplateDriver::suspendRendering
+  SUSPEND = 3,
+  RESUME = 4
+};
+
+// Where an update came from.  SYSTEM is the device itself (e.g., timestamp
+// and wifi_state).
+enum class UpdateSource : uint8_t { SYSTEM = 0, MQTT = 1, HTTP = 2 };
+
+struct UpdateEvent {
+  UpdateEventType type;
+  UpdateSource source;
+  // Milliseconds since the trace started
+  uint32_t time;
+  // One entry for VARIABLE, empty for SUSPEND and RESUME
+  VariableBatch values;
+};
+
+class UpdateTrace {
+public:
+  static const uint8_t MAGIC[4];
+  static const uint8_t VERSION = 1;
+  static const size_t HEADER_SIZE = sizeof(MAGIC) + 1;
+
+  static const char* sourceToString(UpdateSource source);
+};
+
+// Appends events to a buffer.  Keys are numbered in the order they're first
+// written, so the buffers from one encoder must be read back in order.
+class UpdateTraceEncoder {
+public:
+  UpdateTraceEncoder();
+
+  // Forgets every key, and appends the header for a new trace
+  void begin(std::vector<uint8_t>& out);
+
+  // delay is in milliseconds since the previous event.  values is ignored
+  // unless type is VARIABLE (which writes the first entry) or BATCH.
+  void encode(std::vector<uint8_t>& out,
+    UpdateEventType type,
+    UpdateSource source,
+    uint32_t delay,
+    const VariableBatch& values);
+
+  // Drops the last event appended to out, which started at start, and
+  // forgets the keys it introduced
+  void rollback(std::vector<uint8_t>& out, size_t start);
+
+private:
+  std::map<String, uint32_t> keys;
+  // Keys introduced by the last event
+  std::vector<String> newKeys;
+
+  void encodeKey(std::vector<uint8_t>& out, const String& key);
+  static void encodeString(std::vector<uint8_t>& out, const String& value);
+  static void encodeVarint(std::vector<uint8_t>& out, uint32_t value);
+};
+
+// Reads events from a trace in memory
+class UpdateTraceReader {
+public:
+  UpdateTraceReader(const uint8_t* data, size_t length);
+
+  // False if the header is missing or from another version
+  bool isValid() const;
+
+  // Reads the next event.  Returns false at the end of the trace, or at an
+  // event that's cut short or malformed (see isTruncated).
+  bool next(UpdateEvent& event);
+
+  // True if reading stopped before the end of the data
+  bool isTruncated() const;
+
+private:
+  const uint8_t* data;
+  const size_t length;
+  size_t position;
+  uint32_t time;
+  bool valid;
+  bool truncated;
+  std::vector<String> keys;
+
+  bool readVarint(uint32_t& value);
+  bool readString(String& value);
+  bool readKey(String& key);
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include <UpdateTraceRecorder.h>
+
+#if defined(ESP32)
+#include <SPIFFS.h>
+#endif
+
+UpdateTraceRecorder::UpdateTraceRecorder()
+  : destination(Destination::NONE)
+  , sink(nullptr)
+  , startedAt(0)
+  , lastEventAt(0)
+  , lastFlush(0)
+  , events(0)
+  , dropped(0)
+  , bytesWritten(0)
+  , endReason(nullptr)
+{
+#if defined(ESP32)
+  mutex = xSemaphoreCreateMutex();
+
+  if (mutex == NULL) {
+    Serial.println(F("ERROR: could not create mutex"));
+  }
+#endif
+}
+
+UpdateTraceRecorder::~UpdateTraceRecorder() {
+  stop();
+
+#if defined(ESP32)
+  vSemaphoreDelete(mutex);
+#endif
+}
+
+void UpdateTraceRecorder::lock() {
+#if defined(ESP32)
+  xSemaphoreTake(mutex, portMAX_DELAY);
+#endif
+}
+
+void UpdateTraceRecorder::unlock() {
+#if defined(ESP32)
+  xSemaphoreGive(mutex);
+#endif
+}
+
+bool UpdateTraceRecorder::startFile(const String& path) {
+  lock();
+
+  end(nullptr);
+  file = SPIFFS.open(path, FILE_WRITE);
+
+  if (!file) {
+    Serial.printf_P(PSTR("UpdateTraceRecorder - ERROR: couldn't open %s\n"), path.c_str());
+    unlock();
+    return false;
+  }
+
+  Serial.printf_P(PSTR("UpdateTraceRecorder - recording to %s\n"), path.c_str());
+  begin(Destination::FILE);
+
+  unlock();
+  return true;
+}
+
+void UpdateTraceRecorder::startStream(TSinkFn sink) {
+  lock();
+
+  end(nullptr);
+  this->sink = sink;
+  begin(Destination::STREAM);
+
+  unlock();
+}
+
+void UpdateTraceRecorder::stop() {
+  lock();
+  end(nullptr);
+  unlock();
+}
+
+bool UpdateTraceRecorder::isRecording() {
+  lock();
+  const bool result = destination != Destination::NONE;
+  unlock();
+
+  return result;
+}
+
+bool UpdateTraceRecorder::isStreaming() {
+  lock();
+  const bool result = destination == Destination::STREAM;
+  unlock();
+
+  return result;
+}
+
+void UpdateTraceRecorder::recordVariable(
+    UpdateSource source, const String& key, const String& value) {
+  if (destination == Destination::NONE) {
+    return;
+  }
+
+  VariableBatch values;
+  values[key] = value;
+
+  record(UpdateEventType::VARIABLE, source, values);
+}
+
+void UpdateTraceRecorder::recordBatch(UpdateSource source, const VariableBatch& batch) {
+  record(UpdateEventType::BATCH, source, batch);
+}
+
+void UpdateTraceRecorder::recordSuspend(UpdateSource source) {
+  record(UpdateEventType::SUSPEND, source, VariableBatch());
+}
+
+void UpdateTraceRecorder::recordResume(UpdateSource source) {
+  record(UpdateEventType::RESUME, source, VariableBatch());
+}
+
+void UpdateTraceRecorder::record(
+    UpdateEventType type, UpdateSource source, const VariableBatch& values) {
+  // Unlocked check, so that not recording costs nothing.  A racing start
+  // only misses events that arrived around the same time.
+  if (destination == Destination::NONE) {
+    return;
+  }
+
+  const unsigned long now = millis();
+
+  lock();
+
+  if (destination != Destination::NONE) {
+    const size_t start = buffer.size();
+    encoder.encode(buffer, type, source, now - lastEventAt, values);
+
+    if (buffer.size() > UPDATE_TRACE_BUFFER_SIZE) {
+      // The next event's delay counts from the last one that was kept
+      encoder.rollback(buffer, start);
+      ++dropped;
+    } else {
+      lastEventAt = now;
+      ++events;
+    }
+  }
+
+  unlock();
+}
+
+void UpdateTraceRecorder::loop() {
+  if (destination == Destination::NONE) {
+    return;
+  }
+
+  lock();
+
+  if (!buffer.empty()
+      && (millis() - lastFlush >= UPDATE_TRACE_FLUSH_INTERVAL
+          || buffer.size() >= UPDATE_TRACE_BUFFER_SIZE / 2)) {
+    flush();
+  }
+
+  unlock();
+}
+
+void UpdateTraceRecorder::dumpStatus(JsonObject result) {
+  lock();
+
+  result["recording"] = destination != Destination::NONE;
+
+  if (destination != Destination::NONE) {
+    result["destination"] = destination == Destination::FILE ? "file" : "stream";
+    result["duration"] = millis() - startedAt;
+  }
+
+  result["events"] = events;
+  result["dropped"] = dropped;
+  result["bytes"] = bytesWritten + buffer.size();
+
+  if (endReason != nullptr) {
+    result["end_reason"] = endReason;
+  }
+
+  unlock();
+}
+
+void UpdateTraceRecorder::begin(Destination destination) {
+  this->destination = destination;
+
+  startedAt = millis();
+  lastEventAt = startedAt;
+  lastFlush = startedAt;
+  events = 0;
+  dropped = 0;
+  bytesWritten = 0;
+  endReason = nullptr;
+
+  buffer.clear();
+  encoder.begin(buffer);
+
+  // Streams get the header straight away, so that clients know they're
+  // connected to a trace
+  if (destination == Destination::STREAM) {
+    flush();
+  }
+}
+
+void UpdateTraceRecorder::flush() {
+  if (destination == Destination::FILE) {
+    if (bytesWritten + buffer.size() > UPDATE_TRACE_MAX_FILE_SIZE) {
+      end("full");
+      return;
+    }
+
+    if (file.write(buffer.data(), buffer.size()) != buffer.size()) {
+      end("write failed");
+      return;
+    }
+    file.flush();
+  } else if (destination == Destination::STREAM) {
+    if (!sink(buffer.data(), buffer.size())) {
+      end("stream dropped");
+      return;
+    }
+  }
+
+  bytesWritten += buffer.size();
+  buffer.clear();
+  lastFlush = millis();
+}
+
+void UpdateTraceRecorder::end(const char* reason) {
+  if (destination == Destination::NONE) {
+    return;
+  }
+
+  if (reason == nullptr && !buffer.empty()) {
+    flush();
+
+    // Flushing can fail and end the trace itself
+    if (destination == Destination::NONE) {
+      return;
+    }
+  }
+
+  if (destination == Destination::FILE) {
+    file.close();
+  }
+
+  if (reason != nullptr) {
+    Serial.printf_P(PSTR("UpdateTraceRecorder - WARN: trace ended: %s\n"), reason);
+  }
+
+  destination = Destination::NONE;
+  endReason = reason;
+  sink = nullptr;
+  buffer.clear();
+  // Free the memory for a burst
+  buffer.shrink_to_fit();
+}
@@ -0,0 +1,115 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <FS.h>
+#include <UpdateTrace.h>
+
+#include <functional>
+#include <vector>
+
+#if defined(ESP32)
+extern "C" {
+#include "freertos/semphr.h"
+}
+#endif
+
+#ifndef _UPDATE_TRACE_RECORDER_H
+#define _UPDATE_TRACE_RECORDER_H
+
+// Where traces recorded to SPIFFS are kept
+#ifndef UPDATE_TRACE_FILE
+#define UPDATE_TRACE_FILE "/trace.bin"
+#endif
+
+// Recording to a file stops once it's this large
+#ifndef UPDATE_TRACE_MAX_FILE_SIZE
+#define UPDATE_TRACE_MAX_FILE_SIZE (256 * 1024)
+#endif
+
+// Most bytes of events held between writes.  Events that don't fit are
+// dropped and counted.
+#ifndef UPDATE_TRACE_BUFFER_SIZE
+#define UPDATE_TRACE_BUFFER_SIZE 8192
+#endif
+
+// Longest events are held before they're written
+#ifndef UPDATE_TRACE_FLUSH_INTERVAL
+#define UPDATE_TRACE_FLUSH_INTERVAL 1000
+#endif
+
+// Records variable updates into an UpdateTrace, either in a SPIFFS file or
+// streamed to a callback (e.g., a WebSocket client).
+//
+// Recording only appends to a buffer, so it's safe to call from any task,
+// and never waits for SPIFFS or the network.  The buffer is written out from
+// loop(), which runs on the main loop.  The main loop can be blocked for
+// seconds by a panel refresh, which is when updates pile up, so the buffer is
+// sized for a burst rather than a steady rate.
+class UpdateTraceRecorder {
+public:
+  // Receives the trace in chunks, starting with the header.  Returns false if
+  // a chunk couldn't be sent, which ends the recording, since the rest of the
+  // trace can't be read without it.
+  typedef std::function<bool(const uint8_t* data, size_t length)> TSinkFn;
+
+  UpdateTraceRecorder();
+  ~UpdateTraceRecorder();
+
+  // Starts a new trace in path, replacing the file and any trace in progress.
+  // Returns false if the file couldn't be opened.
+  bool startFile(const String& path = UPDATE_TRACE_FILE);
+
+  // Starts a new trace sent to sink, replacing any trace in progress
+  void startStream(TSinkFn sink);
+
+  // Writes out what's buffered and ends the trace
+  void stop();
+
+  bool isRecording();
+  bool isStreaming();
+
+  void recordVariable(UpdateSource source, const String& key, const String& value);
+  void recordBatch(UpdateSource source, const VariableBatch& batch);
+  void recordSuspend(UpdateSource source);
+  void recordResume(UpdateSource source);
+
+  // Writes out buffered events every UPDATE_TRACE_FLUSH_INTERVAL, or sooner
+  // if the buffer is half full
+  void loop();
+
+  // Writes whether a trace is being recorded and how big it is
+  void dumpStatus(JsonObject result);
+
+private:
+  enum class Destination { NONE, FILE, STREAM };
+
+  UpdateTraceEncoder encoder;
+  std::vector<uint8_t> buffer;
+  Destination destination;
+  File file;
+  TSinkFn sink;
+
+  unsigned long startedAt;
+  unsigned long lastEventAt;
+  unsigned long lastFlush;
+  uint32_t events;
+  uint32_t dropped;
+  size_t bytesWritten;
+  // Why the last trace ended, if it wasn't stop()
+  const char* endReason;
+
+#if defined(ESP32)
+  SemaphoreHandle_t mutex;
+#endif
+
+  void lock();
+  void unlock();
+
+  void record(UpdateEventType type, UpdateSource source, const VariableBatch& values);
+
+  // Callers must hold the lock
+  void begin(Destination destination);
+  void flush();
+  void end(const char* reason);
+};
+
+#endif
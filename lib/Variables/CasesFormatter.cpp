@@ -1,11 +1,12 @@
 #include <VariableFormatters.h>
+#include <algorithm>
 
 CasesVariableFormatter::CasesVariableFormatter(JsonObject args) {
   JsonVariant cases = args["cases"];
 
   if (cases.is<JsonObject>()) {
     for (JsonPair kv : cases.as<JsonObject>()) {
-      this->cases[kv.key().c_str()] = kv.value().as<String>();
+      this->cases.emplace_back(kv.key().c_str(), kv.value().as<String>());
     }
   } else if (cases.is<JsonArray>()) {
     for (JsonVariant value : cases.as<JsonArray>()) {
@@ -13,25 +14,41 @@ CasesVariableFormatter::CasesVariableFormatter(JsonObject args) {
       const char* mapFrom = _value["key"].as<const char*>();
       const char* mapTo = _value["value"].as<const char*>();
 
-      this->cases[mapFrom] = mapTo;
+      this->cases.emplace_back(mapFrom, mapTo);
     }
   } else {
     Serial.println(
         F("CasesVariableFormatter: ERROR - unexpected type for \"cases\" arg"));
   }
 
+  // Sort into a flat array so lookups are a binary search.  Sort is stable, so
+  // when a key is repeated the last definition is the one that's kept.
+  std::stable_sort(this->cases.begin(),
+      this->cases.end(),
+      [](const Case& a, const Case& b) { return a.first < b.first; });
+
+  auto last = std::unique(this->cases.rbegin(),
+      this->cases.rend(),
+      [](const Case& a, const Case& b) { return a.first == b.first; });
+  this->cases.erase(this->cases.begin(), last.base());
+  this->cases.shrink_to_fit();
+
   this->defaultValue = args["default"].as<const char*>();
   this->prefix = args["prefix"].as<const char*>();
 }
 
-String CasesVariableFormatter::format(const String& value) const {
-  String result = prefix;
+void CasesVariableFormatter::formatInto(
+    const String& value, String& result) const {
+  result = prefix;
 
-  if (cases.count(value) > 0) {
-    result += cases.at(value);
+  auto it = std::lower_bound(cases.begin(),
+      cases.end(),
+      value,
+      [](const Case& c, const String& key) { return c.first < key; });
+
+  if (it != cases.end() && it->first == value) {
+    result += it->second;
   } else {
     result += defaultValue;
   }
-
-  return result;
 }
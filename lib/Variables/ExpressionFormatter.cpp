@@ -0,0 +1,370 @@
+#include <VariableFormatters.h>
+#include <math.h>
+#include <stdlib.h>
+
+static const char EXPRESSION_ARG_NAME[] = "expression";
+
+using OpCode = ExpressionVariableFormatter::OpCode;
+using Instruction = ExpressionVariableFormatter::Instruction;
+
+namespace {
+
+struct NamedFunction {
+  const char* name;
+  OpCode op;
+  uint8_t arity;
+};
+
+static const NamedFunction FUNCTIONS[] = {
+  {"abs", OpCode::ABS, 1},
+  {"floor", OpCode::FLOOR, 1},
+  {"ceil", OpCode::CEIL, 1},
+  {"round", OpCode::ROUND, 1},
+  {"sqrt", OpCode::SQRT, 1},
+  {"min", OpCode::MIN, 2},
+  {"max", OpCode::MAX, 2},
+  {"pow", OpCode::POW, 2},
+};
+
+// Recursive descent parser which emits a program in reverse polish notation.
+// Tracks the stack depth the program will need so that evaluation can use a
+// fixed-size stack, and how deeply it has recursed, so that a template can't
+// overflow the task's stack.
+//
+//   expr    := term (('+' | '-') term)*
+//   term    := unary (('*' | '/' | '%') unary)*
+//   unary   := ('-' | '+') unary | power
+//   power   := primary ('^' unary)?
+//   primary := number | 'x' | 'value' | fn '(' expr (',' expr)* ')' | '(' expr ')'
+class ExpressionCompiler {
+public:
+  ExpressionCompiler(const char* expression, std::vector<Instruction>& program)
+    : p(expression)
+    , program(program)
+    , depth(0)
+    , nesting(0)
+    , error(nullptr)
+  { }
+
+  const char* compile() {
+    parseExpr();
+    skipWhitespace();
+
+    if (!error && *p != 0) {
+      error = "unexpected trailing characters";
+    }
+
+    return error;
+  }
+
+private:
+  const char* p;
+  std::vector<Instruction>& program;
+  size_t depth;
+  size_t nesting;
+  const char* error;
+
+  void skipWhitespace() {
+    while (*p == ' ' || *p == '\t') {
+      ++p;
+    }
+  }
+
+  bool accept(char c) {
+    skipWhitespace();
+
+    if (*p == c) {
+      ++p;
+      return true;
+    }
+
+    return false;
+  }
+
+  void emit(OpCode op, float operand = 0) {
+    switch (op) {
+      case OpCode::PUSH_CONST:
+      case OpCode::PUSH_VALUE:
+        if (++depth > ExpressionVariableFormatter::MAX_STACK_DEPTH) {
+          error = "expression is nested too deeply";
+        }
+        break;
+      case OpCode::ADD:
+      case OpCode::SUB:
+      case OpCode::MUL:
+      case OpCode::DIV:
+      case OpCode::MOD:
+      case OpCode::POW:
+      case OpCode::MIN:
+      case OpCode::MAX:
+        --depth;
+        break;
+      default:
+        break;
+    }
+
+    program.push_back({op, operand});
+  }
+
+  void parseExpr() {
+    parseTerm();
+
+    while (!error) {
+      if (accept('+')) {
+        parseTerm();
+        emit(OpCode::ADD);
+      } else if (accept('-')) {
+        parseTerm();
+        emit(OpCode::SUB);
+      } else {
+        break;
+      }
+    }
+  }
+
+  void parseTerm() {
+    parseUnary();
+
+    while (!error) {
+      if (accept('*')) {
+        parseUnary();
+        emit(OpCode::MUL);
+      } else if (accept('/')) {
+        parseUnary();
+        emit(OpCode::DIV);
+      } else if (accept('%')) {
+        parseUnary();
+        emit(OpCode::MOD);
+      } else {
+        break;
+      }
+    }
+  }
+
+  // Every cycle in the grammar passes through here
+  void parseUnary() {
+    if (++nesting > ExpressionVariableFormatter::MAX_NESTING_DEPTH) {
+      error = "expression is nested too deeply";
+    } else if (accept('-')) {
+      parseUnary();
+      emit(OpCode::NEG);
+    } else if (accept('+')) {
+      parseUnary();
+    } else {
+      parsePower();
+    }
+
+    --nesting;
+  }
+
+  void parsePower() {
+    parsePrimary();
+
+    if (!error && accept('^')) {
+      parseUnary();
+      emit(OpCode::POW);
+    }
+  }
+
+  void parsePrimary() {
+    if (error) {
+      return;
+    }
+
+    skipWhitespace();
+
+    if (accept('(')) {
+      parseExpr();
+
+      if (!error && !accept(')')) {
+        error = "expected `)'";
+      }
+    } else if (isdigit(static_cast<unsigned char>(*p)) || *p == '.') {
+      char* end;
+      float constant = strtof(p, &end);
+
+      if (end == p) {
+        error = "invalid number";
+      } else {
+        p = end;
+        emit(OpCode::PUSH_CONST, constant);
+      }
+    } else if (isalpha(static_cast<unsigned char>(*p))) {
+      const char* start = p;
+      while (isalnum(static_cast<unsigned char>(*p)) || *p == '_') {
+        ++p;
+      }
+      parseIdentifier(start, p - start);
+    } else if (*p == 0) {
+      error = "unexpected end of expression";
+    } else {
+      error = "unexpected character";
+    }
+  }
+
+  void parseIdentifier(const char* name, size_t length) {
+    if ((length == 1 && name[0] == 'x') ||
+        (length == 5 && strncmp(name, "value", 5) == 0)) {
+      emit(OpCode::PUSH_VALUE);
+      return;
+    }
+
+    for (const NamedFunction& fn : FUNCTIONS) {
+      if (strlen(fn.name) == length && strncmp(fn.name, name, length) == 0) {
+        if (!accept('(')) {
+          error = "expected `(' after function name";
+          return;
+        }
+
+        for (uint8_t i = 0; i < fn.arity && !error; ++i) {
+          if (i > 0 && !accept(',')) {
+            error = "too few function arguments";
+            return;
+          }
+          parseExpr();
+        }
+
+        if (!error && !accept(')')) {
+          error = "expected `)' after function arguments";
+          return;
+        }
+
+        emit(fn.op);
+        return;
+      }
+    }
+
+    error = "unknown identifier";
+  }
+};
+
+}
+
+ExpressionVariableFormatter::ExpressionVariableFormatter(
+    std::vector<Instruction>&& program,
+    std::shared_ptr<const VariableFormatter> outputFormatter)
+    : program(std::move(program))
+    , outputFormatter(outputFormatter) {}
+
+std::shared_ptr<const ExpressionVariableFormatter>
+ExpressionVariableFormatter::build(
+    JsonObject args, std::shared_ptr<const VariableFormatter> outputFormatter) {
+  const char* expression = args[EXPRESSION_ARG_NAME];
+
+  if (expression == nullptr) {
+    Serial.println(
+        F("ExpressionVariableFormatter: ERROR - missing \"expression\" arg"));
+    return nullptr;
+  }
+
+  std::vector<Instruction> program;
+  const char* error = compile(expression, program);
+
+  if (error != nullptr) {
+    Serial.printf_P(
+        PSTR("ExpressionVariableFormatter: ERROR - %s in expression `%s'\n"),
+        error,
+        expression);
+    return nullptr;
+  }
+
+  program.shrink_to_fit();
+
+  return std::shared_ptr<const ExpressionVariableFormatter>(
+      new ExpressionVariableFormatter(std::move(program), outputFormatter));
+}
+
+const char* ExpressionVariableFormatter::compile(
+    const char* expression, std::vector<Instruction>& program) {
+  program.clear();
+  return ExpressionCompiler(expression, program).compile();
+}
+
+float ExpressionVariableFormatter::evaluate(float x) const {
+  float stack[MAX_STACK_DEPTH];
+  size_t sp = 0;
+
+  for (const Instruction& instruction : program) {
+    switch (instruction.op) {
+      case OpCode::PUSH_CONST:
+        stack[sp++] = instruction.operand;
+        break;
+      case OpCode::PUSH_VALUE:
+        stack[sp++] = x;
+        break;
+      case OpCode::ADD:
+        --sp;
+        stack[sp - 1] += stack[sp];
+        break;
+      case OpCode::SUB:
+        --sp;
+        stack[sp - 1] -= stack[sp];
+        break;
+      case OpCode::MUL:
+        --sp;
+        stack[sp - 1] *= stack[sp];
+        break;
+      case OpCode::DIV:
+        --sp;
+        stack[sp - 1] /= stack[sp];
+        break;
+      case OpCode::MOD:
+        --sp;
+        stack[sp - 1] = fmodf(stack[sp - 1], stack[sp]);
+        break;
+      case OpCode::POW:
+        --sp;
+        stack[sp - 1] = powf(stack[sp - 1], stack[sp]);
+        break;
+      case OpCode::MIN:
+        --sp;
+        stack[sp - 1] = fminf(stack[sp - 1], stack[sp]);
+        break;
+      case OpCode::MAX:
+        --sp;
+        stack[sp - 1] = fmaxf(stack[sp - 1], stack[sp]);
+        break;
+      case OpCode::NEG:
+        stack[sp - 1] = -stack[sp - 1];
+        break;
+      case OpCode::ABS:
+        stack[sp - 1] = fabsf(stack[sp - 1]);
+        break;
+      case OpCode::FLOOR:
+        stack[sp - 1] = floorf(stack[sp - 1]);
+        break;
+      case OpCode::CEIL:
+        stack[sp - 1] = ceilf(stack[sp - 1]);
+        break;
+      case OpCode::ROUND:
+        stack[sp - 1] = roundf(stack[sp - 1]);
+        break;
+      case OpCode::SQRT:
+        stack[sp - 1] = sqrtf(stack[sp - 1]);
+        break;
+    }
+  }
+
+  return sp == 1 ? stack[0] : NAN;
+}
+
+void ExpressionVariableFormatter::formatInto(
+    const String& value, String& result) const {
+  const char* str = value.c_str();
+  char* end;
+  float x = strtof(str, &end);
+
+  // Non-numeric inputs evaluate to NaN rather than silently becoming 0
+  float evaluated = (end == str) ? NAN : evaluate(x);
+
+  // Floats carry about 7 significant digits.  Printing more than that shows
+  // representation noise (e.g., 70.699997).
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.7g", evaluated);
+
+  if (outputFormatter) {
+    outputFormatter->formatInto(buffer, result);
+  } else {
+    result = buffer;
+  }
+}
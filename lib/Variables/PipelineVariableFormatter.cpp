@@ -0,0 +1,30 @@
+#include <VariableFormatters.h>
+
+PipelineVariableFormatter::PipelineVariableFormatter(
+    std::vector<std::shared_ptr<const VariableFormatter>> formatters)
+    : stages(std::move(formatters)) {}
+
+void PipelineVariableFormatter::formatInto(
+    const String& value, String& result) const {
+  String scratch;
+  formatIntoWithScratch(value, result, scratch);
+}
+
+void PipelineVariableFormatter::formatIntoWithScratch(
+    const String& value, String& result, String& scratch) const {
+  if (stages.empty()) {
+    result = value;
+    return;
+  }
+
+  // Stages alternate between scratch and result, starting with whichever one
+  // leaves the last stage writing into result.  A stage never writes into its
+  // own input.
+  const String* input = &value;
+
+  for (size_t i = 0; i < stages.size(); ++i) {
+    String& output = (stages.size() - i) % 2 == 1 ? result : scratch;
+    stages[i]->formatInto(*input, output);
+    input = &output;
+  }
+}
@@ -1,39 +1,411 @@
 #include <VariableFormatters.h>
 #include <ArduinoJson.h>
+#include <math.h>
 
 static const char FORMAT_ARG_NAME[] = "format";
+static const char DEFAULT_FORMAT[] = "%d";
 
-PrintfFormatterNumeric::PrintfFormatterNumeric(const String& formatSchema)
-  : formatSchema(formatSchema)
+static const uint64_t POWERS_OF_TEN[] = {
+  1ULL,
+  10ULL,
+  100ULL,
+  1000ULL,
+  10000ULL,
+  100000ULL,
+  1000000ULL,
+  10000000ULL,
+  100000000ULL,
+  1000000000ULL
+};
+
+// Past this (2^52), doubles can't hold a fractional part, so a scaled value
+// can't be rounded exactly.
+static const double MAX_FIXED_POINT_VALUE = 4503599627370496.0;
+
+// Computes a * b as p + e exactly, where p is the rounded product (Dekker's
+// algorithm).  fma() would do, but newlib's isn't fused.
+static void exactProduct(double a, double b, double& p, double& e) {
+  // 2^27 + 1, splits a double into two halves of 26 bits
+  const double SPLIT = 134217729.0;
+
+  p = a * b;
+
+  double t = SPLIT * a;
+  const double aHigh = t - (t - a);
+  const double aLow = a - aHigh;
+
+  t = SPLIT * b;
+  const double bHigh = t - (t - b);
+  const double bLow = b - bHigh;
+
+  e = ((aHigh * bHigh - p) + aHigh * bLow + aLow * bHigh) + aLow * bLow;
+}
+
+// Rounds value * 10^precision to an integer the way printf does: to nearest,
+// with exact ties to even.  value * 10^precision must be below
+// MAX_FIXED_POINT_VALUE.
+static uint64_t roundScaled(double value, uint8_t precision) {
+  double scaled, error;
+  exactProduct(value, POWERS_OF_TEN[precision], scaled, error);
+
+  const double whole = floor(scaled);
+  uint64_t result = static_cast<uint64_t>(whole);
+
+  // The exact fraction is (scaled - whole) + error.  Both subtractions are
+  // exact, so this compares it with 0.5 without rounding.
+  const double fromHalf = (scaled - whole) - 0.5;
+
+  if (fromHalf > -error || (fromHalf == -error && (result & 1))) {
+    ++result;
+  }
+
+  return result;
+}
+
+// Writes the digits of value backwards, ending at end.  Returns a pointer to
+// the first digit.
+static char* writeDigits(
+    uint64_t value, uint8_t base, bool uppercase, size_t minDigits, char* end) {
+  const char* digits = uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+  char* p = end;
+
+  while (value > 0) {
+    *--p = digits[value % base];
+    value /= base;
+  }
+
+  while (static_cast<size_t>(end - p) < minDigits) {
+    *--p = '0';
+  }
+
+  return p;
+}
+
+PrintfFormatterNumeric::PrintfFormatterNumeric(const Spec& spec)
+  : spec(spec)
 { }
 
 std::shared_ptr<const PrintfFormatterNumeric> PrintfFormatterNumeric::build(JsonObject args) {
-  String formatSchema;
+  const char* format = DEFAULT_FORMAT;
 
   if (args.containsKey(FORMAT_ARG_NAME)) {
-    formatSchema = args[FORMAT_ARG_NAME].as<const char*>();
-    // In case someone does a schema that can crash the ESP
-    formatSchema.replace("%s", "ERR");
-    // Replacing the double percent in case the user needs a percent sign in the output
-    // Replacing it with a (hopefully) impossible character should make sure that it doesn't get un-replaced by anything that is needed.
-    // \a is the bell/ding that can flash your console/cause it to make a sound.
-    formatSchema.replace("%%", "\a");
-    // This makes sure that if they add more than one formatter, it will only use the first and only argument.
-    formatSchema.replace("%", "%1$");
-    // Undoing the first replace so the escaped percent can be printed
-    formatSchema.replace("\a", "%%");
-  } else {
-    formatSchema = "%1$d";
-  }
-
-  return std::shared_ptr<const PrintfFormatterNumeric>(new PrintfFormatterNumeric(formatSchema));
+    format = args[FORMAT_ARG_NAME].as<const char*>();
+  }
+
+  Spec spec;
+  const char* error = parse(format, spec);
+
+  if (error != nullptr) {
+    Serial.printf_P(
+        PSTR("PrintfFormatterNumeric: ERROR - %s in format `%s'\n"),
+        error,
+        format);
+    return nullptr;
+  }
+
+  return std::shared_ptr<const PrintfFormatterNumeric>(new PrintfFormatterNumeric(spec));
 }
 
-String PrintfFormatterNumeric::format(const String &value) const {
-  int numericValue = value.toInt();
+const char* PrintfFormatterNumeric::parse(const char* format, Spec& spec) {
+  spec = Spec();
+  String* literal = &spec.prefix;
+
+  if (format == nullptr) {
+    return "missing format";
+  }
+
+  for (const char* p = format; *p != 0; ++p) {
+    if (*p != '%') {
+      *literal += *p;
+      continue;
+    }
+
+    ++p;
+
+    if (*p == '%') {
+      *literal += '%';
+      continue;
+    }
+
+    if (spec.conversion != 0) {
+      return "only one conversion is allowed";
+    }
+
+    // Positional argument.  Only the first (and only) argument makes sense.
+    const char* q = p;
+    while (isdigit(static_cast<unsigned char>(*q))) {
+      ++q;
+    }
+    if (*q == '$') {
+      if (q - p != 1 || *p != '1') {
+        return "positional arguments other than 1$ are not supported";
+      }
+      p = q + 1;
+    }
+
+    for (;; ++p) {
+      if (*p == '-') {
+        spec.leftAlign = true;
+      } else if (*p == '+') {
+        spec.forceSign = true;
+      } else if (*p == ' ') {
+        spec.spaceSign = true;
+      } else if (*p == '0') {
+        spec.zeroPad = true;
+      } else if (*p == '#') {
+        spec.alternate = true;
+      } else {
+        break;
+      }
+    }
+
+    if (*p == '*') {
+      return "variable width is not supported";
+    }
+
+    uint16_t width = 0;
+    while (isdigit(static_cast<unsigned char>(*p))) {
+      width = width * 10 + (*p++ - '0');
+
+      if (width > MAX_WIDTH) {
+        return "width is too large";
+      }
+    }
+    spec.width = width;
+
+    if (*p == '.') {
+      ++p;
+
+      if (*p == '*') {
+        return "variable precision is not supported";
+      }
+
+      uint16_t precision = 0;
+      while (isdigit(static_cast<unsigned char>(*p))) {
+        precision = precision * 10 + (*p++ - '0');
+
+        if (precision > MAX_PRECISION) {
+          return "precision is too large";
+        }
+      }
+      spec.precision = precision;
+    }
+
+    // Length modifiers don't mean anything here since the value is parsed from
+    // a string, but allow them so that existing formats keep working.
+    while (*p == 'h' || *p == 'l' || *p == 'L') {
+      ++p;
+    }
+
+    switch (*p) {
+      case 'd':
+      case 'i':
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'o':
+      case 'f':
+      case 'F':
+        spec.conversion = *p;
+        literal = &spec.suffix;
+        break;
+      case 0:
+        return "incomplete conversion";
+      default:
+        return "unsupported conversion";
+    }
+  }
+
+  return nullptr;
+}
+
+void PrintfFormatterNumeric::formatLargeInto(
+    double value, uint8_t precision, String& result) const {
+  char format[16];
+  char* f = format;
+
+  *f++ = '%';
+  if (spec.leftAlign) {
+    *f++ = '-';
+  }
+  if (spec.forceSign) {
+    *f++ = '+';
+  }
+  if (spec.spaceSign) {
+    *f++ = ' ';
+  }
+  if (spec.zeroPad) {
+    *f++ = '0';
+  }
+  if (spec.alternate) {
+    *f++ = '#';
+  }
+  strcpy(f, "*.*f");
+
+  // Up to 309 integer digits, so size the buffer for the value
+  const int length = snprintf(nullptr, 0, format, spec.width, precision, value);
+
+  if (length < 0) {
+    return;
+  }
+
+  std::unique_ptr<char[]> buffer(new char[length + 1]);
+  snprintf(buffer.get(), length + 1, format, spec.width, precision, value);
+
+  result += buffer.get();
+}
+
+void PrintfFormatterNumeric::formatInto(
+    const String& value, String& result) const {
+  result = spec.prefix;
+
+  if (spec.conversion == 0) {
+    return;
+  }
+
+  // Large enough for a maximum-width field
+  char buffer[MAX_WIDTH + 48];
+  char* end = buffer + sizeof(buffer);
+  char* digits = end;
+  char sign = 0;
+  const char* radixPrefix = "";
+  bool zeroPaddable = spec.zeroPad && !spec.leftAlign;
+
+  switch (spec.conversion) {
+    case 'd':
+    case 'i': {
+      long numericValue = value.toInt();
+      uint64_t magnitude = numericValue < 0
+          ? -static_cast<int64_t>(numericValue)
+          : numericValue;
+
+      if (numericValue < 0) {
+        sign = '-';
+      } else if (spec.forceSign) {
+        sign = '+';
+      } else if (spec.spaceSign) {
+        sign = ' ';
+      }
+
+      digits = writeDigits(magnitude, 10, false, spec.precision < 0 ? 1 : spec.precision, end);
+      zeroPaddable = zeroPaddable && spec.precision < 0;
+      break;
+    }
+
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o': {
+      uint32_t numericValue = static_cast<uint32_t>(value.toInt());
+      uint8_t base = spec.conversion == 'o' ? 8 : (spec.conversion == 'u' ? 10 : 16);
+
+      digits = writeDigits(numericValue,
+          base,
+          spec.conversion == 'X',
+          spec.precision < 0 ? 1 : spec.precision,
+          end);
+
+      if (spec.alternate && numericValue != 0) {
+        if (spec.conversion == 'x') {
+          radixPrefix = "0x";
+        } else if (spec.conversion == 'X') {
+          radixPrefix = "0X";
+        } else if (spec.conversion == 'o' && *digits != '0') {
+          *--digits = '0';
+        }
+      }
+
+      zeroPaddable = zeroPaddable && spec.precision < 0;
+      break;
+    }
+
+    case 'f':
+    case 'F': {
+      const char* str = value.c_str();
+      char* parseEnd;
+      double numericValue = strtod(str, &parseEnd);
+      uint8_t precision = spec.precision < 0 ? 6 : spec.precision;
+      bool uppercase = spec.conversion == 'F';
+
+      if (parseEnd == str) {
+        numericValue = 0;
+      }
+
+      if (signbit(numericValue)) {
+        sign = '-';
+      } else if (spec.forceSign) {
+        sign = '+';
+      } else if (spec.spaceSign) {
+        sign = ' ';
+      }
+
+      double magnitude = fabs(numericValue);
+
+      if (isnan(magnitude) || isinf(magnitude)) {
+        const char* text = isnan(magnitude)
+            ? (uppercase ? "NAN" : "nan")
+            : (uppercase ? "INF" : "inf");
+        digits = end - strlen(text);
+        memcpy(digits, text, strlen(text));
+        zeroPaddable = false;
+      } else if (magnitude * POWERS_OF_TEN[precision] < MAX_FIXED_POINT_VALUE) {
+        uint64_t fixed = roundScaled(magnitude, precision);
+        uint64_t scale = POWERS_OF_TEN[precision];
+
+        digits = end;
+        if (precision > 0) {
+          digits = writeDigits(fixed % scale, 10, false, precision, digits);
+          *--digits = '.';
+        } else if (spec.alternate) {
+          *--digits = '.';
+        }
+        digits = writeDigits(fixed / scale, 10, false, 1, digits);
+      } else {
+        // Too large for the fixed point path.  This is rare enough that it's
+        // fine to let libc deal with it, padding and all.
+        formatLargeInto(numericValue, precision, result);
+        result += spec.suffix;
+        return;
+      }
+
+      break;
+    }
+  }
+
+  size_t length = (end - digits) + strlen(radixPrefix) + (sign ? 1 : 0);
+  size_t padding = spec.width > length ? spec.width - length : 0;
+
+  char* out = buffer;
+
+  if (!spec.leftAlign && !zeroPaddable) {
+    memset(out, ' ', padding);
+    out += padding;
+  }
+
+  if (sign) {
+    *out++ = sign;
+  }
+
+  size_t prefixLength = strlen(radixPrefix);
+  memcpy(out, radixPrefix, prefixLength);
+  out += prefixLength;
+
+  if (zeroPaddable) {
+    memset(out, '0', padding);
+    out += padding;
+  }
+
+  // Digits were written at the end of the same buffer, so this might overlap
+  memmove(out, digits, end - digits);
+  out += (end - digits);
+
+  if (spec.leftAlign) {
+    memset(out, ' ', padding);
+    out += padding;
+  }
 
-  char buffer[120];
-  snprintf(buffer, sizeof(buffer), formatSchema.c_str(), numericValue);
+  *out = 0;
 
-  return buffer;
+  result += buffer;
+  result += spec.suffix;
 }
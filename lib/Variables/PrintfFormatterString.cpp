@@ -26,9 +26,10 @@ std::shared_ptr<const PrintfFormatterString> PrintfFormatterString::build(JsonOb
   return std::shared_ptr<const PrintfFormatterString>(new PrintfFormatterString(formatSchema));
 }
 
-String PrintfFormatterString::format(const String &value) const {
+void PrintfFormatterString::formatInto(
+    const String& value, String& result) const {
   char buffer[120];
   snprintf(buffer, sizeof(buffer), formatSchema.c_str(), value.c_str());
 
-  return buffer;
+  result = buffer;
 }
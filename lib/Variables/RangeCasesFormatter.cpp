@@ -0,0 +1,61 @@
+#include <VariableFormatters.h>
+#include <algorithm>
+#include <math.h>
+
+RangeCasesVariableFormatter::RangeCasesVariableFormatter(JsonObject args) {
+  JsonVariant ranges = args["ranges"];
+  std::vector<std::pair<float, String>> bands;
+
+  if (ranges.is<JsonObject>()) {
+    for (JsonPair kv : ranges.as<JsonObject>()) {
+      bands.emplace_back(atof(kv.key().c_str()), kv.value().as<String>());
+    }
+  } else if (ranges.is<JsonArray>()) {
+    for (JsonObject range : ranges.as<JsonArray>()) {
+      bands.emplace_back(range["min"].as<float>(), range["value"].as<String>());
+    }
+  } else {
+    Serial.println(F(
+        "RangeCasesVariableFormatter: ERROR - unexpected type for \"ranges\" arg"));
+  }
+
+  std::stable_sort(bands.begin(),
+      bands.end(),
+      [](const std::pair<float, String>& a, const std::pair<float, String>& b) {
+        return a.first < b.first;
+      });
+
+  thresholds.reserve(bands.size());
+  values.reserve(bands.size());
+
+  for (auto& band : bands) {
+    thresholds.push_back(band.first);
+    values.push_back(band.second);
+  }
+
+  this->defaultValue = args["default"].as<const char*>();
+  this->prefix = args["prefix"].as<const char*>();
+}
+
+void RangeCasesVariableFormatter::formatInto(
+    const String& value, String& result) const {
+  result = prefix;
+
+  const char* str = value.c_str();
+  char* end;
+  float x = strtof(str, &end);
+
+  // First threshold strictly greater than x.  The band we want is the one
+  // before it.
+  size_t band = 0;
+  if (end != str && !isnan(x)) {
+    band = std::upper_bound(thresholds.begin(), thresholds.end(), x) -
+        thresholds.begin();
+  }
+
+  if (band > 0) {
+    result += values[band - 1];
+  } else {
+    result += defaultValue;
+  }
+}
@@ -3,11 +3,12 @@
 RatioVariableFormatter::RatioVariableFormatter(float baseValue)
     : baseValue(baseValue) {}
 
-String RatioVariableFormatter::format(const String& value) const {
+void RatioVariableFormatter::formatInto(
+    const String& value, String& result) const {
   if (baseValue == 0.0) {
-    return "0";
+    result = "0";
   } else {
     float fValue = value.toFloat();
-    return String(fValue/baseValue);
+    result = String(fValue/baseValue);
   }
 }
\ No newline at end of file
@@ -4,11 +4,12 @@ RoundingVariableFormatter::RoundingVariableFormatter(uint8_t digits)
   : digits(digits)
 { }
 
-String RoundingVariableFormatter::format(const String& value) const {
+void RoundingVariableFormatter::formatInto(
+    const String& value, String& result) const {
   char format[20];
   sprintf(format, "%%.%df", digits);
-  char formattedValue[value.length() + 1];
-  sprintf(formattedValue, format, value.toFloat());
+  char formattedValue[40];
+  snprintf(formattedValue, sizeof(formattedValue), format, value.toFloat());
 
-  return formattedValue;
+  result = formattedValue;
 }
\ No newline at end of file
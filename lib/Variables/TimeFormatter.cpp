@@ -27,7 +27,8 @@ std::shared_ptr<const TimeVariableFormatter> TimeVariableFormatter::build(JsonOb
   return std::shared_ptr<const TimeVariableFormatter>(new TimeVariableFormatter(timeFormat, tz));
 }
 
-String TimeVariableFormatter::format(const String &value) const {
+void TimeVariableFormatter::formatInto(
+    const String& value, String& result) const {
   time_t parsedTime = value.toInt();
   parsedTime = timezone.toLocal(parsedTime);
 
@@ -37,5 +38,5 @@ String TimeVariableFormatter::format(const String &value) const {
 
   strftime(buffer, sizeof(buffer), timeFormat.c_str(), tminfo);
 
-  return buffer;
+  result = buffer;
 }
@@ -0,0 +1,11 @@
+#include <Arduino.h>
+#include <map>
+
+#ifndef VARIABLE_BATCH
+#define VARIABLE_BATCH
+
+// A set of variable updates that should be applied together.  If a variable
+// appears more than once, the last value wins.
+typedef std::map<String, String> VariableBatch;
+
+#endif
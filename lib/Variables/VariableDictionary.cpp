@@ -9,40 +9,100 @@ static const size_t MAX_VALUE_SIZE = 255;
 static const char DEFAULT_VALUE[] = "";
 const char VariableDictionary::FILENAME[] = "/variables.db";
 
-VariableDictionary::VariableDictionary()
-{ }
+VariableDictionary::VariableDictionary() {
+#if defined(ESP32)
+  mutex = xSemaphoreCreateMutex();
+
+  if (mutex == NULL) {
+    Serial.println(F("ERROR: could not create mutex"));
+  }
+#endif
+}
+
+void VariableDictionary::lock() {
+#if defined(ESP32)
+  xSemaphoreTake(mutex, portMAX_DELAY);
+#endif
+}
+
+void VariableDictionary::unlock() {
+#if defined(ESP32)
+  xSemaphoreGive(mutex);
+#endif
+}
 
 void VariableDictionary::set(const String& key, const String& value) {
+  lock();
+
   if (TRANSIENT_VARIABLES.find(key) != TRANSIENT_VARIABLES.end()) {
     transientVariables[key] = value;
   } else {
-    db.set(key.c_str(), key.length(), value.c_str(), value.length());
+    // Values are stored in a single-byte length column, and get() needs room
+    // for a null terminator.
+    size_t length = value.length();
+
+    if (length >= MAX_VALUE_SIZE) {
+      Serial.printf_P(
+        PSTR("VariableDictionary: WARN - truncating %u byte value for %s\n"),
+        length,
+        key.c_str()
+      );
+      length = MAX_VALUE_SIZE - 1;
+    }
+
+    db.set(key.c_str(), key.length(), value.c_str(), length);
   }
+
+  unlock();
 }
 
 void VariableDictionary::erase(const String &key) {
+  lock();
   db.erase(key.c_str(), key.length());
+  unlock();
 }
 
 String VariableDictionary::get(const String &key) {
   char valueBuffer[MAX_VALUE_SIZE];
+  String value = DEFAULT_VALUE;
+
+  lock();
+
   auto tvLookup = transientVariables.find(key);
 
   if (tvLookup != transientVariables.end()) {
-    return tvLookup->second;
+    value = tvLookup->second;
   } else if (db.get(key.c_str(), key.length(), valueBuffer, MAX_VALUE_SIZE)) {
-    return valueBuffer;
-  } else {
-    return DEFAULT_VALUE;
+    value = valueBuffer;
   }
+
+  unlock();
+
+  return value;
+}
+
+void VariableDictionary::beginBatch() {
+  lock();
+  db.beginBatch();
+  unlock();
+}
+
+void VariableDictionary::endBatch() {
+  lock();
+  db.endBatch();
+  unlock();
 }
 
 void VariableDictionary::clear() {
+  lock();
+
   SPIFFS.remove(VariableDictionary::FILENAME);
   SPIFFS.open(VariableDictionary::FILENAME, "w").close();
 
   db.open(SPIFFS.open(VariableDictionary::FILENAME, "r+"));
   db.initialize();
+
+  unlock();
 }
 
 void VariableDictionary::loop() {
@@ -52,11 +112,15 @@ void VariableDictionary::load() {
   // Create the database if it doesn't exist.
   // We specifically need r+ mode to enable both random reads and random writes.
   // r+ fails if the file doesn't already exist.
+  lock();
+
   if (! SPIFFS.exists(VariableDictionary::FILENAME)) {
     SPIFFS.open(VariableDictionary::FILENAME, "w").close();
   }
 
   db.open(SPIFFS.open(VariableDictionary::FILENAME, "r+"));
+
+  unlock();
 }
 
 void VariableDictionary::save() {
@@ -4,9 +4,17 @@
 #include <map>
 #include <set>
 
+#if defined(ESP32)
+extern "C" {
+#include "freertos/semphr.h"
+}
+#endif
+
 #ifndef VARIABLE_DICTIONARY
 #define VARIABLE_DICTIONARY
 
+// Each call holds a lock of its own for as long as it takes, so values can be
+// read from a different task than the one updating them.
 class VariableDictionary {
 public:
   static const char FILENAME[];
@@ -19,6 +27,10 @@ public:
   void erase(const String& key);
   void clear();
 
+  // Writes between these calls are persisted with a single flush
+  void beginBatch();
+  void endBatch();
+
   void save();
   void load();
   void loop();
@@ -26,6 +38,13 @@ public:
 private:
   KeyValueDatabase db;
 
+#if defined(ESP32)
+  SemaphoreHandle_t mutex;
+#endif
+
+  void lock();
+  void unlock();
+
   static const std::set<String> TRANSIENT_VARIABLES;
   std::map<String, String> transientVariables;
 };
@@ -25,12 +25,12 @@ VariableFormatterFactory::VariableFormatterFactory(
 }
 
 std::shared_ptr<const VariableFormatter> VariableFormatterFactory::create(
-    JsonObject spec) {
+    JsonObject spec) const {
   return _createInternal(spec, true);
 }
 
 std::shared_ptr<const VariableFormatter> VariableFormatterFactory::getReference(
-    String refKey, bool allowReference) {
+    String refKey, bool allowReference) const {
   if (!allowReference) {
     Serial.println(
         F("WARNING: Tried to reference a formatter when references were "
@@ -38,8 +38,10 @@ std::shared_ptr<const VariableFormatter> VariableFormatterFactory::getReference(
     return defaultFormatter;
   }
 
-  if (refFormatters.count(refKey) > 0) {
-    return refFormatters[refKey];
+  auto ref = refFormatters.find(refKey);
+
+  if (ref != refFormatters.end()) {
+    return ref->second;
   } else {
     Serial.printf_P(PSTR("WARNING: undefined reference to formatter `%s'\n"),
         refKey.c_str());
@@ -49,7 +51,7 @@ std::shared_ptr<const VariableFormatter> VariableFormatterFactory::getReference(
 
 std::shared_ptr<const VariableFormatter>
 VariableFormatterFactory::_createInternal(
-    JsonObject spec, bool allowReference) {
+    JsonObject spec, bool allowReference) const {
   JsonVariant formatterSpec = spec;
 
   if (formatterSpec.containsKey("formatter")) {
@@ -86,6 +88,8 @@ VariableFormatterFactory::_createInternal(
     return TimeVariableFormatter::build(formatterArgs);
   } else if (formatterDef.equalsIgnoreCase("cases")) {
     return std::make_shared<CasesVariableFormatter>(formatterArgs);
+  } else if (formatterDef.equalsIgnoreCase("range_cases")) {
+    return std::make_shared<RangeCasesVariableFormatter>(formatterArgs);
   } else if (formatterDef.equalsIgnoreCase("round")) {
     uint8_t numDigits = 0;
     if (formatterArgs.containsKey("digits")) {
@@ -103,7 +107,32 @@ VariableFormatterFactory::_createInternal(
   } else if (formatterDef.equalsIgnoreCase("pfstring")) {
     return PrintfFormatterString::build(formatterArgs);
   } else if (formatterDef.equalsIgnoreCase("pfnumeric")) {
-    return PrintfFormatterNumeric::build(formatterArgs);
+    auto formatter = PrintfFormatterNumeric::build(formatterArgs);
+    if (formatter) {
+      return formatter;
+    } else {
+      return defaultFormatter;
+    }
+  } else if (formatterDef.equalsIgnoreCase("expr")) {
+    std::shared_ptr<const VariableFormatter> outputFormatter;
+    if (formatterArgs.containsKey("formatter")) {
+      outputFormatter = _createInternal(formatterArgs, allowReference);
+    }
+
+    auto formatter = ExpressionVariableFormatter::build(formatterArgs, outputFormatter);
+    if (formatter) {
+      return formatter;
+    } else {
+      return defaultFormatter;
+    }
+  } else if (formatterDef.equalsIgnoreCase("pipeline")) {
+    std::vector<std::shared_ptr<const VariableFormatter>> stages;
+
+    for (JsonObject stage : formatterArgs["stages"].as<JsonArray>()) {
+      stages.push_back(_createInternal(stage, allowReference));
+    }
+
+    return std::make_shared<PipelineVariableFormatter>(std::move(stages));
   } else {
     return defaultFormatter;
   }
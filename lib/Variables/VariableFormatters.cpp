@@ -1,6 +1,13 @@
 #include <Arduino.h>
 #include <VariableFormatters.h>
 
-String IdentityVariableFormatter::format(const String& value) const {
-  return value;
+String VariableFormatter::format(const String& value) const {
+  String result;
+  formatInto(value, result);
+  return result;
+}
+
+void IdentityVariableFormatter::formatInto(
+    const String& value, String& result) const {
+  result = value;
 }
@@ -2,20 +2,36 @@
 #include <Timezone.h>
 #include <memory>
 #include <map>
+#include <vector>
 
 #ifndef _VARIABLE_FORMATTER_H
 #define _VARIABLE_FORMATTER_H
 
+// Formatters are built once per template and shared: between regions bound
+// through a reference, and with resolveVariables, which runs on the web
+// server's task without the driver lock.  They must not keep any state between
+// calls.
 class VariableFormatter {
 public:
-  virtual String format(const String& value) const = 0;
+  String format(const String& value) const;
+
+  // Writes the formatted value into result.  Reusing result across calls lets
+  // callers (e.g., pipelines) avoid allocating a new String for every update.
+  virtual void formatInto(const String& value, String& result) const = 0;
+
+  // Same, with a buffer for intermediate results that the caller keeps
+  // between calls.  Formatters are shared, so they can't keep one themselves.
+  // Only multi-stage formatters use it.
+  virtual void formatIntoWithScratch(const String& value, String& result, String&) const {
+    formatInto(value, result);
+  }
 
   ~VariableFormatter() { }
 };
 
 class IdentityVariableFormatter : public VariableFormatter {
 public:
-  virtual String format(const String& value) const;
+  virtual void formatInto(const String& value, String& result) const;
 };
 
 class TimeVariableFormatter : public VariableFormatter {
@@ -24,7 +40,7 @@ public:
 
   TimeVariableFormatter(const String& timeFormat, Timezone& timezone);
 
-  virtual String format(const String& value) const;
+  virtual void formatInto(const String& value, String& result) const;
   static std::shared_ptr<const TimeVariableFormatter> build(JsonObject args);
 
 protected:
@@ -34,20 +50,49 @@ protected:
 
 class PrintfFormatterNumeric : public VariableFormatter {
 public:
-  PrintfFormatterNumeric(const String& formatSchema);
-
-  virtual String format(const String& value) const;
+  static const uint8_t MAX_WIDTH = 64;
+  static const uint8_t MAX_PRECISION = 9;
+
+  // Parsed form of a printf format string with (at most) one conversion.
+  struct Spec {
+    String prefix;
+    String suffix;
+    // One of d, i, u, x, X, o, f, F.  0 if the format has no conversion.
+    char conversion = 0;
+    bool leftAlign = false;
+    bool forceSign = false;
+    bool spaceSign = false;
+    bool zeroPad = false;
+    bool alternate = false;
+    uint8_t width = 0;
+    // -1 if not specified
+    int8_t precision = -1;
+  };
+
+  PrintfFormatterNumeric(const Spec& spec);
+
+  virtual void formatInto(const String& value, String& result) const;
+
+  // Returns nullptr if the format is invalid or unsafe
   static std::shared_ptr<const PrintfFormatterNumeric> build(JsonObject args);
 
+  // Parses format into spec.  Returns an error message, or nullptr if
+  // successful.
+  static const char* parse(const char* format, Spec& spec);
+
 protected:
-  String formatSchema;
+  Spec spec;
+
+  // Formats a float conversion with libc, for values beyond the fixed point
+  // path
+  void formatLargeInto(double value, uint8_t precision, String& result) const;
 };
 
 class PrintfFormatterString : public VariableFormatter {
 public:
   PrintfFormatterString(const String& formatSchema);
 
-  virtual String format(const String& value) const;
+  virtual void formatInto(const String& value, String& result) const;
   static std::shared_ptr<const PrintfFormatterString> build(JsonObject args);
 
 protected:
@@ -58,10 +103,30 @@ class CasesVariableFormatter : public VariableFormatter {
 public:
   CasesVariableFormatter(JsonObject args);
 
-  virtual String format(const String& value) const;
+  virtual void formatInto(const String& value, String& result) const;
+
+protected:
+  typedef std::pair<String, String> Case;
+
+  // Sorted by key
+  std::vector<Case> cases;
+  String defaultValue;
+  String prefix;
+};
+
+// Maps numeric values to the band they fall in.  Each band is defined by its
+// lower bound, and extends up to the lower bound of the next band.  Values
+// below the first band (or that aren't numbers) get the default.
+class RangeCasesVariableFormatter : public VariableFormatter {
+public:
+  RangeCasesVariableFormatter(JsonObject args);
+
+  virtual void formatInto(const String& value, String& result) const;
 
 protected:
-  std::map<String, String> cases;
+  // Sorted lower bounds, and the value for each band.
+  std::vector<float> thresholds;
+  std::vector<String> values;
   String defaultValue;
   String prefix;
 };
@@ -70,7 +135,7 @@ class RoundingVariableFormatter : public VariableFormatter {
 public:
   RoundingVariableFormatter(uint8_t digits);
 
-  virtual String format(const String& value) const;
+  virtual void formatInto(const String& value, String& result) const;
 private:
   uint8_t digits;
 };
@@ -79,22 +144,77 @@ class RatioVariableFormatter : public VariableFormatter {
 public:
   RatioVariableFormatter(float baseValue);
 
-  virtual String format(const String& value) const;
+  virtual void formatInto(const String& value, String& result) const;
 private:
   float baseValue;
 };
 
+class ExpressionVariableFormatter : public VariableFormatter {
+public:
+  static const size_t MAX_STACK_DEPTH = 16;
+  // Most parentheses, function calls and unary operators the compiler will
+  // descend into.  Each level is a few frames of recursion on the task that
+  // loads the template.
+  static const size_t MAX_NESTING_DEPTH = 12;
+
+  enum class OpCode : uint8_t {
+    PUSH_CONST, PUSH_VALUE,
+    ADD, SUB, MUL, DIV, MOD, POW, MIN, MAX,
+    NEG, ABS, FLOOR, CEIL, ROUND, SQRT
+  };
+
+  struct Instruction {
+    OpCode op;
+    float operand;
+  };
+
+  // Result is passed through outputFormatter (if not null).  This allows for
+  // things like rounding the converted value.
+  ExpressionVariableFormatter(
+    std::vector<Instruction>&& program,
+    std::shared_ptr<const VariableFormatter> outputFormatter
+  );
+
+  virtual void formatInto(const String& value, String& result) const;
+  float evaluate(float x) const;
+
+  static std::shared_ptr<const ExpressionVariableFormatter> build(
+    JsonObject args,
+    std::shared_ptr<const VariableFormatter> outputFormatter
+  );
+
+  // Compiles expression into program.  Returns an error message, or nullptr
+  // if compilation succeeded.
+  static const char* compile(const char* expression, std::vector<Instruction>& program);
+
+protected:
+  std::vector<Instruction> program;
+  std::shared_ptr<const VariableFormatter> outputFormatter;
+};
+
+// Chains formatters so that the output of each stage is the input to the next.
+class PipelineVariableFormatter : public VariableFormatter {
+public:
+  PipelineVariableFormatter(std::vector<std::shared_ptr<const VariableFormatter>> formatters);
+
+  virtual void formatInto(const String& value, String& result) const;
+  virtual void formatIntoWithScratch(const String& value, String& result, String& scratch) const;
+
+private:
+  const std::vector<std::shared_ptr<const VariableFormatter>> stages;
+};
+
 class VariableFormatterFactory {
 public:
   VariableFormatterFactory(const JsonVariant& referenceFormatters);
 
-  std::shared_ptr<const VariableFormatter> create(JsonObject spec);
+  std::shared_ptr<const VariableFormatter> create(JsonObject spec) const;
 
 private:
   std::map<String, std::shared_ptr<const VariableFormatter>> refFormatters;
 
-  std::shared_ptr<const VariableFormatter> getReference(String refKey, bool allowReference);
-  std::shared_ptr<const VariableFormatter> _createInternal(JsonObject spec, bool allowReference);
+  std::shared_ptr<const VariableFormatter> getReference(String refKey, bool allowReference) const;
+  std::shared_ptr<const VariableFormatter> _createInternal(JsonObject spec, bool allowReference) const;
   std::shared_ptr<const VariableFormatter> defaultFormatter;
 };
 
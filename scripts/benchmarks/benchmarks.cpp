@@ -0,0 +1,643 @@
+// Benchmarks for the render path, run on the host against the stand-ins in
+// test/native/compat.  Reports the mean time and heap allocations per
+// operation, and compares them against a baseline.
+//
+// Build with PlatformIO:
+//
+//   pio run -e benchmarks
+//
+// Usage (from the root of the repository, which has the fixtures):
+//
+//   .pio/build/benchmarks/program [-f filter] [-d duration_ms]
+//     [-o results.json] [-c baseline.json] [-t threshold_percent]
+//     [-e examples_dir] [-V]
+//
+// -f only runs the benchmarks whose name contains filter.  Each runs for
+// about duration_ms (default 200), several times over, and the fastest is
+// kept.  -o saves the results as JSON, to be used as a baseline for later
+// runs.  -c compares each result against a baseline, and the exit status is
+// 1 if there were any regressions.  -V prints the driver's logging to stderr.
+//
+// Allocations are counted through operator new, and are the same everywhere
+// the host's standard library is, so any increase is a regression.  Times
+// depend on the machine.  They're scaled by the median change across all the
+// benchmarks, and only regress if they're more than threshold_percent
+// (default 50) slower than that.  scripts/benchmarks/baseline.json is
+// checked in, and should be re-recorded with -o when a change is expected to
+// move the numbers.
+//
+// Neither is the same as on the device: in particular, the KV benchmarks run
+// on the stand-in SPIFFS, which is a directory on the host.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <DisplayTemplateDriver.h>
+#include <DisplayTypeHelpers.h>
+#include <FS.h>
+#include <FontStore.h>
+#include <NativeClock.h>
+#include <Settings.h>
+#include <TemplateCache.h>
+#include <TextLayout.h>
+#include <TokenIterator.h>
+#include <VariableBatch.h>
+#include <VariableDictionary.h>
+#include <VariableFormatters.h>
+
+#include <dirent.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static size_t allocations = 0;
+
+// Only this pair touches malloc() and free(), and it's kept out of line.
+// Otherwise GCC inlines free() where the pointer came from operator new and
+// warns (-Wmismatched-new-delete).  The other forms forward to it.
+__attribute__((noinline)) void* operator new(size_t size) {
+  ++allocations;
+
+  if (void* p = malloc(size > 0 ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete[](void* p) noexcept {
+  operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  operator delete(p);
+}
+
+static const size_t HOST_DOCUMENT_SIZE = 1024 * 1024;
+static const GxEPD2::Panel PANEL = GxEPD2::GDEW042T2;
+static const char* const EXAMPLES[] = {"alarm_clock", "weather_dashboard"};
+static const size_t FANOUTS[] = {1, 10, 50};
+static const size_t RUNS = 5;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Result {
+  double nsPerOp;
+  double allocsPerOp;
+  size_t iterations;
+};
+
+// Handed to each benchmark.  Work between pause() and resume() (e.g., setting
+// up the next operation) isn't counted.
+class State {
+public:
+  void pause() {
+    elapsed += Clock::now() - start;
+    pausedAllocations = allocations;
+  }
+
+  void resume() {
+    excludedAllocations += allocations - pausedAllocations;
+    start = Clock::now();
+  }
+
+private:
+  friend class Runner;
+
+  Clock::time_point start;
+  Clock::duration elapsed;
+  size_t pausedAllocations;
+  size_t excludedAllocations;
+  size_t countedAllocations;
+};
+
+typedef std::function<void(State&)> BenchmarkFn;
+
+class Runner {
+public:
+  const char* filter = nullptr;
+  Clock::duration duration = std::chrono::milliseconds(200);
+  std::map<std::string, Result> results;
+
+  bool selected(const std::string& name) const {
+    return filter == nullptr || name.find(filter) != std::string::npos;
+  }
+
+  void run(const std::string& name, BenchmarkFn fn) {
+    if (!selected(name)) {
+      return;
+    }
+
+    // Find out roughly how many iterations fit in a tenth of the duration,
+    // which also warms up caches
+    size_t iterations = 1;
+    while (measure(fn, iterations).elapsed < duration / 10) {
+      iterations *= 2;
+    }
+    iterations *= 10;
+
+    // Fastest of a few runs, to filter out noise from the rest of the system
+    Result best = {0, 0, iterations};
+    for (size_t i = 0; i < RUNS; ++i) {
+      State state = measure(fn, iterations);
+      const double ns = std::chrono::duration<double, std::nano>(state.elapsed).count();
+
+      if (i == 0 || ns / iterations < best.nsPerOp) {
+        best.nsPerOp = ns / iterations;
+      }
+      best.allocsPerOp = static_cast<double>(state.countedAllocations) / iterations;
+    }
+
+    results[name] = best;
+    printf("%-48s %14.1f ns/op %10.1f allocs/op\n", name.c_str(), best.nsPerOp, best.allocsPerOp);
+    fflush(stdout);
+  }
+
+private:
+  static State measure(BenchmarkFn& fn, size_t iterations) {
+    State state;
+    state.elapsed = Clock::duration::zero();
+    state.excludedAllocations = 0;
+
+    const size_t startAllocations = allocations;
+    state.start = Clock::now();
+
+    for (size_t i = 0; i < iterations; ++i) {
+      fn(state);
+    }
+
+    state.elapsed += Clock::now() - state.start;
+    state.countedAllocations = allocations - startAllocations - state.excludedAllocations;
+
+    return state;
+  }
+};
+
+static bool readFile(const std::string& path, std::string& contents) {
+  std::ifstream file(path, std::ios::binary);
+
+  if (!file) {
+    return false;
+  }
+
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  contents = buffer.str();
+
+  return true;
+}
+
+static void writeSpiffsFile(const String& path, const std::string& contents) {
+  File file = SPIFFS.open(path, "w");
+  file.write(reinterpret_cast<const uint8_t*>(contents.data()), contents.size());
+  file.close();
+}
+
+// Makes the example's bitmaps available as if they'd been uploaded
+static void copyBitmaps(const std::string& exampleDir) {
+  DIR* dir = opendir(exampleDir.c_str());
+
+  if (dir == nullptr) {
+    return;
+  }
+
+  while (struct dirent* entry = readdir(dir)) {
+    const size_t length = strlen(entry->d_name);
+    std::string contents;
+
+    if (length > 4 && strcmp(entry->d_name + length - 4, ".bin") == 0
+        && readFile(exampleDir + "/" + entry->d_name, contents)) {
+      writeSpiffsFile(String(BITMAPS_DIRECTORY "/") + entry->d_name, contents);
+    }
+  }
+
+  closedir(dir);
+}
+
+// A driver rendering to an in-memory panel
+struct Fixture {
+  Settings settings;
+  GxEPD2_GFX* display;
+  DisplayTemplateDriver* driver;
+
+  explicit Fixture(bool windowed = false) {
+    settings.display.display_type = PANEL;
+    settings.display.windowed_updates = windowed;
+
+    display = DisplayTypeHelpers::buildDisplay(PANEL,
+        settings.hardware.dc_pin,
+        settings.hardware.rst_pin,
+        settings.hardware.busy_pin,
+        settings.hardware.getSsPin());
+    driver = new DisplayTemplateDriver(display, settings);
+    driver->init();
+  }
+
+  ~Fixture() {
+    delete driver;
+    delete display;
+  }
+
+  void load(const String& templatePath) {
+    driver->setTemplate(templatePath);
+    driver->loop();
+    display->clearRefreshes();
+  }
+};
+
+// Text regions laid out in a grid.  Bound to variable if it's set, otherwise
+// each to its own variable, v0, v1, ...
+static std::string gridTemplate(size_t regions, const char* variable) {
+  DynamicJsonDocument doc(HOST_DOCUMENT_SIZE);
+  JsonArray text = doc.createNestedArray("text");
+
+  for (size_t i = 0; i < regions; ++i) {
+    JsonObject region = text.createNestedObject();
+    region["x"] = (i % 8) * 50;
+    region["y"] = 20 + (i / 8) * 40;
+    region["font"] = "FreeSans9pt7b";
+
+    JsonObject value = region.createNestedObject("value");
+    value["type"] = "variable";
+    value["variable"] = variable != nullptr ? String(variable) : String("v") + i;
+  }
+
+  std::string result;
+  serializeJson(doc, result);
+  return result;
+}
+
+static void benchmarkTemplates(Runner& runner, const std::string& examplesDir) {
+  for (const char* example : EXAMPLES) {
+    const std::string dir = examplesDir + "/" + example;
+    const String path = String(TEMPLATES_DIRECTORY "/") + example + ".json";
+    std::string contents;
+
+    if (!readFile(dir + "/" + example + ".json", contents)) {
+      fprintf(stderr, "Couldn't read the %s example from %s\n", example, dir.c_str());
+      continue;
+    }
+
+    copyBitmaps(dir);
+    writeSpiffsFile(path, contents);
+
+    Fixture fixture;
+    fixture.load(path);
+
+    // Invalid templates aren't cached (weather_dashboard refers to a bitmap
+    // that isn't in the example), so they're compiled on every load
+    if (runner.selected(std::string("template_load/") + example)
+        && !SPIFFS.exists(TemplateCache::pathFor(path))) {
+      fprintf(stderr, "%s isn't valid, so every template_load compiles it (see -V)\n", example);
+    }
+
+    // Load and full update, from the compiled copy
+    runner.run(std::string("template_load/") + example, [&](State&) {
+      fixture.load(path);
+    });
+
+    runner.run(std::string("template_compile/") + example, [&](State& state) {
+      state.pause();
+      TemplateCache::invalidate(path);
+      state.resume();
+
+      fixture.load(path);
+    });
+
+    bool odd = false;
+    runner.run(std::string("update_variable/") + example + "/timestamp", [&](State&) {
+      fixture.driver->updateVariable("timestamp", (odd = !odd) ? "1600000000" : "1600000060");
+    });
+  }
+}
+
+static void benchmarkFanout(Runner& runner) {
+  for (size_t regions : FANOUTS) {
+    const String path = String(TEMPLATES_DIRECTORY "/fanout_") + regions + ".json";
+    writeSpiffsFile(path, gridTemplate(regions, "v"));
+
+    Fixture fixture;
+    fixture.load(path);
+
+    bool odd = false;
+    runner.run("update_variable/fanout_" + std::to_string(regions), [&](State&) {
+      fixture.driver->updateVariable("v", (odd = !odd) ? "12.3" : "45.6");
+    });
+  }
+}
+
+static void benchmarkFlush(Runner& runner) {
+  for (size_t regions : FANOUTS) {
+    const String path = String(TEMPLATES_DIRECTORY "/windows_") + regions + ".json";
+    writeSpiffsFile(path, gridTemplate(regions, nullptr));
+
+    Fixture fixture(true);
+    fixture.load(path);
+
+    VariableBatch batches[2];
+    for (size_t i = 0; i < regions; ++i) {
+      batches[0][String("v") + i] = "12.3";
+      batches[1][String("v") + i] = "45.6";
+    }
+
+    // Renders the dirty regions and issues a window for each
+    bool odd = false;
+    runner.run("flush_dirty_regions/" + std::to_string(regions), [&](State& state) {
+      state.pause();
+      fixture.display->clearRefreshes();
+      fixture.driver->updateVariables(batches[odd = !odd]);
+      state.resume();
+
+      fixture.driver->loop();
+    });
+  }
+}
+
+static void benchmarkDrawing(Runner& runner) {
+  Fixture fixture;
+  GxEPD2_GFX* display = fixture.display;
+
+  std::vector<uint8_t> bitmap(display->width() * display->height() / 8);
+  for (size_t i = 0; i < bitmap.size(); ++i) {
+    bitmap[i] = static_cast<uint8_t>(i * 37);
+  }
+
+  runner.run("draw_bitmap/64x64", [&](State&) {
+    DisplayTemplateDriver::drawBitmap(display, bitmap.data(), 10, 10, 64, 64, GxEPD_BLACK, GxEPD_WHITE);
+  });
+
+  runner.run("draw_bitmap/full_screen", [&](State&) {
+    DisplayTemplateDriver::drawBitmap(display,
+        bitmap.data(), 0, 0, display->width(), display->height(), GxEPD_BLACK, GxEPD_WHITE);
+  });
+
+  FontStore fonts;
+  TextLayout small(fonts.get("FreeSans9pt7b"), 1, TextAlignment::LEFT);
+  TextLayout large(fonts.get("FreeSans18pt7b"), 2, TextAlignment::CENTER);
+  const String time = "12:34";
+  const String sentence =
+      "The quick brown fox jumps over the lazy dog, and then does it again "
+      "until the line wraps at the edge of the display.";
+
+  runner.run("text_layout/short", [&](State&) {
+    large.render(display, time, 200, 100, GxEPD_BLACK);
+  });
+
+  runner.run("text_layout/wrapped", [&](State&) {
+    small.render(display, sentence, 0, 20, GxEPD_BLACK);
+  });
+}
+
+static void benchmarkFormatters(Runner& runner) {
+  struct Case {
+    const char* name;
+    const char* spec;
+    const char* value;
+  };
+
+  static const Case CASES[] = {
+    {"identity", R"({})", "21.46"},
+    {"round", R"({"formatter":{"type":"round","args":{"digits":1}}})", "21.46"},
+    {"ratio", R"({"formatter":{"type":"ratio","args":{"base":4}}})", "21.46"},
+    {"pfnumeric", R"({"formatter":{"type":"pfnumeric","args":{"format":"%.1f C"}}})", "21.46"},
+    {"pfstring", R"({"formatter":{"type":"pfstring","args":{"format":"[%s]"}}})", "abc"},
+    {"expr", R"({"formatter":{"type":"expr","args":{"expression":"x * 9 / 5 + 32"}}})", "21.46"},
+    {"cases", R"({"formatter":{"type":"cases","args":{"cases":{"a":"1","b":"2","c":"3"}}}})", "b"},
+    {"range_cases", R"({"formatter":{"type":"range_cases","args":{
+        "ranges":[{"min":0,"value":"cold"},{"min":15,"value":"mild"},{"min":25,"value":"hot"}]
+      }}})", "21.46"},
+    {"time", R"({"formatter":{"type":"time","args":{"timezone":"UTC","format":"%H:%M"}}})", "1600000000"},
+    {"pipeline", R"({"formatter":{"type":"pipeline","args":{"stages":[
+        {"type":"expr","args":{"expression":"x * 10"}},
+        {"type":"pfnumeric","args":{"format":"%.0f%%"}}
+      ]}}})", "21.46"},
+  };
+
+  DynamicJsonDocument refs(16);
+  VariableFormatterFactory factory(refs.as<JsonVariant>());
+
+  for (const Case& c : CASES) {
+    DynamicJsonDocument spec(1024);
+    deserializeJson(spec, c.spec);
+
+    auto formatter = factory.create(spec.as<JsonObject>());
+    const String value = c.value;
+    String result;
+
+    runner.run(std::string("formatter/") + c.name, [&](State&) {
+      formatter->formatInto(value, result);
+    });
+  }
+}
+
+// The variables each update goes through, stored in KeyValueDatabase
+static void benchmarkVariables(Runner& runner) {
+  static const size_t KEYS = 50;
+
+  VariableDictionary vars;
+  vars.load();
+
+  char key[16];
+  for (size_t i = 0; i < KEYS; ++i) {
+    snprintf(key, sizeof(key), "var%u", static_cast<unsigned>(i));
+    vars.set(key, "value");
+  }
+
+  runner.run("kv/get", [&](State&) {
+    vars.get("var49");
+  });
+
+  bool odd = false;
+  runner.run("kv/set", [&](State&) {
+    vars.set("var49", (odd = !odd) ? "other" : "value");
+  });
+
+  static const char DATA[] = "temperature,humidity,pressure,wind_speed,timestamp";
+  char buffer[sizeof(DATA)];
+
+  runner.run("token_iterator/5", [&](State&) {
+    memcpy(buffer, DATA, sizeof(DATA));
+    TokenIterator it(buffer, sizeof(DATA) - 1);
+
+    while (it.hasNext()) {
+      it.nextToken();
+    }
+  });
+}
+
+// One benchmark per line, so that changes to the baseline diff well
+static bool writeResults(const char* path, const std::map<std::string, Result>& results) {
+  FILE* file = fopen(path, "w");
+
+  if (file == nullptr) {
+    return false;
+  }
+
+  fprintf(file, "{\n  \"benchmarks\": {");
+
+  for (auto it = results.begin(); it != results.end(); ++it) {
+    fprintf(file, "%s\n    \"%s\": {\"ns_per_op\": %.1f, \"allocs_per_op\": %.1f}",
+        it == results.begin() ? "" : ",",
+        it->first.c_str(),
+        it->second.nsPerOp,
+        it->second.allocsPerOp);
+  }
+
+  fprintf(file, "\n  }\n}\n");
+
+  return fclose(file) == 0;
+}
+
+// Returns the number of regressions, or -1 if the baseline can't be read.
+//
+// Any increase in allocations is a regression.  Times are scaled by the
+// median change across all the benchmarks first, which takes out the
+// difference between this machine and the one that recorded the baseline,
+// and then have to be more than threshold percent slower.
+static int compare(const char* path,
+    const std::map<std::string, Result>& results,
+    double threshold) {
+  std::string contents;
+  DynamicJsonDocument doc(HOST_DOCUMENT_SIZE);
+
+  if (!readFile(path, contents) || deserializeJson(doc, contents)) {
+    fprintf(stderr, "Couldn't read baseline %s\n", path);
+    return -1;
+  }
+
+  JsonObject baseline = doc["benchmarks"];
+  std::vector<double> ratios;
+
+  for (const auto& result : results) {
+    const double baseNs = baseline[result.first.c_str()]["ns_per_op"];
+
+    if (baseNs > 0) {
+      ratios.push_back(result.second.nsPerOp / baseNs);
+    }
+  }
+
+  double scale = 1;
+
+  if (!ratios.empty()) {
+    std::nth_element(ratios.begin(), ratios.begin() + ratios.size() / 2, ratios.end());
+    scale = ratios[ratios.size() / 2];
+  }
+
+  int regressions = 0;
+
+  printf("\nCompared to baseline, with times scaled by %.2f (the median change)\n", scale);
+  printf("%-48s %12s %12s %8s %10s %10s\n",
+      "", "ns/op", "baseline", "change", "allocs/op", "baseline");
+
+  for (const auto& result : results) {
+    JsonObject base = baseline[result.first.c_str()];
+
+    if (base.isNull()) {
+      printf("%-48s %12.1f %12s %8s %10.1f %10s  new\n",
+          result.first.c_str(), result.second.nsPerOp, "-", "-", result.second.allocsPerOp, "-");
+      continue;
+    }
+
+    const double baseNs = base["ns_per_op"];
+    const double baseAllocs = base["allocs_per_op"];
+    const double change = baseNs > 0 ? (result.second.nsPerOp / (baseNs * scale) - 1) * 100 : 0;
+    const bool slower = change > threshold;
+    // Only allows for the rounding in the saved results
+    const bool allocates = result.second.allocsPerOp > baseAllocs + 0.05;
+
+    printf("%-48s %12.1f %12.1f %+7.1f%% %10.1f %10.1f%s\n",
+        result.first.c_str(),
+        result.second.nsPerOp,
+        baseNs,
+        change,
+        result.second.allocsPerOp,
+        baseAllocs,
+        slower || allocates ? "  REGRESSION" : "");
+
+    regressions += slower || allocates;
+  }
+
+  return regressions;
+}
+
+static void usage() {
+  fprintf(stderr,
+      "Usage: benchmarks [-f filter] [-d duration_ms] [-o results.json]\n"
+      "         [-c baseline.json] [-t threshold_percent] [-e examples_dir] [-V]\n");
+}
+
+int main(int argc, char** argv) {
+  Runner runner;
+  const char* outputPath = nullptr;
+  const char* baselinePath = nullptr;
+  const char* examplesDir = "examples";
+  double threshold = 50;
+  bool verbose = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "f:d:o:c:t:e:V")) != -1) {
+    switch (opt) {
+      case 'f': runner.filter = optarg; break;
+      case 'd': runner.duration = std::chrono::milliseconds(atol(optarg)); break;
+      case 'o': outputPath = optarg; break;
+      case 'c': baselinePath = optarg; break;
+      case 't': threshold = atof(optarg); break;
+      case 'e': examplesDir = optarg; break;
+      case 'V': verbose = true; break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+
+  setenv("TZ", "UTC", 1);
+  tzset();
+  Serial.setOutput(verbose ? stderr : nullptr);
+  NativeClock::set(0);
+
+  benchmarkTemplates(runner, examplesDir);
+  benchmarkFanout(runner);
+  benchmarkFlush(runner);
+  benchmarkDrawing(runner);
+  benchmarkFormatters(runner);
+  benchmarkVariables(runner);
+
+  if (outputPath != nullptr && !writeResults(outputPath, runner.results)) {
+    fprintf(stderr, "Couldn't write %s\n", outputPath);
+    return 1;
+  }
+
+  if (baselinePath != nullptr) {
+    const int regressions = compare(baselinePath, runner.results, threshold);
+
+    if (regressions != 0) {
+      if (regressions > 0) {
+        printf("\n%d regression(s)\n", regressions);
+      }
+      return 1;
+    }
+  }
+
+  return 0;
+}
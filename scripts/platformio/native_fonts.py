@@ -0,0 +1,31 @@
+#!/usr/bin/python3
+#
+# FontStore's built-in fonts come from Adafruit GFX's Fonts/ directory.  The
+# library itself can't be built on the host (it needs SPI), so the native
+# environment ignores it, and this copies Fonts/ to a directory on the include
+# path.  Adding the library's own directory would expose its Adafruit_GFX.h,
+# which would compete with test/native/compat's.
+#
+# The font headers don't include anything.  They're used with compat's
+# gfxfont.h, which has the same layout as the library's.
+
+import os
+import shutil
+
+Import("env")
+
+fonts_dir = os.path.join(
+    env.subst("$PROJECT_LIBDEPS_DIR"),
+    env.subst("$PIOENV"),
+    "Adafruit GFX Library",
+    "Fonts"
+)
+include_dir = os.path.join(env.subst("$BUILD_DIR"), "adafruit_fonts")
+copy_dir = os.path.join(include_dir, "Fonts")
+
+if not os.path.isdir(fonts_dir):
+    print("[WARNING] %s doesn't exist.  Built-in fonts won't be found." % fonts_dir)
+elif not os.path.isdir(copy_dir):
+    shutil.copytree(fonts_dir, copy_dir)
+
+env.Append(CPPPATH=[include_dir])
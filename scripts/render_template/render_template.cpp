@@ -0,0 +1,367 @@
+// Renders a template the way a display would, without the hardware.  Runs the
+// same DisplayTemplateDriver as the firmware against the in-memory panels in
+// test/native/compat, and writes the resulting image along with the refreshes
+// the driver issued.
+//
+// Build with PlatformIO:
+//
+//   pio run -e render_template
+//
+// Usage:
+//
+//   .pio/build/render_template/program -p panel [-b bitmap_dir] [-f font_dir]
+//     [-v variables.json] [-r refreshes.json] [-w] [-V] template.json output
+//
+// panel is one of DisplayTypeHelpers::PANELS_BY_NAME (e.g. GDEW042T2).  The
+// files in bitmap_dir and font_dir are made available as they would be after
+// uploading them (e.g. bitmap_dir/sun.bin is /b/sun.bin).
+//
+// The template is loaded and rendered with a full refresh first.  The
+// variables file is either an object of variable values, which is applied as
+// one batch, or an array of them, applied one batch at a time.  After each
+// batch the driver is looped once, like the firmware's main loop.  -w enables
+// windowed partial updates.
+//
+// Problems found by the template validator are printed, and the template is
+// rendered anyway, like the device would.  The exit status is 1 if there were
+// any.
+//
+// The image is PNG, or PBM if output ends in .pbm.  The refreshes are written
+// as JSON to the -r file ("-" for stdout).  Each has the index of the batch
+// that caused it, 0 being the initial load.  -V prints the driver's logging to
+// stderr.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <DisplayTemplateDriver.h>
+#include <DisplayTypeHelpers.h>
+#include <FS.h>
+#include <NativeClock.h>
+#include <ScreenshotStream.h>
+#include <Settings.h>
+#include <VariableBatch.h>
+
+#include <dirent.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static const size_t HOST_DOCUMENT_SIZE = 1024 * 1024;
+static const char TEMPLATE_FILENAME[] = TEMPLATES_DIRECTORY "/template.json";
+
+static void usage() {
+  fprintf(stderr,
+      "Usage: render_template -p panel [-b bitmap_dir] [-f font_dir]\n"
+      "         [-v variables.json] [-r refreshes.json] [-w] [-V]\n"
+      "         template.json output\n");
+}
+
+static bool readFile(const char* path, std::string& contents) {
+  std::ifstream file(path, std::ios::binary);
+
+  if (!file) {
+    return false;
+  }
+
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  contents = buffer.str();
+
+  return true;
+}
+
+static bool writeSpiffsFile(const String& path, const std::string& contents) {
+  File file = SPIFFS.open(path, "w");
+
+  if (!file) {
+    return false;
+  }
+
+  const size_t written =
+      file.write(reinterpret_cast<const uint8_t*>(contents.data()), contents.size());
+  file.close();
+
+  return written == contents.size();
+}
+
+// Copies every file in hostDir to spiffsDir
+static bool copyDirectory(const char* hostDir, const char* spiffsDir) {
+  DIR* dir = opendir(hostDir);
+
+  if (dir == nullptr) {
+    fprintf(stderr, "Couldn't open directory: %s\n", hostDir);
+    return false;
+  }
+
+  bool ok = true;
+
+  while (struct dirent* entry = readdir(dir)) {
+    const std::string hostPath = std::string(hostDir) + "/" + entry->d_name;
+    std::string contents;
+
+    if (entry->d_name[0] == '.' || !readFile(hostPath.c_str(), contents)) {
+      continue;
+    }
+
+    String path = spiffsDir;
+    path += '/';
+    path += entry->d_name;
+
+    if (!writeSpiffsFile(path, contents)) {
+      fprintf(stderr, "Couldn't copy %s\n", hostPath.c_str());
+      ok = false;
+    }
+  }
+
+  closedir(dir);
+  return ok;
+}
+
+static void addBatch(JsonObject values, std::vector<VariableBatch>& batches) {
+  VariableBatch batch;
+
+  for (JsonPair kv : values) {
+    batch[kv.key().c_str()] = kv.value().as<String>();
+  }
+
+  batches.push_back(batch);
+}
+
+static bool readVariables(const char* path, std::vector<VariableBatch>& batches) {
+  std::string contents;
+
+  if (!readFile(path, contents)) {
+    fprintf(stderr, "Couldn't read %s\n", path);
+    return false;
+  }
+
+  DynamicJsonDocument doc(HOST_DOCUMENT_SIZE);
+  DeserializationError error = deserializeJson(doc, contents);
+
+  if (error) {
+    fprintf(stderr, "%s: %s\n", path, error.c_str());
+    return false;
+  }
+
+  if (doc.is<JsonObject>()) {
+    addBatch(doc.as<JsonObject>(), batches);
+  } else if (doc.is<JsonArray>()) {
+    for (JsonVariant batch : doc.as<JsonArray>()) {
+      if (!batch.is<JsonObject>()) {
+        fprintf(stderr, "%s: each batch must be an object\n", path);
+        return false;
+      }
+
+      addBatch(batch.as<JsonObject>(), batches);
+    }
+  } else {
+    fprintf(stderr, "%s: must be an object or an array of objects\n", path);
+    return false;
+  }
+
+  return true;
+}
+
+static bool writeImage(const Framebuffer& framebuffer, const char* path) {
+  const size_t length = strlen(path);
+  const ScreenshotStream::Format format =
+      length > 4 && strcasecmp(path + length - 4, ".pbm") == 0
+      ? ScreenshotStream::Format::PBM
+      : ScreenshotStream::Format::PNG;
+
+  FILE* file = fopen(path, "wb");
+
+  if (file == nullptr) {
+    fprintf(stderr, "Couldn't write %s\n", path);
+    return false;
+  }
+
+  ScreenshotStream stream(
+      framebuffer, format, 0, 0, framebuffer.width(), framebuffer.height());
+  uint8_t buffer[1024];
+  bool ok = true;
+
+  while (size_t n = stream.read(buffer, sizeof(buffer))) {
+    ok = ok && fwrite(buffer, 1, n, file) == n;
+  }
+
+  return fclose(file) == 0 && ok;
+}
+
+struct IssuedRefresh {
+  size_t batch;
+  GxEPD2_GFX::Refresh refresh;
+};
+
+static bool writeRefreshes(const char* path,
+    GxEPD2::Panel panel,
+    GxEPD2_GFX* display,
+    const std::vector<IssuedRefresh>& refreshes) {
+  DynamicJsonDocument doc(HOST_DOCUMENT_SIZE);
+
+  doc["panel"] = DisplayTypeHelpers::displayTypeToString(panel);
+  doc["width"] = display->width();
+  doc["height"] = display->height();
+
+  JsonArray list = doc.createNestedArray("refreshes");
+
+  for (const IssuedRefresh& issued : refreshes) {
+    JsonObject refresh = list.createNestedObject();
+    refresh["batch"] = issued.batch;
+    refresh["partial"] = issued.refresh.partial;
+    refresh["x"] = issued.refresh.x;
+    refresh["y"] = issued.refresh.y;
+    refresh["w"] = issued.refresh.w;
+    refresh["h"] = issued.refresh.h;
+  }
+
+  std::string output;
+  serializeJsonPretty(doc, output);
+  output += '\n';
+
+  if (strcmp(path, "-") == 0) {
+    fwrite(output.data(), 1, output.size(), stdout);
+    return true;
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  file << output;
+
+  return file.good();
+}
+
+int main(int argc, char** argv) {
+  const char* panelName = nullptr;
+  const char* bitmapDir = nullptr;
+  const char* fontDir = nullptr;
+  const char* variablesPath = nullptr;
+  const char* refreshesPath = nullptr;
+  bool windowed = false;
+  bool verbose = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "p:b:f:v:r:wV")) != -1) {
+    switch (opt) {
+      case 'p': panelName = optarg; break;
+      case 'b': bitmapDir = optarg; break;
+      case 'f': fontDir = optarg; break;
+      case 'v': variablesPath = optarg; break;
+      case 'r': refreshesPath = optarg; break;
+      case 'w': windowed = true; break;
+      case 'V': verbose = true; break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+
+  if (panelName == nullptr || argc - optind != 2) {
+    usage();
+    return 1;
+  }
+
+  const char* templatePath = argv[optind];
+  const char* outputPath = argv[optind + 1];
+
+  auto panelIt = DisplayTypeHelpers::PANELS_BY_NAME.find(panelName);
+  if (panelIt == DisplayTypeHelpers::PANELS_BY_NAME.end()) {
+    fprintf(stderr, "Unknown panel: %s.  One of:", panelName);
+    for (const auto& panel : DisplayTypeHelpers::PANELS_BY_NAME) {
+      fprintf(stderr, " %s", panel.first);
+    }
+    fprintf(stderr, "\n");
+    return 1;
+  }
+  const GxEPD2::Panel panel = panelIt->second;
+
+  // Matches the device: strftime has no timezone but the template's
+  setenv("TZ", "UTC", 1);
+  tzset();
+  Serial.setOutput(verbose ? stderr : nullptr);
+
+  // Time only moves when we say so, so periodic full refreshes never happen
+  NativeClock::set(0);
+
+  std::vector<VariableBatch> batches;
+  std::string templateContents;
+
+  if (!readFile(templatePath, templateContents)) {
+    fprintf(stderr, "Couldn't read %s\n", templatePath);
+    return 1;
+  }
+
+  if (variablesPath != nullptr && !readVariables(variablesPath, batches)) {
+    return 1;
+  }
+
+  // SPIFFS is a scratch directory, so nothing is written next to the inputs
+  bool ok = writeSpiffsFile(TEMPLATE_FILENAME, templateContents)
+      && (bitmapDir == nullptr || copyDirectory(bitmapDir, BITMAPS_DIRECTORY))
+      && (fontDir == nullptr || copyDirectory(fontDir, FONTS_DIRECTORY));
+
+  Settings settings;
+  settings.display.display_type = panel;
+  settings.display.windowed_updates = windowed;
+
+  GxEPD2_GFX* display = DisplayTypeHelpers::buildDisplay(panel,
+      settings.hardware.dc_pin,
+      settings.hardware.rst_pin,
+      settings.hardware.busy_pin,
+      settings.hardware.getSsPin());
+  DisplayTemplateDriver* driver = new DisplayTemplateDriver(display, settings);
+  driver->init();
+
+  // Invalid templates are still rendered, as they would be on the device
+  bool valid = true;
+
+  if (ok) {
+    DynamicJsonDocument tmpl(HOST_DOCUMENT_SIZE);
+    DynamicJsonDocument errors(HOST_DOCUMENT_SIZE);
+    DeserializationError error = deserializeJson(tmpl, templateContents);
+
+    if (error) {
+      fprintf(stderr, "%s: %s\n", templatePath, error.c_str());
+      ok = false;
+    } else if (!driver->validateTemplate(tmpl, errors.to<JsonArray>())) {
+      for (JsonObject e : errors.as<JsonArray>()) {
+        fprintf(stderr, "%s: %s: %s\n",
+            templatePath,
+            e["path"].as<const char*>(),
+            e["message"].as<const char*>());
+      }
+      valid = false;
+    }
+  }
+
+  if (ok) {
+    std::vector<IssuedRefresh> refreshes;
+
+    driver->setTemplate(TEMPLATE_FILENAME);
+    driver->loop();
+
+    for (size_t i = 0; i <= batches.size(); ++i) {
+      if (i > 0) {
+        driver->updateVariables(batches[i - 1]);
+        driver->loop();
+      }
+
+      for (const GxEPD2_GFX::Refresh& refresh : display->getRefreshes()) {
+        refreshes.push_back({i, refresh});
+      }
+      display->clearRefreshes();
+    }
+
+    ok = writeImage(driver->getFramebuffer(), outputPath)
+        && (refreshesPath == nullptr
+            || writeRefreshes(refreshesPath, panel, display, refreshes));
+  }
+
+  delete driver;
+  delete display;
+
+  return ok && valid ? 0 : 1;
+}
@@ -0,0 +1,475 @@
+// Replays a trace of variable updates recorded on a device (see
+// lib/Trace/UpdateTrace.h) against a template, and reports how often the
+// panel would refresh and how long updates take to show up.  Runs the same
+// DisplayTemplateDriver as the firmware against the in-memory panels in
+// test/native/compat, so changes to the template or the driver can be compared
+// on the same traffic.
+//
+// Build with PlatformIO:
+//
+//   pio run -e replay_trace
+//
+// Usage:
+//
+//   .pio/build/replay_trace/program -p panel [-b bitmap_dir] [-f font_dir]
+//     [-w] [-R full_refresh_period] [-F full_ms] [-P partial_ms]
+//     [-o report.json] [-V] template.json trace.bin
+//
+// panel, bitmap_dir, font_dir and -w are the same as for render_template.
+// -R is the full refresh period in milliseconds (the default is the device's).
+//
+// Time is simulated.  Each event is applied when it arrived on the device,
+// and the driver is looped after every group of events that arrived together,
+// like the firmware's main loop.  Refreshes keep the panel busy for as long as
+// the fake panel estimates (GxEPD2_EPD::full_refresh_time and
+// partial_refresh_time), or -F and -P when given.  Events that arrive while
+// the panel is busy wait for the next loop, as they would on the device.
+//
+// The latency of an update that changed a region is from when it arrived to
+// when the refresh that showed it finished.  Updates that didn't change any
+// region (e.g., the same value again) are counted separately.  The template's
+// initial full refresh is not counted.
+//
+// The report is printed, and written as JSON to the -o file ("-" for stdout,
+// in which case the printed one goes to stderr).
+// -V prints the driver's logging to stderr.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <DisplayTemplateDriver.h>
+#include <DisplayTypeHelpers.h>
+#include <FS.h>
+#include <NativeClock.h>
+#include <Settings.h>
+#include <UpdateTrace.h>
+
+#include <dirent.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const size_t HOST_DOCUMENT_SIZE = 64 * 1024;
+static const char TEMPLATE_FILENAME[] = TEMPLATES_DIRECTORY "/template.json";
+static const size_t SOURCES = 3;
+
+static void usage() {
+  fprintf(stderr,
+      "Usage: replay_trace -p panel [-b bitmap_dir] [-f font_dir] [-w]\n"
+      "         [-R full_refresh_period] [-F full_ms] [-P partial_ms]\n"
+      "         [-o report.json] [-V] template.json trace.bin\n");
+}
+
+static bool readFile(const char* path, std::string& contents) {
+  std::ifstream file(path, std::ios::binary);
+
+  if (!file) {
+    return false;
+  }
+
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  contents = buffer.str();
+
+  return true;
+}
+
+static bool writeSpiffsFile(const String& path, const std::string& contents) {
+  File file = SPIFFS.open(path, "w");
+
+  if (!file) {
+    return false;
+  }
+
+  const size_t written =
+      file.write(reinterpret_cast<const uint8_t*>(contents.data()), contents.size());
+  file.close();
+
+  return written == contents.size();
+}
+
+// Copies every file in hostDir to spiffsDir
+static bool copyDirectory(const char* hostDir, const char* spiffsDir) {
+  DIR* dir = opendir(hostDir);
+
+  if (dir == nullptr) {
+    fprintf(stderr, "Couldn't open directory: %s\n", hostDir);
+    return false;
+  }
+
+  bool ok = true;
+
+  while (struct dirent* entry = readdir(dir)) {
+    const std::string hostPath = std::string(hostDir) + "/" + entry->d_name;
+    std::string contents;
+
+    if (entry->d_name[0] == '.' || !readFile(hostPath.c_str(), contents)) {
+      continue;
+    }
+
+    String path = spiffsDir;
+    path += '/';
+    path += entry->d_name;
+
+    if (!writeSpiffsFile(path, contents)) {
+      fprintf(stderr, "Couldn't copy %s\n", hostPath.c_str());
+      ok = false;
+    }
+  }
+
+  closedir(dir);
+  return ok;
+}
+
+static bool readTrace(const char* path, std::vector<UpdateEvent>& events, bool& truncated) {
+  std::string contents;
+
+  if (!readFile(path, contents)) {
+    fprintf(stderr, "Couldn't read %s\n", path);
+    return false;
+  }
+
+  UpdateTraceReader reader(
+      reinterpret_cast<const uint8_t*>(contents.data()), contents.size());
+
+  if (!reader.isValid()) {
+    fprintf(stderr, "%s: not a trace, or from another version\n", path);
+    return false;
+  }
+
+  UpdateEvent event;
+  while (reader.next(event)) {
+    events.push_back(event);
+  }
+  truncated = reader.isTruncated();
+
+  return true;
+}
+
+static unsigned long nowMillis() {
+  return NativeClock::now() / 1000;
+}
+
+static void advanceTo(unsigned long ms) {
+  const unsigned long now = nowMillis();
+
+  if (ms > now) {
+    NativeClock::advance(static_cast<uint64_t>(ms - now) * 1000);
+  }
+}
+
+struct Report {
+  uint32_t duration = 0;
+  uint32_t events[SOURCES] = {};
+  uint32_t variables = 0;
+  uint32_t fullRefreshes = 0;
+  uint32_t partialRefreshes = 0;
+  uint32_t loopsWithRefreshes = 0;
+  uint64_t busy = 0;
+  // Updates that didn't change any region
+  uint32_t invisible = 0;
+  // Updates that changed a region but were never rendered (e.g., rendering
+  // was still suspended when the trace ended)
+  uint32_t unrendered = 0;
+  std::vector<uint32_t> latencies;
+  bool truncated = false;
+};
+
+// Nearest-rank percentile of sorted values
+static uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+
+  size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.5);
+  rank = std::max<size_t>(rank, 1);
+
+  return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+static void printReport(FILE* out, const Report& report) {
+  uint32_t events = 0;
+  for (size_t i = 0; i < SOURCES; ++i) {
+    events += report.events[i];
+  }
+
+  fprintf(out, "Trace: %u events over %.1fs (%u system, %u mqtt, %u http), %u variables\n",
+      events,
+      report.duration / 1000.0,
+      report.events[static_cast<size_t>(UpdateSource::SYSTEM)],
+      report.events[static_cast<size_t>(UpdateSource::MQTT)],
+      report.events[static_cast<size_t>(UpdateSource::HTTP)],
+      report.variables);
+  fprintf(out, "Refreshes: %u full, %u partial in %u loops\n",
+      report.fullRefreshes,
+      report.partialRefreshes,
+      report.loopsWithRefreshes);
+  fprintf(out, "Panel busy: %.1fs (%.1f%% of the trace)\n",
+      report.busy / 1000.0,
+      report.duration > 0 ? 100.0 * report.busy / report.duration : 0.0);
+
+  if (!report.latencies.empty()) {
+    fprintf(out, "Latency over %zu updates: p50 %ums, p90 %ums, p99 %ums, max %ums\n",
+        report.latencies.size(),
+        percentile(report.latencies, 50),
+        percentile(report.latencies, 90),
+        percentile(report.latencies, 99),
+        report.latencies.back());
+  }
+
+  fprintf(out, "Updates that changed nothing: %u\n", report.invisible);
+
+  if (report.unrendered > 0) {
+    fprintf(out, "Updates never rendered: %u\n", report.unrendered);
+  }
+}
+
+static bool writeReport(const char* path, GxEPD2::Panel panel, const Report& report) {
+  DynamicJsonDocument doc(HOST_DOCUMENT_SIZE);
+
+  doc["panel"] = DisplayTypeHelpers::displayTypeToString(panel);
+  doc["duration"] = report.duration;
+  doc["truncated"] = report.truncated;
+
+  JsonObject events = doc.createNestedObject("events");
+  for (size_t i = 0; i < SOURCES; ++i) {
+    events[UpdateTrace::sourceToString(static_cast<UpdateSource>(i))] = report.events[i];
+  }
+  doc["variables"] = report.variables;
+
+  JsonObject refreshes = doc.createNestedObject("refreshes");
+  refreshes["full"] = report.fullRefreshes;
+  refreshes["partial"] = report.partialRefreshes;
+  refreshes["loops"] = report.loopsWithRefreshes;
+  refreshes["busy"] = report.busy;
+
+  JsonObject latency = doc.createNestedObject("latency");
+  latency["count"] = report.latencies.size();
+  latency["p50"] = percentile(report.latencies, 50);
+  latency["p90"] = percentile(report.latencies, 90);
+  latency["p99"] = percentile(report.latencies, 99);
+  latency["max"] = report.latencies.empty() ? 0 : report.latencies.back();
+
+  doc["invisible"] = report.invisible;
+  doc["unrendered"] = report.unrendered;
+
+  std::string output;
+  serializeJsonPretty(doc, output);
+  output += '\n';
+
+  if (strcmp(path, "-") == 0) {
+    fwrite(output.data(), 1, output.size(), stdout);
+    return true;
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  file << output;
+
+  return file.good();
+}
+
+int main(int argc, char** argv) {
+  const char* panelName = nullptr;
+  const char* bitmapDir = nullptr;
+  const char* fontDir = nullptr;
+  const char* reportPath = nullptr;
+  const char* fullRefreshPeriod = nullptr;
+  long fullTime = -1;
+  long partialTime = -1;
+  bool windowed = false;
+  bool verbose = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "p:b:f:wR:F:P:o:V")) != -1) {
+    switch (opt) {
+      case 'p': panelName = optarg; break;
+      case 'b': bitmapDir = optarg; break;
+      case 'f': fontDir = optarg; break;
+      case 'w': windowed = true; break;
+      case 'R': fullRefreshPeriod = optarg; break;
+      case 'F': fullTime = atol(optarg); break;
+      case 'P': partialTime = atol(optarg); break;
+      case 'o': reportPath = optarg; break;
+      case 'V': verbose = true; break;
+      default:
+        usage();
+        return 1;
+    }
+  }
+
+  if (panelName == nullptr || argc - optind != 2) {
+    usage();
+    return 1;
+  }
+
+  const char* templatePath = argv[optind];
+  const char* tracePath = argv[optind + 1];
+
+  auto panelIt = DisplayTypeHelpers::PANELS_BY_NAME.find(panelName);
+  if (panelIt == DisplayTypeHelpers::PANELS_BY_NAME.end()) {
+    fprintf(stderr, "Unknown panel: %s.  One of:", panelName);
+    for (const auto& panel : DisplayTypeHelpers::PANELS_BY_NAME) {
+      fprintf(stderr, " %s", panel.first);
+    }
+    fprintf(stderr, "\n");
+    return 1;
+  }
+  const GxEPD2::Panel panel = panelIt->second;
+
+  // Matches the device: strftime has no timezone but the template's
+  setenv("TZ", "UTC", 1);
+  tzset();
+  Serial.setOutput(verbose ? stderr : nullptr);
+  NativeClock::set(0);
+
+  Report report;
+  std::vector<UpdateEvent> events;
+  std::string templateContents;
+
+  if (!readTrace(tracePath, events, report.truncated)) {
+    return 1;
+  }
+
+  if (report.truncated) {
+    fprintf(stderr, "%s: trace ends part way through an event, replaying the rest\n",
+        tracePath);
+  }
+
+  if (!readFile(templatePath, templateContents)) {
+    fprintf(stderr, "Couldn't read %s\n", templatePath);
+    return 1;
+  }
+
+  // SPIFFS is a scratch directory, so nothing is written next to the inputs
+  if (!writeSpiffsFile(TEMPLATE_FILENAME, templateContents)
+      || (bitmapDir != nullptr && !copyDirectory(bitmapDir, BITMAPS_DIRECTORY))
+      || (fontDir != nullptr && !copyDirectory(fontDir, FONTS_DIRECTORY))) {
+    return 1;
+  }
+
+  Settings settings;
+  settings.display.display_type = panel;
+  settings.display.windowed_updates = windowed;
+
+  if (fullRefreshPeriod != nullptr) {
+    settings.display.full_refresh_period = strtoull(fullRefreshPeriod, nullptr, 10);
+  }
+
+  GxEPD2_GFX* display = DisplayTypeHelpers::buildDisplay(panel,
+      settings.hardware.dc_pin,
+      settings.hardware.rst_pin,
+      settings.hardware.busy_pin,
+      settings.hardware.getSsPin());
+  DisplayTemplateDriver* driver = new DisplayTemplateDriver(display, settings);
+  driver->init();
+
+  bool changedRegion = false;
+  driver->onRegionUpdate([&changedRegion](TRegionId, TVariableName, TVariableValue) {
+    changedRegion = true;
+  });
+
+  driver->setTemplate(TEMPLATE_FILENAME);
+  driver->loop();
+  display->clearRefreshes();
+
+  // Arrival times of updates that are waiting to be rendered
+  std::vector<uint32_t> pending;
+  // The trace starts once the template is on the screen
+  const unsigned long start = nowMillis();
+  size_t next = 0;
+
+  while (next < events.size()) {
+    advanceTo(start + events[next].time);
+
+    // Everything that arrived while the last loop was busy is applied before
+    // the next one
+    while (next < events.size() && start + events[next].time <= nowMillis()) {
+      const UpdateEvent& event = events[next++];
+      changedRegion = false;
+
+      switch (event.type) {
+        case UpdateEventType::VARIABLE:
+          for (const auto& entry : event.values) {
+            driver->updateVariable(entry.first, entry.second);
+          }
+          break;
+        case UpdateEventType::BATCH:
+          driver->updateVariables(event.values);
+          break;
+        case UpdateEventType::SUSPEND:
+          driver->suspendRendering();
+          break;
+        case UpdateEventType::RESUME:
+          driver->resumeRendering();
+          break;
+      }
+
+      if (static_cast<size_t>(event.source) < SOURCES) {
+        ++report.events[static_cast<size_t>(event.source)];
+      }
+      report.variables += event.values.size();
+      report.duration = event.time;
+
+      if (event.type == UpdateEventType::VARIABLE || event.type == UpdateEventType::BATCH) {
+        if (changedRegion) {
+          pending.push_back(event.time);
+        } else {
+          ++report.invisible;
+        }
+      }
+    }
+
+    driver->loop();
+
+    const std::vector<GxEPD2_GFX::Refresh>& refreshes = display->getRefreshes();
+    if (refreshes.empty()) {
+      continue;
+    }
+
+    unsigned long busy = 0;
+    for (const GxEPD2_GFX::Refresh& refresh : refreshes) {
+      if (refresh.partial) {
+        busy += partialTime >= 0 ? partialTime : refresh.duration;
+        ++report.partialRefreshes;
+      } else {
+        busy += fullTime >= 0 ? fullTime : refresh.duration;
+        ++report.fullRefreshes;
+      }
+    }
+    display->clearRefreshes();
+
+    ++report.loopsWithRefreshes;
+    report.busy += busy;
+    advanceTo(nowMillis() + busy);
+
+    // Everything that was pending is on the screen once the loop's refreshes
+    // are done
+    for (uint32_t arrival : pending) {
+      report.latencies.push_back(nowMillis() - start - arrival);
+    }
+    pending.clear();
+  }
+
+  report.unrendered = pending.size();
+  std::sort(report.latencies.begin(), report.latencies.end());
+
+  // Keeps stdout for the JSON
+  printReport(reportPath != nullptr && strcmp(reportPath, "-") == 0 ? stderr : stdout, report);
+
+  bool ok = true;
+  if (reportPath != nullptr && !writeReport(reportPath, panel, report)) {
+    fprintf(stderr, "Couldn't write %s\n", reportPath);
+    ok = false;
+  }
+
+  delete driver;
+  delete display;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+// Checks templates with the same validator the firmware runs when a template
+// is uploaded, so that they can be checked in CI before they reach a display.
+//
+// Build with PlatformIO:
+//
+//   pio run -e validate_template
+//
+// Usage:
+//
+//   .pio/build/validate_template/program [-d data_dir] template.json...
+//
+// data_dir stands in for SPIFFS, so bitmaps and uploaded fonts are found the
+// same way as on the device (e.g. "/b/sun.bin" is data_dir/b/sun.bin).  It
+// defaults to the current directory.  Exits with status 1 if any template is
+// invalid.
+//
+// Memory use depends on the platform, so unlike on the device, templates
+// aren't checked against JSON_TEMPLATE_BUFFER_SIZE.
+
+#include <Arduino.h>
+#include <FS.h>
+#include <FontStore.h>
+#include <TemplateValidator.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+
+static const size_t HOST_DOCUMENT_SIZE = 1024 * 1024;
+
+static bool validateFile(TemplateValidator& validator, const char* filename) {
+  std::ifstream file(filename);
+
+  if (!file) {
+    fprintf(stderr, "%s: could not open file\n", filename);
+    return false;
+  }
+
+  DynamicJsonDocument tmpl(HOST_DOCUMENT_SIZE);
+  DynamicJsonDocument result(HOST_DOCUMENT_SIZE);
+  JsonArray errors = result.to<JsonArray>();
+  DeserializationError error = deserializeJson(tmpl, file);
+
+  if (error) {
+    TemplateValidator::addParseError(error, errors);
+  } else {
+    validator.validate(tmpl, errors);
+  }
+
+  for (JsonObject e : errors) {
+    const char* path = e["path"];
+
+    printf("%s: %s: %s\n", filename, *path ? path : "/", e["message"].as<const char*>());
+  }
+
+  return errors.size() == 0;
+}
+
+int main(int argc, char** argv) {
+  const char* dataDir = ".";
+  int i = 1;
+
+  if (i + 1 < argc && strcmp(argv[i], "-d") == 0) {
+    dataDir = argv[i + 1];
+    i += 2;
+  }
+
+  if (i >= argc) {
+    fprintf(stderr, "Usage: %s [-d data_dir] template.json...\n", argv[0]);
+    return 2;
+  }
+
+  // Only read from, so the files in data_dir are left alone
+  SPIFFS.setRoot(dataDir);
+  // Warnings, e.g. about fonts that aren't valid, go with the errors
+  Serial.setOutput(stderr);
+
+  // Same lookups as DisplayTemplateDriver::checkTemplate
+  FontStore fonts;
+  TemplateValidator validator(
+      [](const char* path) { return SPIFFS.exists(path); },
+      [&fonts](const char* name) { return fonts.contains(name); });
+  bool valid = true;
+
+  for (; i < argc; ++i) {
+    valid = validateFile(validator, argv[i]) && valid;
+  }
+
+  return valid ? 0 : 1;
+}
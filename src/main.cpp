@@ -15,6 +15,7 @@
 #include <ESP8266WebServer.h>
 #define WEBSERVER_H
 #endif
+#include <AtomicFileWriter.h>
 #include <DisplayTemplateDriver.h>
 #include <DisplayTypeHelpers.h>
 #include <ESPAsyncWebServer.h>
@@ -27,6 +28,7 @@
 #include <NTPClient.h>
 #include <Settings.h>
 #include <Timezone.h>
+#include <UpdateTraceRecorder.h>
 #include <WiFiManager.h>
 #include <WiFiUdp.h>
 
@@ -38,6 +40,7 @@ DisplayTemplateDriver* driver = NULL;
 EpaperWebServer* webServer = NULL;
 MqttClient* mqttClient = NULL;
 NTPClient* timeClient;
+UpdateTraceRecorder traceRecorder;
 
 // Don't attempt to reconnect to wifi if we've never connected
 volatile bool hasConnected = false;
@@ -137,11 +140,36 @@ void applySettings() {
         settings.mqtt.variables_topic_pattern,
         settings.mqtt.username,
         settings.mqtt.password,
-        settings.mqtt.client_status_topic);
+        settings.mqtt.client_status_topic,
+        settings.mqtt.variables_batch_topic);
     mqttClient->onVariableUpdate(
         [](const String& variable, const String& value) {
+          traceRecorder.recordVariable(UpdateSource::MQTT, variable, value);
           driver->updateVariable(variable, value);
         });
+    mqttClient->onVariableBatchUpdate([](const VariableBatch& batch) {
+      traceRecorder.recordBatch(UpdateSource::MQTT, batch);
+      driver->updateVariables(batch);
+    });
+    mqttClient->addExtractionRules(settings.mqtt.extraction_rules);
+    mqttClient->onBootstrap([](bool active, uint32_t messages) {
+      if (active) {
+        traceRecorder.recordSuspend(UpdateSource::MQTT);
+        driver->suspendRendering();
+      } else {
+        traceRecorder.recordResume(UpdateSource::MQTT);
+        uint32_t saved = driver->resumeRendering();
+
+        Serial.printf_P(
+            PSTR("MQTT bootstrap: %u messages, %u refreshes saved\n"),
+            messages,
+            saved);
+        traceRecorder.recordVariable(UpdateSource::SYSTEM,
+            MqttClient::BOOTSTRAP_REFRESHES_SAVED_VARIABLE, String(saved));
+        driver->updateVariable(
+            MqttClient::BOOTSTRAP_REFRESHES_SAVED_VARIABLE, String(saved));
+      }
+    });
     mqttClient->begin();
   }
 
@@ -150,7 +178,7 @@ void applySettings() {
   }
 
   if (webServer == NULL) {
-    webServer = new EpaperWebServer(driver, settings);
+    webServer = new EpaperWebServer(driver, settings, traceRecorder);
     webServer->onSettingsChange(applySettings);
     webServer->onCancelSleep(cancelSleep);
     webServer->begin();
@@ -176,6 +204,7 @@ void updateWiFiState(WiFiState state) {
   const String varValue =
       state == WiFiState::CONNECTED ? "connected" : "disconnected";
 
+  traceRecorder.recordVariable(UpdateSource::SYSTEM, varName, varValue);
   driver->updateVariable(varName, varValue);
 }
 
@@ -228,6 +257,9 @@ void setup() {
       .done()
       .init();
 
+  // Finish any file write that was interrupted by losing power
+  AtomicFileWriter::recover();
+
   initDisplay();
 
   WiFiManager wifiManager;
@@ -267,13 +299,22 @@ void loop() {
 
   if (timeClient != NULL && timeClient->update() && lastSecond != second()) {
     lastSecond = second();
-    driver->updateVariable("timestamp", String(timeClient->getEpochTime()));
+
+    const String timestamp(timeClient->getEpochTime());
+    traceRecorder.recordVariable(UpdateSource::SYSTEM, "timestamp", timestamp);
+    driver->updateVariable("timestamp", timestamp);
   }
 
   if (webServer) {
     webServer->handleClient();
   }
 
+  if (mqttClient) {
+    mqttClient->loop();
+  }
+
+  traceRecorder.loop();
+
   if (!suspendSleep && initialSleepMode == SleepMode::DEEP_SLEEP) {
     if (digitalRead(settings.power.sleep_override_pin) == settings.power.sleep_override_value) {
       Serial.println(F("Sleep override pin was held.  Suspending deep sleep."));
@@ -0,0 +1,151 @@
+#include <Arduino.h>
+#include <NativeClock.h>
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+static const auto START = std::chrono::steady_clock::now();
+
+static bool frozen = false;
+static uint64_t frozenMicros = 0;
+
+void NativeClock::set(uint64_t micros) {
+  frozen = true;
+  frozenMicros = micros;
+}
+
+void NativeClock::advance(uint64_t micros) {
+  if (frozen) {
+    frozenMicros += micros;
+  }
+}
+
+void NativeClock::release() {
+  frozen = false;
+}
+
+bool NativeClock::isFrozen() {
+  return frozen;
+}
+
+uint64_t NativeClock::now() {
+  if (frozen) {
+    return frozenMicros;
+  }
+
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - START)
+      .count();
+}
+
+// Both wrap around like they do on the device
+unsigned long millis() {
+  return static_cast<uint32_t>(NativeClock::now() / 1000);
+}
+
+unsigned long micros() {
+  return static_cast<uint32_t>(NativeClock::now());
+}
+
+void delay(unsigned long ms) {
+  delayMicroseconds(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  if (NativeClock::isFrozen()) {
+    NativeClock::advance(us);
+  } else {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+  }
+}
+
+void yield() {}
+
+static std::minstd_rand& generator() {
+  static std::minstd_rand instance;
+  return instance;
+}
+
+long random(long max) {
+  return random(0, max);
+}
+
+long random(long min, long max) {
+  if (min >= max) {
+    return min;
+  }
+
+  return min + static_cast<long>(generator()() % static_cast<unsigned long>(max - min));
+}
+
+void randomSeed(unsigned long seed) {
+  if (seed != 0) {
+    generator().seed(seed);
+  }
+}
+
+HardwareSerial::HardwareSerial()
+    : out(stderr) {}
+
+void HardwareSerial::begin(unsigned long) {}
+
+void HardwareSerial::end() {}
+
+void HardwareSerial::setOutput(FILE* out) {
+  this->out = out;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (out != nullptr) {
+    fputc(c, out);
+  }
+
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  if (out != nullptr) {
+    fwrite(buffer, 1, size, out);
+  }
+
+  return size;
+}
+
+int HardwareSerial::available() {
+  return 0;
+}
+
+int HardwareSerial::read() {
+  return -1;
+}
+
+int HardwareSerial::peek() {
+  return -1;
+}
+
+void HardwareSerial::flush() {
+  if (out != nullptr) {
+    fflush(out);
+  }
+}
+
+HardwareSerial::operator bool() const {
+  return true;
+}
+
+HardwareSerial Serial;
+
+uint32_t EspClass::getFreeHeap() {
+  return 0;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  return 0;
+}
+
+uint32_t EspClass::getHeapSize() {
+  return 0;
+}
+
+EspClass ESP;
@@ -0,0 +1,86 @@
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <Print.h>
+#include <Stream.h>
+#include <WString.h>
+#include <pgmspace.h>
+
+#pragma once
+
+// Just enough of the Arduino core to build lib/ on the host (see
+// test/native/README.md).  Time comes from the system clock unless it's
+// frozen with NativeClock.
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x02
+#define INPUT_PULLUP 0x05
+
+// ESP32's SPI bus numbers, which HardwareSettings stores
+#define HSPI 2
+#define VSPI 3
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+#define constrain(amt, low, high) \
+  ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// Writes to stderr, so that it doesn't mix with output a program writes to
+// stdout.  setOutput(nullptr) discards everything.
+class HardwareSerial : public Stream {
+public:
+  HardwareSerial();
+
+  void begin(unsigned long baud);
+  void end();
+  void setOutput(FILE* out);
+
+  virtual size_t write(uint8_t c) override;
+  virtual size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+
+  virtual int available() override;
+  virtual int read() override;
+  virtual int peek() override;
+  virtual void flush() override;
+
+  operator bool() const;
+
+private:
+  FILE* out;
+};
+
+extern HardwareSerial Serial;
+
+// The host has no fixed heap, so these report 0
+class EspClass {
+public:
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getHeapSize();
+};
+
+extern EspClass ESP;
@@ -0,0 +1,4 @@
+#pragma once
+
+// Settings.h includes RichHttpServer's AuthProviders.h, but nothing built on
+// the host uses it
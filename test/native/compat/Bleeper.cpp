@@ -0,0 +1,3 @@
+#include <Bleeper.h>
+
+BleeperClass Bleeper;
@@ -0,0 +1,54 @@
+#include <Arduino.h>
+
+#include <map>
+
+#pragma once
+
+// Stands in for Bleeper's configuration classes.  Each setting is a plain
+// member initialized to its default: nothing is persisted, the dictionary
+// methods do nothing, and observers are never notified.
+
+typedef std::map<String, String> ConfigurationDictionary;
+
+struct ConfigurationPropertyChange {
+  String key;
+  String oldValue;
+  String newValue;
+};
+
+class ConfigurationObserver {
+public:
+  virtual ~ConfigurationObserver() {}
+  virtual void onConfigurationChanged(const ConfigurationPropertyChange value) = 0;
+};
+
+class Configuration {
+public:
+  virtual ~Configuration() {}
+
+  void setFromDictionary(const ConfigurationDictionary&) {}
+  ConfigurationDictionary getAsDictionary(bool = false) { return ConfigurationDictionary(); }
+};
+
+class RootConfiguration : public Configuration {};
+
+#define persistentVar(type, name, defaultValue, fromString, toString) \
+  type name = defaultValue;                                           \
+  String name##String;
+
+#define persistentStringVar(name, defaultValue) String name = defaultValue;
+#define persistentIntVar(name, defaultValue) int name = defaultValue;
+#define subconfig(type, name) type name;
+
+class BleeperStorage {
+public:
+  void persist() {}
+  void load() {}
+};
+
+class BleeperClass {
+public:
+  BleeperStorage storage;
+};
+
+extern BleeperClass Bleeper;
@@ -0,0 +1,537 @@
+#include <FS.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace fs {
+
+class FileImpl {
+public:
+  std::string path;
+  std::string hostPath;
+
+  // Regular files
+  std::vector<uint8_t> data;
+  size_t pos = 0;
+  bool readable = false;
+  bool writable = false;
+  bool append = false;
+  bool dirty = false;
+  bool open = false;
+
+  // Directories.  Paths of the files under the directory, relative to the
+  // filesystem's root.
+  bool directory = false;
+  std::vector<std::string> entries;
+  size_t nextEntry = 0;
+  FS* fs = nullptr;
+
+  ~FileImpl() { close(); }
+
+  bool flush() {
+    if (!open || !dirty) {
+      return true;
+    }
+
+    FILE* f = fopen(hostPath.c_str(), "wb");
+
+    if (f == nullptr) {
+      return false;
+    }
+
+    const bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    fclose(f);
+    dirty = false;
+
+    return ok;
+  }
+
+  void close() {
+    flush();
+    open = false;
+    data.clear();
+    data.shrink_to_fit();
+    entries.clear();
+  }
+};
+
+}  // namespace fs
+
+using fs::FileImpl;
+
+static bool isDirectory(const std::string& path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static bool isFile(const std::string& path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+static bool makeDirectories(const std::string& path) {
+  if (path.empty() || isDirectory(path)) {
+    return true;
+  }
+
+  const size_t slash = path.find_last_of('/');
+
+  if (slash != std::string::npos && slash > 0 && !makeDirectories(path.substr(0, slash))) {
+    return false;
+  }
+
+  return ::mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+static std::string parentOf(const std::string& path) {
+  const size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? std::string() : path.substr(0, slash);
+}
+
+// SPIFFS paths are flat, so every file under dir is listed, at any depth
+static void listFiles(
+    const std::string& hostDir, const std::string& dir, std::vector<std::string>& result) {
+  DIR* d = opendir(hostDir.c_str());
+
+  if (d == nullptr) {
+    return;
+  }
+
+  while (struct dirent* entry = readdir(d)) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+      continue;
+    }
+
+    const std::string hostPath = hostDir + "/" + entry->d_name;
+    const std::string path = dir + "/" + entry->d_name;
+
+    if (isDirectory(hostPath)) {
+      listFiles(hostPath, path, result);
+    } else {
+      result.push_back(path);
+    }
+  }
+
+  closedir(d);
+}
+
+// Directories created by getRoot(), removed when the process exits
+static std::vector<std::string> temporaryRoots;
+
+static void removeTree(const std::string& hostDir) {
+  DIR* d = opendir(hostDir.c_str());
+
+  if (d != nullptr) {
+    while (struct dirent* entry = readdir(d)) {
+      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+        continue;
+      }
+
+      const std::string hostPath = hostDir + "/" + entry->d_name;
+      struct stat info;
+
+      // lstat, so that links are removed rather than followed
+      if (lstat(hostPath.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+        removeTree(hostPath);
+      } else {
+        unlink(hostPath.c_str());
+      }
+    }
+
+    closedir(d);
+  }
+
+  rmdir(hostDir.c_str());
+}
+
+static void removeTemporaryRoots() {
+  for (const std::string& root : temporaryRoots) {
+    removeTree(root);
+  }
+}
+
+namespace fs {
+
+File::File(FileImplPtr impl)
+    : impl(impl) {}
+
+size_t File::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+  if (!*this || !impl->writable) {
+    return 0;
+  }
+
+  if (impl->append) {
+    impl->pos = impl->data.size();
+  }
+
+  if (impl->pos + size > impl->data.size()) {
+    impl->data.resize(impl->pos + size);
+  }
+
+  memcpy(impl->data.data() + impl->pos, buffer, size);
+  impl->pos += size;
+  impl->dirty = true;
+
+  return size;
+}
+
+int File::available() {
+  if (!*this || impl->directory) {
+    return 0;
+  }
+
+  return impl->pos < impl->data.size() ? impl->data.size() - impl->pos : 0;
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek() {
+  if (available() <= 0) {
+    return -1;
+  }
+
+  return impl->data[impl->pos];
+}
+
+void File::flush() {
+  if (*this) {
+    impl->flush();
+  }
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+  if (!*this || !impl->readable) {
+    return 0;
+  }
+
+  const size_t n = std::min<size_t>(size, available());
+  memcpy(buffer, impl->data.data() + impl->pos, n);
+  impl->pos += n;
+
+  return n;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!*this || impl->directory) {
+    return false;
+  }
+
+  size_t target;
+
+  switch (mode) {
+    case SeekCur:
+      target = impl->pos + pos;
+      break;
+    case SeekEnd:
+      target = impl->data.size() + pos;
+      break;
+    default:
+      target = pos;
+      break;
+  }
+
+  // SPIFFS can't seek past the end of a file
+  if (target > impl->data.size()) {
+    return false;
+  }
+
+  impl->pos = target;
+  return true;
+}
+
+size_t File::position() const {
+  return *this ? impl->pos : 0;
+}
+
+size_t File::size() const {
+  return *this ? impl->data.size() : 0;
+}
+
+void File::close() {
+  if (impl) {
+    impl->close();
+    impl.reset();
+  }
+}
+
+File::operator bool() const {
+  return impl && impl->open;
+}
+
+time_t File::getLastWrite() {
+  struct stat info;
+
+  if (!*this || stat(impl->hostPath.c_str(), &info) != 0) {
+    return 0;
+  }
+
+  return info.st_mtime;
+}
+
+const char* File::name() const {
+  return *this ? impl->path.c_str() : nullptr;
+}
+
+bool File::isDirectory() const {
+  return *this && impl->directory;
+}
+
+File File::openNextFile(const char* mode) {
+  if (!isDirectory() || impl->nextEntry >= impl->entries.size()) {
+    return File();
+  }
+
+  return impl->fs->open(impl->entries[impl->nextEntry++].c_str(), mode);
+}
+
+void File::rewindDirectory() {
+  if (isDirectory()) {
+    impl->nextEntry = 0;
+  }
+}
+
+FS::FS(const char* root)
+    : root(root != nullptr ? root : "") {}
+
+bool FS::begin(bool) {
+  return getRoot()[0] != '\0';
+}
+
+void FS::end() {}
+
+bool FS::format() {
+  std::vector<std::string> files;
+  listFiles(getRoot(), "", files);
+
+  for (const std::string& file : files) {
+    remove(file.c_str());
+  }
+
+  return true;
+}
+
+void FS::setRoot(const char* root) {
+  this->root = root;
+
+  while (this->root.length() > 1 && this->root.back() == '/') {
+    this->root.pop_back();
+  }
+
+  makeDirectories(this->root);
+}
+
+const char* FS::getRoot() {
+  if (root.empty()) {
+    const char* tmp = getenv("TMPDIR");
+    std::string pattern = std::string(tmp != nullptr ? tmp : "/tmp") + "/spiffs.XXXXXX";
+    std::vector<char> buffer(pattern.begin(), pattern.end());
+    buffer.push_back('\0');
+
+    if (mkdtemp(buffer.data()) != nullptr) {
+      root = buffer.data();
+      temporaryRoots.push_back(root);
+
+      if (temporaryRoots.size() == 1) {
+        atexit(removeTemporaryRoots);
+      }
+    }
+  }
+
+  return root.c_str();
+}
+
+std::string FS::hostPath(const char* path) {
+  std::string result = getRoot();
+
+  if (path[0] != '/') {
+    result += '/';
+  }
+
+  result += path;
+
+  while (result.length() > root.length() + 1 && result.back() == '/') {
+    result.pop_back();
+  }
+
+  return result;
+}
+
+File FS::open(const char* path, const char* mode) {
+  if (path == nullptr || path[0] != '/') {
+    return File();
+  }
+
+  std::shared_ptr<FileImpl> impl = std::make_shared<FileImpl>();
+  impl->path = path;
+  impl->hostPath = hostPath(path);
+
+  if (isDirectory(impl->hostPath)) {
+    if (mode[0] != 'r') {
+      return File();
+    }
+
+    impl->directory = true;
+    impl->fs = this;
+    impl->readable = true;
+    listFiles(impl->hostPath, impl->path == "/" ? "" : impl->path, impl->entries);
+    std::sort(impl->entries.begin(), impl->entries.end());
+    impl->open = true;
+
+    return File(impl);
+  }
+
+  const bool exists = isFile(impl->hostPath);
+  const bool update = strchr(mode, '+') != nullptr;
+
+  switch (mode[0]) {
+    case 'r':
+      if (!exists) {
+        return File();
+      }
+      impl->readable = true;
+      impl->writable = update;
+      break;
+    case 'w':
+      impl->readable = update;
+      impl->writable = true;
+      // Truncated, and created if it doesn't exist
+      impl->dirty = true;
+      break;
+    case 'a':
+      impl->readable = update;
+      impl->writable = true;
+      impl->append = true;
+      impl->dirty = !exists;
+      break;
+    default:
+      return File();
+  }
+
+  if (impl->writable && !makeDirectories(parentOf(impl->hostPath))) {
+    return File();
+  }
+
+  if (exists && mode[0] != 'w') {
+    FILE* f = fopen(impl->hostPath.c_str(), "rb");
+
+    if (f == nullptr) {
+      return File();
+    }
+
+    char buffer[4096];
+    size_t n;
+
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+      impl->data.insert(impl->data.end(), buffer, buffer + n);
+    }
+
+    fclose(f);
+  }
+
+  impl->open = true;
+
+  // Writes the empty file right away, like SPIFFS does
+  if (impl->dirty && !impl->flush()) {
+    return File();
+  }
+
+  return File(impl);
+}
+
+bool FS::exists(const char* path) {
+  if (path == nullptr || path[0] != '/') {
+    return false;
+  }
+
+  const std::string host = hostPath(path);
+  return isFile(host) || isDirectory(host);
+}
+
+bool FS::remove(const char* path) {
+  if (path == nullptr || path[0] != '/') {
+    return false;
+  }
+
+  std::string host = hostPath(path);
+
+  if (!isFile(host) || unlink(host.c_str()) != 0) {
+    return false;
+  }
+
+  // Directories only exist as long as there are files in them
+  while ((host = parentOf(host)).length() > root.length() && ::rmdir(host.c_str()) == 0) {
+  }
+
+  return true;
+}
+
+bool FS::rename(const char* pathFrom, const char* pathTo) {
+  if (pathFrom == nullptr || pathTo == nullptr || pathFrom[0] != '/' || pathTo[0] != '/') {
+    return false;
+  }
+
+  const std::string from = hostPath(pathFrom);
+  const std::string to = hostPath(pathTo);
+
+  // SPIFFS won't replace an existing file
+  if (!isFile(from) || exists(pathTo) || !makeDirectories(parentOf(to))) {
+    return false;
+  }
+
+  if (::rename(from.c_str(), to.c_str()) != 0) {
+    return false;
+  }
+
+  std::string host = from;
+
+  while ((host = parentOf(host)).length() > root.length() && ::rmdir(host.c_str()) == 0) {
+  }
+
+  return true;
+}
+
+bool FS::mkdir(const char* path) {
+  return path != nullptr && path[0] == '/' && makeDirectories(hostPath(path));
+}
+
+bool FS::rmdir(const char* path) {
+  return path != nullptr && path[0] == '/' && ::rmdir(hostPath(path).c_str()) == 0;
+}
+
+size_t FS::totalBytes() {
+  return 0;
+}
+
+size_t FS::usedBytes() {
+  std::vector<std::string> files;
+  size_t used = 0;
+  struct stat info;
+
+  listFiles(getRoot(), "", files);
+
+  for (const std::string& file : files) {
+    if (stat(hostPath(file.c_str()).c_str(), &info) == 0) {
+      used += info.st_size;
+    }
+  }
+
+  return used;
+}
+
+}  // namespace fs
+
+fs::FS SPIFFS;
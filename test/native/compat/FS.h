@@ -0,0 +1,117 @@
+#include <Arduino.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#pragma once
+
+// ESP32's File and FS, backed by a directory on the host.  SPIFFS has no
+// directories, so parent directories are created as files are written, and
+// opening a directory lists every file under it.
+//
+// An open File keeps the whole file in memory, and writes it back to disk on
+// flush() and close().
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class FileImpl;
+typedef std::shared_ptr<FileImpl> FileImplPtr;
+
+class File : public Stream {
+public:
+  File(FileImplPtr impl = FileImplPtr());
+
+  virtual size_t write(uint8_t c) override;
+  virtual size_t write(const uint8_t* buffer, size_t size) override;
+
+  virtual int available() override;
+  virtual int read() override;
+  virtual int peek() override;
+  virtual void flush() override;
+  size_t read(uint8_t* buffer, size_t size);
+  virtual size_t readBytes(char* buffer, size_t length) override {
+    return read(reinterpret_cast<uint8_t*>(buffer), length);
+  }
+  using Stream::readBytes;
+
+  bool seek(uint32_t pos, SeekMode mode);
+  bool seek(uint32_t pos) { return seek(pos, SeekSet); }
+  size_t position() const;
+  size_t size() const;
+  void close();
+  operator bool() const;
+  time_t getLastWrite();
+  const char* name() const;
+
+  bool isDirectory() const;
+  File openNextFile(const char* mode = FILE_READ);
+  void rewindDirectory();
+
+private:
+  FileImplPtr impl;
+};
+
+class FS {
+public:
+  // root is the host directory that holds the filesystem's files
+  explicit FS(const char* root = nullptr);
+
+  bool begin(bool formatOnFail = false);
+  void end();
+  bool format();
+
+  // Host only.  Defaults to a new temporary directory, which is removed when
+  // the process exits.
+  void setRoot(const char* root);
+  const char* getRoot();
+
+  File open(const char* path, const char* mode = FILE_READ);
+  File open(const String& path, const char* mode = FILE_READ) {
+    return open(path.c_str(), mode);
+  }
+
+  bool exists(const char* path);
+  bool exists(const String& path) { return exists(path.c_str()); }
+
+  bool remove(const char* path);
+  bool remove(const String& path) { return remove(path.c_str()); }
+
+  bool rename(const char* pathFrom, const char* pathTo);
+  bool rename(const String& pathFrom, const String& pathTo) {
+    return rename(pathFrom.c_str(), pathTo.c_str());
+  }
+
+  bool mkdir(const char* path);
+  bool mkdir(const String& path) { return mkdir(path.c_str()); }
+
+  bool rmdir(const char* path);
+  bool rmdir(const String& path) { return rmdir(path.c_str()); }
+
+  size_t totalBytes();
+  size_t usedBytes();
+
+private:
+  std::string root;
+
+  std::string hostPath(const char* path);
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekMode;
+using fs::SeekSet;
+
+// Like the ESP8266 core, FS.h declares SPIFFS so that code written for either
+// core finds it
+extern fs::FS SPIFFS;
@@ -0,0 +1,42 @@
+#include <Arduino.h>
+
+#pragma once
+
+// Colors and panel types from GxEPD2 1.2.14
+
+#define GxEPD_BLACK 0x0000
+#define GxEPD_DARKGREY 0x7BEF
+#define GxEPD_LIGHTGREY 0xC618
+#define GxEPD_WHITE 0xFFFF
+#define GxEPD_RED 0xF800
+#define GxEPD_YELLOW 0xFFE0
+#define GxEPD_COLORED GxEPD_RED
+
+class GxEPD2 {
+public:
+  enum Panel {
+    GDEP015OC1,
+    GDEH0213B72,
+    GDEH0213B73,
+    GDE0213B1,
+    GDEW0213I5F,
+    GDEH029A1,
+    GDEW029T5,
+    GDEW026T0,
+    GDEW027W3,
+    GDEW0371W7,
+    GDEW042T2,
+    GDEW0583T7,
+    GDEW075T8,
+    GDEW075T7,
+    ED060SCT,
+    GDEW0154Z04,
+    GDEW0213Z16,
+    GDEW029Z10,
+    GDEW027C44,
+    GDEW042Z15,
+    GDEW0583Z21,
+    GDEW075Z09,
+    GDEW075Z08
+  };
+};
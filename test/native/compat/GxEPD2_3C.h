@@ -0,0 +1,145 @@
+#include <GxEPD2_EPD.h>
+#include <GxEPD2_GFX.h>
+
+#include <string.h>
+
+#pragma once
+
+// Three color displays.  Like GxEPD2_BW, the buffers match GxEPD2 1.2.14's:
+// a pixel is black if its bit is clear in _black_buffer, otherwise colored if
+// its bit is clear in _color_buffer.
+template <typename GxEPD2_Type, const uint16_t page_height>
+class GxEPD2_3C : public GxEPD2_GFX {
+public:
+  GxEPD2_Type epd2;
+
+  GxEPD2_3C(GxEPD2_Type epd2_instance)
+      : GxEPD2_GFX(epd2, GxEPD2_Type::WIDTH, GxEPD2_Type::HEIGHT)
+      , epd2(epd2_instance)
+      , _mirror(false)
+      , _reverse(GxEPD2_Type::panel == GxEPD2::GDEW0213Z16)
+      , _using_partial_mode(false) {
+    static_assert(page_height == GxEPD2_Type::HEIGHT, "only full height pages are supported");
+    memset(_black_buffer, 0xFF, sizeof(_black_buffer));
+    memset(_color_buffer, 0xFF, sizeof(_color_buffer));
+    setFullWindow();
+  }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    if (x < 0 || x >= width() || y < 0 || y >= height()) {
+      return;
+    }
+
+    if (_mirror) {
+      x = width() - x - 1;
+    }
+
+    int16_t t;
+
+    switch (getRotation()) {
+      case 1:
+        t = x;
+        x = GxEPD2_Type::WIDTH - y - 1;
+        y = t;
+        break;
+      case 2:
+        x = GxEPD2_Type::WIDTH - x - 1;
+        y = GxEPD2_Type::HEIGHT - y - 1;
+        break;
+      case 3:
+        t = x;
+        x = y;
+        y = GxEPD2_Type::HEIGHT - t - 1;
+        break;
+    }
+
+    if (_reverse) {
+      y = page_height - y - 1;
+    }
+
+    const size_t i = x / 8 + static_cast<size_t>(y) * (GxEPD2_Type::WIDTH / 8);
+    const uint8_t mask = 1 << (7 - x % 8);
+
+    if (color == GxEPD_WHITE) {
+      _black_buffer[i] |= mask;
+      _color_buffer[i] |= mask;
+    } else if (color == GxEPD_BLACK) {
+      _black_buffer[i] &= ~mask;
+      _color_buffer[i] |= mask;
+    } else {
+      _black_buffer[i] |= mask;
+      _color_buffer[i] &= ~mask;
+    }
+  }
+
+  void init(uint32_t serial_diag_bitrate = 0) override {
+    epd2.init(serial_diag_bitrate);
+    _using_partial_mode = false;
+    setFullWindow();
+  }
+
+  void fillScreen(uint16_t color) override {
+    uint8_t black = 0xFF;
+    uint8_t red = 0xFF;
+
+    if (color == GxEPD_BLACK) {
+      black = 0x00;
+    } else if (color == GxEPD_RED || color == GxEPD_YELLOW) {
+      red = 0x00;
+    }
+
+    memset(_black_buffer, black, sizeof(_black_buffer));
+    memset(_color_buffer, red, sizeof(_color_buffer));
+  }
+
+  void display(bool partial_update_mode = false) override {
+    recordRefresh(partial_update_mode, 0, 0, width(), height());
+  }
+
+  void displayWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h) override {
+    recordRefresh(true, x, y, w, h);
+  }
+
+  void setFullWindow() override {
+    _using_partial_mode = false;
+    _pw_x = 0;
+    _pw_y = 0;
+    _pw_w = width();
+    _pw_h = height();
+  }
+
+  void setPartialWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h) override {
+    _using_partial_mode = true;
+    _pw_x = x;
+    _pw_y = y;
+    _pw_w = w;
+    _pw_h = h;
+  }
+
+  void firstPage() override {}
+
+  bool nextPage() override {
+    recordRefresh(_using_partial_mode, _pw_x, _pw_y, _pw_w, _pw_h);
+    return false;
+  }
+
+  void refresh(bool partial_update_mode = false) override {
+    recordRefresh(partial_update_mode, 0, 0, width(), height());
+  }
+
+  void refresh(int16_t x, int16_t y, int16_t w, int16_t h) override {
+    recordRefresh(true, x, y, w, h);
+  }
+
+  void powerOff() override { epd2.powerOff(); }
+  void hibernate() override { epd2.hibernate(); }
+  void mirror(bool m) override { _mirror = m; }
+
+private:
+  uint8_t _black_buffer[(GxEPD2_Type::WIDTH / 8) * page_height];
+  uint8_t _color_buffer[(GxEPD2_Type::WIDTH / 8) * page_height];
+  bool _mirror;
+  bool _reverse;
+  bool _using_partial_mode;
+  uint16_t _pw_x, _pw_y, _pw_w, _pw_h;
+};
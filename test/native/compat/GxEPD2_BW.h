@@ -0,0 +1,125 @@
+#include <GxEPD2_EPD.h>
+#include <GxEPD2_GFX.h>
+
+#include <string.h>
+
+#pragma once
+
+// Black and white displays.  The buffer has the same layout and the same
+// name as GxEPD2 1.2.14's, so that DisplayTypeHelpers::getFramebuffer works
+// on the host: one bit per pixel, MSB first, set for white.
+//
+// Only full height pages are supported, which is how buildDisplay builds
+// displays.
+template <typename GxEPD2_Type, const uint16_t page_height>
+class GxEPD2_BW : public GxEPD2_GFX {
+public:
+  GxEPD2_Type epd2;
+
+  GxEPD2_BW(GxEPD2_Type epd2_instance)
+      : GxEPD2_GFX(epd2, GxEPD2_Type::WIDTH, GxEPD2_Type::HEIGHT)
+      , epd2(epd2_instance)
+      , _mirror(false)
+      , _using_partial_mode(false) {
+    static_assert(page_height == GxEPD2_Type::HEIGHT, "only full height pages are supported");
+    memset(_buffer, 0xFF, sizeof(_buffer));
+    setFullWindow();
+  }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    if (x < 0 || x >= width() || y < 0 || y >= height()) {
+      return;
+    }
+
+    if (_mirror) {
+      x = width() - x - 1;
+    }
+
+    int16_t t;
+
+    switch (getRotation()) {
+      case 1:
+        t = x;
+        x = GxEPD2_Type::WIDTH - y - 1;
+        y = t;
+        break;
+      case 2:
+        x = GxEPD2_Type::WIDTH - x - 1;
+        y = GxEPD2_Type::HEIGHT - y - 1;
+        break;
+      case 3:
+        t = x;
+        x = y;
+        y = GxEPD2_Type::HEIGHT - t - 1;
+        break;
+    }
+
+    const size_t i = x / 8 + static_cast<size_t>(y) * (GxEPD2_Type::WIDTH / 8);
+    const uint8_t mask = 1 << (7 - x % 8);
+
+    if (color == GxEPD_WHITE) {
+      _buffer[i] |= mask;
+    } else {
+      _buffer[i] &= ~mask;
+    }
+  }
+
+  void init(uint32_t serial_diag_bitrate = 0) override {
+    epd2.init(serial_diag_bitrate);
+    _using_partial_mode = false;
+    setFullWindow();
+  }
+
+  void fillScreen(uint16_t color) override {
+    memset(_buffer, color == GxEPD_BLACK ? 0x00 : 0xFF, sizeof(_buffer));
+  }
+
+  void display(bool partial_update_mode = false) override {
+    recordRefresh(partial_update_mode, 0, 0, width(), height());
+  }
+
+  void displayWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h) override {
+    recordRefresh(true, x, y, w, h);
+  }
+
+  void setFullWindow() override {
+    _using_partial_mode = false;
+    _pw_x = 0;
+    _pw_y = 0;
+    _pw_w = width();
+    _pw_h = height();
+  }
+
+  void setPartialWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h) override {
+    _using_partial_mode = true;
+    _pw_x = x;
+    _pw_y = y;
+    _pw_w = w;
+    _pw_h = h;
+  }
+
+  void firstPage() override {}
+
+  bool nextPage() override {
+    recordRefresh(_using_partial_mode, _pw_x, _pw_y, _pw_w, _pw_h);
+    return false;
+  }
+
+  void refresh(bool partial_update_mode = false) override {
+    recordRefresh(partial_update_mode, 0, 0, width(), height());
+  }
+
+  void refresh(int16_t x, int16_t y, int16_t w, int16_t h) override {
+    recordRefresh(true, x, y, w, h);
+  }
+
+  void powerOff() override { epd2.powerOff(); }
+  void hibernate() override { epd2.hibernate(); }
+  void mirror(bool m) override { _mirror = m; }
+
+private:
+  uint8_t _buffer[(GxEPD2_Type::WIDTH / 8) * page_height];
+  bool _mirror;
+  bool _using_partial_mode;
+  uint16_t _pw_x, _pw_y, _pw_w, _pw_h;
+};
@@ -0,0 +1,90 @@
+#include <Arduino.h>
+#include <GxEPD2.h>
+
+#pragma once
+
+// Panel drivers.  There's no hardware on the host, so a panel is only its
+// dimensions and capabilities.  Sizes match DisplayTypeHelpers::PANEL_SIZES.
+//
+// The refresh times, in milliseconds, are roughly how long each panel stays
+// busy.  They're estimates for the replayer (scripts/replay_trace); the
+// epaper_*_seconds metrics on a device measure the real thing.
+class GxEPD2_EPD {
+public:
+  const uint16_t WIDTH;
+  const uint16_t HEIGHT;
+  const GxEPD2::Panel panel;
+  const bool hasColor;
+  const bool hasPartialUpdate;
+  const bool hasFastPartialUpdate;
+  const uint16_t full_refresh_time;
+  const uint16_t partial_refresh_time;
+
+  GxEPD2_EPD(int8_t cs,
+      int8_t dc,
+      int8_t rst,
+      int8_t busy,
+      uint16_t w,
+      uint16_t h,
+      GxEPD2::Panel p,
+      bool c,
+      bool pu,
+      bool fpu,
+      uint16_t frt,
+      uint16_t prt)
+      : WIDTH(w)
+      , HEIGHT(h)
+      , panel(p)
+      , hasColor(c)
+      , hasPartialUpdate(pu)
+      , hasFastPartialUpdate(fpu)
+      , full_refresh_time(frt)
+      , partial_refresh_time(prt) {}
+  virtual ~GxEPD2_EPD() {}
+
+  void init(uint32_t = 0) {}
+  void powerOff() {}
+  void hibernate() {}
+};
+
+// Color panels have no fast partial update, so a partial refresh takes as
+// long as a full one
+#define GXEPD2_PANEL(Class, panelType, width, height, color, fullMs, partialMs) \
+  class Class : public GxEPD2_EPD {                                            \
+  public:                                                                      \
+    static const uint16_t WIDTH = width;                                       \
+    static const uint16_t HEIGHT = height;                                     \
+    static const GxEPD2::Panel panel = GxEPD2::panelType;                      \
+    static const bool hasColor = color;                                        \
+    static const uint16_t full_refresh_time = fullMs;                          \
+    static const uint16_t partial_refresh_time = color ? fullMs : partialMs;   \
+                                                                               \
+    Class(int8_t cs, int8_t dc, int8_t rst, int8_t busy)                       \
+        : GxEPD2_EPD(cs, dc, rst, busy, WIDTH, HEIGHT, panel, color, true,     \
+              !color, full_refresh_time, partial_refresh_time) {}              \
+  };
+
+GXEPD2_PANEL(GxEPD2_154, GDEP015OC1, 200, 200, false, 1200, 300)
+GXEPD2_PANEL(GxEPD2_213, GDE0213B1, 128, 250, false, 4000, 300)
+GXEPD2_PANEL(GxEPD2_213_B72, GDEH0213B72, 128, 250, false, 4000, 300)
+GXEPD2_PANEL(GxEPD2_213_B73, GDEH0213B73, 128, 250, false, 4000, 300)
+GXEPD2_PANEL(GxEPD2_213_flex, GDEW0213I5F, 104, 212, false, 3500, 1000)
+GXEPD2_PANEL(GxEPD2_260, GDEW026T0, 152, 296, false, 4000, 1000)
+GXEPD2_PANEL(GxEPD2_270, GDEW027W3, 176, 264, false, 4000, 1000)
+GXEPD2_PANEL(GxEPD2_290, GDEH029A1, 128, 296, false, 3200, 300)
+GXEPD2_PANEL(GxEPD2_290_T5, GDEW029T5, 128, 296, false, 4000, 1000)
+GXEPD2_PANEL(GxEPD2_371, GDEW0371W7, 240, 416, false, 4000, 1000)
+GXEPD2_PANEL(GxEPD2_420, GDEW042T2, 400, 300, false, 1600, 600)
+GXEPD2_PANEL(GxEPD2_583, GDEW0583T7, 600, 448, false, 1600, 1600)
+GXEPD2_PANEL(GxEPD2_750, GDEW075T8, 640, 384, false, 4000, 4000)
+GXEPD2_PANEL(GxEPD2_750_T7, GDEW075T7, 800, 480, false, 4000, 2000)
+GXEPD2_PANEL(GxEPD2_it60, ED060SCT, 600, 800, false, 1200, 600)
+
+GXEPD2_PANEL(GxEPD2_154c, GDEW0154Z04, 200, 200, true, 16000, 0)
+GXEPD2_PANEL(GxEPD2_213c, GDEW0213Z16, 104, 212, true, 16000, 0)
+GXEPD2_PANEL(GxEPD2_270c, GDEW027C44, 176, 264, true, 16000, 0)
+GXEPD2_PANEL(GxEPD2_290c, GDEW029Z10, 128, 296, true, 16000, 0)
+GXEPD2_PANEL(GxEPD2_420c, GDEW042Z15, 400, 300, true, 16000, 0)
+GXEPD2_PANEL(GxEPD2_583c, GDEW0583Z21, 600, 448, true, 16000, 0)
+GXEPD2_PANEL(GxEPD2_750c, GDEW075Z09, 640, 384, true, 26000, 0)
+GXEPD2_PANEL(GxEPD2_750c_Z08, GDEW075Z08, 800, 480, true, 26000, 0)
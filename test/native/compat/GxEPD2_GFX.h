@@ -0,0 +1,86 @@
+#include <Adafruit_GFX.h>
+#include <GxEPD2_EPD.h>
+
+#include <algorithm>
+#include <vector>
+
+#pragma once
+
+// GxEPD2's common base class for displays.  On the host, drawing goes to an
+// in-memory framebuffer (see GxEPD2_BW and GxEPD2_3C), and refreshes are
+// recorded instead of being sent to a panel.
+class GxEPD2_GFX : public Adafruit_GFX {
+public:
+  // A refresh, in the display's rotated coordinates
+  struct Refresh {
+    // Full refreshes redraw the whole panel, clearing ghosting
+    bool partial;
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+    // millis() when the refresh was issued
+    unsigned long time;
+    // Roughly how long the panel would be busy, in milliseconds.  Time doesn't
+    // pass on the host; see scripts/replay_trace for a use.
+    uint16_t duration;
+  };
+
+  GxEPD2_GFX(GxEPD2_EPD& _epd2, int16_t w, int16_t h)
+      : Adafruit_GFX(w, h)
+      , epd2(_epd2) {}
+  virtual ~GxEPD2_GFX() {}
+
+  GxEPD2_EPD& epd2;
+
+  virtual void init(uint32_t serial_diag_bitrate = 0) = 0;
+  virtual void fillScreen(uint16_t color) = 0;
+  virtual void display(bool partial_update_mode = false) = 0;
+  virtual void displayWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h) = 0;
+  virtual void setFullWindow() = 0;
+  virtual void setPartialWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h) = 0;
+  virtual void firstPage() = 0;
+  virtual bool nextPage() = 0;
+  virtual void refresh(bool partial_update_mode = false) = 0;
+  virtual void refresh(int16_t x, int16_t y, int16_t w, int16_t h) = 0;
+  virtual void powerOff() = 0;
+  virtual void hibernate() = 0;
+  virtual void mirror(bool m) = 0;
+
+  // Host only.  Every refresh since the display was built or the log was
+  // cleared, oldest first.
+  const std::vector<Refresh>& getRefreshes() const { return refreshes; }
+  void clearRefreshes() { refreshes.clear(); }
+
+protected:
+  // Clips the window to the screen and records it
+  void recordRefresh(bool partial, int32_t x, int32_t y, int32_t w, int32_t h) {
+    if (x < 0) {
+      w += x;
+      x = 0;
+    }
+
+    if (y < 0) {
+      h += y;
+      y = 0;
+    }
+
+    w = std::min<int32_t>(w, width() - x);
+    h = std::min<int32_t>(h, height() - y);
+
+    if (w <= 0 || h <= 0) {
+      return;
+    }
+
+    refreshes.push_back({partial,
+        static_cast<uint16_t>(x),
+        static_cast<uint16_t>(y),
+        static_cast<uint16_t>(w),
+        static_cast<uint16_t>(h),
+        millis(),
+        partial ? epd2.partial_refresh_time : epd2.full_refresh_time});
+  }
+
+private:
+  std::vector<Refresh> refreshes;
+};
@@ -0,0 +1,18 @@
+#include <stdint.h>
+
+#pragma once
+
+// Controls what millis() and micros() return on the host.  By default they
+// follow the system's monotonic clock from the start of the process.  Once
+// set() is called, time stands still except for advance() and delay(), which
+// makes tests and trace replays deterministic.
+class NativeClock {
+public:
+  static void set(uint64_t micros);
+  static void advance(uint64_t micros);
+  // Goes back to following the system clock
+  static void release();
+
+  static bool isFrozen();
+  static uint64_t now();
+};
@@ -0,0 +1,150 @@
+#include <Print.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+
+  while (size-- > 0 && write(*buffer++)) {
+    ++n;
+  }
+
+  return n;
+}
+
+size_t Print::write(const char* str) {
+  if (str == nullptr) {
+    return 0;
+  }
+
+  return write(reinterpret_cast<const uint8_t*>(str), strlen(str));
+}
+
+size_t Print::printf(const char* format, ...) {
+  char small[64];
+  va_list args;
+
+  va_start(args, format);
+  int length = vsnprintf(small, sizeof(small), format, args);
+  va_end(args);
+
+  if (length < 0) {
+    return 0;
+  }
+
+  if (static_cast<size_t>(length) < sizeof(small)) {
+    return write(reinterpret_cast<const uint8_t*>(small), length);
+  }
+
+  std::vector<char> large(length + 1);
+
+  va_start(args, format);
+  vsnprintf(large.data(), large.size(), format, args);
+  va_end(args);
+
+  return write(reinterpret_cast<const uint8_t*>(large.data()), length);
+}
+
+size_t Print::print(const __FlashStringHelper* str) {
+  return write(reinterpret_cast<const char*>(str));
+}
+
+size_t Print::print(const String& str) {
+  return write(str.c_str(), str.length());
+}
+
+size_t Print::print(const char* str) {
+  return write(str);
+}
+
+size_t Print::print(char c) {
+  return write(static_cast<uint8_t>(c));
+}
+
+size_t Print::print(unsigned char value, int base) {
+  return print(String(value, base));
+}
+
+size_t Print::print(int value, int base) {
+  return print(String(value, base));
+}
+
+size_t Print::print(unsigned int value, int base) {
+  return print(String(value, base));
+}
+
+size_t Print::print(long value, int base) {
+  return print(String(value, base));
+}
+
+size_t Print::print(unsigned long value, int base) {
+  return print(String(value, base));
+}
+
+size_t Print::print(long long value, int base) {
+  return print(String(value, base));
+}
+
+size_t Print::print(unsigned long long value, int base) {
+  return print(String(value, base));
+}
+
+size_t Print::print(double value, int digits) {
+  return print(String(value, digits));
+}
+
+size_t Print::println(const __FlashStringHelper* str) {
+  return print(str) + println();
+}
+
+size_t Print::println(const String& str) {
+  return print(str) + println();
+}
+
+size_t Print::println(const char* str) {
+  return print(str) + println();
+}
+
+size_t Print::println(char c) {
+  return print(c) + println();
+}
+
+size_t Print::println(unsigned char value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(int value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(unsigned int value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(long value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(unsigned long value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(long long value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(unsigned long long value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(double value, int digits) {
+  return print(value, digits) + println();
+}
+
+size_t Print::println() {
+  return write("\r\n");
+}
@@ -0,0 +1,3 @@
+#include <FS.h>
+
+#pragma once
@@ -0,0 +1,55 @@
+#include <Stream.h>
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+  size_t n = 0;
+
+  while (n < length) {
+    int c = read();
+
+    if (c < 0) {
+      break;
+    }
+
+    buffer[n++] = static_cast<char>(c);
+  }
+
+  return n;
+}
+
+size_t Stream::readBytesUntil(char terminator, char* buffer, size_t length) {
+  size_t n = 0;
+
+  while (n < length) {
+    int c = read();
+
+    if (c < 0 || c == terminator) {
+      break;
+    }
+
+    buffer[n++] = static_cast<char>(c);
+  }
+
+  return n;
+}
+
+String Stream::readString() {
+  String result;
+  int c;
+
+  while ((c = read()) >= 0) {
+    result.concat(static_cast<char>(c));
+  }
+
+  return result;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String result;
+  int c;
+
+  while ((c = read()) >= 0 && c != terminator) {
+    result.concat(static_cast<char>(c));
+  }
+
+  return result;
+}
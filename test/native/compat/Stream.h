@@ -0,0 +1,22 @@
+#include <Print.h>
+
+#pragma once
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  // Reads never block on the host, so there's nothing to time out
+  void setTimeout(unsigned long) {}
+
+  virtual size_t readBytes(char* buffer, size_t length);
+  size_t readBytes(uint8_t* buffer, size_t length) {
+    return readBytes(reinterpret_cast<char*>(buffer), length);
+  }
+  size_t readBytesUntil(char terminator, char* buffer, size_t length);
+
+  String readString();
+  String readStringUntil(char terminator);
+};
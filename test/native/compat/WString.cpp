@@ -0,0 +1,420 @@
+#include <WString.h>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static std::string formatInteger(unsigned long long value, bool negative, unsigned char base) {
+  char digits[66];
+  size_t i = sizeof(digits);
+
+  digits[--i] = '\0';
+
+  if (base < 2 || base > 36) {
+    base = 10;
+  }
+
+  do {
+    const unsigned d = value % base;
+    digits[--i] = d < 10 ? '0' + d : 'a' + d - 10;
+    value /= base;
+  } while (value > 0);
+
+  if (negative) {
+    digits[--i] = '-';
+  }
+
+  return std::string(digits + i);
+}
+
+static std::string formatSigned(long long value, unsigned char base) {
+  // Like Arduino, only base 10 is signed
+  if (base == 10 && value < 0) {
+    return formatInteger(-static_cast<unsigned long long>(value), true, base);
+  }
+
+  return formatInteger(static_cast<unsigned long long>(value), false, base);
+}
+
+static std::string formatDouble(double value, unsigned char decimalPlaces) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimalPlaces, value);
+  return std::string(buffer);
+}
+
+String::String(const char* cstr)
+    : buffer(cstr != nullptr ? cstr : "") {}
+
+String::String(const char* cstr, size_t length)
+    : buffer(cstr != nullptr ? std::string(cstr, length) : std::string()) {}
+
+String::String(const __FlashStringHelper* str)
+    : String(reinterpret_cast<const char*>(str)) {}
+
+String::String(char c)
+    : buffer(1, c) {}
+
+String::String(unsigned char value, unsigned char base)
+    : buffer(formatInteger(value, false, base)) {}
+
+String::String(int value, unsigned char base)
+    : buffer(formatSigned(value, base)) {}
+
+String::String(unsigned int value, unsigned char base)
+    : buffer(formatInteger(value, false, base)) {}
+
+String::String(long value, unsigned char base)
+    : buffer(formatSigned(value, base)) {}
+
+String::String(unsigned long value, unsigned char base)
+    : buffer(formatInteger(value, false, base)) {}
+
+String::String(long long value, unsigned char base)
+    : buffer(formatSigned(value, base)) {}
+
+String::String(unsigned long long value, unsigned char base)
+    : buffer(formatInteger(value, false, base)) {}
+
+String::String(float value, unsigned char decimalPlaces)
+    : buffer(formatDouble(value, decimalPlaces)) {}
+
+String::String(double value, unsigned char decimalPlaces)
+    : buffer(formatDouble(value, decimalPlaces)) {}
+
+String& String::operator=(const char* cstr) {
+  buffer = cstr != nullptr ? cstr : "";
+  return *this;
+}
+
+String& String::operator=(const __FlashStringHelper* str) {
+  return *this = reinterpret_cast<const char*>(str);
+}
+
+bool String::reserve(size_t size) {
+  buffer.reserve(size);
+  return true;
+}
+
+bool String::concat(const String& str) {
+  buffer.append(str.buffer);
+  return true;
+}
+
+bool String::concat(const char* cstr) {
+  if (cstr == nullptr) {
+    return false;
+  }
+
+  buffer.append(cstr);
+  return true;
+}
+
+bool String::concat(const char* cstr, size_t length) {
+  if (cstr == nullptr) {
+    return false;
+  }
+
+  buffer.append(cstr, length);
+  return true;
+}
+
+bool String::concat(const __FlashStringHelper* str) {
+  return concat(reinterpret_cast<const char*>(str));
+}
+
+bool String::concat(char c) {
+  buffer.push_back(c);
+  return true;
+}
+
+bool String::concat(unsigned char value) { return concat(String(value)); }
+bool String::concat(int value) { return concat(String(value)); }
+bool String::concat(unsigned int value) { return concat(String(value)); }
+bool String::concat(long value) { return concat(String(value)); }
+bool String::concat(unsigned long value) { return concat(String(value)); }
+bool String::concat(long long value) { return concat(String(value)); }
+bool String::concat(unsigned long long value) { return concat(String(value)); }
+bool String::concat(float value) { return concat(String(value)); }
+bool String::concat(double value) { return concat(String(value)); }
+
+StringSumHelper operator+(const StringSumHelper& lhs, const String& rhs) {
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+StringSumHelper operator+(const StringSumHelper& lhs, const char* cstr) {
+  StringSumHelper result(lhs);
+  result.concat(cstr);
+  return result;
+}
+
+StringSumHelper operator+(const StringSumHelper& lhs, const __FlashStringHelper* rhs) {
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+StringSumHelper operator+(const StringSumHelper& lhs, char c) {
+  StringSumHelper result(lhs);
+  result.concat(c);
+  return result;
+}
+
+StringSumHelper operator+(const StringSumHelper& lhs, unsigned char value) {
+  StringSumHelper result(lhs);
+  result.concat(value);
+  return result;
+}
+
+StringSumHelper operator+(const StringSumHelper& lhs, int value) {
+  StringSumHelper result(lhs);
+  result.concat(value);
+  return result;
+}
+
+StringSumHelper operator+(const StringSumHelper& lhs, unsigned int value) {
+  StringSumHelper result(lhs);
+  result.concat(value);
+  return result;
+}
+
+StringSumHelper operator+(const StringSumHelper& lhs, long value) {
+  StringSumHelper result(lhs);
+  result.concat(value);
+  return result;
+}
+
+StringSumHelper operator+(const StringSumHelper& lhs, unsigned long value) {
+  StringSumHelper result(lhs);
+  result.concat(value);
+  return result;
+}
+
+StringSumHelper operator+(const StringSumHelper& lhs, float value) {
+  StringSumHelper result(lhs);
+  result.concat(value);
+  return result;
+}
+
+StringSumHelper operator+(const StringSumHelper& lhs, double value) {
+  StringSumHelper result(lhs);
+  result.concat(value);
+  return result;
+}
+
+int String::compareTo(const String& str) const {
+  return buffer.compare(str.buffer);
+}
+
+bool String::equals(const String& str) const {
+  return buffer == str.buffer;
+}
+
+bool String::equals(const char* cstr) const {
+  return cstr != nullptr ? buffer == cstr : buffer.empty();
+}
+
+bool String::equalsIgnoreCase(const String& str) const {
+  return length() == str.length() && strcasecmp(c_str(), str.c_str()) == 0;
+}
+
+bool String::startsWith(const String& prefix) const {
+  return startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String& prefix, size_t offset) const {
+  return offset + prefix.length() <= length() &&
+         buffer.compare(offset, prefix.length(), prefix.buffer) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+  return suffix.length() <= length() &&
+         buffer.compare(length() - suffix.length(), suffix.length(), suffix.buffer) == 0;
+}
+
+char String::charAt(size_t index) const {
+  return (*this)[index];
+}
+
+void String::setCharAt(size_t index, char c) {
+  if (index < length()) {
+    buffer[index] = c;
+  }
+}
+
+char String::operator[](size_t index) const {
+  return index < length() ? buffer[index] : '\0';
+}
+
+char& String::operator[](size_t index) {
+  static char dummy;
+
+  if (index >= length()) {
+    dummy = '\0';
+    return dummy;
+  }
+
+  return buffer[index];
+}
+
+void String::getBytes(unsigned char* buf, size_t bufsize, size_t index) const {
+  if (bufsize == 0 || buf == nullptr) {
+    return;
+  }
+
+  if (index >= length()) {
+    buf[0] = '\0';
+    return;
+  }
+
+  size_t n = length() - index;
+
+  if (n > bufsize - 1) {
+    n = bufsize - 1;
+  }
+
+  memcpy(buf, c_str() + index, n);
+  buf[n] = '\0';
+}
+
+void String::toCharArray(char* buf, size_t bufsize, size_t index) const {
+  getBytes(reinterpret_cast<unsigned char*>(buf), bufsize, index);
+}
+
+int String::indexOf(char ch) const {
+  return indexOf(ch, 0);
+}
+
+int String::indexOf(char ch, size_t fromIndex) const {
+  const size_t i = buffer.find(ch, fromIndex);
+  return i == std::string::npos ? -1 : static_cast<int>(i);
+}
+
+int String::indexOf(const String& str) const {
+  return indexOf(str, 0);
+}
+
+int String::indexOf(const String& str, size_t fromIndex) const {
+  const size_t i = buffer.find(str.buffer, fromIndex);
+  return i == std::string::npos ? -1 : static_cast<int>(i);
+}
+
+int String::lastIndexOf(char ch) const {
+  return lastIndexOf(ch, length() - 1);
+}
+
+int String::lastIndexOf(char ch, size_t fromIndex) const {
+  if (isEmpty()) {
+    return -1;
+  }
+
+  const size_t i = buffer.rfind(ch, fromIndex);
+  return i == std::string::npos ? -1 : static_cast<int>(i);
+}
+
+int String::lastIndexOf(const String& str) const {
+  return lastIndexOf(str, length() - str.length());
+}
+
+int String::lastIndexOf(const String& str, size_t fromIndex) const {
+  if (str.length() > length()) {
+    return -1;
+  }
+
+  const size_t i = buffer.rfind(str.buffer, fromIndex);
+  return i == std::string::npos ? -1 : static_cast<int>(i);
+}
+
+String String::substring(size_t beginIndex) const {
+  return substring(beginIndex, length());
+}
+
+String String::substring(size_t beginIndex, size_t endIndex) const {
+  if (beginIndex > endIndex) {
+    const size_t t = beginIndex;
+    beginIndex = endIndex;
+    endIndex = t;
+  }
+
+  if (beginIndex >= length()) {
+    return String();
+  }
+
+  if (endIndex > length()) {
+    endIndex = length();
+  }
+
+  return String(c_str() + beginIndex, endIndex - beginIndex);
+}
+
+void String::replace(char find, char replace) {
+  for (char& c : buffer) {
+    if (c == find) {
+      c = replace;
+    }
+  }
+}
+
+void String::replace(const String& find, const String& replace) {
+  if (find.isEmpty()) {
+    return;
+  }
+
+  size_t i = 0;
+
+  while ((i = buffer.find(find.buffer, i)) != std::string::npos) {
+    buffer.replace(i, find.length(), replace.buffer);
+    i += replace.length();
+  }
+}
+
+void String::remove(size_t index) {
+  remove(index, static_cast<size_t>(-1));
+}
+
+void String::remove(size_t index, size_t count) {
+  if (index >= length()) {
+    return;
+  }
+
+  buffer.erase(index, count);
+}
+
+void String::toLowerCase() {
+  for (char& c : buffer) {
+    c = tolower(static_cast<unsigned char>(c));
+  }
+}
+
+void String::toUpperCase() {
+  for (char& c : buffer) {
+    c = toupper(static_cast<unsigned char>(c));
+  }
+}
+
+void String::trim() {
+  const size_t begin = buffer.find_first_not_of(" \t\r\n\f\v");
+
+  if (begin == std::string::npos) {
+    buffer.clear();
+    return;
+  }
+
+  const size_t end = buffer.find_last_not_of(" \t\r\n\f\v");
+  buffer = buffer.substr(begin, end - begin + 1);
+}
+
+long String::toInt() const {
+  return atol(c_str());
+}
+
+float String::toFloat() const {
+  return atof(c_str());
+}
+
+double String::toDouble() const {
+  return atof(c_str());
+}
@@ -0,0 +1,157 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+
+#pragma once
+
+class __FlashStringHelper;
+class StringSumHelper;
+
+// Arduino's String, backed by std::string.  Unlike on the device, a String
+// always has a buffer, so c_str() is never null.
+class String {
+public:
+  String(const char* cstr = "");
+  String(const char* cstr, size_t length);
+  String(const String& str) = default;
+  String(String&& str) = default;
+  String(const __FlashStringHelper* str);
+  explicit String(char c);
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(float value, unsigned char decimalPlaces = 2);
+  explicit String(double value, unsigned char decimalPlaces = 2);
+  ~String() = default;
+
+  String& operator=(const String& rhs) = default;
+  String& operator=(String&& rhs) = default;
+  String& operator=(const char* cstr);
+  String& operator=(const __FlashStringHelper* str);
+
+  bool reserve(size_t size);
+  size_t length() const { return buffer.length(); }
+  bool isEmpty() const { return buffer.empty(); }
+  const char* c_str() const { return buffer.c_str(); }
+
+  bool concat(const String& str);
+  bool concat(const char* cstr);
+  bool concat(const char* cstr, size_t length);
+  bool concat(const __FlashStringHelper* str);
+  bool concat(char c);
+  bool concat(unsigned char value);
+  bool concat(int value);
+  bool concat(unsigned int value);
+  bool concat(long value);
+  bool concat(unsigned long value);
+  bool concat(long long value);
+  bool concat(unsigned long long value);
+  bool concat(float value);
+  bool concat(double value);
+
+  template <typename T>
+  String& operator+=(const T& rhs) {
+    concat(rhs);
+    return *this;
+  }
+
+  friend StringSumHelper operator+(const StringSumHelper& lhs, const String& rhs);
+  friend StringSumHelper operator+(const StringSumHelper& lhs, const char* cstr);
+  friend StringSumHelper operator+(const StringSumHelper& lhs, const __FlashStringHelper* rhs);
+  friend StringSumHelper operator+(const StringSumHelper& lhs, char c);
+  friend StringSumHelper operator+(const StringSumHelper& lhs, unsigned char value);
+  friend StringSumHelper operator+(const StringSumHelper& lhs, int value);
+  friend StringSumHelper operator+(const StringSumHelper& lhs, unsigned int value);
+  friend StringSumHelper operator+(const StringSumHelper& lhs, long value);
+  friend StringSumHelper operator+(const StringSumHelper& lhs, unsigned long value);
+  friend StringSumHelper operator+(const StringSumHelper& lhs, float value);
+  friend StringSumHelper operator+(const StringSumHelper& lhs, double value);
+
+  explicit operator bool() const { return true; }
+
+  int compareTo(const String& str) const;
+  bool equals(const String& str) const;
+  bool equals(const char* cstr) const;
+  bool equalsIgnoreCase(const String& str) const;
+  bool startsWith(const String& prefix) const;
+  bool startsWith(const String& prefix, size_t offset) const;
+  bool endsWith(const String& suffix) const;
+
+  bool operator==(const String& rhs) const { return equals(rhs); }
+  bool operator==(const char* cstr) const { return equals(cstr); }
+  bool operator!=(const String& rhs) const { return !equals(rhs); }
+  bool operator!=(const char* cstr) const { return !equals(cstr); }
+  bool operator<(const String& rhs) const { return compareTo(rhs) < 0; }
+  bool operator>(const String& rhs) const { return compareTo(rhs) > 0; }
+  bool operator<=(const String& rhs) const { return compareTo(rhs) <= 0; }
+  bool operator>=(const String& rhs) const { return compareTo(rhs) >= 0; }
+
+  char charAt(size_t index) const;
+  void setCharAt(size_t index, char c);
+  char operator[](size_t index) const;
+  char& operator[](size_t index);
+  void getBytes(unsigned char* buf, size_t bufsize, size_t index = 0) const;
+  void toCharArray(char* buf, size_t bufsize, size_t index = 0) const;
+  char* begin() { return &buffer[0]; }
+  char* end() { return &buffer[0] + buffer.length(); }
+  const char* begin() const { return c_str(); }
+  const char* end() const { return c_str() + length(); }
+
+  int indexOf(char ch) const;
+  int indexOf(char ch, size_t fromIndex) const;
+  int indexOf(const String& str) const;
+  int indexOf(const String& str, size_t fromIndex) const;
+  int lastIndexOf(char ch) const;
+  int lastIndexOf(char ch, size_t fromIndex) const;
+  int lastIndexOf(const String& str) const;
+  int lastIndexOf(const String& str, size_t fromIndex) const;
+  String substring(size_t beginIndex) const;
+  String substring(size_t beginIndex, size_t endIndex) const;
+
+  void replace(char find, char replace);
+  void replace(const String& find, const String& replace);
+  void remove(size_t index);
+  void remove(size_t index, size_t count);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long toInt() const;
+  float toFloat() const;
+  double toDouble() const;
+
+private:
+  std::string buffer;
+};
+
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const String& s) : String(s) {}
+  StringSumHelper(const char* p) : String(p) {}
+  StringSumHelper(char c) : String(c) {}
+  StringSumHelper(unsigned char num) : String(num) {}
+  StringSumHelper(int num) : String(num) {}
+  StringSumHelper(unsigned int num) : String(num) {}
+  StringSumHelper(long num) : String(num) {}
+  StringSumHelper(unsigned long num) : String(num) {}
+  StringSumHelper(float num) : String(num) {}
+  StringSumHelper(double num) : String(num) {}
+};
+
+inline bool operator==(const char* lhs, const String& rhs) { return rhs.equals(lhs); }
+inline bool operator!=(const char* lhs, const String& rhs) { return !rhs.equals(lhs); }
+
+namespace std {
+template <>
+struct hash<String> {
+  size_t operator()(const String& s) const {
+    return hash<string>()(string(s.c_str(), s.length()));
+  }
+};
+}
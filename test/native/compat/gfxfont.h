@@ -0,0 +1,27 @@
+// Same layout as Adafruit GFX 1.6.1's gfxfont.h, so that its Fonts/ headers
+// can be used as they are.  Shares its include guard so that only one of the
+// two is ever defined.
+
+#ifndef _GFXFONT_H_
+#define _GFXFONT_H_
+
+#include <stdint.h>
+
+typedef struct {
+  uint16_t bitmapOffset;
+  uint8_t width;
+  uint8_t height;
+  uint8_t xAdvance;
+  int8_t xOffset;
+  int8_t yOffset;
+} GFXglyph;
+
+typedef struct {
+  uint8_t* bitmap;
+  GFXglyph* glyph;
+  uint8_t first;
+  uint8_t last;
+  uint8_t yAdvance;
+} GFXfont;
+
+#endif
@@ -72,7 +72,7 @@ class ApiClient
     `curl -s "http://#{@host}#{path}" -X POST -F 'f=@#{file}'`
   end
 
-  def upload_template(name, contents:)
+  def upload_template(name, contents:, allow_error: false)
     Tempfile.create do |filename|
       File.open(filename, 'w+') do |f|
         f.write(contents)
@@ -85,7 +85,7 @@ class ApiClient
         'template' => UploadIO.new(filename, 'application/json', name)
       )
 
-      request(nil, nil, nil, request: r)
+      request(nil, nil, nil, request: r, allow_error: allow_error)
     end
   end
 
@@ -115,6 +115,21 @@ class ApiClient
     request(:Get, path, **args)
   end
 
+  # Returns the raw response so that headers and status codes can be checked.
+  # Paths not starting with /api are relative to /api/v1.
+  def get_response(path, headers: {})
+    path = File.join('/api/v1', path) unless path.start_with?('/')
+    uri = URI("http://#{@host}#{path}")
+
+    Net::HTTP.start(uri.host, uri.port) do |http|
+      req = Net::HTTP::Get.new(uri)
+      headers.each { |k, v| req[k] = v }
+      req.basic_auth(@username, @password) if @username && @password
+
+      http.request(req)
+    end
+  end
+
   def put(path, body, **args)
     request(:Put, path, body, **args)
   end
@@ -67,33 +67,93 @@ RSpec.describe 'API Server' do
 
     context 'POST' do
       it 'should upload a template' do
-        @api.upload_template(@template_name, contents: 'test')
+        @api.upload_template(@template_name, contents: '{"lines":[]}')
 
         expected_entry = {
           'name' => "/t/#{@template_name}",
-          'size' => 4
+          'size' => 12
         }
 
         expect(@api.get('/templates')['templates']).to include(expected_entry)
 
         @api.delete("/templates/#{@template_name}")
       end
+
+      it 'should reject a template that is not valid JSON' do
+        response = @api.upload_template(@template_name, contents: 'test', allow_error: true)
+
+        expect(response['success']).to eq(false)
+        expect(response['errors']).to eq([{ 'path' => '', 'message' => 'invalid JSON' }])
+        expect(@api.get('/templates')['templates'].map { |x| x['name'] }).to_not include("/t/#{@template_name}")
+      end
+
+      it 'should report the path of each problem in a template' do
+        contents = {
+          text: [
+            {
+              x: 0, y: 0, font: 'NotAFont',
+              value: { type: 'variable', variable: 'v', formatter: { type: 'ref', ref: 'missing' } }
+            }
+          ]
+        }
+        response = @api.upload_template(@template_name, contents: contents.to_json, allow_error: true)
+
+        expect(response['success']).to eq(false)
+        expect(response['errors']).to contain_exactly(
+          { 'path' => '/text/0/font', 'message' => 'font not found' },
+          { 'path' => '/text/0/value/formatter', 'message' => 'refers to an undefined formatter' }
+        )
+      end
+
+      it 'should keep the previous template when an update is rejected' do
+        contents = { 'lines' => [{ 'x1' => 0, 'y1' => 0, 'x2' => 10, 'y2' => 10 }] }
+        @api.upload_template(@template_name, contents: contents.to_json)
+        @api.upload_template(@template_name, contents: { rotation: 7 }.to_json, allow_error: true)
+
+        expect(@api.get("/templates/#{@template_name}")).to eq(contents)
+      end
     end
 
     context 'DELETE :template_name' do
       it 'should delete a template' do
-        @api.upload_template(@template_name, contents: 'test')
+        @api.upload_template(@template_name, contents: '{"lines":[]}')
         @api.delete("/templates/#{@template_name}")
 
         template = {
           'name' => "/t/#{@template_name}",
-          'size' => 4
+          'size' => 12
         }
 
         expect(@api.get('/templates')['templates']).to_not include(template)
       end
     end
 
+    context 'PUT :template_name' do
+      it 'should merge top-level keys into a large template' do
+        # Uploads must fit in the buffer the display loads templates into
+        lines = 150.times.map { |i| { 'x1' => i, 'y1' => 0, 'x2' => i, 'y2' => 10, 'color' => 'black' } }
+        contents = { 'lines' => lines, 'rotation' => 0, 'background_color' => 'white' }
+        @api.upload_template(@template_name, contents: contents.to_json)
+
+        response = @api.put("/templates/#{@template_name}", { 'rotation' => 1, 'background_color' => nil })
+        expected = { 'lines' => lines, 'rotation' => 1 }
+
+        expect(response).to eq(expected)
+        expect(@api.get("/templates/#{@template_name}")).to eq(expected)
+      end
+
+      it 'should reject a merge that makes the template invalid' do
+        contents = { 'lines' => [{ 'x1' => 0, 'y1' => 0, 'x2' => 10, 'y2' => 10 }], 'rotation' => 0 }
+        @api.upload_template(@template_name, contents: contents.to_json)
+
+        response = @api.put("/templates/#{@template_name}", { 'rotation' => 7 }, allow_error: true)
+
+        expect(response['success']).to eq(false)
+        expect(response['errors']).to eq([{ 'path' => '/rotation', 'message' => 'must be 0, 1, 2 or 3' }])
+        expect(@api.get("/templates/#{@template_name}")).to eq(contents)
+      end
+    end
+
     context 'GET :template_name' do
       it 'should return the template contents' do
         contents = { 'test' => 123 }
@@ -101,6 +161,28 @@ RSpec.describe 'API Server' do
 
         expect(@api.get("/templates/#{@template_name}")).to eq(contents)
       end
+
+      it 'should answer a matching If-None-Match with 304' do
+        @api.upload_template(@template_name, contents: { 'test' => 1 }.to_json)
+
+        etag = @api.get_response("templates/#{@template_name}")['ETag']
+        expect(etag).to match(/\A"[0-9a-f]{32}"\z/)
+
+        response = @api.get_response("templates/#{@template_name}", headers: { 'If-None-Match' => etag })
+        expect(response.code).to eq('304')
+        expect(response['ETag']).to eq(etag)
+      end
+
+      it 'should change the ETag when the template changes' do
+        @api.upload_template(@template_name, contents: { 'test' => 1 }.to_json)
+        etag = @api.get_response("templates/#{@template_name}")['ETag']
+
+        @api.put("/templates/#{@template_name}", { 'test' => 2 })
+
+        response = @api.get_response("templates/#{@template_name}", headers: { 'If-None-Match' => etag })
+        expect(response.code).to eq('200')
+        expect(response['ETag']).to_not eq(etag)
+      end
     end
   end
 
@@ -158,6 +240,67 @@ RSpec.describe 'API Server' do
     end
   end
 
+  context 'web assets' do
+    it 'should answer a matching If-None-Match with 304' do
+      etag = @api.get_response('/')['ETag']
+      expect(etag).to_not be_nil
+
+      response = @api.get_response('/', headers: { 'If-None-Match' => etag })
+      expect(response.code).to eq('304')
+      expect(response['Cache-Control']).to eq('no-cache')
+    end
+  end
+
+  context '/metrics' do
+    it 'should serve metrics in the Prometheus text format' do
+      response = @api.get_response('metrics')
+
+      expect(response.code).to eq('200')
+      expect(response['Content-Type']).to start_with('text/plain')
+      expect(response.body).to include('# TYPE epaper_update_variable_seconds histogram')
+      expect(response.body).to match(/^epaper_update_variable_seconds_bucket\{le="\+Inf"\} \d+$/)
+      expect(response.body).to match(/^epaper_min_free_heap_bytes \d+$/)
+    end
+
+    it 'should count variable updates' do
+      count = lambda do
+        @api.get_response('metrics').body[/^epaper_update_variable_seconds_count (\d+)$/, 1].to_i
+      end
+
+      before = count.call
+      @api.put('/variables', SecureRandom.hex(6) => 'value')
+
+      expect(count.call).to be > before
+    end
+  end
+
+  context '/screen' do
+    it 'should return the screen as a PNG by default' do
+      response = @api.get_response('screen')
+
+      expect(response.code).to eq('200')
+      expect(response['Content-Type']).to eq('image/png')
+      expect(response.body.bytes.first(8)).to eq([0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A])
+    end
+
+    it 'should crop a region as a PBM' do
+      response = @api.get_response('screen?format=pbm&x=1&y=2&w=10&h=3')
+
+      expect(response.code).to eq('200')
+      expect(response['Content-Type']).to eq('image/x-portable-bitmap')
+      expect(response.body).to start_with("P4\n10 3\n")
+      expect(response.body.bytesize).to eq("P4\n10 3\n".bytesize + 2 * 3)
+    end
+
+    it 'should reject a region outside of the screen' do
+      expect(@api.get_response('screen?x=10000').code).to eq('400')
+    end
+
+    it 'should reject unknown formats' do
+      expect(@api.get_response('screen?format=gif').code).to eq('400')
+    end
+  end
+
   context '/system' do
     context 'POST' do
       it 'Should respond with expected keys' do
@@ -167,6 +310,15 @@ RSpec.describe 'API Server' do
         expect(required_keys - response.keys).to be_empty
       end
 
+      it 'Should include WebSocket stats for each encoding' do
+        response = @api.get('/system')
+
+        expect(response['websocket'].keys).to contain_exactly('json', 'msgpack')
+        response['websocket'].each_value do |stats|
+          expect(stats.keys).to contain_exactly('frames', 'updates', 'bytes', 'encode_us')
+        end
+      end
+
       it 'Should respond to the reboot command' do
         begin
           @api.post('/system', command: 'reboot')
@@ -254,6 +406,27 @@ RSpec.describe 'API Server' do
         expect(response).to include('bitmaps')
         expect(response['bitmaps']).to be_a(Array)
       end
+
+      it 'should list every bitmap with its metadata' do
+        names = 25.times.map { |i| "#{@bitmap_name}#{i}" }
+        names.each_with_index do |name, i|
+          @api.upload_bitmap(name, contents: '11', metadata: { width: i, height: 200, label: "bitmap \"#{i}\"" })
+        end
+
+        begin
+          bitmaps = @api.get('/bitmaps')['bitmaps']
+
+          names.each_with_index do |name, i|
+            expect(bitmaps).to include(
+              'name' => "/b/#{name}",
+              'size' => 2,
+              'metadata' => { 'width' => i, 'height' => 200, 'label' => "bitmap \"#{i}\"" }
+            )
+          end
+        ensure
+          names.each { |name| @api.delete("/bitmaps/#{name}") }
+        end
+      end
     end
 
     context 'POST' do
@@ -300,6 +473,20 @@ RSpec.describe 'API Server' do
         @api.upload_bitmap(@bitmap_name, contents: '11', metadata: { width: 100, height: 200 })
         expect(@api.get("/bitmaps/#{@bitmap_name}")).to eq('11')
       end
+
+      it 'should answer a matching If-None-Match with 304' do
+        @api.upload_bitmap(@bitmap_name, contents: '11', metadata: { width: 100, height: 200 })
+        etag = @api.get_response("bitmaps/#{@bitmap_name}")['ETag']
+
+        response = @api.get_response("bitmaps/#{@bitmap_name}", headers: { 'If-None-Match' => etag })
+        expect(response.code).to eq('304')
+
+        @api.upload_bitmap(@bitmap_name, contents: '111', metadata: { width: 100, height: 200 })
+
+        response = @api.get_response("bitmaps/#{@bitmap_name}", headers: { 'If-None-Match' => etag })
+        expect(response.code).to eq('200')
+        expect(response.body).to eq('111')
+      end
     end
 
     context 'DELETE :bitmap_name' do
@@ -0,0 +1,233 @@
+# frozen_string_literal: true
+
+require 'mqtt'
+require 'securerandom'
+
+RSpec.describe 'MQTT' do
+  # Values are truncated to this length when they're stored
+  MAX_STORED_VALUE_SIZE = 254
+
+  # Larger than a single TCP segment, so the device receives it in chunks
+  LARGE_PAYLOAD_SIZE = 8192
+
+  before :all do
+    @api = ApiClient.from_environment
+    @topic_prefix = ENV.fetch('EPAPER_TEMPLATES_MQTT_TOPIC_PREFIX')
+
+    server = ENV.fetch('EPAPER_TEMPLATES_MQTT_SERVER')
+    username = ENV.fetch('EPAPER_TEMPLATES_MQTT_USERNAME', '')
+    password = ENV.fetch('EPAPER_TEMPLATES_MQTT_PASSWORD', '')
+
+    @api.patch_settings(
+      'mqtt.server' => server,
+      'mqtt.username' => username,
+      'mqtt.password' => password,
+      'mqtt.variables_topic_pattern' => [
+        "#{@topic_prefix}variables/:variable_name",
+        "#{@topic_prefix}rooms/:room/:variable_name :room_:variable_name",
+        "#{@topic_prefix}fixed/topic mqtt_fixed_var"
+      ].join("\n"),
+      'mqtt.variables_batch_topic' => "#{@topic_prefix}variables",
+      'mqtt.extraction_rules' => [
+        "#{@topic_prefix}sensor $.temperature mqtt_extracted_temp",
+        "#{@topic_prefix}sensor $.readings['humidity'] mqtt_extracted_humidity",
+        "#{@topic_prefix}sensor $.list[1] mqtt_extracted_element"
+      ].join("\n")
+    )
+
+    host, port = server.split(':')
+    @mqtt = MQTT::Client.connect(
+      host: host,
+      port: (port || 1883).to_i,
+      username: username.empty? ? nil : username,
+      password: password.empty? ? nil : password
+    )
+
+    wait_for_variable('mqtt_state', 'connected')
+  end
+
+  after :all do
+    @mqtt&.disconnect
+  end
+
+  def wait_for_variable(name, value, timeout: 10)
+    deadline = Time.now + timeout
+
+    loop do
+      current = @api.get_variable(name)
+      return current if current == value || Time.now > deadline
+
+      sleep 0.2
+    end
+  end
+
+  def publish_variable(name, value)
+    @mqtt.publish("#{@topic_prefix}variables/#{name}", value)
+  end
+
+  def large_payload(size = LARGE_PAYLOAD_SIZE)
+    (SecureRandom.hex(size / 2 + 1))[0, size]
+  end
+
+  context 'variable updates' do
+    it 'should update a variable from a small message' do
+      value = SecureRandom.hex(8)
+      publish_variable('mqtt_test_var', value)
+
+      expect(wait_for_variable('mqtt_test_var', value)).to eq(value)
+    end
+
+    it 'should reassemble an 8 KB message delivered in several pieces' do
+      payload = large_payload
+      expected = payload[0, MAX_STORED_VALUE_SIZE]
+
+      publish_variable('mqtt_large_var', payload)
+
+      expect(wait_for_variable('mqtt_large_var', expected)).to eq(expected)
+    end
+
+    it 'should reassemble back-to-back 8 KB messages on different topics' do
+      payloads = (1..3).map { |i| ["mqtt_large_var#{i}", large_payload] }
+
+      payloads.each { |name, payload| publish_variable(name, payload) }
+
+      payloads.each do |name, payload|
+        expected = payload[0, MAX_STORED_VALUE_SIZE]
+        expect(wait_for_variable(name, expected)).to eq(expected)
+      end
+    end
+
+    it 'should drop oversized messages and keep handling later ones' do
+      before_value = SecureRandom.hex(8)
+      publish_variable('mqtt_oversized_var', before_value)
+      expect(wait_for_variable('mqtt_oversized_var', before_value)).to eq(before_value)
+
+      publish_variable('mqtt_oversized_var', large_payload(LARGE_PAYLOAD_SIZE * 2))
+
+      after_value = SecureRandom.hex(8)
+      publish_variable('mqtt_test_var', after_value)
+      expect(wait_for_variable('mqtt_test_var', after_value)).to eq(after_value)
+
+      expect(@api.get_variable('mqtt_oversized_var')).to eq(before_value)
+    end
+  end
+
+  context 'bootstrap window' do
+    it 'should report the refreshes saved after connecting' do
+      deadline = Time.now + 10
+      saved = nil
+
+      loop do
+        saved = @api.get_variable('mqtt_bootstrap_refreshes_saved')
+        break if saved.to_s.match?(/\A\d+\z/) || Time.now > deadline
+
+        sleep 0.2
+      end
+
+      expect(saved).to match(/\A\d+\z/)
+    end
+  end
+
+  context 'multiple topic patterns' do
+    it 'should build variable names from pattern tokens' do
+      value = SecureRandom.hex(8)
+      @mqtt.publish("#{@topic_prefix}rooms/kitchen/temp", value)
+
+      expect(wait_for_variable('kitchen_temp', value)).to eq(value)
+    end
+
+    it 'should bind a fixed topic to a fixed variable name' do
+      value = SecureRandom.hex(8)
+      @mqtt.publish("#{@topic_prefix}fixed/topic", value)
+
+      expect(wait_for_variable('mqtt_fixed_var', value)).to eq(value)
+    end
+
+    it 'should still handle the default pattern' do
+      value = SecureRandom.hex(8)
+      publish_variable('mqtt_test_var', value)
+
+      expect(wait_for_variable('mqtt_test_var', value)).to eq(value)
+    end
+  end
+
+  context 'batch updates' do
+    def publish_batch(payload)
+      @mqtt.publish("#{@topic_prefix}variables", payload)
+    end
+
+    it 'should update every variable in the batch' do
+      values = (1..5).map { |i| ["mqtt_batch_var#{i}", SecureRandom.hex(8)] }.to_h
+
+      publish_batch(values.to_json)
+
+      values.each do |name, value|
+        expect(wait_for_variable(name, value)).to eq(value)
+      end
+    end
+
+    it 'should store numbers and booleans as their literal text' do
+      publish_batch('{"mqtt_batch_num": 12.5, "mqtt_batch_bool": true}')
+
+      expect(wait_for_variable('mqtt_batch_num', '12.5')).to eq('12.5')
+      expect(wait_for_variable('mqtt_batch_bool', 'true')).to eq('true')
+    end
+
+    it 'should accept batches larger than the payload size limit' do
+      values = (1..64).map { |i| ["mqtt_big_batch_var#{i}", large_payload(200)] }.to_h
+      payload = values.to_json
+      expect(payload.length).to be > LARGE_PAYLOAD_SIZE
+
+      publish_batch(payload)
+
+      values.each do |name, value|
+        expect(wait_for_variable(name, value)).to eq(value)
+      end
+    end
+
+    it 'should ignore invalid batches' do
+      value = SecureRandom.hex(8)
+      publish_batch({ 'mqtt_batch_invalid' => value }.to_json)
+      expect(wait_for_variable('mqtt_batch_invalid', value)).to eq(value)
+
+      publish_batch('{"mqtt_batch_invalid": "changed", ')
+
+      after_value = SecureRandom.hex(8)
+      publish_variable('mqtt_test_var', after_value)
+      expect(wait_for_variable('mqtt_test_var', after_value)).to eq(after_value)
+
+      expect(@api.get_variable('mqtt_batch_invalid')).to eq(value)
+    end
+  end
+
+  context 'field extraction' do
+    it 'should extract several fields from one JSON payload' do
+      temp = rand(100).to_s
+      humidity = rand(100).to_s
+      element = SecureRandom.hex(4)
+
+      @mqtt.publish(
+        "#{@topic_prefix}sensor",
+        { temperature: temp.to_i, readings: { humidity: humidity }, list: ['x', element], other: [1, 2] }.to_json
+      )
+
+      expect(wait_for_variable('mqtt_extracted_temp', temp)).to eq(temp)
+      expect(wait_for_variable('mqtt_extracted_humidity', humidity)).to eq(humidity)
+      expect(wait_for_variable('mqtt_extracted_element', element)).to eq(element)
+    end
+
+    it 'should leave variables alone when fields are missing' do
+      temp = rand(100).to_s
+      @mqtt.publish("#{@topic_prefix}sensor", { temperature: temp.to_i }.to_json)
+      expect(wait_for_variable('mqtt_extracted_temp', temp)).to eq(temp)
+
+      @mqtt.publish("#{@topic_prefix}sensor", { unrelated: 1 }.to_json)
+
+      after_value = SecureRandom.hex(8)
+      publish_variable('mqtt_test_var', after_value)
+      expect(wait_for_variable('mqtt_test_var', after_value)).to eq(after_value)
+
+      expect(@api.get_variable('mqtt_extracted_temp')).to eq(temp)
+    end
+  end
+end
@@ -0,0 +1,275 @@
+#include <Arduino.h>
+#include <AtomicFileWriter.h>
+#include <FS.h>
+#include <KeyValueDatabase.h>
+#include <VariableDictionary.h>
+#include <unity.h>
+
+static const char DB_FILENAME[] = "/test.db";
+
+static KeyValueDatabase db;
+
+static void openDatabase() {
+  if (!SPIFFS.exists(DB_FILENAME)) {
+    SPIFFS.open(DB_FILENAME, "w").close();
+    db.open(SPIFFS.open(DB_FILENAME, "r+"));
+    db.initialize();
+  } else {
+    db.open(SPIFFS.open(DB_FILENAME, "r+"));
+  }
+}
+
+static void set(const char* key, const char* value) {
+  db.set(key, strlen(key), value, strlen(value));
+}
+
+static void writeFile(const String& path, const char* contents) {
+  File file = SPIFFS.open(path, "w");
+  file.print(contents);
+  file.close();
+}
+
+static String readFile(const String& path) {
+  File file = SPIFFS.open(path, "r");
+  String contents = file.readString();
+  file.close();
+
+  return contents;
+}
+
+static String get(const char* key) {
+  char buffer[KeyValueDatabase::MAX_COLUMN_SIZE];
+
+  if (db.get(key, strlen(key), buffer, sizeof(buffer))) {
+    return buffer;
+  } else {
+    return "(missing)";
+  }
+}
+
+void setUp() {
+  SPIFFS.format();
+}
+
+void tearDown() {
+  db.close();
+}
+
+void test_kv_get_missing() {
+  openDatabase();
+
+  TEST_ASSERT_EQUAL_STRING("(missing)", get("a").c_str());
+  TEST_ASSERT_EQUAL(0, db.size());
+}
+
+void test_kv_set_and_get() {
+  openDatabase();
+
+  set("a", "1");
+  set("bb", "22");
+  set("ccc", "333");
+
+  TEST_ASSERT_EQUAL(3, db.size());
+  TEST_ASSERT_EQUAL_STRING("1", get("a").c_str());
+  TEST_ASSERT_EQUAL_STRING("22", get("bb").c_str());
+  TEST_ASSERT_EQUAL_STRING("333", get("ccc").c_str());
+}
+
+void test_kv_overwrite() {
+  openDatabase();
+
+  set("a", "short");
+  set("b", "other");
+  set("a", "a much longer value than before");
+  set("a", "x");
+
+  TEST_ASSERT_EQUAL(2, db.size());
+  TEST_ASSERT_EQUAL_STRING("x", get("a").c_str());
+  TEST_ASSERT_EQUAL_STRING("other", get("b").c_str());
+}
+
+void test_kv_erase() {
+  openDatabase();
+
+  set("a", "1");
+  set("b", "2");
+  db.erase("a", 1);
+
+  TEST_ASSERT_EQUAL(1, db.size());
+  TEST_ASSERT_EQUAL_STRING("(missing)", get("a").c_str());
+  TEST_ASSERT_EQUAL_STRING("2", get("b").c_str());
+
+  // Erased rows are reused
+  const size_t sizeBefore = SPIFFS.open(DB_FILENAME, "r").size();
+  set("c", "3");
+
+  TEST_ASSERT_EQUAL(sizeBefore, SPIFFS.open(DB_FILENAME, "r").size());
+  TEST_ASSERT_EQUAL_STRING("3", get("c").c_str());
+}
+
+void test_kv_read_entries() {
+  openDatabase();
+
+  set("a", "1");
+  set("b", "2");
+  set("c", "3");
+  db.erase("b", 1);
+
+  char key[KeyValueDatabase::MAX_COLUMN_SIZE];
+  char value[KeyValueDatabase::MAX_COLUMN_SIZE];
+  String seen;
+
+  db.beginRead();
+  while (db.readEntry(key, sizeof(key), value, sizeof(value))) {
+    seen += key;
+    seen += '=';
+    seen += value;
+    seen += ';';
+  }
+
+  TEST_ASSERT_EQUAL_STRING("a=1;c=3;", seen.c_str());
+}
+
+void test_kv_persists() {
+  openDatabase();
+  set("a", "1");
+  db.close();
+
+  openDatabase();
+
+  TEST_ASSERT_EQUAL(1, db.size());
+  TEST_ASSERT_EQUAL_STRING("1", get("a").c_str());
+}
+
+void test_kv_batch() {
+  openDatabase();
+
+  db.beginBatch();
+  set("a", "1");
+  set("b", "2");
+  db.endBatch();
+  db.close();
+
+  openDatabase();
+
+  TEST_ASSERT_EQUAL(2, db.size());
+  TEST_ASSERT_EQUAL_STRING("2", get("b").c_str());
+}
+
+void test_dictionary_set_and_get() {
+  VariableDictionary vars;
+  vars.load();
+
+  vars.set("temperature", "21.5");
+
+  TEST_ASSERT_EQUAL_STRING("21.5", vars.get("temperature").c_str());
+  TEST_ASSERT_EQUAL_STRING("", vars.get("humidity").c_str());
+}
+
+void test_dictionary_persists() {
+  {
+    VariableDictionary vars;
+    vars.load();
+    vars.set("temperature", "21.5");
+    vars.set("timestamp", "1600000000");
+  }
+
+  VariableDictionary vars;
+  vars.load();
+
+  TEST_ASSERT_EQUAL_STRING("21.5", vars.get("temperature").c_str());
+  // Transient variables are only kept in memory
+  TEST_ASSERT_EQUAL_STRING("", vars.get("timestamp").c_str());
+}
+
+void test_dictionary_erase_and_clear() {
+  VariableDictionary vars;
+  vars.load();
+
+  vars.set("a", "1");
+  vars.set("b", "2");
+  vars.erase("a");
+
+  TEST_ASSERT_EQUAL_STRING("", vars.get("a").c_str());
+  TEST_ASSERT_EQUAL_STRING("2", vars.get("b").c_str());
+
+  vars.clear();
+
+  TEST_ASSERT_EQUAL_STRING("", vars.get("b").c_str());
+}
+
+void test_atomic_writes_are_independent() {
+  writeFile("/a.json", "old a");
+  writeFile("/b.json", "old b");
+
+  AtomicFileWriter a;
+  AtomicFileWriter b;
+
+  TEST_ASSERT_FALSE(a.getTempPath() == b.getTempPath());
+
+  // Interleaved, as two requests would be
+  File fileA = a.open();
+  File fileB = b.open();
+  fileA.print("new ");
+  fileB.print("new b");
+  fileB.close();
+
+  // Picked up again by ID, like a later chunk of the same upload
+  fileA.close();
+  fileA = AtomicFileWriter(a.getId()).open("a");
+  fileA.print("a");
+  fileA.close();
+
+  b.abort();
+  TEST_ASSERT_TRUE(AtomicFileWriter(a.getId()).commit("/a.json"));
+
+  TEST_ASSERT_EQUAL_STRING("new a", readFile("/a.json").c_str());
+  TEST_ASSERT_EQUAL_STRING("old b", readFile("/b.json").c_str());
+  TEST_ASSERT_FALSE(SPIFFS.exists(a.getTempPath()));
+  TEST_ASSERT_FALSE(SPIFFS.exists(b.getTempPath()));
+}
+
+void test_atomic_recover() {
+  writeFile("/a.json", "old a");
+  writeFile("/b.json", "old b");
+
+  // Power lost after a's journal was written, and before b was committed
+  AtomicFileWriter a;
+  writeFile(a.getTempPath(), "new a");
+  writeFile(a.getTempPath() + ".dst", "/a.json\n");
+  SPIFFS.remove("/a.json");
+
+  AtomicFileWriter b;
+  writeFile(b.getTempPath(), "new b");
+
+  AtomicFileWriter::recover();
+
+  TEST_ASSERT_EQUAL_STRING("new a", readFile("/a.json").c_str());
+  TEST_ASSERT_EQUAL_STRING("old b", readFile("/b.json").c_str());
+
+  File dir = SPIFFS.open(AtomicFileWriter::TEMP_DIRECTORY);
+  TEST_ASSERT_FALSE(dir && dir.openNextFile());
+}
+
+int main(int argc, char** argv) {
+  Serial.setOutput(nullptr);
+
+  UNITY_BEGIN();
+
+  RUN_TEST(test_kv_get_missing);
+  RUN_TEST(test_kv_set_and_get);
+  RUN_TEST(test_kv_overwrite);
+  RUN_TEST(test_kv_erase);
+  RUN_TEST(test_kv_read_entries);
+  RUN_TEST(test_kv_persists);
+  RUN_TEST(test_kv_batch);
+
+  RUN_TEST(test_dictionary_set_and_get);
+  RUN_TEST(test_dictionary_persists);
+  RUN_TEST(test_dictionary_erase_and_clear);
+
+  RUN_TEST(test_atomic_writes_are_independent);
+  RUN_TEST(test_atomic_recover);
+
+  return UNITY_END();
+}
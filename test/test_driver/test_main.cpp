@@ -0,0 +1,568 @@
+#include <Arduino.h>
+#include <DisplayTemplateDriver.h>
+#include <DisplayTypeHelpers.h>
+#include <FS.h>
+#include <NativeClock.h>
+#include <Settings.h>
+#include <FontStore.h>
+#include <TemplateValidator.h>
+#include <TextLayout.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+static const char TEMPLATE_FILENAME[] = TEMPLATES_DIRECTORY "/test.json";
+
+// A filled square in the top left corner, and a variable below it
+static const char TEMPLATE[] = R"({
+  "rotation": 0,
+  "rectangles": [
+    {
+      "x": 0,
+      "y": 0,
+      "w": {"type": "static", "value": 10},
+      "h": {"type": "static", "value": 10},
+      "style": "filled",
+      "color": "black"
+    }
+  ],
+  "text": [
+    {
+      "x": 10,
+      "y": 40,
+      "font": "FreeSans9pt7b",
+      "value": {"type": "variable", "variable": "temperature"}
+    }
+  ]
+})";
+
+static Settings settings;
+static GxEPD2_GFX* display;
+static std::unique_ptr<DisplayTemplateDriver> driver;
+
+void setUp() {
+  SPIFFS.format();
+
+  File file = SPIFFS.open(TEMPLATE_FILENAME, "w");
+  file.write(reinterpret_cast<const uint8_t*>(TEMPLATE), strlen(TEMPLATE));
+  file.close();
+
+  NativeClock::set(0);
+  settings.display.windowed_updates = false;
+
+  display = DisplayTypeHelpers::buildDisplay(settings.display.display_type,
+      settings.hardware.dc_pin,
+      settings.hardware.rst_pin,
+      settings.hardware.busy_pin,
+      settings.hardware.getSsPin());
+  driver.reset(new DisplayTemplateDriver(display, settings));
+  driver->init();
+  driver->setTemplate(TEMPLATE_FILENAME);
+  driver->loop();
+}
+
+void tearDown() {
+  driver.reset();
+  delete display;
+}
+
+void test_full_update_on_load() {
+  const auto& refreshes = display->getRefreshes();
+
+  TEST_ASSERT_EQUAL(1, refreshes.size());
+  TEST_ASSERT_FALSE(refreshes[0].partial);
+  TEST_ASSERT_EQUAL(display->width(), refreshes[0].w);
+  TEST_ASSERT_EQUAL(display->height(), refreshes[0].h);
+
+  Framebuffer fb = driver->getFramebuffer();
+
+  TEST_ASSERT_EQUAL(GxEPD_BLACK, fb.getPixel(5, 5));
+  TEST_ASSERT_EQUAL(GxEPD_WHITE, fb.getPixel(15, 5));
+}
+
+void test_variable_update_renders_text() {
+  display->clearRefreshes();
+
+  driver->updateVariable("temperature", "21.5");
+  driver->loop();
+
+  const auto& refreshes = display->getRefreshes();
+  TEST_ASSERT_EQUAL(1, refreshes.size());
+  TEST_ASSERT_TRUE(refreshes[0].partial);
+
+  Framebuffer fb = driver->getFramebuffer();
+  size_t black = 0;
+
+  for (uint16_t y = 20; y < 45; ++y) {
+    for (uint16_t x = 10; x < 60; ++x) {
+      black += fb.getPixel(x, y) == GxEPD_BLACK;
+    }
+  }
+
+  TEST_ASSERT_GREATER_THAN(0, black);
+  TEST_ASSERT_EQUAL_STRING("21.5", driver->getVariable("temperature").c_str());
+}
+
+void test_text_layout_wraps_like_adafruit_gfx() {
+  FontStore fonts;
+  TextLayout layout(fonts.get("FreeSans9pt7b"), 1, TextAlignment::LEFT);
+
+  // Lines after the first start at the left edge of the display, not at x
+  layout.render(display, "ab\ncd", 100, 40, GxEPD_BLACK);
+  Rectangle bounds = layout.getBounds();
+  TEST_ASSERT_LESS_THAN(10, bounds.x);
+  TEST_ASSERT_GREATER_THAN(100, bounds.x + bounds.w);
+
+  // So does text that runs off the right edge
+  const String line(std::string(display->width() / 4, 'W').c_str());
+  layout.render(display, line, 100, 40, GxEPD_BLACK);
+  bounds = layout.getBounds();
+  TEST_ASSERT_LESS_THAN(10, bounds.x);
+  TEST_ASSERT_GREATER_THAN(60, bounds.y + bounds.h);
+}
+
+static void writeFont(const char* name, const uint8_t* data, size_t length) {
+  File file = SPIFFS.open(String(FONTS_DIRECTORY) + "/" + name, "w");
+  file.write(data, length);
+  file.close();
+}
+
+void test_font_store_skips_invalid_fonts() {
+  // One glyph for 'A', 8x1 pixels
+  const uint8_t font[] = {
+    'G', 'F', 'X', 'F', 'A', 'A', 10, 0,
+    0, 0, 8, 1, 9, 0, static_cast<uint8_t>(-1), 0,
+    0xFF
+  };
+  const uint8_t truncated[] = {'G', 'F', 'X', 'F', 'A', 'Z', 10, 0};
+
+  writeFont("valid", font, sizeof(font));
+  writeFont("truncated", truncated, sizeof(truncated));
+
+  FontStore fonts;
+  TEST_ASSERT_TRUE(fonts.contains("valid"));
+  TEST_ASSERT_FALSE(fonts.contains("truncated"));
+  TEST_ASSERT_NULL(fonts.get("truncated").get());
+
+  std::shared_ptr<const FontMetrics> metrics = fonts.get("valid");
+  TEST_ASSERT_NOT_NULL(metrics.get());
+
+  // Bitmaps are read on demand, after the table was loaded
+  const FontMetrics::Glyph* glyph = metrics->getGlyph('A');
+  TEST_ASSERT_NOT_NULL(glyph);
+  const uint8_t* bitmap = metrics->getGlyphBitmap(*glyph);
+  TEST_ASSERT_NOT_NULL(bitmap);
+  TEST_ASSERT_EQUAL_HEX8(0xFF, bitmap[0]);
+}
+
+void test_windowed_updates() {
+  settings.display.windowed_updates = true;
+  display->clearRefreshes();
+
+  driver->updateVariable("temperature", "21.5");
+  driver->loop();
+
+  const auto& refreshes = display->getRefreshes();
+  TEST_ASSERT_EQUAL(1, refreshes.size());
+  TEST_ASSERT_TRUE(refreshes[0].partial);
+  // Only the text's bounding box is refreshed
+  TEST_ASSERT_TRUE(refreshes[0].x <= 10);
+  TEST_ASSERT_TRUE(refreshes[0].w < display->width());
+  TEST_ASSERT_TRUE(refreshes[0].h < display->height());
+}
+
+void test_unbound_variable_doesnt_refresh() {
+  display->clearRefreshes();
+
+  driver->updateVariable("humidity", "40");
+  driver->loop();
+
+  TEST_ASSERT_EQUAL(0, display->getRefreshes().size());
+}
+
+void test_periodic_full_refresh() {
+  display->clearRefreshes();
+
+  NativeClock::advance((settings.display.full_refresh_period + 1) * 1000);
+  driver->updateVariable("temperature", "21.5");
+  driver->loop();
+
+  const auto& refreshes = display->getRefreshes();
+  TEST_ASSERT_EQUAL(1, refreshes.size());
+  TEST_ASSERT_FALSE(refreshes[0].partial);
+}
+
+void test_suspended_rendering() {
+  display->clearRefreshes();
+
+  driver->suspendRendering();
+  driver->updateVariable("temperature", "1");
+  driver->loop();
+  driver->updateVariable("temperature", "2");
+  driver->loop();
+
+  TEST_ASSERT_EQUAL(0, display->getRefreshes().size());
+  TEST_ASSERT_EQUAL(1, driver->resumeRendering());
+
+  driver->loop();
+
+  TEST_ASSERT_EQUAL(1, display->getRefreshes().size());
+}
+
+void test_validator_checks_formatters() {
+  StaticJsonDocument<2048> tmpl;
+  StaticJsonDocument<1024> errors;
+
+  deserializeJson(tmpl, R"({
+    "text": [
+      {
+        "font_size": "2",
+        "value": {
+          "type": "variable",
+          "variable": "a",
+          "formatter": {"type": "cases", "args": {"cases": {"on": "On"}}}
+        }
+      },
+      {
+        "value": {
+          "type": "variable",
+          "variable": "b",
+          "formatter": {"type": "pfnumeric", "args": {"format": "%d%d"}}
+        }
+      },
+      {
+        "value": {
+          "type": "variable",
+          "variable": "c",
+          "formatter": {"type": "expr", "args": {"expression": "x +"}}
+        }
+      }
+    ]
+  })");
+
+  JsonArray errorList = errors.to<JsonArray>();
+
+  TEST_ASSERT_FALSE(driver->validateTemplate(tmpl, errorList));
+  TEST_ASSERT_EQUAL(2, errorList.size());
+  TEST_ASSERT_EQUAL_STRING("/text/1/value/formatter/args/format",
+      errorList[0]["path"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("/text/2/value/formatter/args/expression",
+      errorList[1]["path"].as<const char*>());
+
+  // Normalized so that the driver reads it as a number
+  TEST_ASSERT_TRUE(tmpl["text"][0]["font_size"].is<int>());
+  TEST_ASSERT_EQUAL(2, tmpl["text"][0]["font_size"].as<int>());
+}
+
+void test_validator_escapes_paths() {
+  StaticJsonDocument<512> tmpl;
+  StaticJsonDocument<512> errors;
+
+  deserializeJson(tmpl, R"({"formatters": {"a/b~c": {"type": "round", "args": "x"}}})");
+
+  JsonArray errorList = errors.to<JsonArray>();
+
+  TEST_ASSERT_FALSE(driver->validateTemplate(tmpl, errorList));
+  TEST_ASSERT_EQUAL(1, errorList.size());
+  TEST_ASSERT_EQUAL_STRING("/formatters/a~1b~0c/args", errorList[0]["path"].as<const char*>());
+}
+
+// The schema is what the editor builds its forms from, and is checked by
+// breaking each of its constraints in SCHEMA_TEMPLATE one at a time.
+static const char SCHEMA_FILENAME[] = "template.schema.json";
+// Not a valid value for any of the schema's enums or patterns
+static const char NOT_IN_SCHEMA[] = "not in schema";
+
+// Every field in the schema.  Values and formatters are filled in by
+// SchemaChecker::load().
+static const char SCHEMA_TEMPLATE[] = R"({
+  "background_color": "white",
+  "rotation": 0,
+  "formatters": [{"name": "named", "formatter": null}],
+  "bitmaps": [{"x": 0, "y": 0, "w": 32, "h": 32, "color": "black", "value": null}],
+  "text": [
+    {
+      "x": 0,
+      "y": 0,
+      "font": "FreeSans9pt7b",
+      "font_size": 1,
+      "alignment": "left",
+      "value": null
+    }
+  ],
+  "rectangles": [
+    {"x": 0, "y": 0, "style": "outline", "color": "black", "w": null, "h": null}
+  ],
+  "lines": [{"x1": 0, "x2": 1, "y1": 0, "y2": 1}]
+})";
+
+// Has the fields of both variants, so that one is picked by changing its type
+static const char SCHEMA_VALUE[] = R"({
+  "type": "variable",
+  "value": "10",
+  "variable": "a",
+  "formatter": null
+})";
+
+// Likewise for every variant of a formatter
+static const char SCHEMA_FORMATTER[] = R"({
+  "type": "identity",
+  "ref": "named",
+  "args": {
+    "format": "%.1f",
+    "digits": 1,
+    "base": 100,
+    "prefix": "",
+    "default": "a",
+    "cases": [{"key": "a", "value": "b"}],
+    "ranges": [{"min": 0, "value": "b"}],
+    "expression": "x * 2",
+    "formatter": {"type": "identity"},
+    "stages": [{"type": "identity"}]
+  }
+})";
+
+static const char* const SCHEMA_VALUE_PATHS[] = {
+  "/bitmaps/0/value",
+  "/text/0/value",
+  "/rectangles/0/w",
+  "/rectangles/0/h",
+  nullptr
+};
+
+// Schema keys don't need escaping, so paths are split on "/"
+static JsonVariant resolvePath(JsonVariant value, const std::string& path) {
+  if (path.empty() || value.isNull()) {
+    return value;
+  }
+
+  const size_t end = path.find('/', 1);
+  const std::string key = path.substr(1, end == std::string::npos ? std::string::npos : end - 1);
+  const std::string rest = end == std::string::npos ? "" : path.substr(end);
+
+  if (value.is<JsonArray>()) {
+    return resolvePath(value.as<JsonArray>()[atoi(key.c_str())], rest);
+  } else {
+    return resolvePath(value.as<JsonObject>()[key.c_str()], rest);
+  }
+}
+
+static void replacePath(JsonDocument& doc, const std::string& path, const char* json) {
+  StaticJsonDocument<2048> value;
+
+  deserializeJson(value, json);
+  resolvePath(doc.as<JsonVariant>(), path).set(value.as<JsonVariant>());
+}
+
+class SchemaChecker {
+public:
+  typedef std::function<void(JsonVariant field)> TBreakFn;
+
+  SchemaChecker(JsonObject definitions)
+    : definitions(definitions)
+    , validator(
+        [](const char*) { return true; },
+        [](const char* name) { return strcmp(name, NOT_IN_SCHEMA) != 0; }
+      )
+  { }
+
+  // Checks the constraints of the schema node for the value at path.
+  // selected is set for the variants of a formatter or value, where "type" is
+  // what selects them.
+  void check(JsonObject node, const std::string& path, bool selected = false) {
+    const char* ref = node["$ref"];
+
+    if (ref != nullptr) {
+      const std::string name = ref + strlen("#/definitions/");
+
+      // Formatters contain formatters.  Once is enough.
+      if (std::find(refs.begin(), refs.end(), name) == refs.end()) {
+        refs.push_back(name);
+        check(definitions[name.c_str()].as<JsonObject>(), path);
+        refs.pop_back();
+      }
+
+      return;
+    }
+
+    checkConstraints(node, path);
+
+    for (JsonPair property : node["properties"].as<JsonObject>()) {
+      if (!selected || strcmp(property.key().c_str(), "type") != 0) {
+        check(property.value().as<JsonObject>(), path + "/" + property.key().c_str());
+      }
+    }
+
+    if (node.containsKey("items")) {
+      check(node["items"].as<JsonObject>(), path + "/0");
+    }
+
+    for (JsonObject variant : node["dependencies"]["type"]["oneOf"].as<JsonArray>()) {
+      selectors.emplace_back(path + "/type", variant["properties"]["type"]["enum"][0].as<const char*>());
+      check(variant, path, true);
+      selectors.pop_back();
+    }
+  }
+
+  size_t getChecked() const {
+    return checked;
+  }
+
+private:
+  JsonObject definitions;
+  TemplateValidator validator;
+  std::vector<std::string> refs;
+  // Types set to pick the variants that are being checked
+  std::vector<std::pair<std::string, std::string>> selectors;
+  size_t checked = 0;
+
+  void checkConstraints(JsonObject node, const std::string& path) {
+    // The template itself
+    if (path.empty()) {
+      return;
+    }
+
+    const char* type = node["type"] | "";
+
+    if (strcmp(type, "object") == 0 || strcmp(type, "array") == 0) {
+      expectError(path, "type", [](JsonVariant field) { field.set(5); });
+    } else if (strcmp(type, "string") == 0) {
+      expectError(path, "type", [](JsonVariant field) { field.to<JsonObject>(); });
+    } else if (strcmp(type, "integer") == 0 || strcmp(type, "number") == 0) {
+      expectError(path, "type", [](JsonVariant field) { field.set(NOT_IN_SCHEMA); });
+    }
+
+    if (node.containsKey("minimum")) {
+      const long minimum = node["minimum"];
+      expectError(path, "minimum", [=](JsonVariant field) { field.set(minimum - 1); });
+    }
+
+    if (node.containsKey("pattern")) {
+      expectError(path, "pattern", [](JsonVariant field) { field.set(NOT_IN_SCHEMA); });
+    }
+
+    if (node.containsKey("enum")) {
+      JsonArray choices = node["enum"];
+      long maximum = 0;
+
+      for (JsonVariant choice : choices) {
+        expectValid(path, choice);
+        maximum = std::max(maximum, choice.as<long>());
+      }
+
+      if (choices[0].is<const char*>()) {
+        expectError(path, "enum", [](JsonVariant field) { field.set(NOT_IN_SCHEMA); });
+      } else {
+        expectError(path, "enum", [=](JsonVariant field) { field.set(maximum + 1); });
+      }
+    }
+
+    for (JsonVariant key : node["required"].as<JsonArray>()) {
+      // The editor leaves it out of formatters that haven't been set up, and
+      // the validator fills in "identity"
+      if (strcmp(key, "type") == 0) {
+        continue;
+      }
+
+      const std::string field = path + "/" + key.as<const char*>();
+      expectError(field, "required", [&](JsonVariant) {
+        resolvePath(tmpl.as<JsonVariant>(), path).as<JsonObject>().remove(key.as<const char*>());
+      });
+    }
+  }
+
+  void expectValid(const std::string& path, JsonVariant value) {
+    std::string description = path + " = ";
+    serializeJson(value, description);
+
+    load(path, description);
+    resolvePath(tmpl.as<JsonVariant>(), path).set(value);
+    TEST_ASSERT_FALSE_MESSAGE(hasError(path), description.c_str());
+  }
+
+  void expectError(const std::string& path, const char* constraint, TBreakFn breakField) {
+    const std::string description = path + " (" + constraint + ")";
+
+    load(path, description);
+    TEST_ASSERT_FALSE_MESSAGE(hasError(path), (description + " is invalid before it's broken").c_str());
+
+    load(path, description);
+    breakField(resolvePath(tmpl.as<JsonVariant>(), path));
+    TEST_ASSERT_TRUE_MESSAGE(hasError(path), (description + " isn't checked").c_str());
+  }
+
+  void load(const std::string& path, const std::string& description) {
+    deserializeJson(tmpl, SCHEMA_TEMPLATE);
+    replacePath(tmpl, "/formatters/0/formatter", SCHEMA_FORMATTER);
+
+    for (const char* const* value = SCHEMA_VALUE_PATHS; *value != nullptr; ++value) {
+      replacePath(tmpl, *value, SCHEMA_VALUE);
+      replacePath(tmpl, std::string(*value) + "/formatter", SCHEMA_FORMATTER);
+    }
+
+    for (const auto& selector : selectors) {
+      resolvePath(tmpl.as<JsonVariant>(), selector.first).set(selector.second.c_str());
+    }
+
+    // Required fields are checked by removing them from their parent
+    const std::string parent = path.substr(0, path.rfind('/'));
+    TEST_ASSERT_FALSE_MESSAGE(
+      resolvePath(tmpl.as<JsonVariant>(), parent).isNull(),
+      (description + " isn't in SCHEMA_TEMPLATE").c_str()
+    );
+  }
+
+  bool hasError(const std::string& path) {
+    errors.clear();
+    validator.validate(tmpl, errors.to<JsonArray>());
+    ++checked;
+
+    for (JsonObject error : errors.as<JsonArray>()) {
+      if (path == error["path"].as<const char*>()) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  DynamicJsonDocument tmpl{16384};
+  DynamicJsonDocument errors{4096};
+};
+
+void test_validator_follows_schema() {
+  std::ifstream file(SCHEMA_FILENAME);
+  DynamicJsonDocument schema(32768);
+
+  TEST_ASSERT_TRUE_MESSAGE(file.good(), "run from the project directory");
+  TEST_ASSERT_FALSE(deserializeJson(schema, file));
+
+  SchemaChecker checker(schema["definitions"].as<JsonObject>());
+  checker.check(schema.as<JsonObject>(), "");
+
+  TEST_ASSERT_TRUE(checker.getChecked() > 0);
+}
+
+int main(int argc, char** argv) {
+  Serial.setOutput(nullptr);
+
+  UNITY_BEGIN();
+
+  RUN_TEST(test_full_update_on_load);
+  RUN_TEST(test_variable_update_renders_text);
+  RUN_TEST(test_text_layout_wraps_like_adafruit_gfx);
+  RUN_TEST(test_font_store_skips_invalid_fonts);
+  RUN_TEST(test_windowed_updates);
+  RUN_TEST(test_unbound_variable_doesnt_refresh);
+  RUN_TEST(test_periodic_full_refresh);
+  RUN_TEST(test_suspended_rendering);
+  RUN_TEST(test_validator_checks_formatters);
+  RUN_TEST(test_validator_escapes_paths);
+  RUN_TEST(test_validator_follows_schema);
+
+  return UNITY_END();
+}
@@ -0,0 +1,443 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <AtomicFileWriter.h>
+#include <FS.h>
+#include <JsonMergePatch.h>
+#include <JsonStreamParser.h>
+#include <unity.h>
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+// Records every event as a line of text, with the value's path and the bytes
+// of the document it was reported to span
+class Recorder : public JsonStreamParser::Handler {
+public:
+  JsonStreamParser* parser;
+  const char* document;
+  std::string events;
+  bool sawTruncated;
+
+  Recorder(const char* document)
+    : parser(nullptr)
+    , document(document)
+    , sawTruncated(false)
+  { }
+
+  virtual void onScalar(
+    const JsonStreamPath& path,
+    JsonStreamParser::ValueType type,
+    const char* value,
+    size_t length
+  ) {
+    events += pathString(path);
+    events += " ";
+    events += TYPE_NAMES[static_cast<int>(type)];
+    events += " ";
+    events.append(value, length);
+    events += span();
+    sawTruncated |= parser->isValueTruncated();
+  }
+
+  virtual void onStartContainer(const JsonStreamPath& path, bool isArray) {
+    events += pathString(path);
+    events += isArray ? " [\n" : " {\n";
+  }
+
+  virtual void onEndContainer(const JsonStreamPath& path, bool isArray) {
+    events += pathString(path);
+    events += isArray ? " ]" : " }";
+    events += span();
+  }
+
+private:
+  static constexpr const char* TYPE_NAMES[] = {"str", "num", "bool", "null"};
+
+  static std::string pathString(const JsonStreamPath& path) {
+    std::string result = "$";
+
+    for (size_t i = 0; i < path.getDepth(); ++i) {
+      if (path[i].isArray) {
+        result += "[" + std::to_string(path[i].index) + "]";
+      } else {
+        result += ".";
+        result += path[i].key.c_str();
+      }
+    }
+
+    return result;
+  }
+
+  std::string span() const {
+    std::string result = " <";
+    result.append(document + parser->getValueStart(), document + parser->getValueEnd());
+    result += ">\n";
+    return result;
+  }
+};
+
+constexpr const char* Recorder::TYPE_NAMES[];
+
+// Parses document in pieces, split at each of splits (offsets in ascending
+// order).  Returns the events, or "ERROR" if the document was rejected.
+static std::string parse(const char* document, const std::vector<size_t>& splits = {}) {
+  Recorder recorder(document);
+  JsonStreamParser parser(recorder);
+  recorder.parser = &parser;
+
+  const size_t length = strlen(document);
+  size_t start = 0;
+  bool ok = true;
+
+  for (size_t i = 0; i <= splits.size() && ok; ++i) {
+    const size_t end = i < splits.size() ? splits[i] : length;
+    ok = parser.feed(document + start, end - start);
+    start = end;
+  }
+
+  if (!ok || !parser.finish()) {
+    return "ERROR";
+  }
+
+  return recorder.events;
+}
+
+// Every way of splitting document in two, and one byte at a time, must give
+// the same result as parsing it whole
+static std::string parseSplit(const char* document) {
+  const std::string whole = parse(document);
+  const size_t length = strlen(document);
+  std::vector<size_t> everyByte;
+
+  for (size_t i = 1; i < length; ++i) {
+    const std::string split = parse(document, {i});
+
+    if (split != whole) {
+      std::string message = "split at " + std::to_string(i) + " of " + document;
+      TEST_ASSERT_EQUAL_STRING_MESSAGE(whole.c_str(), split.c_str(), message.c_str());
+    }
+
+    everyByte.push_back(i);
+  }
+
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(whole.c_str(), parse(document, everyByte).c_str(), document);
+
+  return whole;
+}
+
+static void assertRejected(const char* document) {
+  TEST_ASSERT_EQUAL_STRING_MESSAGE("ERROR", parseSplit(document).c_str(), document);
+}
+
+static const char TEMPLATE_PATH[] = "/t/template.json";
+
+static String readFile(const char* path) {
+  File file = SPIFFS.open(path, "r");
+  String contents = file.readString();
+  file.close();
+
+  return contents;
+}
+
+// Merges patch into a file holding source, the way the web server updates
+// templates: into a temp file that replaces the original only if the merge
+// succeeded.  Returns the merged document, or "ERROR" if apply() failed.
+static std::string mergePatch(const std::string& source, const char* patch) {
+  File file = SPIFFS.open(TEMPLATE_PATH, "w");
+  file.print(source.c_str());
+  file.close();
+
+  DynamicJsonDocument patchDoc(1024);
+  TEST_ASSERT_FALSE(deserializeJson(patchDoc, patch));
+
+  AtomicFileWriter writer;
+  File input = SPIFFS.open(TEMPLATE_PATH, "r");
+  File output = writer.open();
+  const bool merged = JsonMergePatch::apply(input, patchDoc.as<JsonObjectConst>(), output);
+  input.close();
+  output.close();
+
+  if (!merged) {
+    writer.abort();
+
+    // The original is left as it was
+    TEST_ASSERT_EQUAL_STRING(source.c_str(), readFile(TEMPLATE_PATH).c_str());
+    TEST_ASSERT_FALSE(SPIFFS.exists(writer.getTempPath()));
+
+    return "ERROR";
+  }
+
+  TEST_ASSERT_TRUE(writer.commit(TEMPLATE_PATH));
+  TEST_ASSERT_FALSE(SPIFFS.exists(writer.getTempPath()));
+
+  String result = readFile(TEMPLATE_PATH);
+
+  // Whatever was merged must still be valid JSON
+  TEST_ASSERT_TRUE_MESSAGE(parse(result.c_str()) != "ERROR", result.c_str());
+
+  return result.c_str();
+}
+
+void setUp() {
+  SPIFFS.format();
+}
+
+void tearDown() {}
+
+void test_nested() {
+  const char* document = R"( {"a": [1, {"b": true}, []], "c": {}, "d": null} )";
+
+  TEST_ASSERT_EQUAL_STRING(
+    "$ {\n"
+    "$.a [\n"
+    "$.a[0] num 1 <1>\n"
+    "$.a[1] {\n"
+    "$.a[1].b bool true <true>\n"
+    "$.a[1] } <{\"b\": true}>\n"
+    "$.a[2] [\n"
+    "$.a[2] ] <[]>\n"
+    "$.a ] <[1, {\"b\": true}, []]>\n"
+    "$.c {\n"
+    "$.c } <{}>\n"
+    "$.d null null <null>\n"
+    "$ } <{\"a\": [1, {\"b\": true}, []], \"c\": {}, \"d\": null}>\n",
+    parseSplit(document).c_str()
+  );
+}
+
+void test_root_scalars() {
+  TEST_ASSERT_EQUAL_STRING("$ num 42 <42>\n", parseSplit("42").c_str());
+  TEST_ASSERT_EQUAL_STRING("$ num -0.5e+10 <-0.5e+10>\n", parseSplit(" -0.5e+10 ").c_str());
+  TEST_ASSERT_EQUAL_STRING("$ bool false <false>\n", parseSplit("false").c_str());
+  TEST_ASSERT_EQUAL_STRING("$ str  <\"\">\n", parseSplit("\"\"").c_str());
+}
+
+void test_numbers() {
+  const char* document = "[0, -0, 10, 1.25, 1E3, 2e-2, -7.5E+1]";
+
+  TEST_ASSERT_EQUAL_STRING(
+    "$ [\n"
+    "$[0] num 0 <0>\n"
+    "$[1] num -0 <-0>\n"
+    "$[2] num 10 <10>\n"
+    "$[3] num 1.25 <1.25>\n"
+    "$[4] num 1E3 <1E3>\n"
+    "$[5] num 2e-2 <2e-2>\n"
+    "$[6] num -7.5E+1 <-7.5E+1>\n"
+    "$ ] <[0, -0, 10, 1.25, 1E3, 2e-2, -7.5E+1]>\n",
+    parseSplit(document).c_str()
+  );
+}
+
+void test_escapes() {
+  const char* document = R"({"k\"ey": "a\"b\\c\/d\b\f\n\r\t\u00e9\u20AC\ud83d\ude00"})";
+
+  TEST_ASSERT_EQUAL_STRING(
+    "$ {\n"
+    "$.k\"ey str a\"b\\c/d\b\f\n\r\t\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80 "
+    "<\"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t\\u00e9\\u20AC\\ud83d\\ude00\">\n"
+    "$ } <" R"({"k\"ey": "a\"b\\c\/d\b\f\n\r\t\u00e9\u20AC\ud83d\ude00"})" ">\n",
+    parseSplit(document).c_str()
+  );
+}
+
+void test_invalid() {
+  const char* documents[] = {
+    "",
+    "   ",
+    R"({"a":01})",
+    "-",
+    "-01",
+    "1.",
+    ".5",
+    "1e",
+    "1e+",
+    "+1",
+    "0x10",
+    "tru",
+    "nul",
+    "True",
+    R"("abc)",
+    R"("a\x")",
+    "\"a\nb\"",
+    R"({"a":1,})",
+    R"({"a" 1})",
+    R"({"a":1 "b":2})",
+    R"({a:1})",
+    "[1 2]",
+    "[1,]",
+    "[1]]",
+    R"({"a":1}})",
+    "{} {}",
+    R"([1, 2)",
+  };
+
+  for (const char* document : documents) {
+    assertRejected(document);
+  }
+}
+
+void test_invalid_surrogates() {
+  const char* documents[] = {
+    R"("\ud800")",
+    R"("\ud800x")",
+    R"("\ud800\n")",
+    R"("\ud800\ud800")",
+    R"("\ud800A")",
+    R"("\udc00")",
+    R"({"\ud800":1})",
+    R"("\u12")",
+    R"("\u12g4")",
+  };
+
+  for (const char* document : documents) {
+    assertRejected(document);
+  }
+}
+
+void test_depth() {
+  const std::string ok = std::string(JSON_STREAM_MAX_DEPTH, '[') + std::string(JSON_STREAM_MAX_DEPTH, ']');
+  const std::string deep = "[" + ok + "]";
+
+  TEST_ASSERT_TRUE(parse(ok.c_str()) != "ERROR");
+  TEST_ASSERT_EQUAL_STRING("ERROR", parse(deep.c_str()).c_str());
+}
+
+void test_truncated_value() {
+  const std::string value(JSON_STREAM_MAX_TOKEN_SIZE + 10, 'v');
+  const std::string document = R"({"a":")" + value + R"(","b":"short"})";
+
+  Recorder recorder(document.c_str());
+  JsonStreamParser parser(recorder);
+  recorder.parser = &parser;
+
+  TEST_ASSERT_TRUE(parser.feed(document.c_str(), document.length()));
+  TEST_ASSERT_TRUE(parser.finish());
+  TEST_ASSERT_TRUE(recorder.sawTruncated);
+
+  // The value is a prefix, but its offsets cover all of it
+  const std::string expected = "$.a str " + value.substr(0, JSON_STREAM_MAX_TOKEN_SIZE)
+    + " <\"" + value + "\">\n";
+  TEST_ASSERT_TRUE(recorder.events.find(expected) != std::string::npos);
+  TEST_ASSERT_TRUE(recorder.events.find("$.b str short <\"short\">\n") != std::string::npos);
+}
+
+void test_truncated_key() {
+  const std::string key(JSON_STREAM_MAX_TOKEN_SIZE + 1, 'k');
+  const std::string document = "{\"" + key + "\":1}";
+
+  TEST_ASSERT_EQUAL_STRING("ERROR", parse(document.c_str()).c_str());
+}
+
+void test_reset() {
+  Recorder recorder("1");
+  JsonStreamParser parser(recorder);
+  recorder.parser = &parser;
+
+  TEST_ASSERT_FALSE(parser.feed("}", 1));
+  TEST_ASSERT_TRUE(parser.hasError());
+
+  parser.reset();
+  TEST_ASSERT_TRUE(parser.feed("1", 1));
+  TEST_ASSERT_TRUE(parser.finish());
+  TEST_ASSERT_EQUAL_STRING("$ num 1 <1>\n", recorder.events.c_str());
+}
+
+void test_merge_replaces_and_adds() {
+  TEST_ASSERT_EQUAL_STRING(
+    R"({"a":1,"b":"two","c":[3]})",
+    mergePatch(R"({"a":1,"b":2})", R"({"b":"two","c":[3]})").c_str()
+  );
+  TEST_ASSERT_EQUAL_STRING(R"({"a":1})", mergePatch(R"({})", R"({"a":1})").c_str());
+  TEST_ASSERT_EQUAL_STRING(R"({"a":1})", mergePatch(R"({"a":1})", R"({})").c_str());
+}
+
+void test_merge_nested() {
+  // Untouched members are copied byte for byte, whitespace and all
+  const char* source = R"( { "a" : { "x" : [1, {"y": 2}] }, "b": 1, "c": {"d": {"e": null}} } )";
+
+  TEST_ASSERT_EQUAL_STRING(
+    R"({"a":{ "x" : [1, {"y": 2}] },"b":2,"c":{"d": {"e": null}}})",
+    mergePatch(source, R"({"b":2})").c_str()
+  );
+
+  // Nested objects are replaced, not merged
+  TEST_ASSERT_EQUAL_STRING(
+    R"({"a":{"z":1},"b":1,"c":{"d": {"e": null}}})",
+    mergePatch(source, R"({"a":{"z":1}})").c_str()
+  );
+}
+
+void test_merge_null_removes() {
+  TEST_ASSERT_EQUAL_STRING(R"({"a":1,"c":3})", mergePatch(R"({"a":1,"b":[2],"c":3})", R"({"b":null})").c_str());
+  TEST_ASSERT_EQUAL_STRING(R"({"b":2})", mergePatch(R"({"a":{"x":1},"b":2})", R"({"a":null})").c_str());
+  TEST_ASSERT_EQUAL_STRING(R"({})", mergePatch(R"({"a":1})", R"({"a":null})").c_str());
+
+  // Removing a member that isn't there does nothing
+  TEST_ASSERT_EQUAL_STRING(R"({"a":1})", mergePatch(R"({"a":1})", R"({"z":null})").c_str());
+}
+
+void test_merge_strings_with_delimiters() {
+  const char* source = R"({"s":"}{\"]","k\"}":"a\\\"}","t":"[,:]"})";
+
+  TEST_ASSERT_EQUAL_STRING(
+    R"({"s":"}{\"]","k\"}":"a\\\"}","t":"x","n\"{":"\"}"})",
+    mergePatch(source, R"({"t":"x","n\"{":"\"}"})").c_str()
+  );
+  TEST_ASSERT_EQUAL_STRING(
+    R"({"s":"}{\"]","t":"[,:]"})",
+    mergePatch(source, R"({"k\"}":null})").c_str()
+  );
+}
+
+void test_merge_large_member() {
+  // Bigger than both the copy buffer and the parser's token buffer
+  const std::string big(JSON_STREAM_MAX_TOKEN_SIZE * 2, 'x');
+  std::string array = "[";
+  for (size_t i = 0; i < 300; ++i) {
+    array += (i > 0 ? "," : "") + std::to_string(i);
+  }
+  array += "]";
+
+  const std::string source = R"({"big":")" + big + R"(","array":)" + array + R"(,"n":1})";
+
+  TEST_ASSERT_EQUAL_STRING(
+    (R"({"big":")" + big + R"(","array":)" + array + R"(,"n":2})").c_str(),
+    mergePatch(source, R"({"n":2})").c_str()
+  );
+}
+
+void test_merge_invalid_source() {
+  TEST_ASSERT_EQUAL_STRING("ERROR", mergePatch("[1]", R"({"a":1})").c_str());
+  TEST_ASSERT_EQUAL_STRING("ERROR", mergePatch(R"("a")", R"({"a":1})").c_str());
+  TEST_ASSERT_EQUAL_STRING("ERROR", mergePatch(R"({"a":1)", R"({"a":1})").c_str());
+  TEST_ASSERT_EQUAL_STRING("ERROR", mergePatch(R"({"a":01})", R"({"a":1})").c_str());
+  TEST_ASSERT_EQUAL_STRING("ERROR", mergePatch("", R"({"a":1})").c_str());
+}
+
+int main(int argc, char** argv) {
+  Serial.setOutput(nullptr);
+
+  UNITY_BEGIN();
+
+  RUN_TEST(test_nested);
+  RUN_TEST(test_root_scalars);
+  RUN_TEST(test_numbers);
+  RUN_TEST(test_escapes);
+  RUN_TEST(test_invalid);
+  RUN_TEST(test_invalid_surrogates);
+  RUN_TEST(test_depth);
+  RUN_TEST(test_truncated_value);
+  RUN_TEST(test_truncated_key);
+  RUN_TEST(test_reset);
+  RUN_TEST(test_merge_replaces_and_adds);
+  RUN_TEST(test_merge_nested);
+  RUN_TEST(test_merge_null_removes);
+  RUN_TEST(test_merge_strings_with_delimiters);
+  RUN_TEST(test_merge_large_member);
+  RUN_TEST(test_merge_invalid_source);
+
+  return UNITY_END();
+}
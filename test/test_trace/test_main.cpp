@@ -0,0 +1,276 @@
+#include <Arduino.h>
+#include <FS.h>
+#include <NativeClock.h>
+#include <UpdateTrace.h>
+#include <UpdateTraceRecorder.h>
+#include <unity.h>
+
+#include <vector>
+
+static const char TRACE_FILENAME[] = "/trace.bin";
+
+static std::vector<uint8_t> readFile(const char* path) {
+  File file = SPIFFS.open(path, "r");
+  std::vector<uint8_t> contents(file.size());
+
+  file.read(contents.data(), contents.size());
+  file.close();
+
+  return contents;
+}
+
+static VariableBatch batchOf(const char* key, const char* value) {
+  VariableBatch batch;
+  batch[key] = value;
+  return batch;
+}
+
+static void advanceMillis(unsigned long ms) {
+  NativeClock::advance(static_cast<uint64_t>(ms) * 1000);
+}
+
+void setUp() {
+  SPIFFS.format();
+  NativeClock::set(0);
+}
+
+void tearDown() {}
+
+void test_round_trip() {
+  UpdateTraceEncoder encoder;
+  std::vector<uint8_t> trace;
+
+  VariableBatch batch;
+  batch["humidity"] = "40";
+  batch["temperature"] = "21.5";
+
+  encoder.begin(trace);
+  encoder.encode(trace, UpdateEventType::VARIABLE, UpdateSource::MQTT, 0, batchOf("temperature", "21"));
+  encoder.encode(trace, UpdateEventType::SUSPEND, UpdateSource::MQTT, 300, VariableBatch());
+  encoder.encode(trace, UpdateEventType::BATCH, UpdateSource::HTTP, 20000, batch);
+  encoder.encode(trace, UpdateEventType::RESUME, UpdateSource::MQTT, 5, VariableBatch());
+
+  UpdateTraceReader reader(trace.data(), trace.size());
+  UpdateEvent event;
+
+  TEST_ASSERT_TRUE(reader.isValid());
+
+  TEST_ASSERT_TRUE(reader.next(event));
+  TEST_ASSERT_TRUE(event.type == UpdateEventType::VARIABLE);
+  TEST_ASSERT_TRUE(event.source == UpdateSource::MQTT);
+  TEST_ASSERT_EQUAL(0, event.time);
+  TEST_ASSERT_EQUAL_STRING("21", event.values["temperature"].c_str());
+
+  TEST_ASSERT_TRUE(reader.next(event));
+  TEST_ASSERT_TRUE(event.type == UpdateEventType::SUSPEND);
+  TEST_ASSERT_EQUAL(300, event.time);
+  TEST_ASSERT_EQUAL(0, event.values.size());
+
+  TEST_ASSERT_TRUE(reader.next(event));
+  TEST_ASSERT_TRUE(event.type == UpdateEventType::BATCH);
+  TEST_ASSERT_TRUE(event.source == UpdateSource::HTTP);
+  TEST_ASSERT_EQUAL(20300, event.time);
+  TEST_ASSERT_EQUAL(2, event.values.size());
+  TEST_ASSERT_EQUAL_STRING("40", event.values["humidity"].c_str());
+  TEST_ASSERT_EQUAL_STRING("21.5", event.values["temperature"].c_str());
+
+  TEST_ASSERT_TRUE(reader.next(event));
+  TEST_ASSERT_TRUE(event.type == UpdateEventType::RESUME);
+  TEST_ASSERT_EQUAL(20305, event.time);
+
+  TEST_ASSERT_FALSE(reader.next(event));
+  TEST_ASSERT_FALSE(reader.isTruncated());
+}
+
+void test_keys_are_written_once() {
+  UpdateTraceEncoder encoder;
+  std::vector<uint8_t> trace;
+
+  encoder.begin(trace);
+  encoder.encode(trace, UpdateEventType::VARIABLE, UpdateSource::MQTT, 0, batchOf("temperature", "21"));
+  const size_t first = trace.size() - UpdateTrace::HEADER_SIZE;
+
+  encoder.encode(trace, UpdateEventType::VARIABLE, UpdateSource::MQTT, 0, batchOf("temperature", "22"));
+  const size_t second = trace.size() - UpdateTrace::HEADER_SIZE - first;
+
+  // tag, delay, key id, value length, "22"
+  TEST_ASSERT_EQUAL(6, second);
+  TEST_ASSERT_EQUAL(second + strlen("temperature") + 1, first);
+}
+
+void test_invalid_header() {
+  const uint8_t data[] = {'E', 'P', 'T', 'R', 99};
+  UpdateTraceReader reader(data, sizeof(data));
+  UpdateEvent event;
+
+  TEST_ASSERT_FALSE(reader.isValid());
+  TEST_ASSERT_FALSE(reader.next(event));
+}
+
+void test_truncated() {
+  UpdateTraceEncoder encoder;
+  std::vector<uint8_t> trace;
+
+  encoder.begin(trace);
+  encoder.encode(trace, UpdateEventType::VARIABLE, UpdateSource::MQTT, 10, batchOf("a", "1"));
+  encoder.encode(trace, UpdateEventType::VARIABLE, UpdateSource::MQTT, 10, batchOf("b", "2"));
+
+  UpdateTraceReader reader(trace.data(), trace.size() - 1);
+  UpdateEvent event;
+
+  TEST_ASSERT_TRUE(reader.next(event));
+  TEST_ASSERT_EQUAL_STRING("1", event.values["a"].c_str());
+  TEST_ASSERT_FALSE(reader.next(event));
+  TEST_ASSERT_TRUE(reader.isTruncated());
+}
+
+void test_rollback() {
+  UpdateTraceEncoder encoder;
+  std::vector<uint8_t> trace;
+
+  encoder.begin(trace);
+  const size_t start = trace.size();
+  encoder.encode(trace, UpdateEventType::VARIABLE, UpdateSource::MQTT, 10, batchOf("a", "1"));
+  encoder.rollback(trace, start);
+  TEST_ASSERT_EQUAL(start, trace.size());
+
+  // "a" has to be introduced again
+  encoder.encode(trace, UpdateEventType::VARIABLE, UpdateSource::MQTT, 10, batchOf("a", "2"));
+
+  UpdateTraceReader reader(trace.data(), trace.size());
+  UpdateEvent event;
+
+  TEST_ASSERT_TRUE(reader.next(event));
+  TEST_ASSERT_EQUAL_STRING("2", event.values["a"].c_str());
+  TEST_ASSERT_FALSE(reader.next(event));
+  TEST_ASSERT_FALSE(reader.isTruncated());
+}
+
+void test_record_to_file() {
+  UpdateTraceRecorder recorder;
+
+  // Not recording
+  recorder.recordVariable(UpdateSource::MQTT, "ignored", "1");
+
+  TEST_ASSERT_TRUE(recorder.startFile(TRACE_FILENAME));
+  advanceMillis(50);
+  recorder.recordVariable(UpdateSource::MQTT, "temperature", "21");
+  advanceMillis(25);
+  recorder.recordBatch(UpdateSource::HTTP, batchOf("humidity", "40"));
+  recorder.stop();
+
+  recorder.recordVariable(UpdateSource::MQTT, "ignored", "2");
+
+  std::vector<uint8_t> trace = readFile(TRACE_FILENAME);
+  UpdateTraceReader reader(trace.data(), trace.size());
+  UpdateEvent event;
+
+  TEST_ASSERT_TRUE(reader.next(event));
+  TEST_ASSERT_TRUE(event.source == UpdateSource::MQTT);
+  TEST_ASSERT_EQUAL(50, event.time);
+  TEST_ASSERT_EQUAL_STRING("21", event.values["temperature"].c_str());
+
+  TEST_ASSERT_TRUE(reader.next(event));
+  TEST_ASSERT_TRUE(event.type == UpdateEventType::BATCH);
+  TEST_ASSERT_EQUAL(75, event.time);
+
+  TEST_ASSERT_FALSE(reader.next(event));
+  TEST_ASSERT_FALSE(reader.isTruncated());
+}
+
+void test_flushes_on_interval() {
+  UpdateTraceRecorder recorder;
+
+  recorder.startFile(TRACE_FILENAME);
+  recorder.recordVariable(UpdateSource::MQTT, "a", "1");
+
+  recorder.loop();
+  TEST_ASSERT_EQUAL(0, readFile(TRACE_FILENAME).size());
+
+  advanceMillis(UPDATE_TRACE_FLUSH_INTERVAL);
+  recorder.loop();
+  TEST_ASSERT_GREATER_THAN(UpdateTrace::HEADER_SIZE, readFile(TRACE_FILENAME).size());
+}
+
+void test_drops_when_buffer_is_full() {
+  UpdateTraceRecorder recorder;
+  const String value(std::string(UPDATE_TRACE_BUFFER_SIZE / 4, 'x').c_str());
+
+  recorder.startFile(TRACE_FILENAME);
+
+  for (size_t i = 0; i < 5; ++i) {
+    recorder.recordVariable(UpdateSource::MQTT, "a", value);
+  }
+  recorder.stop();
+
+  StaticJsonDocument<256> status;
+  recorder.dumpStatus(status.to<JsonObject>());
+  TEST_ASSERT_EQUAL(3, status["events"].as<int>());
+  TEST_ASSERT_EQUAL(2, status["dropped"].as<int>());
+
+  std::vector<uint8_t> trace = readFile(TRACE_FILENAME);
+  UpdateTraceReader reader(trace.data(), trace.size());
+  UpdateEvent event;
+  size_t events = 0;
+
+  while (reader.next(event)) {
+    ++events;
+  }
+
+  TEST_ASSERT_EQUAL(3, events);
+  TEST_ASSERT_FALSE(reader.isTruncated());
+}
+
+void test_stream() {
+  UpdateTraceRecorder recorder;
+  std::vector<uint8_t> received;
+  bool accept = true;
+
+  recorder.startStream([&](const uint8_t* data, size_t length) {
+    if (accept) {
+      received.insert(received.end(), data, data + length);
+    }
+    return accept;
+  });
+
+  // The header is sent straight away
+  TEST_ASSERT_EQUAL(UpdateTrace::HEADER_SIZE, received.size());
+
+  recorder.recordVariable(UpdateSource::MQTT, "a", "1");
+  advanceMillis(UPDATE_TRACE_FLUSH_INTERVAL);
+  recorder.loop();
+
+  UpdateTraceReader reader(received.data(), received.size());
+  UpdateEvent event;
+  TEST_ASSERT_TRUE(reader.next(event));
+  TEST_ASSERT_EQUAL_STRING("1", event.values["a"].c_str());
+
+  // A chunk that can't be sent ends the trace
+  accept = false;
+  recorder.recordVariable(UpdateSource::MQTT, "a", "2");
+  advanceMillis(UPDATE_TRACE_FLUSH_INTERVAL);
+  recorder.loop();
+
+  TEST_ASSERT_FALSE(recorder.isRecording());
+}
+
+int main(int argc, char** argv) {
+  Serial.setOutput(nullptr);
+
+  UNITY_BEGIN();
+
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_keys_are_written_once);
+  RUN_TEST(test_invalid_header);
+  RUN_TEST(test_truncated);
+  RUN_TEST(test_rollback);
+
+  RUN_TEST(test_record_to_file);
+  RUN_TEST(test_flushes_on_interval);
+  RUN_TEST(test_drops_when_buffer_is_full);
+  RUN_TEST(test_stream);
+
+  NativeClock::release();
+
+  return UNITY_END();
+}
@@ -0,0 +1,341 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <TokenIterator.h>
+#include <VariableFormatters.h>
+#include <unity.h>
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+// Formats value with the formatter described by the JSON spec
+static String format(const char* spec, const char* value, const char* refs = "{}") {
+  DynamicJsonDocument refsDoc(1024);
+  DynamicJsonDocument specDoc(1024);
+  deserializeJson(refsDoc, refs);
+  deserializeJson(specDoc, spec);
+
+  VariableFormatterFactory factory(refsDoc.as<JsonVariant>());
+  return factory.create(specDoc.as<JsonObject>())->format(value);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_identity() {
+  TEST_ASSERT_EQUAL_STRING("abc", format("{}", "abc").c_str());
+  TEST_ASSERT_EQUAL_STRING("abc", format(R"({"formatter":"unknown"})", "abc").c_str());
+}
+
+void test_round() {
+  const char* spec = R"({"formatter":{"type":"round","args":{"digits":1}}})";
+
+  TEST_ASSERT_EQUAL_STRING("21.5", format(spec, "21.46").c_str());
+  TEST_ASSERT_EQUAL_STRING("3", format(R"({"formatter":"round"})", "2.7").c_str());
+}
+
+void test_ratio() {
+  const char* spec = R"({"formatter":{"type":"ratio","args":{"base":4}}})";
+
+  TEST_ASSERT_EQUAL_STRING("0.50", format(spec, "2").c_str());
+}
+
+void test_cases() {
+  const char* spec = R"({"formatter":{"type":"cases","args":{
+    "cases":{"on":"ON","off":"OFF"},
+    "default":"?"
+  }}})";
+
+  TEST_ASSERT_EQUAL_STRING("ON", format(spec, "on").c_str());
+  TEST_ASSERT_EQUAL_STRING("OFF", format(spec, "off").c_str());
+  TEST_ASSERT_EQUAL_STRING("?", format(spec, "unknown").c_str());
+}
+
+void test_range_cases() {
+  const char* spec = R"({"formatter":{"type":"range_cases","args":{
+    "ranges":[{"min":0,"value":"cold"},{"min":15,"value":"mild"},{"min":25,"value":"hot"}],
+    "default":"freezing"
+  }}})";
+
+  TEST_ASSERT_EQUAL_STRING("freezing", format(spec, "-3").c_str());
+  TEST_ASSERT_EQUAL_STRING("cold", format(spec, "0").c_str());
+  TEST_ASSERT_EQUAL_STRING("mild", format(spec, "21").c_str());
+  TEST_ASSERT_EQUAL_STRING("hot", format(spec, "40").c_str());
+}
+
+void test_printf() {
+  TEST_ASSERT_EQUAL_STRING("T=21.5C",
+      format(R"({"formatter":{"type":"pfnumeric","args":{"format":"T=%.1fC"}}})", "21.46").c_str());
+  TEST_ASSERT_EQUAL_STRING("[abc]",
+      format(R"({"formatter":{"type":"pfstring","args":{"format":"[%s]"}}})", "abc").c_str());
+}
+
+static String pfnumeric(const char* format, const char* value) {
+  String spec = R"({"formatter":{"type":"pfnumeric","args":{"format":")";
+  spec += format;
+  spec += R"("}}})";
+
+  return ::format(spec.c_str(), value);
+}
+
+static void assertMatchesLibc(const char* format, double value) {
+  char input[64];
+  char expected[512];
+  snprintf(input, sizeof(input), "%.17g", value);
+  snprintf(expected, sizeof(expected), format, value);
+
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(expected, pfnumeric(format, input).c_str(), input);
+}
+
+void test_printf_float_rounding() {
+  // Exact ties round to even, like libc
+  assertMatchesLibc("%.1f", 0.25);
+  assertMatchesLibc("%.1f", 0.75);
+  assertMatchesLibc("%.0f", 2.5);
+  assertMatchesLibc("%.0f", 3.5);
+  // Not quite ties in binary
+  assertMatchesLibc("%.1f", 0.15);
+  assertMatchesLibc("%.1f", 0.35);
+  assertMatchesLibc("%.2f", 1.005);
+  assertMatchesLibc("%.2f", 2.675);
+
+  srand(1);
+  for (int i = 0; i < 2000; ++i) {
+    char format[8];
+    snprintf(format, sizeof(format), "%%.%df", rand() % 10);
+    assertMatchesLibc(format, (rand() - RAND_MAX / 2) / static_cast<double>(1 << (rand() % 20)));
+  }
+}
+
+void test_printf_float_large() {
+  assertMatchesLibc("%.2f", 1e300);
+  assertMatchesLibc("%.9f", -123456789012345.0);
+  assertMatchesLibc("%+30.1f", 1e20);
+  assertMatchesLibc("%-30.0f|", 4503599627370497.0);
+}
+
+void test_expression() {
+  const char* spec = R"({"formatter":{"type":"expr","args":{
+    "expression":"x * 9 / 5 + 32",
+    "formatter":{"type":"round"}
+  }}})";
+
+  TEST_ASSERT_EQUAL_STRING("212", format(spec, "100").c_str());
+}
+
+static String expr(const char* expression, const char* value) {
+  String spec = R"({"formatter":{"type":"expr","args":{"expression":")";
+  spec += expression;
+  spec += R"("}}})";
+
+  return format(spec.c_str(), value);
+}
+
+void test_expression_precedence() {
+  TEST_ASSERT_EQUAL_STRING("7", expr("1 + 2 * 3", "0").c_str());
+  TEST_ASSERT_EQUAL_STRING("9", expr("(1 + 2) * 3", "0").c_str());
+  TEST_ASSERT_EQUAL_STRING("3", expr("10 - 4 - 3", "0").c_str());
+  TEST_ASSERT_EQUAL_STRING("2", expr("x % 4 * 1", "10").c_str());
+  TEST_ASSERT_EQUAL_STRING("5", expr("x / 2 / 2", "20").c_str());
+
+  // ^ binds tighter than unary minus, and is right associative
+  TEST_ASSERT_EQUAL_STRING("512", expr("2 ^ 3 ^ 2", "0").c_str());
+  TEST_ASSERT_EQUAL_STRING("-9", expr("-x ^ 2", "3").c_str());
+  TEST_ASSERT_EQUAL_STRING("0.5", expr("x ^ -1", "2").c_str());
+
+  TEST_ASSERT_EQUAL_STRING("12", expr("max(x, 2) * 3", "4").c_str());
+}
+
+void test_expression_unary() {
+  TEST_ASSERT_EQUAL_STRING("-5", expr("-x", "5").c_str());
+  TEST_ASSERT_EQUAL_STRING("5", expr("--x", "5").c_str());
+  TEST_ASSERT_EQUAL_STRING("5", expr("+x", "5").c_str());
+  TEST_ASSERT_EQUAL_STRING("-10", expr("2 * -x", "5").c_str());
+  TEST_ASSERT_EQUAL_STRING("7", expr("2 - -x", "5").c_str());
+  TEST_ASSERT_EQUAL_STRING("5", expr("abs(-x)", "5").c_str());
+}
+
+void test_expression_divide_by_zero() {
+  TEST_ASSERT_EQUAL_STRING("inf", expr("x / 0", "1").c_str());
+  TEST_ASSERT_EQUAL_STRING("-inf", expr("x / 0", "-1").c_str());
+  TEST_ASSERT_EQUAL_STRING("inf", expr("1 / x", "0").c_str());
+}
+
+void test_expression_bad_input() {
+  // Values that aren't numbers evaluate to NaN rather than 0
+  TEST_ASSERT_EQUAL_STRING("nan", expr("x + 1", "abc").c_str());
+  TEST_ASSERT_EQUAL_STRING("nan", expr("x + 1", "").c_str());
+
+  // A numeric prefix is used
+  TEST_ASSERT_EQUAL_STRING("22", expr("x + 1", "21C").c_str());
+
+  std::vector<ExpressionVariableFormatter::Instruction> program;
+
+  TEST_ASSERT_NOT_NULL(ExpressionVariableFormatter::compile("", program));
+  TEST_ASSERT_NOT_NULL(ExpressionVariableFormatter::compile("1 +", program));
+  TEST_ASSERT_NOT_NULL(ExpressionVariableFormatter::compile("(x", program));
+  TEST_ASSERT_NOT_NULL(ExpressionVariableFormatter::compile("x)", program));
+  TEST_ASSERT_NOT_NULL(ExpressionVariableFormatter::compile("x x", program));
+  TEST_ASSERT_NOT_NULL(ExpressionVariableFormatter::compile("y * 2", program));
+  TEST_ASSERT_NOT_NULL(ExpressionVariableFormatter::compile("min(x)", program));
+  TEST_ASSERT_NOT_NULL(ExpressionVariableFormatter::compile("sqrt x", program));
+}
+
+static std::string nested(size_t levels) {
+  return std::string(levels, '(') + "x" + std::string(levels, ')');
+}
+
+void test_expression_nesting() {
+  std::vector<ExpressionVariableFormatter::Instruction> program;
+
+  TEST_ASSERT_NULL(ExpressionVariableFormatter::compile(nested(5).c_str(), program));
+  TEST_ASSERT_NOT_NULL(ExpressionVariableFormatter::compile(nested(1000).c_str(), program));
+  TEST_ASSERT_NOT_NULL(ExpressionVariableFormatter::compile(std::string(1000, '-').append("x").c_str(), program));
+
+  // Bytes >= 0x80 aren't letters or digits
+  TEST_ASSERT_NOT_NULL(ExpressionVariableFormatter::compile("x * \xe9", program));
+}
+
+void test_pipeline() {
+  const char* spec = R"({"formatter":{"type":"pipeline","args":{"stages":[
+    {"type":"expr","args":{"expression":"x * 10"}},
+    {"type":"pfnumeric","args":{"format":"%.0f%%"}}
+  ]}}})";
+
+  TEST_ASSERT_EQUAL_STRING("50%", format(spec, "5").c_str());
+}
+
+void test_pipeline_edge_cases() {
+  const char* refs = R"({"half":{"type":"ratio","args":{"base":2}}})";
+
+  TEST_ASSERT_EQUAL_STRING("abc",
+      format(R"({"formatter":{"type":"pipeline","args":{"stages":[]}}})", "abc").c_str());
+  TEST_ASSERT_EQUAL_STRING("abc",
+      format(R"({"formatter":{"type":"pipeline"}})", "abc").c_str());
+  TEST_ASSERT_EQUAL_STRING("3",
+      format(R"({"formatter":{"type":"pipeline","args":{"stages":[{"type":"round"}]}}})", "2.7").c_str());
+
+  // References can be used as stages
+  TEST_ASSERT_EQUAL_STRING("1.50",
+      format(R"({"formatter":{"type":"pipeline","args":{"stages":[
+        {"type":"expr","args":{"expression":"x + 1"}},
+        {"type":"ref","ref":"half"}
+      ]}}})", "2", refs).c_str());
+}
+
+void test_pipeline_is_shared() {
+  DynamicJsonDocument specDoc(1024);
+  deserializeJson(specDoc, R"({"type":"pipeline","args":{"stages":[
+    {"type":"round"},
+    {"type":"cases","args":{"cases":{"1":"one","2":"two"}}}
+  ]}})");
+
+  VariableFormatterFactory factory(JsonVariant{});
+  auto formatter = factory.create(specDoc.as<JsonObject>());
+
+  // The same instance formats for several regions, in any order
+  TEST_ASSERT_EQUAL_STRING("one", formatter->format("1.2").c_str());
+  TEST_ASSERT_EQUAL_STRING("two", formatter->format("1.6").c_str());
+  TEST_ASSERT_EQUAL_STRING("one", formatter->format("0.9").c_str());
+}
+
+void test_pipeline_scratch() {
+  DynamicJsonDocument specDoc(1024);
+  deserializeJson(specDoc, R"({"type":"pipeline","args":{"stages":[
+    {"type":"expr","args":{"expression":"x * 10"}},
+    {"type":"round"},
+    {"type":"pfnumeric","args":{"format":"%.0f%%"}}
+  ]}})");
+
+  VariableFormatterFactory factory(JsonVariant{});
+  auto formatter = factory.create(specDoc.as<JsonObject>());
+  String result;
+  String scratch;
+
+  // Callers keep both buffers between updates, as regions do
+  formatter->formatIntoWithScratch("5.04", result, scratch);
+  TEST_ASSERT_EQUAL_STRING("50%", result.c_str());
+
+  formatter->formatIntoWithScratch("0.26", result, scratch);
+  TEST_ASSERT_EQUAL_STRING("3%", result.c_str());
+}
+
+void test_reference() {
+  const char* refs = R"({"half":{"type":"ratio","args":{"base":2}}})";
+
+  TEST_ASSERT_EQUAL_STRING("0.50",
+      format(R"({"formatter":{"type":"ref","ref":"half"}})", "1", refs).c_str());
+}
+
+void test_time() {
+  const char* spec = R"({"formatter":{"type":"time","args":{"timezone":"UTC","format":"%Y-%m-%d %H:%M"}}})";
+
+  TEST_ASSERT_EQUAL_STRING("2020-09-13 12:26", format(spec, "1600000000").c_str());
+}
+
+void test_token_iterator() {
+  char data[] = "a,bb,,ccc";
+  TokenIterator it(data, strlen(data));
+  String seen;
+
+  while (it.hasNext()) {
+    seen += '[';
+    seen += it.nextToken();
+    seen += ']';
+  }
+
+  TEST_ASSERT_EQUAL_STRING("[a][bb][][ccc]", seen.c_str());
+
+  it.reset();
+  TEST_ASSERT_EQUAL_STRING("a", it.nextToken());
+}
+
+void test_token_iterator_separator() {
+  char data[] = "/api/v1/variables";
+  TokenIterator it(data, strlen(data), '/');
+  String seen;
+
+  while (it.hasNext()) {
+    seen += '[';
+    seen += it.nextToken();
+    seen += ']';
+  }
+
+  TEST_ASSERT_EQUAL_STRING("[][api][v1][variables]", seen.c_str());
+}
+
+int main(int argc, char** argv) {
+  // strftime converts with the host's local timezone.  The device's is UTC.
+  setenv("TZ", "UTC", 1);
+  tzset();
+  Serial.setOutput(nullptr);
+
+  UNITY_BEGIN();
+
+  RUN_TEST(test_identity);
+  RUN_TEST(test_round);
+  RUN_TEST(test_ratio);
+  RUN_TEST(test_cases);
+  RUN_TEST(test_range_cases);
+  RUN_TEST(test_printf);
+  RUN_TEST(test_printf_float_rounding);
+  RUN_TEST(test_printf_float_large);
+  RUN_TEST(test_expression);
+  RUN_TEST(test_expression_precedence);
+  RUN_TEST(test_expression_unary);
+  RUN_TEST(test_expression_divide_by_zero);
+  RUN_TEST(test_expression_bad_input);
+  RUN_TEST(test_expression_nesting);
+  RUN_TEST(test_pipeline);
+  RUN_TEST(test_pipeline_edge_cases);
+  RUN_TEST(test_pipeline_is_shared);
+  RUN_TEST(test_pipeline_scratch);
+  RUN_TEST(test_reference);
+  RUN_TEST(test_time);
+
+  RUN_TEST(test_token_iterator);
+  RUN_TEST(test_token_iterator_separator);
+
+  return UNITY_END();
+}
@@ -29,10 +29,23 @@ export default {
     "mqtt.variables_topic_pattern": {
       $id: "#/properties/mqtt.variables_topic_pattern",
       type: "string",
-      title: "Variables Topic Pattern",
-      examples: ["template-displays/my-display/variables/:variable_name"],
+      title: "Variables Topic Patterns",
+      examples: ["template-displays/my-display/variables/:variable_name"]
+    },
+    "mqtt.variables_batch_topic": {
+      $id: "#/properties/mqtt.variables_batch_topic",
+      type: "string",
+      title: "Variables Batch Topic",
+      examples: ["template-displays/my-display/variables"],
       pattern: "^(.*)$"
     },
+    "mqtt.extraction_rules": {
+      $id: "#/properties/mqtt.extraction_rules",
+      type: "string",
+      title: "JSON Extraction Rules",
+      default: "",
+      examples: ["zigbee/livingroom $.temperature lr_temp"]
+    },
     "mqtt.client_status_topic": {
       $id: "#/properties/mqtt.client_status_topic",
       type: "string",
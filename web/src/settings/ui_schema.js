@@ -71,5 +71,15 @@ export default {
   },
   "mqtt.client_status_topic": {
     "ui:help": "If provided, MQTT birth and LWT messages will be published to this topic."
+  },
+  "mqtt.variables_topic_pattern": {
+    "ui:widget": "textarea",
+    "ui:placeholder": "template-displays/my-display/variables/:variable_name",
+    "ui:help": "One pattern per line, optionally followed by a variable name built from the pattern's tokens (e.g., sensors/:room/:variable_name :room_:variable_name)."
+  },
+  "mqtt.extraction_rules": {
+    "ui:widget": "textarea",
+    "ui:placeholder": "zigbee/livingroom $.temperature lr_temp",
+    "ui:help": "One rule per line: a topic, a JSONPath to a field in the JSON published to it, and the variable to store the field in."
   }
 };
@@ -61,11 +61,23 @@ const SvgLine = React.memo(
   })
 );
 
+const TextAnchors = {
+  left: "start",
+  center: "middle",
+  right: "end"
+};
+
 const SvgText = React.memo(
   React.forwardRef((props, ref) => {
     const {
       definition,
-      definition: { x = 0, y = 0, value: valueDef = {}, color = "black" },
+      definition: {
+        x = 0,
+        y = 0,
+        value: valueDef = {},
+        color = "black",
+        alignment = "left"
+      },
       onClick,
       isActive,
       resolvedValues,
@@ -92,6 +104,7 @@ const SvgText = React.memo(
         className={className}
         x={x}
         y={y}
+        textAnchor={TextAnchors[alignment] || "start"}
         style={style}
         className={isActive ? "active" : ""}
         onClick={onClick}
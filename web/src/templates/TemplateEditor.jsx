@@ -262,7 +262,15 @@ export default ({ isActive, path, template, triggerReload }) => {
           markSaved();
         },
         e => {
-          globalActions.addError("Error saving: " + e);
+          const errors = e.response && e.response.data && e.response.data.errors;
+
+          if (errors && errors.length > 0) {
+            errors.forEach(({ path, message }) =>
+              globalActions.addError(`Error saving: ${path || "/"}: ${message}`)
+            );
+          } else {
+            globalActions.addError("Error saving: " + e);
+          }
         }
       );
     },
@@ -262,7 +262,7 @@ export function VisualTemplateEditor({
                 type: "resolve",
                 variables: [[value.variable, value.formatter, id]]
               };
-              sendMessage(JSON.stringify(message));
+              sendMessage(message);
               setRvIndex(id, value);
             }
           });
@@ -274,9 +274,9 @@ export function VisualTemplateEditor({
   );
 
   useEffect(() => {
-    if (lastMessage && lastMessage.data) {
+    if (lastMessage) {
       try {
-        const parsed = JSON.parse(lastMessage.data);
+        const parsed = lastMessage;
 
         if (parsed.type == "resolve") {
           const next = produce(resolvedVariables, draft => {
@@ -296,20 +296,23 @@ export function VisualTemplateEditor({
             });
           });
           setResolvedVariables(next);
-        } else if (parsed.type == "region") {
-          if (isActive) {
-            const {id: regionId, k: key, v: value} = parsed.body;
-            const [type, id] = parseRegionIdentifier(regionId);
-
+        } else if (parsed.type == "batch") {
+          if (isActive && parsed.body.regions.length > 0) {
             const next = produce(resolvedVariables, draft => {
-              draft[type][id][key] = value;
+              parsed.body.regions.forEach(({id: regionId, k: key, v: value}) => {
+                const [type, id] = parseRegionIdentifier(regionId);
+
+                if (draft[type] && draft[type][id]) {
+                  draft[type][id][key] = value;
+                }
+              });
             });
             setResolvedVariables(next);
           }
         }
       } catch (err) {
         console.log(err);
-        console.warn("error handling websocket message", lastMessage.data);
+        console.warn("error handling websocket message", lastMessage);
       }
     }
   }, [isActive, resolvedVariables, rvIndex, lastMessage]);
@@ -96,6 +96,7 @@ const TextFields = {
     y: { $ref: "#/definitions/verticalPosition" },
     font: { $ref: "#/definitions/font" },
     font_size: { type: "integer", title: "Font Size" },
+    alignment: { $ref: "#/definitions/textAlignment" },
     color: { $ref: "#/definitions/color" },
     value: { title: "Value", $ref: "#/definitions/valueChoice" },
   },
@@ -173,6 +174,11 @@ const Definitions = {
     type: "string",
     enum: ["outline", "filled"],
   },
+  textAlignment: {
+    title: "Alignment",
+    type: "string",
+    enum: ["left", "center", "right"],
+  },
   storedBitmap: {
     type: "string",
   },
@@ -245,9 +251,12 @@ const Definitions = {
           "time",
           "round",
           "cases",
+          "range_cases",
           "ratio",
           "pfstring",
           "pfnumeric",
+          "expr",
+          "pipeline",
         ],
         enumNames: [
           "Pre-Defined Formatter",
@@ -255,9 +264,12 @@ const Definitions = {
           "Time (strftime)",
           "Round",
           "Cases",
+          "Range Cases",
           "Ratio",
           "Printf (String)",
-          "Printf (int)",
+          "Printf (numeric)",
+          "Expression",
+          "Pipeline",
         ],
       },
       args: {
@@ -312,6 +324,43 @@ const Definitions = {
               },
             },
           },
+          {
+            properties: {
+              type: {
+                enum: ["range_cases"],
+              },
+              args: {
+                type: "object",
+                properties: {
+                  prefix: {
+                    title: "Prefix",
+                    type: "string",
+                  },
+                  default: {
+                    title: "Default Value",
+                    type: "string",
+                  },
+                  ranges: {
+                    type: "array",
+                    title: "Ranges",
+                    items: {
+                      type: "object",
+                      properties: {
+                        min: {
+                          type: "number",
+                          title: "Lower Bound",
+                        },
+                        value: {
+                          type: "string",
+                          title: "Value",
+                        },
+                      },
+                    },
+                  },
+                },
+              },
+            },
+          },
           {
             properties: {
               type: {
@@ -393,9 +442,46 @@ const Definitions = {
                 type: "object",
                 properties: {
                   format: {
-                    title: "Printf (int)",
+                    title: "Printf (numeric)",
+                    type: "string",
+                  },
+                },
+              },
+            },
+          },
+          {
+            properties: {
+              type: {
+                enum: ["expr"],
+              },
+              args: {
+                type: "object",
+                properties: {
+                  expression: {
+                    title: "Expression (e.g., x * 1.8 + 32)",
                     type: "string",
                   },
+                  formatter: {
+                    title: "Output Formatter",
+                    $ref: "#/definitions/formatter",
+                  },
+                },
+              },
+            },
+          },
+          {
+            properties: {
+              type: {
+                enum: ["pipeline"],
+              },
+              args: {
+                type: "object",
+                properties: {
+                  stages: {
+                    title: "Stages",
+                    type: "array",
+                    items: { $ref: "#/definitions/formatter" },
+                  },
                 },
               },
             },
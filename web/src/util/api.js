@@ -1,15 +1,22 @@
-import React, { useMemo } from 'react'
+import React, { useCallback, useMemo } from 'react'
 import axios from "axios";
 import { ConcurrencyManager } from "axios-concurrency";
 import useWebSocket from 'react-use-websocket';
+import * as msgpack from "./msgpack";
 
 const api = axios.create({
   baseURL: "/api/v1"
 });
 
+// Messages are sent and received as MessagePack.  The server answers in JSON
+// until the encoding is negotiated, so text frames are still understood.
 export const useEpaperWebsocket = () => {
   const options = useMemo(() => ({
-    shouldReconnect: (closeEvent) => true
+    shouldReconnect: (closeEvent) => true,
+    onOpen: (event) => {
+      event.target.binaryType = "arraybuffer";
+      event.target.send(JSON.stringify({ type: "protocol", encoding: "msgpack" }));
+    }
   }), []);
 
   var loc = window.location, socketUrl;
@@ -21,7 +28,31 @@ export const useEpaperWebsocket = () => {
   socketUrl += "//" + loc.host;
   socketUrl += "/socket";
 
-  return useWebSocket(socketUrl, options);
+  const [sendRawMessage, lastRawMessage, readyState] = useWebSocket(socketUrl, options);
+
+  const sendMessage = useCallback(
+    message => sendRawMessage(msgpack.encode(message)),
+    [sendRawMessage]
+  );
+
+  const lastMessage = useMemo(() => {
+    if (!lastRawMessage || !lastRawMessage.data) {
+      return null;
+    }
+
+    try {
+      if (lastRawMessage.data instanceof ArrayBuffer) {
+        return msgpack.decode(lastRawMessage.data);
+      } else {
+        return JSON.parse(lastRawMessage.data);
+      }
+    } catch (err) {
+      console.warn("error decoding websocket message", err);
+      return null;
+    }
+  }, [lastRawMessage]);
+
+  return [sendMessage, lastMessage, readyState];
 }
 
 ConcurrencyManager(api, 1);
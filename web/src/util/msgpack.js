@@ -0,0 +1,185 @@
+// Minimal MessagePack codec for the WebSocket protocol.  Covers the types
+// ArduinoJson reads and writes: nil, booleans, numbers, strings, arrays and
+// maps.
+
+const textEncoder = new TextEncoder();
+const textDecoder = new TextDecoder();
+
+export const encode = value => {
+  const bytes = [];
+
+  const pushUint = (n, size) => {
+    for (let shift = (size - 1) * 8; shift >= 0; shift -= 8) {
+      bytes.push(Math.floor(n / Math.pow(2, shift)) & 0xff);
+    }
+  };
+
+  const pushHeader = (length, fixPrefix, fixMax, codes) => {
+    if (length <= fixMax) {
+      bytes.push(fixPrefix | length);
+    } else if (codes[0] && length < 0x100) {
+      bytes.push(codes[0], length);
+    } else if (length < 0x10000) {
+      bytes.push(codes[1]);
+      pushUint(length, 2);
+    } else {
+      bytes.push(codes[2]);
+      pushUint(length, 4);
+    }
+  };
+
+  const write = value => {
+    if (value === null || value === undefined) {
+      bytes.push(0xc0);
+    } else if (value === true || value === false) {
+      bytes.push(value ? 0xc3 : 0xc2);
+    } else if (typeof value === "number") {
+      if (Number.isInteger(value) && value >= 0 && value < 0x80) {
+        bytes.push(value);
+      } else if (Number.isInteger(value) && value >= -32 && value < 0) {
+        bytes.push(value & 0xff);
+      } else if (Number.isInteger(value) && value >= 0 && value <= 0xffffffff) {
+        bytes.push(0xce);
+        pushUint(value, 4);
+      } else {
+        const view = new DataView(new ArrayBuffer(8));
+        view.setFloat64(0, value);
+        bytes.push(0xcb, ...new Uint8Array(view.buffer));
+      }
+    } else if (typeof value === "string") {
+      const encoded = textEncoder.encode(value);
+      pushHeader(encoded.length, 0xa0, 31, [0xd9, 0xda, 0xdb]);
+      encoded.forEach(b => bytes.push(b));
+    } else if (Array.isArray(value)) {
+      pushHeader(value.length, 0x90, 15, [null, 0xdc, 0xdd]);
+      value.forEach(write);
+    } else {
+      const keys = Object.keys(value).filter(k => value[k] !== undefined);
+      pushHeader(keys.length, 0x80, 15, [null, 0xde, 0xdf]);
+      keys.forEach(k => {
+        write(k);
+        write(value[k]);
+      });
+    }
+  };
+
+  write(value);
+
+  return new Uint8Array(bytes);
+};
+
+export const decode = buffer => {
+  const view = new DataView(buffer);
+  const bytes = new Uint8Array(buffer);
+  let offset = 0;
+
+  const read = () => {
+    const type = bytes[offset++];
+
+    if (type < 0x80) {
+      return type;
+    } else if (type < 0x90) {
+      return readMap(type & 0x0f);
+    } else if (type < 0xa0) {
+      return readArray(type & 0x0f);
+    } else if (type < 0xc0) {
+      return readString(type & 0x1f);
+    } else if (type >= 0xe0) {
+      return type - 0x100;
+    }
+
+    let value;
+
+    switch (type) {
+      case 0xc0:
+        return null;
+      case 0xc2:
+        return false;
+      case 0xc3:
+        return true;
+      case 0xca:
+        value = view.getFloat32(offset);
+        offset += 4;
+        return value;
+      case 0xcb:
+        value = view.getFloat64(offset);
+        offset += 8;
+        return value;
+      case 0xcc:
+        return bytes[offset++];
+      case 0xcd:
+        value = view.getUint16(offset);
+        offset += 2;
+        return value;
+      case 0xce:
+        value = view.getUint32(offset);
+        offset += 4;
+        return value;
+      case 0xcf:
+        value = view.getUint32(offset) * 0x100000000 + view.getUint32(offset + 4);
+        offset += 8;
+        return value;
+      case 0xd0:
+        return view.getInt8(offset++);
+      case 0xd1:
+        value = view.getInt16(offset);
+        offset += 2;
+        return value;
+      case 0xd2:
+        value = view.getInt32(offset);
+        offset += 4;
+        return value;
+      case 0xd3:
+        value = view.getInt32(offset) * 0x100000000 + view.getUint32(offset + 4);
+        offset += 8;
+        return value;
+      case 0xd9:
+        return readString(bytes[offset++]);
+      case 0xda:
+        offset += 2;
+        return readString(view.getUint16(offset - 2));
+      case 0xdb:
+        offset += 4;
+        return readString(view.getUint32(offset - 4));
+      case 0xdc:
+        offset += 2;
+        return readArray(view.getUint16(offset - 2));
+      case 0xdd:
+        offset += 4;
+        return readArray(view.getUint32(offset - 4));
+      case 0xde:
+        offset += 2;
+        return readMap(view.getUint16(offset - 2));
+      case 0xdf:
+        offset += 4;
+        return readMap(view.getUint32(offset - 4));
+      default:
+        throw new Error("Unsupported MessagePack type: 0x" + type.toString(16));
+    }
+  };
+
+  const readString = length => {
+    const value = textDecoder.decode(bytes.subarray(offset, offset + length));
+    offset += length;
+    return value;
+  };
+
+  const readArray = length => {
+    const value = [];
+    for (let i = 0; i < length; i++) {
+      value.push(read());
+    }
+    return value;
+  };
+
+  const readMap = length => {
+    const value = {};
+    for (let i = 0; i < length; i++) {
+      const key = read();
+      value[key] = read();
+    }
+    return value;
+  };
+
+  return read();
+};
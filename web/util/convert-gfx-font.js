@@ -0,0 +1,90 @@
+#!/usr/bin/env node
+
+// Converts an Adafruit GFX font header (e.g., Fonts/FreeSerif12pt7b.h) to the
+// binary format read from the /f directory on the device.  See
+// lib/Display/SpiffsFontMetrics.h for a description of the format.
+//
+// Usage: node convert-gfx-font.js <font.h> [output file]
+
+const fs = require('fs')
+const path = require('path')
+
+const MAGIC = 'GFXF'
+const HEADER_SIZE = 8
+const GLYPH_SIZE = 8
+
+const stripComments = (source) => source
+  .replace(/\/\*[\s\S]*?\*\//g, '')
+  .replace(/\/\/.*$/gm, '')
+
+const parseNumber = (str) => parseInt(str.trim(), str.trim().match(/^-?0x/i) ? 16 : 10)
+
+const parseFont = (source) => {
+  source = stripComments(source)
+
+  const bitmapMatch = source.match(/uint8_t\s+\w+Bitmaps\[\]\s*PROGMEM\s*=\s*{([^}]*)}/)
+  const glyphsMatch = source.match(/GFXglyph\s+\w+Glyphs\[\]\s*PROGMEM\s*=\s*{([\s\S]*?)}\s*;/)
+  const fontMatch = source.match(/GFXfont\s+(\w+)\s*PROGMEM\s*=\s*{([^}]*)}/)
+
+  if (!bitmapMatch || !glyphsMatch || !fontMatch) {
+    throw new Error('Could not find bitmap, glyph and font definitions')
+  }
+
+  const bitmap = bitmapMatch[1]
+    .split(',')
+    .filter(x => x.trim().length > 0)
+    .map(parseNumber)
+
+  const glyphs = [...glyphsMatch[1].matchAll(/{([^}]*)}/g)]
+    .map(m => m[1].split(',').map(parseNumber))
+
+  const fontFields = fontMatch[2].split(',')
+  const [first, last, yAdvance] = fontFields.slice(-3).map(parseNumber)
+
+  if (glyphs.length !== last - first + 1) {
+    throw new Error(`Expected ${last - first + 1} glyphs, found ${glyphs.length}`)
+  }
+
+  return { name: fontMatch[1], bitmap, glyphs, first, last, yAdvance }
+}
+
+const serializeFont = ({ bitmap, glyphs, first, last, yAdvance }) => {
+  const buffer = Buffer.alloc(HEADER_SIZE + glyphs.length * GLYPH_SIZE + bitmap.length)
+
+  buffer.write(MAGIC, 0, 'ascii')
+  buffer.writeUInt8(first, 4)
+  buffer.writeUInt8(last, 5)
+  buffer.writeUInt8(yAdvance, 6)
+
+  glyphs.forEach(([bitmapOffset, width, height, xAdvance, xOffset, yOffset], i) => {
+    const offset = HEADER_SIZE + i * GLYPH_SIZE
+
+    buffer.writeUInt16LE(bitmapOffset, offset)
+    buffer.writeUInt8(width, offset + 2)
+    buffer.writeUInt8(height, offset + 3)
+    buffer.writeUInt8(xAdvance, offset + 4)
+    buffer.writeInt8(xOffset, offset + 5)
+    buffer.writeInt8(yOffset, offset + 6)
+  })
+
+  Buffer.from(bitmap).copy(buffer, HEADER_SIZE + glyphs.length * GLYPH_SIZE)
+
+  return buffer
+}
+
+if (require.main === module) {
+  const [input, output] = process.argv.slice(2)
+
+  if (!input) {
+    console.error('Usage: node convert-gfx-font.js <font.h> [output file]')
+    process.exit(1)
+  }
+
+  const font = parseFont(fs.readFileSync(input, 'utf8'))
+  const outputFile = output || path.join(path.dirname(input), font.name)
+
+  fs.writeFileSync(outputFile, serializeFont(font))
+  console.log(`Wrote ${outputFile}`)
+}
+
+module.exports = { parseFont, serializeFont }
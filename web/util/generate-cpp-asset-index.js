@@ -1,5 +1,11 @@
+const crypto = require("crypto")
+
 const PLUGIN_NAME = "GenerateCpAssetIndex"
 
+// Webpack names bundles with a content hash (e.g., main.1a2b3c4d.js), so they
+// can be cached forever.  Everything else has to be revalidated.
+const isHashedFilename = filename => /\.[0-9a-f]{8,}\./.test(filename)
+
 const buildCppAssetDefinition = (filename, source) => {
   const assetPath = `/${filename.replace(/.gz$/, "")}`
   const baseName = filename
@@ -16,6 +22,10 @@ const buildCppAssetDefinition = (filename, source) => {
   const lengthVar = `${baseName}_LENGTH`
   const lengthDefinition = `static const size_t ${lengthVar} = ${source.length};`
 
+  const etag = crypto.createHash("md5").update(source).digest("hex")
+  const etagVar = `${baseName}_ETAG`
+  const etagDefinition = `static const char ${etagVar}[] = "\\"${etag}\\"";`
+
   return {
     progmemSourceVar,
     progmemDefinition,
@@ -27,6 +37,10 @@ const buildCppAssetDefinition = (filename, source) => {
     lengthVar,
     lengthDefinition,
 
+    etagVar,
+    etagDefinition,
+    immutable: isHashedFilename(filename),
+
     source,
     assetPath,
     extension: assetPath.split('.').slice(-1)
@@ -54,6 +68,7 @@ struct cmp_str {
 ${definitions.map(x => x.pathDefinition).join("\n")}
 ${definitions.map(x => x.progmemDefinition).join("\n")}
 ${definitions.map(x => x.lengthDefinition).join("\n")}
+${definitions.map(x => x.etagDefinition).join("\n")}
 static const std::map<const char*, const char*, cmp_str> WEB_ASSET_CONTENT_TYPES = {\n${
   definitions
     .map(x => `{${x.pathVar},"${contentTypesByExtension[x.extension]}"}`)
@@ -64,6 +79,16 @@ static const std::map<const char*, size_t, cmp_str> WEB_ASSET_LENGTHS = {\n${
     .map(x => `{${x.pathVar},${x.lengthVar}}`)
     .join(",\n")
 }\n};
+static const std::map<const char*, const char*, cmp_str> WEB_ASSET_ETAGS = {\n${
+  definitions
+    .map(x => `{${x.pathVar},${x.etagVar}}`)
+    .join(",\n")
+}\n};
+static const std::map<const char*, bool, cmp_str> WEB_ASSET_IMMUTABLE = {\n${
+  definitions
+    .map(x => `{${x.pathVar},${x.immutable}}`)
+    .join(",\n")
+}\n};
 static const std::map<const char*, const uint8_t*> WEB_ASSET_CONTENTS = {\n${
   definitions
     .map(x => `{${x.pathVar},${x.progmemSourceVar}}`)